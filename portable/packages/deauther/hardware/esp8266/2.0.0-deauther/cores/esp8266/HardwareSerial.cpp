@@ -21,6 +21,7 @@
  Modified 31 March 2015 by Markus Sattler (rewrite the code for UART0 + UART1 support in ESP8266)
  Modified 25 April 2015 by Thomas Flayols (add configuration different from 8N1 in ESP8266)
  Modified 3 May 2015 by Hristo Gochkov (change register access methods)
+ Modified 2018 by ixty (sized tx buffer, bulk write, drop-on-full policy)
  */
 
 #include <stdlib.h>
@@ -478,10 +479,11 @@ int uart_get_debug() {
 // ####################################################################################################
 
 HardwareSerial::HardwareSerial(int uart_nr) :
-        _uart_nr(uart_nr), _uart(0), _tx_buffer(0), _rx_buffer(0), _written(false) {
+        _uart_nr(uart_nr), _uart(0), _tx_buffer(0), _rx_buffer(0), _written(false),
+        _tx_size(0), _tx_policy(SERIAL_TX_BLOCK), _tx_dropped(0), _tx_waits(0) {
 }
 
-void HardwareSerial::begin(unsigned long baud, byte config, byte mode) {
+void HardwareSerial::begin(unsigned long baud, byte config, byte mode, size_t tx_size) {
 
     // disable debug for this interface
     if(uart_get_debug() == _uart_nr) {
@@ -499,10 +501,17 @@ void HardwareSerial::begin(unsigned long baud, byte config, byte mode) {
             _rx_buffer = new cbuf(SERIAL_RX_BUFFER_SIZE);
     }
     if(_uart->txEnabled) {
+        if(_tx_buffer && _tx_size != tx_size) {
+            delete _tx_buffer;
+            _tx_buffer = 0;
+        }
         if(!_tx_buffer)
-            _tx_buffer = new cbuf(SERIAL_TX_BUFFER_SIZE);
+            _tx_buffer = new cbuf(tx_size);
+        _tx_size = tx_size;
     }
     _written = false;
+    _tx_dropped = 0;
+    _tx_waits = 0;
     delay(1);
 }
 
@@ -590,7 +599,11 @@ int HardwareSerial::availableForWrite(void) {
     if(_uart == 0)
         return 0;
     if(_uart->txEnabled) {
-        return static_cast<int>(_tx_buffer->room());
+        // write() goes straight to the fifo while nothing is queued ahead of it
+        size_t room = _tx_buffer->room();
+        if(_tx_buffer->empty())
+            room += uart_get_tx_fifo_room(_uart);
+        return static_cast<int>(room);
     } else {
         return 0;
     }
@@ -611,25 +624,42 @@ void HardwareSerial::flush() {
 }
 
 size_t HardwareSerial::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
     if(_uart == 0 || !_uart->txEnabled)
         return 0;
     _written = true;
-    size_t room = uart_get_tx_fifo_room(_uart);
-    if(room > 0 && _tx_buffer->empty()) {
-        uart_transmit_char(_uart, c);
-        if(room < 10) {
-            uart_arm_tx_interrupt(_uart);
-        }
-        return 1;
+
+    // nothing queued: as much as fits straight into the hardware fifo
+    size_t sent = 0;
+    if(_tx_buffer->empty()) {
+        size_t room = uart_get_tx_fifo_room(_uart);
+        for(; sent < size && room; ++sent, --room)
+            uart_transmit_char(_uart, buffer[sent]);
     }
 
-    while(_tx_buffer->room() == 0) {
-        yield();
+    // the rest into the buffer, the tx fifo empty interrupt moves it on
+    bool waited = false;
+    while(sent < size) {
+        sent += _tx_buffer->write((const char*) buffer + sent, size - sent);
         uart_arm_tx_interrupt(_uart);
-    }
+        if(sent == size)
+            break;
 
-    _tx_buffer->write(c);
-    return 1;
+        if(_tx_policy == SERIAL_TX_DROP) {
+            _tx_dropped += size - sent;
+            break;
+        }
+        if(!waited) {
+            waited = true;
+            ++_tx_waits;
+        }
+        while(_tx_buffer->room() == 0)
+            yield();
+    }
+    return sent;
 }
 
 HardwareSerial::operator bool() const {
@@ -658,4 +688,8 @@ void HardwareSerial::_tx_empty_irq(void) {
     while(n--) {
         uart_transmit_char(_uart, _tx_buffer->read());
     }
+    // drained: no need to come back once more just to find that out
+    if(_tx_buffer->empty()) {
+        uart_disarm_tx_interrupt(_uart);
+    }
 }
@@ -64,6 +64,10 @@
 #define SERIAL_RX_ONLY  1
 #define SERIAL_TX_ONLY  2
 
+// What write() does when the tx buffer is full, see setTxOverflow()
+#define SERIAL_TX_BLOCK 0   // yield until the tx interrupt made room (default)
+#define SERIAL_TX_DROP  1   // keep what fits, count the rest in txDropped()
+
 class cbuf;
 
 struct uart_;
@@ -79,7 +83,8 @@ class HardwareSerial: public Stream {
         void begin(unsigned long baud, uint8_t config) {
             begin(baud, config, SERIAL_FULL);
         }
-        void begin(unsigned long, uint8_t, uint8_t);
+        // tx_size: bytes written ahead of the line, drained by the tx fifo empty interrupt
+        void begin(unsigned long, uint8_t, uint8_t, size_t tx_size = SERIAL_TX_BUFFER_SIZE);
         void end();
         void swap();  //toggle between use of GPIO13/GPIO15 or GPIO3/GPIO1 as RX and TX
         int available(void) override;
@@ -100,9 +105,20 @@ class HardwareSerial: public Stream {
         inline size_t write(int n) {
             return write((uint8_t) n);
         }
+        size_t write(const uint8_t *buffer, size_t size) override;
         using Print::write; // pull in write(str) and write(buf, size) from Print
         operator bool() const;
 
+        void setTxOverflow(uint8_t policy) {
+            _tx_policy = policy;
+        }
+        uint32_t txDropped(void) const {    // bytes lost to SERIAL_TX_DROP since begin()
+            return _tx_dropped;
+        }
+        uint32_t txWaits(void) const {      // writes that had to wait for room since begin()
+            return _tx_waits;
+        }
+
         void setDebugOutput(bool);
         bool isTxEnabled(void);
         bool isRxEnabled(void);
@@ -118,6 +134,10 @@ class HardwareSerial: public Stream {
         cbuf* _tx_buffer;
         cbuf* _rx_buffer;
         bool _written;
+        size_t _tx_size;
+        uint8_t _tx_policy;
+        uint32_t _tx_dropped;
+        uint32_t _tx_waits;
 };
 
 extern HardwareSerial Serial;
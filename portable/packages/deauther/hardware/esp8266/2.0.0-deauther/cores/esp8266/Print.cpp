@@ -19,6 +19,7 @@
  Modified 23 November 2006 by David A. Mellis
  Modified December 2014 by Ivan Grokhotkov
  Modified May 2015 by Michael C. Miller - esp8266 progmem support
+ Modified 2018 by ixty - printf streams through printf_cb, no stack buffer
  */
 
 #include <stdlib.h>
@@ -28,6 +29,7 @@
 #include "Arduino.h"
 
 #include "Print.h"
+#include "printf_cb.h"
 extern "C" {
 #include "c_types.h"
 #include "ets_sys.h"
@@ -44,14 +46,33 @@ size_t ICACHE_FLASH_ATTR Print::write(const uint8_t *buffer, size_t size) {
     return n;
 }
 
+// printf_cb sink: each chunk goes straight to write(), counts what it took
+struct PrintfSink {
+  Print* print;
+  size_t written;
+};
+
+static void printf_sink(void* arg, const char* buf, size_t len) {
+  PrintfSink* sink = static_cast<PrintfSink*>(arg);
+  sink->written += sink->print->write((const uint8_t *) buf, len);
+}
+
 size_t Print::printf(const char *format, ...) {
+  PrintfSink sink = { this, 0 };
+  va_list arg;
+  va_start(arg, format);
+  vprintf_cb(printf_sink, &sink, format, arg);
+  va_end(arg);
+  return sink.written;
+}
+
+size_t Print::printf_P(PGM_P format, ...) {
+  PrintfSink sink = { this, 0 };
   va_list arg;
   va_start(arg, format);
-  char temp[1460];
-  size_t len = ets_vsnprintf(temp, 1460, format, arg);
-  len = print(temp);
+  vprintf_cb_P(printf_sink, &sink, format, arg);
   va_end(arg);
-  return len;
+  return sink.written;
 }
 
 size_t ICACHE_FLASH_ATTR Print::print(const __FlashStringHelper *ifsh) {
@@ -64,6 +64,7 @@ class Print {
         }
 
         size_t printf(const char * format, ...)  __attribute__ ((format (printf, 2, 3)));
+        size_t printf_P(PGM_P format, ...)  __attribute__ ((format (printf, 2, 3)));
         size_t print(const __FlashStringHelper *);
         size_t print(const String &);
         size_t print(const char[]);
@@ -5,6 +5,7 @@
  Copyright 2011, Paul Stoffregen, paul@pjrc.com
  Modified by Ivan Grokhotkov, 2014 - esp8266 support
  Modified by Michael C. Miller, 2015 - esp8266 progmem support
+ Modified by ixty, 2018 - short strings in place, moves take the buffer, geometric concat growth
 
  This library is free software; you can redistribute it and/or
  modify it under the terms of the GNU Lesser General Public
@@ -38,6 +39,8 @@ ICACHE_FLASH_ATTR String::String(const char *cstr) {
     init();
     if(cstr)
         copy(cstr, strlen(cstr));
+    else
+        invalidate();
 }
 
 ICACHE_FLASH_ATTR String::String(const String &value) {
@@ -118,8 +121,8 @@ ICACHE_FLASH_ATTR String::String(double value, unsigned char decimalPlaces) {
 }
 
 ICACHE_FLASH_ATTR String::~String() {
-    if(buffer) {
-        free(buffer);
+    if(!isSSO() && ptr.buff) {
+        free(ptr.buff);
     }
 }
 
@@ -127,57 +130,77 @@ ICACHE_FLASH_ATTR String::~String() {
 // /*  Memory Management                        */
 // /*********************************************/
 
+// empty, in place
 inline void String::init(void) {
-    buffer = NULL;
-    capacity = 0;
-    len = 0;
+    sso.isSSO = 1;
+    sso.len = 0;
+    sso.buff[0] = 0;
 }
 
 void ICACHE_FLASH_ATTR String::invalidate(void) {
-    if(buffer)
-        free(buffer);
-    buffer = NULL;
-    capacity = len = 0;
+    if(!isSSO() && ptr.buff)
+        free(ptr.buff);
+    sso.isSSO = 0;
+    ptr.buff = NULL;
+    ptr.cap = ptr.len = 0;
 }
 
 unsigned char ICACHE_FLASH_ATTR String::reserve(unsigned int size) {
-    if(buffer && capacity >= size)
+    if(buffer() && capacity() >= size)
         return 1;
     if(changeBuffer(size)) {
-        if(len == 0)
-            buffer[0] = 0;
+        if(len() == 0)
+            wbuffer()[0] = 0;
         return 1;
     }
     return 0;
 }
 
+// never gives up a heap buffer for the inline one: on failure the string is left as it was
 unsigned char ICACHE_FLASH_ATTR String::changeBuffer(unsigned int maxStrLen) {
+    if(maxStrLen < SSO_SIZE && (isSSO() || !ptr.buff)) {
+        if(!isSSO())
+            init();
+        return 1;
+    }
+    if(maxStrLen >= 0x7ffffff0)
+        return 0;
+
     size_t newSize = (maxStrLen + 16) & (~0xf);
-    char *newbuffer = (char *) malloc(newSize);
-    if(newbuffer) {
-        memset(newbuffer, 0, newSize);
-        memcpy(newbuffer, buffer, len);
-        if (buffer)
-            free(buffer);
-        capacity = newSize - 1;
-        buffer = newbuffer;
+    if(isSSO()) {
+        char *newbuffer = (char *) malloc(newSize);
+        if(!newbuffer)
+            return 0;
+        unsigned int oldLen = sso.len;
+        memcpy(newbuffer, sso.buff, oldLen + 1);
+        sso.isSSO = 0;
+        ptr.buff = newbuffer;
+        ptr.cap = newSize - 1;
+        ptr.len = oldLen;
         return 1;
     }
-    buffer = newbuffer;
-    return 0;
+
+    char *newbuffer = (char *) realloc(ptr.buff, newSize);
+    if(!newbuffer)
+        return 0;
+    ptr.buff = newbuffer;
+    ptr.cap = newSize - 1;
+    return 1;
 }
 
 // /*********************************************/
 // /*  Copy and Move                            */
 // /*********************************************/
 
+// cstr may point into this string (substring of itself)
 String & ICACHE_FLASH_ATTR String::copy(const char *cstr, unsigned int length) {
     if(!reserve(length)) {
         invalidate();
         return *this;
     }
-    len = length;
-    strcpy(buffer, cstr);
+    setLen(length);
+    memmove(wbuffer(), cstr, length);
+    wbuffer()[length] = 0;
     return *this;
 }
 
@@ -186,29 +209,18 @@ String & ICACHE_FLASH_ATTR String::copy(const __FlashStringHelper *pstr, unsigne
         invalidate();
         return *this;
     }
-    len = length;
-    strcpy_P(buffer, (PGM_P)pstr);
+    setLen(length);
+    strcpy_P(wbuffer(), (PGM_P)pstr);
     return *this;
 }
 
 #ifdef __GXX_EXPERIMENTAL_CXX0X__
+// takes rhs' heap buffer as it is (inline strings are copied), rhs is left empty
 void ICACHE_FLASH_ATTR String::move(String &rhs) {
-    if(buffer) {
-        if(capacity >= rhs.len) {
-            strcpy(buffer, rhs.buffer);
-            len = rhs.len;
-            rhs.len = 0;
-            return;
-        } else {
-            free(buffer);
-        }
-    }
-    buffer = rhs.buffer;
-    capacity = rhs.capacity;
-    len = rhs.len;
-    rhs.buffer = NULL;
-    rhs.capacity = 0;
-    rhs.len = 0;
+    static_assert(sizeof(_ptr) >= sizeof(_sso), "ptr has to cover sso");
+    invalidate();
+    ptr = rhs.ptr;          // covers sso as well
+    rhs.init();
 }
 #endif
 
@@ -216,8 +228,8 @@ String & ICACHE_FLASH_ATTR String::operator =(const String &rhs) {
     if(this == &rhs)
         return *this;
 
-    if(rhs.buffer)
-        copy(rhs.buffer, rhs.len);
+    if(rhs.buffer())
+        copy(rhs.buffer(), rhs.len());
     else
         invalidate();
 
@@ -260,19 +272,35 @@ String & ICACHE_FLASH_ATTR String::operator = (const __FlashStringHelper *pstr)
 // /*********************************************/
 
 unsigned char ICACHE_FLASH_ATTR String::concat(const String &s) {
-    return concat(s.buffer, s.len);
+    return concat(s.buffer(), s.len());
+}
+
+// appending one piece at a time: grow by half the capacity at least, so n appends cost
+// log(n) reallocations instead of n / 16 (falls back to the exact size when short on heap)
+static unsigned int concatCapacity(unsigned int capacity, unsigned int newlen) {
+    unsigned int grown = capacity + (capacity >> 1);
+    return (newlen > grown) ? newlen : grown;
 }
 
 unsigned char ICACHE_FLASH_ATTR String::concat(const char *cstr, unsigned int length) {
-    unsigned int newlen = len + length;
+    unsigned int newlen = len() + length;
     if(!cstr)
         return 0;
     if(length == 0)
         return 1;
-    if(!reserve(newlen))
-        return 0;
-    strcpy(buffer + len, cstr);
-    len = newlen;
+    if(newlen > capacity()) {
+        // s += s, or a piece of it: the buffer may move
+        const char *old = buffer();
+        bool self = old && cstr >= old && cstr <= old + len();
+        size_t offset = cstr - old;
+        if(!reserve(concatCapacity(capacity(), newlen)) && !reserve(newlen))
+            return 0;
+        if(self)
+            cstr = buffer() + offset;
+    }
+    memmove(wbuffer() + len(), cstr, length);
+    wbuffer()[newlen] = 0;
+    setLen(newlen);
     return 1;
 }
 
@@ -335,10 +363,10 @@ unsigned char ICACHE_FLASH_ATTR String::concat(const __FlashStringHelper * str)
     if (!str) return 0;
     int length = strlen_P((PGM_P)str);
     if (length == 0) return 1;
-    unsigned int newlen = len + length;
-    if (!reserve(newlen)) return 0;
-    strcpy_P(buffer + len, (PGM_P)str);
-    len = newlen;
+    unsigned int newlen = len() + length;
+    if (newlen > capacity() && !reserve(concatCapacity(capacity(), newlen)) && !reserve(newlen)) return 0;
+    strcpy_P(wbuffer() + len(), (PGM_P)str);
+    setLen(newlen);
     return 1;
 }
 
@@ -348,7 +376,7 @@ unsigned char ICACHE_FLASH_ATTR String::concat(const __FlashStringHelper * str)
 
 StringSumHelper & ICACHE_FLASH_ATTR operator +(const StringSumHelper &lhs, const String &rhs) {
     StringSumHelper &a = const_cast<StringSumHelper&>(lhs);
-    if(!a.concat(rhs.buffer, rhs.len))
+    if(!a.concat(rhs.buffer(), rhs.len()))
         a.invalidate();
     return a;
 }
@@ -428,26 +456,26 @@ StringSumHelper & ICACHE_FLASH_ATTR operator + (const StringSumHelper &lhs, cons
 // /*********************************************/
 
 int ICACHE_FLASH_ATTR String::compareTo(const String &s) const {
-    if(!buffer || !s.buffer) {
-        if(s.buffer && s.len > 0)
-            return 0 - *(unsigned char *) s.buffer;
-        if(buffer && len > 0)
-            return *(unsigned char *) buffer;
+    if(!buffer() || !s.buffer()) {
+        if(s.buffer() && s.len() > 0)
+            return 0 - *(unsigned char *) s.buffer();
+        if(buffer() && len() > 0)
+            return *(unsigned char *) buffer();
         return 0;
     }
-    return strcmp(buffer, s.buffer);
+    return strcmp(buffer(), s.buffer());
 }
 
 unsigned char ICACHE_FLASH_ATTR String::equals(const String &s2) const {
-    return (len == s2.len && compareTo(s2) == 0);
+    return (len() == s2.len() && compareTo(s2) == 0);
 }
 
 unsigned char ICACHE_FLASH_ATTR String::equals(const char *cstr) const {
-    if(len == 0)
+    if(len() == 0)
         return (cstr == NULL || *cstr == 0);
     if(cstr == NULL)
-        return buffer[0] == 0;
-    return strcmp(buffer, cstr) == 0;
+        return buffer()[0] == 0;
+    return strcmp(buffer(), cstr) == 0;
 }
 
 unsigned char ICACHE_FLASH_ATTR String::operator<(const String &rhs) const {
@@ -469,12 +497,12 @@ unsigned char ICACHE_FLASH_ATTR String::operator>=(const String &rhs) const {
 unsigned char ICACHE_FLASH_ATTR String::equalsIgnoreCase(const String &s2) const {
     if(this == &s2)
         return 1;
-    if(len != s2.len)
+    if(len() != s2.len())
         return 0;
-    if(len == 0)
+    if(len() == 0)
         return 1;
-    const char *p1 = buffer;
-    const char *p2 = s2.buffer;
+    const char *p1 = buffer();
+    const char *p2 = s2.buffer();
     while(*p1) {
         if(tolower(*p1++) != tolower(*p2++))
             return 0;
@@ -483,21 +511,21 @@ unsigned char ICACHE_FLASH_ATTR String::equalsIgnoreCase(const String &s2) const
 }
 
 unsigned char ICACHE_FLASH_ATTR String::startsWith(const String &s2) const {
-    if(len < s2.len)
+    if(len() < s2.len())
         return 0;
     return startsWith(s2, 0);
 }
 
 unsigned char ICACHE_FLASH_ATTR String::startsWith(const String &s2, unsigned int offset) const {
-    if(offset > len - s2.len || !buffer || !s2.buffer)
+    if(offset > len() - s2.len() || !buffer() || !s2.buffer())
         return 0;
-    return strncmp(&buffer[offset], s2.buffer, s2.len) == 0;
+    return strncmp(&buffer()[offset], s2.buffer(), s2.len()) == 0;
 }
 
 unsigned char ICACHE_FLASH_ATTR String::endsWith(const String &s2) const {
-    if(len < s2.len || !buffer || !s2.buffer)
+    if(len() < s2.len() || !buffer() || !s2.buffer())
         return 0;
-    return strcmp(&buffer[len - s2.len], s2.buffer) == 0;
+    return strcmp(&buffer()[len() - s2.len()], s2.buffer()) == 0;
 }
 
 // /*********************************************/
@@ -509,36 +537,36 @@ char ICACHE_FLASH_ATTR String::charAt(unsigned int loc) const {
 }
 
 void ICACHE_FLASH_ATTR String::setCharAt(unsigned int loc, char c) {
-    if(loc < len)
-        buffer[loc] = c;
+    if(loc < len())
+        wbuffer()[loc] = c;
 }
 
 char & ICACHE_FLASH_ATTR String::operator[](unsigned int index) {
     static char dummy_writable_char;
-    if(index >= len || !buffer) {
+    if(index >= len() || !buffer()) {
         dummy_writable_char = 0;
         return dummy_writable_char;
     }
-    return buffer[index];
+    return wbuffer()[index];
 }
 
 char ICACHE_FLASH_ATTR String::operator[](unsigned int index) const {
-    if(index >= len || !buffer)
+    if(index >= len() || !buffer())
         return 0;
-    return buffer[index];
+    return buffer()[index];
 }
 
 void ICACHE_FLASH_ATTR String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
     if(!bufsize || !buf)
         return;
-    if(index >= len) {
+    if(index >= len()) {
         buf[0] = 0;
         return;
     }
     unsigned int n = bufsize - 1;
-    if(n > len - index)
-        n = len - index;
-    strncpy((char *) buf, buffer + index, n);
+    if(n > len() - index)
+        n = len() - index;
+    strncpy((char *) buf, buffer() + index, n);
     buf[n] = 0;
 }
 
@@ -552,12 +580,12 @@ int ICACHE_FLASH_ATTR String::indexOf(char c) const {
 }
 
 int ICACHE_FLASH_ATTR String::indexOf(char ch, unsigned int fromIndex) const {
-    if(fromIndex >= len)
+    if(fromIndex >= len())
         return -1;
-    const char* temp = strchr(buffer + fromIndex, ch);
+    const char* temp = strchr(buffer() + fromIndex, ch);
     if(temp == NULL)
         return -1;
-    return temp - buffer;
+    return temp - buffer();
 }
 
 int ICACHE_FLASH_ATTR String::indexOf(const String &s2) const {
@@ -565,46 +593,46 @@ int ICACHE_FLASH_ATTR String::indexOf(const String &s2) const {
 }
 
 int ICACHE_FLASH_ATTR String::indexOf(const String &s2, unsigned int fromIndex) const {
-    if(fromIndex >= len)
+    if(fromIndex >= len())
         return -1;
-    const char *found = strstr(buffer + fromIndex, s2.buffer);
+    const char *found = strstr(buffer() + fromIndex, s2.buffer());
     if(found == NULL)
         return -1;
-    return found - buffer;
+    return found - buffer();
 }
 
 int ICACHE_FLASH_ATTR String::lastIndexOf(char theChar) const {
-    return lastIndexOf(theChar, len - 1);
+    return lastIndexOf(theChar, len() - 1);
 }
 
 int ICACHE_FLASH_ATTR String::lastIndexOf(char ch, unsigned int fromIndex) const {
-    if(fromIndex >= len)
+    if(fromIndex >= len())
         return -1;
-    char tempchar = buffer[fromIndex + 1];
-    buffer[fromIndex + 1] = '\0';
-    char* temp = strrchr(buffer, ch);
-    buffer[fromIndex + 1] = tempchar;
-    if(temp == NULL)
-        return -1;
-    return temp - buffer;
+    const char *b = buffer();
+    for(int i = fromIndex; i >= 0; i--) {
+        if(b[i] == ch)
+            return i;
+    }
+    return -1;
 }
 
 int ICACHE_FLASH_ATTR String::lastIndexOf(const String &s2) const {
-    return lastIndexOf(s2, len - s2.len);
+    return lastIndexOf(s2, len() - s2.len());
 }
 
 int ICACHE_FLASH_ATTR String::lastIndexOf(const String &s2, unsigned int fromIndex) const {
-    if(s2.len == 0 || len == 0 || s2.len > len)
+    if(s2.len() == 0 || len() == 0 || s2.len() > len())
         return -1;
-    if(fromIndex >= len)
-        fromIndex = len - 1;
+    if(fromIndex >= len())
+        fromIndex = len() - 1;
     int found = -1;
-    for(char *p = buffer; p <= buffer + fromIndex; p++) {
-        p = strstr(p, s2.buffer);
+    const char *b = buffer();
+    for(const char *p = b; p <= b + fromIndex; p++) {
+        p = strstr(p, s2.buffer());
         if(!p)
             break;
-        if((unsigned int) (p - buffer) <= fromIndex)
-            found = p - buffer;
+        if((unsigned int) (p - b) <= fromIndex)
+            found = p - b;
     }
     return found;
 }
@@ -616,14 +644,11 @@ String ICACHE_FLASH_ATTR String::substring(unsigned int left, unsigned int right
         left = temp;
     }
     String out;
-    if(left >= len)
+    if(left >= len())
         return out;
-    if(right > len)
-        right = len;
-    char temp = buffer[right];  // save the replaced character
-    buffer[right] = '\0';
-    out = buffer + left;  // pointer arithmetic
-    buffer[right] = temp;  //restore character
+    if(right > len())
+        right = len();
+    out.copy(buffer() + left, right - left);
     return out;
 }
 
@@ -632,54 +657,54 @@ String ICACHE_FLASH_ATTR String::substring(unsigned int left, unsigned int right
 // /*********************************************/
 
 void ICACHE_FLASH_ATTR String::replace(char find, char replace) {
-    if(!buffer)
+    if(!buffer())
         return;
-    for(char *p = buffer; *p; p++) {
+    for(char *p = wbuffer(); *p; p++) {
         if(*p == find)
             *p = replace;
     }
 }
 
 void ICACHE_FLASH_ATTR String::replace(const String& find, const String& replace) {
-    if(len == 0 || find.len == 0)
+    if(len() == 0 || find.len() == 0)
         return;
-    int diff = replace.len - find.len;
-    char *readFrom = buffer;
+    int diff = replace.len() - find.len();
+    char *readFrom = wbuffer();
     char *foundAt;
     if(diff == 0) {
-        while((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-            memcpy(foundAt, replace.buffer, replace.len);
-            readFrom = foundAt + replace.len;
+        while((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+            memcpy(foundAt, replace.buffer(), replace.len());
+            readFrom = foundAt + replace.len();
         }
     } else if(diff < 0) {
-        char *writeTo = buffer;
-        while((foundAt = strstr(readFrom, find.buffer)) != NULL) {
+        char *writeTo = wbuffer();
+        while((foundAt = strstr(readFrom, find.buffer())) != NULL) {
             unsigned int n = foundAt - readFrom;
-            memcpy(writeTo, readFrom, n);
+            memmove(writeTo, readFrom, n);
             writeTo += n;
-            memcpy(writeTo, replace.buffer, replace.len);
-            writeTo += replace.len;
-            readFrom = foundAt + find.len;
-            len += diff;
+            memcpy(writeTo, replace.buffer(), replace.len());
+            writeTo += replace.len();
+            readFrom = foundAt + find.len();
+            setLen(len() + diff);
         }
-        strcpy(writeTo, readFrom);
+        memmove(writeTo, readFrom, strlen(readFrom) + 1);
     } else {
-        unsigned int size = len; // compute size needed for result
-        while((foundAt = strstr(readFrom, find.buffer)) != NULL) {
-            readFrom = foundAt + find.len;
+        unsigned int size = len(); // compute size needed for result
+        while((foundAt = strstr(readFrom, find.buffer())) != NULL) {
+            readFrom = foundAt + find.len();
             size += diff;
         }
-        if(size == len)
+        if(size == len())
             return;
-        if(size > capacity && !changeBuffer(size))
+        if(size > capacity() && !changeBuffer(size))
             return; // XXX: tell user!
-        int index = len - 1;
+        int index = len() - 1;
         while(index >= 0 && (index = lastIndexOf(find, index)) >= 0) {
-            readFrom = buffer + index + find.len;
-            memmove(readFrom + diff, readFrom, len - (readFrom - buffer));
-            len += diff;
-            buffer[len] = 0;
-            memcpy(buffer + index, replace.buffer, replace.len);
+            readFrom = wbuffer() + index + find.len();
+            memmove(readFrom + diff, readFrom, len() - (readFrom - buffer()));
+            setLen(len() + diff);
+            wbuffer()[len()] = 0;
+            memcpy(wbuffer() + index, replace.buffer(), replace.len());
             index--;
         }
     }
@@ -693,50 +718,50 @@ void ICACHE_FLASH_ATTR String::remove(unsigned int index) {
 }
 
 void ICACHE_FLASH_ATTR String::remove(unsigned int index, unsigned int count) {
-    if(index >= len) {
+    if(index >= len()) {
         return;
     }
     if(count <= 0) {
         return;
     }
-    if(count > len - index) {
-        count = len - index;
+    if(count > len() - index) {
+        count = len() - index;
     }
-    char *writeTo = buffer + index;
-    len = len - count;
-    strncpy(writeTo, buffer + index + count, len - index);
-    buffer[len] = 0;
+    char *writeTo = wbuffer() + index;
+    setLen(len() - count);
+    memmove(writeTo, wbuffer() + index + count, len() - index);
+    wbuffer()[len()] = 0;
 }
 
 void ICACHE_FLASH_ATTR String::toLowerCase(void) {
-    if(!buffer)
+    if(!buffer())
         return;
-    for(char *p = buffer; *p; p++) {
+    for(char *p = wbuffer(); *p; p++) {
         *p = tolower(*p);
     }
 }
 
 void ICACHE_FLASH_ATTR String::toUpperCase(void) {
-    if(!buffer)
+    if(!buffer())
         return;
-    for(char *p = buffer; *p; p++) {
+    for(char *p = wbuffer(); *p; p++) {
         *p = toupper(*p);
     }
 }
 
 void ICACHE_FLASH_ATTR String::trim(void) {
-    if(!buffer || len == 0)
+    if(!buffer() || len() == 0)
         return;
-    char *begin = buffer;
+    char *begin = wbuffer();
     while(isspace(*begin))
         begin++;
-    char *end = buffer + len - 1;
+    char *end = wbuffer() + len() - 1;
     while(isspace(*end) && end >= begin)
         end--;
-    len = end + 1 - begin;
-    if(begin > buffer)
-        memcpy(buffer, begin, len);
-    buffer[len] = 0;
+    setLen(end + 1 - begin);
+    if(begin > buffer())
+        memmove(wbuffer(), begin, len());
+    wbuffer()[len()] = 0;
 }
 
 // /*********************************************/
@@ -744,13 +769,13 @@ void ICACHE_FLASH_ATTR String::trim(void) {
 // /*********************************************/
 
 long ICACHE_FLASH_ATTR String::toInt(void) const {
-    if(buffer)
-        return atol(buffer);
+    if(buffer())
+        return atol(buffer());
     return 0;
 }
 
 float ICACHE_FLASH_ATTR String::toFloat(void) const {
-    if(buffer)
-        return atof(buffer);
+    if(buffer())
+        return atof(buffer());
     return 0;
 }
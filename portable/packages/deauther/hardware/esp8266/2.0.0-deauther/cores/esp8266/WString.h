@@ -76,7 +76,7 @@ class String {
         // invalid string (i.e., "if (s)" will be true afterwards)
         unsigned char reserve(unsigned int size);
         inline unsigned int length(void) const {
-            return len;
+            return len();
         }
 
         // creates a copy of the assigned value.  if the value is null or
@@ -168,7 +168,7 @@ class String {
 
         // comparison (only works w/ Strings and "strings")
         operator StringIfHelperType() const {
-            return buffer ? &String::StringIfHelper : 0;
+            return buffer() ? &String::StringIfHelper : 0;
         }
         int compareTo(const String &s) const;
         unsigned char equals(const String &s) const;
@@ -204,7 +204,7 @@ class String {
             getBytes((unsigned char *) buf, bufsize, index);
         }
         const char * c_str() const {
-            return buffer;
+            return buffer();
         }
 
         // search
@@ -217,7 +217,7 @@ class String {
         int lastIndexOf(const String &str) const;
         int lastIndexOf(const String &str, unsigned int fromIndex) const;
         String substring(unsigned int beginIndex) const {
-            return substring(beginIndex, len);
+            return substring(beginIndex, len());
         }
         ;
         String substring(unsigned int beginIndex, unsigned int endIndex) const;
@@ -236,9 +236,46 @@ class String {
         float toFloat(void) const;
 
     protected:
-        char *buffer;	        // the actual char array
-        unsigned int capacity;  // the array length minus one (for the '\0')
-        unsigned int len;       // the String length (not counting the '\0')
+        // heap storage
+        struct _ptr {
+            char *buff;             // the actual char array, NULL for an invalid string
+            unsigned int cap;       // the array length minus one (for the '\0')
+            unsigned int len;       // the String length (not counting the '\0')
+        };
+        // short strings are kept in the object itself, no allocation. the last
+        // byte overlaps the top byte of a heap cap / len, which never has bit 7 set
+        enum { SSO_SIZE = 11 };     // chars + '\0', sizeof(String) stays 12 on the esp
+        struct _sso {
+            char buff[SSO_SIZE];
+            unsigned char len : 7;
+            unsigned char isSSO : 1;
+        };
+        union {
+            struct _ptr ptr;
+            struct _sso sso;
+        };
+
+        inline bool isSSO(void) const {
+            return sso.isSSO;
+        }
+        inline unsigned int len(void) const {
+            return isSSO() ? sso.len : ptr.len;
+        }
+        inline unsigned int capacity(void) const {
+            return isSSO() ? (unsigned int) SSO_SIZE - 1 : ptr.cap;
+        }
+        inline void setLen(unsigned int newLen) {
+            if(isSSO())
+                sso.len = newLen;
+            else
+                ptr.len = newLen;
+        }
+        inline const char *buffer(void) const {
+            return isSSO() ? sso.buff : ptr.buff;
+        }
+        inline char *wbuffer(void) {
+            return isSSO() ? sso.buff : ptr.buff;
+        }
     protected:
         void init(void);
         void invalidate(void);
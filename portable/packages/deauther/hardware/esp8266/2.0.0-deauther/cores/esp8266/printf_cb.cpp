@@ -0,0 +1,362 @@
+/*
+ printf_cb.cpp - printf straight into a callback, no intermediate buffer
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <pgmspace.h>
+#include "printf_cb.h"
+
+#define F_LEFT  0x01
+#define F_PLUS  0x02
+#define F_SPACE 0x04
+#define F_ALT   0x08
+#define F_ZERO  0x10
+#define F_UPPER 0x20
+
+enum {
+    L_INT,
+    L_CHAR,
+    L_SHORT,
+    L_LONG,
+    L_LLONG,
+    L_SIZE,
+    L_MAX,
+    L_DOUBLE,
+};
+
+typedef struct {
+    printf_cb_t cb;
+    void* arg;
+    int total;
+    size_t len;
+    char buf[PRINTF_CB_CHUNK];
+} printf_out_t;
+
+static inline char fmt_read(const char* p, bool progmem) {
+    return progmem ? (char) pgm_read_byte(p) : *p;
+}
+
+static void out_flush(printf_out_t* o) {
+    if(o->len) {
+        o->cb(o->arg, o->buf, o->len);
+        o->len = 0;
+    }
+}
+
+static void out_char(printf_out_t* o, char c) {
+    if(o->len == sizeof(o->buf))
+        out_flush(o);
+    o->buf[o->len++] = c;
+    o->total++;
+}
+
+static void out_fill(printf_out_t* o, char c, int n) {
+    while(n-- > 0)
+        out_char(o, c);
+}
+
+static void out_mem(printf_out_t* o, const char* s, size_t n, bool progmem) {
+    o->total += n;
+
+    // long enough to be worth a call of its own: no copy
+    if(!progmem && n >= sizeof(o->buf)) {
+        out_flush(o);
+        o->cb(o->arg, s, n);
+        return;
+    }
+
+    while(n) {
+        if(o->len == sizeof(o->buf))
+            out_flush(o);
+        size_t part = sizeof(o->buf) - o->len;
+        if(part > n)
+            part = n;
+        if(progmem)
+            memcpy_P(o->buf + o->len, s, part);
+        else
+            memcpy(o->buf + o->len, s, part);
+        o->len += part;
+        s += part;
+        n -= part;
+    }
+}
+
+static void out_padded(printf_out_t* o, const char* s, size_t n, bool progmem, int flags, int width) {
+    int pad = (width > (int) n) ? width - (int) n : 0;
+    if(!(flags & F_LEFT))
+        out_fill(o, ' ', pad);
+    out_mem(o, s, n, progmem);
+    if(flags & F_LEFT)
+        out_fill(o, ' ', pad);
+}
+
+static void out_number(printf_out_t* o, uint64_t v, bool neg, unsigned base, int flags, int width, int prec) {
+    const char* set = (flags & F_UPPER) ? "0123456789ABCDEF" : "0123456789abcdef";
+    char digits[24];
+    char* d = digits + sizeof(digits);  // filled from the end, most significant first
+    bool zero = (v == 0);
+
+    if(base == 10) {
+        // 64 bit divisions are a library call on the lx106, most values fit 32 bits
+        while(v > 0xffffffffull) {
+            *--d = '0' + (char) (v % 10);
+            v /= 10;
+        }
+        for(uint32_t v32 = (uint32_t) v; v32; v32 /= 10)
+            *--d = '0' + (char) (v32 % 10);
+    } else {
+        unsigned shift = (base == 16) ? 4 : 3;
+        for(; v; v >>= shift)
+            *--d = set[v & (base - 1)];
+    }
+    if(zero && prec != 0)
+        *--d = '0';
+    int n = digits + sizeof(digits) - d;
+
+    char prefix[2];
+    int np = 0;
+    if(neg)
+        prefix[np++] = '-';
+    else if(flags & F_PLUS)
+        prefix[np++] = '+';
+    else if(flags & F_SPACE)
+        prefix[np++] = ' ';
+    if((flags & F_ALT) && base == 16 && !zero) {
+        prefix[np++] = '0';
+        prefix[np++] = (flags & F_UPPER) ? 'X' : 'x';
+    }
+    if((flags & F_ALT) && base == 8 && (n == 0 || *d != '0') && prec <= n) {
+        *--d = '0';
+        n++;
+    }
+
+    int zeros = (prec > n) ? prec - n : 0;
+    int len = np + zeros + n;
+    int pad = (width > len) ? width - len : 0;
+    if((flags & F_ZERO) && !(flags & F_LEFT) && prec < 0) {
+        zeros += pad;
+        pad = 0;
+    }
+
+    if(!(flags & F_LEFT))
+        out_fill(o, ' ', pad);
+    out_mem(o, prefix, np, false);
+    out_fill(o, '0', zeros);
+    out_mem(o, d, n, false);
+    if(flags & F_LEFT)
+        out_fill(o, ' ', pad);
+}
+
+static size_t str_len(const char* s, int prec, bool progmem) {
+    if(!progmem && prec < 0)
+        return strlen(s);
+    size_t n = 0;
+    while((prec < 0 || n < (size_t) prec) && fmt_read(s + n, progmem))
+        n++;
+    return n;
+}
+
+static int printf_cb_impl(printf_cb_t cb, void* arg, const char* f, bool progmem, va_list ap) {
+    printf_out_t o;
+    o.cb = cb;
+    o.arg = arg;
+    o.total = 0;
+    o.len = 0;
+
+    while(true) {
+        // text up to the next conversion
+        const char* run = f;
+        char c;
+        while((c = fmt_read(f, progmem)) && c != '%')
+            f++;
+        out_mem(&o, run, f - run, progmem);
+        if(!c)
+            break;
+        const char* spec = f++;
+
+        int flags = 0;
+        for(;; f++) {
+            c = fmt_read(f, progmem);
+            if(c == '-')
+                flags |= F_LEFT;
+            else if(c == '+')
+                flags |= F_PLUS;
+            else if(c == ' ')
+                flags |= F_SPACE;
+            else if(c == '#')
+                flags |= F_ALT;
+            else if(c == '0')
+                flags |= F_ZERO;
+            else
+                break;
+        }
+
+        int width = 0;
+        if(c == '*') {
+            width = va_arg(ap, int);
+            if(width < 0) {
+                flags |= F_LEFT;
+                width = -width;
+            }
+            c = fmt_read(++f, progmem);
+        } else {
+            for(; c >= '0' && c <= '9'; c = fmt_read(++f, progmem))
+                width = width * 10 + (c - '0');
+        }
+
+        int prec = -1;
+        if(c == '.') {
+            prec = 0;
+            c = fmt_read(++f, progmem);
+            if(c == '*') {
+                prec = va_arg(ap, int);
+                if(prec < 0)
+                    prec = -1;
+                c = fmt_read(++f, progmem);
+            } else {
+                for(; c >= '0' && c <= '9'; c = fmt_read(++f, progmem))
+                    prec = prec * 10 + (c - '0');
+            }
+        }
+
+        int size = L_INT;
+        if(c == 'h') {
+            size = L_SHORT;
+            c = fmt_read(++f, progmem);
+            if(c == 'h') {
+                size = L_CHAR;
+                c = fmt_read(++f, progmem);
+            }
+        } else if(c == 'l') {
+            size = L_LONG;
+            c = fmt_read(++f, progmem);
+            if(c == 'l') {
+                size = L_LLONG;
+                c = fmt_read(++f, progmem);
+            }
+        } else if(c == 'z' || c == 't') {
+            size = L_SIZE;
+            c = fmt_read(++f, progmem);
+        } else if(c == 'j') {
+            size = L_MAX;
+            c = fmt_read(++f, progmem);
+        } else if(c == 'L') {
+            size = L_DOUBLE;
+            c = fmt_read(++f, progmem);
+        }
+        if(!c) {
+            // format ends inside the conversion: as it is
+            out_mem(&o, spec, f - spec, progmem);
+            break;
+        }
+        f++;
+
+        switch(c) {
+            case 'd':
+            case 'i': {
+                int64_t v;
+                switch(size) {
+                    case L_CHAR:  v = (signed char) va_arg(ap, int);      break;
+                    case L_SHORT: v = (short) va_arg(ap, int);            break;
+                    case L_LONG:  v = va_arg(ap, long);                   break;
+                    case L_LLONG: v = va_arg(ap, long long);              break;
+                    case L_SIZE:  v = (ptrdiff_t) va_arg(ap, size_t);     break;
+                    case L_MAX:   v = va_arg(ap, intmax_t);               break;
+                    default:      v = va_arg(ap, int);                    break;
+                }
+                out_number(&o, (v < 0) ? -(uint64_t) v : (uint64_t) v, v < 0, 10, flags, width, prec);
+                break;
+            }
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o': {
+                uint64_t v;
+                switch(size) {
+                    case L_CHAR:  v = (unsigned char) va_arg(ap, unsigned);       break;
+                    case L_SHORT: v = (unsigned short) va_arg(ap, unsigned);      break;
+                    case L_LONG:  v = va_arg(ap, unsigned long);                  break;
+                    case L_LLONG: v = va_arg(ap, unsigned long long);             break;
+                    case L_SIZE:  v = va_arg(ap, size_t);                         break;
+                    case L_MAX:   v = va_arg(ap, uintmax_t);                      break;
+                    default:      v = va_arg(ap, unsigned);                       break;
+                }
+                flags &= ~(F_PLUS | F_SPACE);
+                if(c == 'X')
+                    flags |= F_UPPER;
+                out_number(&o, v, false, (c == 'u') ? 10 : (c == 'o') ? 8 : 16, flags, width, prec);
+                break;
+            }
+            case 'p':
+                flags = (flags & F_LEFT) | F_ALT;
+                out_number(&o, (uintptr_t) va_arg(ap, void*), false, 16, flags, width, -1);
+                break;
+            case 'c': {
+                char ch = (char) va_arg(ap, int);
+                out_padded(&o, &ch, 1, false, flags, width);
+                break;
+            }
+            case 's':
+            case 'S': {
+                const char* s = va_arg(ap, const char*);
+                bool s_progmem = (c == 'S');
+                if(!s) {
+                    s = "(null)";
+                    s_progmem = false;
+                }
+                out_padded(&o, s, str_len(s, prec, s_progmem), s_progmem, flags, width);
+                break;
+            }
+            case '%':
+                out_char(&o, '%');
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                if(size == L_DOUBLE)
+                    (void) va_arg(ap, long double);
+                else
+                    (void) va_arg(ap, double);
+                out_mem(&o, spec, f - spec, progmem);
+                break;
+            case 'n':
+                // never written through
+                (void) va_arg(ap, void*);
+                break;
+            default:
+                out_mem(&o, spec, f - spec, progmem);
+                break;
+        }
+    }
+
+    out_flush(&o);
+    return o.total;
+}
+
+int vprintf_cb(printf_cb_t cb, void* arg, const char* format, va_list ap) {
+    return printf_cb_impl(cb, arg, format, false, ap);
+}
+
+int vprintf_cb_P(printf_cb_t cb, void* arg, const char* formatP, va_list ap) {
+    return printf_cb_impl(cb, arg, formatP, true, ap);
+}
@@ -0,0 +1,50 @@
+/*
+ printf_cb.h - printf straight into a callback, no intermediate buffer
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Lesser General Public
+ License as published by the Free Software Foundation; either
+ version 2.1 of the License, or (at your option) any later version.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Lesser General Public License for more details.
+
+ You should have received a copy of the GNU Lesser General Public
+ License along with this library; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PRINTF_CB_H
+#define PRINTF_CB_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Output is collected in PRINTF_CB_CHUNK bytes on the stack and handed over
+// when that is full; runs of the format string and %s arguments at least that
+// long go to the callback as they are. There is no limit on the total length.
+#define PRINTF_CB_CHUNK 32
+
+typedef void (*printf_cb_t)(void* arg, const char* buf, size_t len);
+
+// Conversions: d i u x X o c s p %, flags - + space # 0, width, precision
+// (both may be *), length hh h l ll z j t. %S takes a PROGMEM string.
+// No floating point, like ets_vsnprintf: %f %e %g %a take the double and
+// print the conversion as it is written.
+// Returns the number of characters handed to cb.
+int vprintf_cb(printf_cb_t cb, void* arg, const char* format, va_list ap);
+
+// same with the format string in PROGMEM
+int vprintf_cb_P(printf_cb_t cb, void* arg, const char* formatP, va_list ap);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -131,6 +131,13 @@ void OLED::displayOff(void)
 void OLED::clear_display(void)
 {
   unsigned char i,k;
+
+  if(_fbMode)
+  {
+    memset(_fb, 0, OLED_FB_SIZE);
+    return;
+  }
+
   for(k=0;k<4;k++)
   {
     setXY(k,0);
@@ -152,6 +159,13 @@ void OLED::SendChar(unsigned char data)
 {
   //if (interrupt && !doing_menu) return;   // Stop printing only if interrupt is call but not in button functions
 
+  if(_fbMode)
+  {
+    _fb[_fbPage * OLED_WIDTH + _fbCol] = data;
+    _fbCol = (_fbCol + 1) % OLED_WIDTH;
+    return;
+  }
+
   Wire.beginTransmission(_address); // begin transmitting
   Wire.write(0x40);//data mode
   Wire.write(data);
@@ -165,6 +179,14 @@ void OLED::SendChar(unsigned char data)
 void OLED::sendCharXY(unsigned char data, int X, int Y)
 {
   setXY(X, Y);
+
+  if(_fbMode)
+  {
+    for(int i=0;i<8;i++)
+      SendChar(pgm_read_byte(myFont[data-0x20]+i));
+    return;
+  }
+
   Wire.beginTransmission(_address); // begin transmitting
   Wire.write(0x40);//data mode
 
@@ -188,6 +210,13 @@ void OLED::sendcommand(unsigned char com)
 // Set the cursor position in a 16 COL * 8 ROW map.
 void OLED::setXY(unsigned char row,unsigned char col)
 {
+  if(_fbMode)
+  {
+    _fbPage = row % OLED_PAGES;
+    _fbCol = (8 * col) % OLED_WIDTH;
+    return;
+  }
+
   sendcommand(0xb0+row);                //set page address
   sendcommand(_offset+(8*col&0x0f));       //set low col address
   sendcommand(0x10+((8*col>>4)&0x0f));  //set high col address
@@ -265,6 +294,97 @@ void OLED::init_OLED(void)
 }
 
 
+//==========================================================//
+// Switches drawing to a RAM framebuffer (or back to direct writes).
+// Returns false if the buffers could not be allocated.
+bool OLED::enableFramebuffer(bool on)
+{
+  if(on && !_fb)
+  {
+    _fb = (uint8_t *)malloc(2 * OLED_FB_SIZE);
+    if(!_fb)
+      return false;
+    _shown = _fb + OLED_FB_SIZE;
+  }
+
+  // we don't know what is on screen, next flush sends everything
+  if(on && !_fbMode)
+  {
+    memset(_fb, 0, OLED_FB_SIZE);
+    _fbSynced = false;
+    _fbPage = _fbCol = 0;
+  }
+
+  _fbMode = on;
+  return true;
+}
+
+//==========================================================//
+// Sends a run of framebuffer bytes: one addressing transaction,
+// then data transactions as big as the Wire buffer allows.
+void OLED::sendData(uint8_t page, uint8_t col, const uint8_t *data, uint8_t len)
+{
+  uint8_t c = _offset + col;
+
+  Wire.beginTransmission(_address);
+  Wire.write(0x00);                     // command stream
+  Wire.write(0xb0 + page);              // set page address
+  Wire.write(c & 0x0f);                 // set low col address
+  Wire.write(0x10 | ((c >> 4) & 0x0f)); // set high col address
+  Wire.endTransmission();
+
+  while(len)
+  {
+    uint8_t n = len < BUFFER_LENGTH - 1 ? len : BUFFER_LENGTH - 1;
+
+    Wire.beginTransmission(_address);
+    Wire.write(0x40);                   // data mode
+    Wire.write(data, n);
+    Wire.endTransmission();
+
+    data += n;
+    len -= n;
+  }
+}
+
+//==========================================================//
+// Sends the framebuffer columns that changed since the last flush,
+// merging runs separated by less than OLED_FB_GAP unchanged bytes.
+void OLED::flush(bool full)
+{
+  if(!_fbMode)
+    return;
+
+  bool all = full || !_fbSynced;
+
+  for(uint8_t page=0; page<OLED_PAGES; page++)
+  {
+    uint8_t *cur = _fb + page * OLED_WIDTH;
+    uint8_t *old = _shown + page * OLED_WIDTH;
+    int col = 0;
+
+    while(col < OLED_WIDTH)
+    {
+      if(!all && cur[col] == old[col])
+      {
+        col++;
+        continue;
+      }
+
+      int last = col;
+      for(int i=col+1; i<OLED_WIDTH && i-last <= OLED_FB_GAP; i++)
+        if(all || cur[i] != old[i])
+          last = i;
+
+      sendData(page, col, cur + col, last + 1 - col);
+      memcpy(old + col, cur + col, last + 1 - col);
+      col = last + 1;
+    }
+  }
+
+  _fbSynced = true;
+}
+
 //==========================================================//
 
 
@@ -273,6 +393,9 @@ OLED::OLED(uint8_t sda, uint8_t scl, uint8_t address, uint8_t offset) {
 	_scl = scl;
 	_address = address;
 	_offset = offset;
+	_fb = _shown = NULL;
+	_fbMode = _fbSynced = false;
+	_fbPage = _fbCol = 0;
 }
 
 void OLED::begin(void) {
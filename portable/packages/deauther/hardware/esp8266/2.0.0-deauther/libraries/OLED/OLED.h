@@ -22,6 +22,14 @@
 	#define DEBUG_PRINTLN(...) {}
 #endif
 
+// Screen geometry (128*32, 4 pages of 8 pixel rows)
+#define OLED_WIDTH		128
+#define OLED_PAGES		4
+#define OLED_FB_SIZE	(OLED_WIDTH * OLED_PAGES)
+
+// Unchanged columns bridged in one transfer by flush() rather than re-addressing.
+#define OLED_FB_GAP		6
+
 class OLED {
 	public:
 		OLED(uint8_t sda, uint8_t scl, uint8_t address=0x3c, uint8_t offset=0);
@@ -31,6 +39,10 @@ class OLED {
 		void clear(void);
 		void print(char *s, uint8_t r=0, uint8_t c=0);
 
+		// Framebuffer mode: drawing only touches RAM, flush() sends what changed.
+		bool enableFramebuffer(bool on=true);
+		void flush(bool full=false);
+
 	public:
 		uint8_t _sda, _scl, _address, _offset;
 		void reset_display(void);
@@ -44,6 +56,12 @@ class OLED {
 		void sendStr(unsigned char *string);
 		void sendStrXY( const char *string, int X, int Y);
 		void init_OLED(void);
+
+	private:
+		uint8_t *_fb, *_shown;
+		bool _fbMode, _fbSynced;
+		uint8_t _fbPage, _fbCol;
+		void sendData(uint8_t page, uint8_t col, const uint8_t *data, uint8_t len);
 };
 
 #endif
@@ -9,6 +9,7 @@
 #include "status.h"
 #include "ui.h"
 #include "wifi.h"
+#include "sched.h"
 
 // mass deauth
 
@@ -23,7 +24,7 @@ void setup(void)
 void loop(void)
 {
     wifi_loop();
-    ui_loop();
+    sched_loop();
 
     yield();
 }
@@ -0,0 +1,167 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : capture.cpp                                                //
+// Description : raw frame capture over the serial port (pcap on the host)  //
+// ======================================================================== //
+
+#include "capture.h"
+#include "status.h"
+#include "Arduino.h"
+
+static_assert((CAPTURE_SLOTS & (CAPTURE_SLOTS - 1)) == 0, "CAPTURE_SLOTS must be a power of 2");
+
+// a captured frame waiting for the uart
+typedef struct capture_slot_t
+{
+    uint32_t    ts;
+    uint16_t    len;
+    int8_t      rssi;
+    uint8_t     channel;
+    uint8_t     caplen;
+    uint8_t     data[CAPTURE_SNAPLEN_MAX];
+} capture_slot_t;
+
+// single producer (rx callback) / single consumer (loop), same scheme as ring.cpp
+static capture_slot_t       slots[CAPTURE_SLOTS];
+static volatile uint32_t    slots_head = 0;
+static volatile uint32_t    slots_tail = 0;
+
+static capture_filter_t     filter;
+static volatile uint8_t     active = 0;
+
+
+// ========================================================================= //
+// control
+// ========================================================================= //
+
+// NULL filter = every frame, default snaplen
+void capture_start(const capture_filter_t * f)
+{
+    active = 0;
+
+    if(f)
+        filter = *f;
+    else
+        memset(&filter, 0, sizeof(filter));
+
+    if(!filter.snaplen)
+        filter.snaplen = CAPTURE_SNAPLEN;
+    if(filter.snaplen > CAPTURE_SNAPLEN_MAX)
+        filter.snaplen = CAPTURE_SNAPLEN_MAX;
+    if(filter.bssid_count > CAPTURE_BSSIDS)
+        filter.bssid_count = CAPTURE_BSSIDS;
+
+    // forget frames & counters from a previous capture
+    slots_tail = slots_head;
+    status.capture_frames   = 0;
+    status.capture_sent     = 0;
+    status.capture_drops    = 0;
+    status.capture_filtered = 0;
+
+    __sync_synchronize();
+    active = 1;
+}
+
+void capture_stop(void)
+{
+    active = 0;
+}
+
+
+// ========================================================================= //
+// producer
+// ========================================================================= //
+static int capture_match(const uint8_t * frame, size_t avail, int8_t rssi)
+{
+    uint8_t type    = (frame[0] >> 2) & 0x03;
+    uint8_t subtype = frame[0] >> 4;
+
+    if(filter.types && !(filter.types & CAPTURE_TYPE(type, subtype)))
+        return 0;
+
+    if(filter.rssi_min && rssi < filter.rssi_min)
+        return 0;
+
+    if(!filter.bssid_count)
+        return 1;
+
+    // addr1 @ 4, addr2 @ 10, addr3 @ 16, whatever the frame carries
+    for(int i=0; i<filter.bssid_count; i++)
+        for(size_t off=4; off + 6 <= avail && off <= 16; off += 6)
+            if(!memcmp(frame + off, filter.bssids[i], 6))
+                return 1;
+
+    return 0;
+}
+
+void capture_frame(const uint8_t * frame, size_t avail, uint16_t len, int8_t rssi, uint8_t channel)
+{
+    if(!active || !avail)
+        return;
+
+    if(!capture_match(frame, avail, rssi))
+    {
+        status.capture_filtered += 1;
+        return;
+    }
+
+    if(slots_head - slots_tail >= CAPTURE_SLOTS)
+    {
+        status.capture_drops += 1;
+        return;
+    }
+
+    capture_slot_t * s = &slots[slots_head & (CAPTURE_SLOTS - 1)];
+    s->ts       = micros();
+    s->len      = len;
+    s->rssi     = rssi;
+    s->channel  = channel;
+    s->caplen   = avail < filter.snaplen ? avail : filter.snaplen;
+    if(s->caplen > len)
+        s->caplen = len;
+    memcpy(s->data, frame, s->caplen);
+
+    status.capture_frames += 1;
+
+    // slot contents must be visible before the new head
+    __sync_synchronize();
+    slots_head = slots_head + 1;
+}
+
+
+// ========================================================================= //
+// consumer
+// ========================================================================= //
+void capture_pump(void)
+{
+    uint8_t p[REPORT_PAYLOAD_MAX];
+
+    while(slots_tail != slots_head)
+    {
+        __sync_synchronize();
+        capture_slot_t * s = &slots[slots_tail & (CAPTURE_SLOTS - 1)];
+
+        p[0] = s->ts;
+        p[1] = s->ts >> 8;
+        p[2] = s->ts >> 16;
+        p[3] = s->ts >> 24;
+        p[4] = s->len;
+        p[5] = s->len >> 8;
+        p[6] = s->rssi;
+        p[7] = s->channel;
+        p[8] = status.capture_drops;
+        p[9] = status.capture_drops >> 8;
+        memcpy(p + CAPTURE_HDR_LEN, s->data, s->caplen);
+
+        // uart full, try again on the next run
+        if(!report_try_send(REPORT_T_CAPTURE, p, CAPTURE_HDR_LEN + s->caplen))
+            return;
+
+        status.capture_sent += 1;
+
+        __sync_synchronize();
+        slots_tail = slots_tail + 1;
+    }
+}
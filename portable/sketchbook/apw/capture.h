@@ -0,0 +1,62 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : capture.h                                                  //
+// Description : raw frame capture over the serial port (pcap on the host)  //
+// ======================================================================== //
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "report.h"
+
+// capture frames share the report framing (see report.h), payload:
+//  0  ts       u32 micros() when the sdk handed us the frame
+//  4  len      u16 length of the frame on air
+//  6  rssi     i8
+//  7  channel  u8
+//  8  drops    u16 frames lost on the device so far (low 16 bits)
+// 10  data     first caplen bytes of the 802.11 frame (no fcs)
+#define REPORT_T_CAPTURE    'C'
+#define CAPTURE_HDR_LEN     10
+#define CAPTURE_SNAPLEN_MAX (REPORT_PAYLOAD_MAX - CAPTURE_HDR_LEN)
+
+#define CAPTURE_SLOTS       16      // frames buffered between the rx callback & the uart, power of 2
+#define CAPTURE_SNAPLEN     64      // default bytes kept per frame
+#define CAPTURE_BSSIDS      4       // addresses the filter can match
+#define CAPTURE_PUMP_MS     10      // ms between attempts to push frames to the uart
+
+// frame type bit for the filter: type (0 mgmt, 1 ctrl, 2 data) & subtype from the frame control
+#define CAPTURE_TYPE(type, subtype)     (1ull << (((type) << 4) | (subtype)))
+#define CAPTURE_MGMT                    0x000000000000ffffull
+#define CAPTURE_DATA                    0x0000ffff00000000ull
+#define CAPTURE_BEACON                  CAPTURE_TYPE(0, 8)
+#define CAPTURE_PROBE_REQ               CAPTURE_TYPE(0, 4)
+#define CAPTURE_PROBE_RESP              CAPTURE_TYPE(0, 5)
+#define CAPTURE_DISASSOC                CAPTURE_TYPE(0, 10)
+#define CAPTURE_DEAUTH                  CAPTURE_TYPE(0, 12)
+
+// what gets captured, a frame must pass every test
+typedef struct capture_filter_t
+{
+    uint64_t    types;                      // CAPTURE_TYPE() bits, 0 = any type
+    uint8_t     bssids[CAPTURE_BSSIDS][6];  // one of them in addr1/2/3
+    uint8_t     bssid_count;                // 0 = any address
+    int8_t      rssi_min;                   // weaker frames are ignored, 0 = any
+    uint8_t     snaplen;                    // bytes kept, up to CAPTURE_SNAPLEN_MAX
+} capture_filter_t;
+
+void    capture_start(const capture_filter_t * filter);
+void    capture_stop(void);
+
+// rx callback side: filter & copy the frame, sdk context
+void    capture_frame(const uint8_t * frame, size_t avail, uint16_t len, int8_t rssi, uint8_t channel);
+
+// send buffered frames while the uart has room (scheduled every CAPTURE_PUMP_MS)
+void    capture_pump(void);
+
+#endif
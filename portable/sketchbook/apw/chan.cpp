@@ -0,0 +1,276 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : chan.cpp                                                   //
+// Description : channel hopping policies + per channel activity stats      //
+// ======================================================================== //
+
+#include "chan.h"
+#include "status.h"
+#include "wifi.h"
+#include "ui.h"
+#include "Arduino.h"
+
+static_assert(CHAN_SWEEP_MS > CHAN_MAX * CHAN_DWELL_MIN, "sweep too short for the minimum dwell");
+
+chan_stat_t chan_stats[CHAN_MAX + 1];
+
+// current visit
+static uint8_t  cur         = 0;    // channel we are tuned to
+static uint32_t arrived     = 0;    // millis() when we got there
+static uint32_t frames_at   = 0;    // chan_stats[cur].frames on arrival
+static uint32_t devs_at     = 0;    // status.devs_new on arrival
+
+// channel plan
+static uint16_t plan        = CHAN_PLAN_DEFAULT;
+static uint8_t  plan_share  = CHAN_PLAN_SHARE;
+static uint32_t plan_time   = 0;    // ms on plan channels since chan_plan_set()
+static uint32_t other_time  = 0;    // ms on the other channels
+static uint8_t  other_last  = 0;    // other channel visited last
+static uint32_t other_sweeps = 0;   // passes over all the other channels
+static uint32_t phy_switches = 0;
+
+
+// ========================================================================= //
+// visits bookkeeping
+// ========================================================================= //
+
+// done with the current channel, sample its activity
+static void chan_leave(uint32_t now)
+{
+    chan_stat_t * c = &chan_stats[cur];
+    uint32_t stay   = now - arrived;
+    uint32_t frames = c->frames - frames_at;
+    uint32_t devs   = status.devs_new - devs_at;
+
+    c->time += stay;
+    c->devs += devs;
+
+    if(status.hop_mode == HOP_PLAN)
+    {
+        if(plan & (1 << cur))
+            plan_time += stay;
+        else
+            other_time += stay;
+    }
+
+    if(stay < CHAN_SAMPLE_MIN)
+        return;
+
+    // rates x16, moving average
+    int32_t fps = frames * 16000 / stay;
+    int32_t nps = devs * 16000 / stay;
+    c->fps = (int32_t)c->fps + ((fps - (int32_t)c->fps) >> CHAN_EWMA_SHIFT);
+    c->nps = (int32_t)c->nps + ((nps - (int32_t)c->nps) >> CHAN_EWMA_SHIFT);
+}
+
+static void chan_enter(uint8_t channel, uint32_t now)
+{
+    chan_stat_t * c = &chan_stats[channel];
+
+    if(c->visits && now - c->last > c->gap_max)
+        c->gap_max = now - c->last;
+    c->visits   += 1;
+    c->last     = now;
+
+    cur         = channel;
+    arrived     = now;
+    frames_at   = c->frames;
+    devs_at     = status.devs_new;
+
+    wifi_set_channel(channel);
+}
+
+// share of the sweep for a channel: fixed minimum + the rest by activity
+// channels without traffic still count as 1 frame/sec
+static uint32_t chan_dwell(uint8_t channel)
+{
+    uint32_t total = 0;
+    uint32_t w = 0;
+
+    for(int i=1; i<=CHAN_MAX; i++)
+    {
+        chan_stat_t * c = &chan_stats[i];
+        uint32_t cw = c->fps + CHAN_NEW_WEIGHT * c->nps + 16;
+        total += cw;
+        if(i == channel)
+            w = cw;
+    }
+
+    return CHAN_DWELL_MIN + (uint64_t)(CHAN_SWEEP_MS - CHAN_MAX * CHAN_DWELL_MIN) * w / total;
+}
+
+// FEATURE_BANDHOP: next phy mode, the radio gets reconfigured so not too often
+static void phy_next(void)
+{
+    if(!FEATURE_BANDHOP)
+        return;
+
+    status.phy += 1;
+    if(status.phy > PHY_MODE_11N)
+        status.phy = PHY_MODE_11B;
+    wifi_set_phy_mode((phy_mode)status.phy);
+    phy_switches += 1;
+}
+
+
+// ========================================================================= //
+// channel plan
+// ========================================================================= //
+
+// plan channel after c in the round, 0 once it is over
+static uint8_t plan_after(uint8_t c)
+{
+    for(c = c + 1; c <= CHAN_MAX; c++)
+        if(plan & (1 << c))
+            return c;
+    return 0;
+}
+
+// other channel after c, wrapping around. 0 if the plan has them all
+static uint8_t other_after(uint8_t c)
+{
+    for(int i=0; i<CHAN_MAX; i++)
+    {
+        c = c % CHAN_MAX + 1;
+        if(!(plan & (1 << c)))
+            return c;
+    }
+    return 0;
+}
+
+// picks status.channel, returns the dwell
+static uint32_t plan_next(void)
+{
+    uint8_t c = plan_after(plan & (1 << cur) ? cur : 0);
+    if(c)
+    {
+        status.channel = c;
+        return CHAN_PLAN_DWELL;
+    }
+
+    // round over: one other channel, for what the plan's share leaves it
+    uint32_t want  = (uint64_t)plan_time * (100 - plan_share) / plan_share;
+    uint32_t dwell = want > other_time ? want - other_time : 0;
+    uint8_t  o     = other_after(other_last);
+
+    if(!o || dwell < CHAN_PLAN_BG_MIN)
+    {
+        status.channel = plan_after(0);
+        return CHAN_PLAN_DWELL;
+    }
+
+    // all of them seen on this phy mode, only now the next one
+    if(o <= other_last)
+    {
+        other_sweeps += 1;
+        phy_next();
+    }
+    other_last = o;
+    status.channel = o;
+    return dwell < CHAN_PLAN_BG_MAX ? dwell : CHAN_PLAN_BG_MAX;
+}
+
+
+// ========================================================================= //
+// api
+// ========================================================================= //
+void chan_init(void)
+{
+    memset(chan_stats, 0, sizeof(chan_stats));
+    plan_time    = 0;
+    other_time   = 0;
+    other_last   = 0;
+    other_sweeps = 0;
+    phy_switches = 0;
+    chan_enter(status.channel, millis());
+}
+
+void chan_frame(uint8_t channel)
+{
+    if(channel && channel <= CHAN_MAX)
+        chan_stats[channel].frames += 1;
+}
+
+uint32_t chan_hop(void)
+{
+    uint32_t now = millis();
+
+    chan_leave(now);
+
+    // focusing on a channel? if yes & not currently on it, switch to focused chan
+    if(status.channel_focus && wifi_get_channel() != status.channel_focus)
+    {
+        chan_enter(status.channel_focus, now);
+        return status.chanhop;
+    }
+
+    if(status.hop_mode == HOP_PLAN && status.mode == MODE_DETECT)
+    {
+        uint32_t dwell = plan_next();
+        chan_enter(status.channel, now);
+        chan_stats[status.channel].dwell = dwell;
+        return dwell;
+    }
+
+    status.channel += 1;
+    if(status.channel > CHAN_MAX)
+    {
+        status.channel = 1;
+        phy_next();
+    }
+    chan_enter(status.channel, now);
+
+    // attack modes & AP focus keep the fixed interval
+    if(status.hop_mode != HOP_ADAPTIVE || status.mode != MODE_DETECT || status.channel_focus)
+        chan_stats[status.channel].dwell = status.chanhop;
+    else
+        chan_stats[status.channel].dwell = chan_dwell(status.channel);
+
+    return chan_stats[status.channel].dwell;
+}
+
+void chan_plan_set(uint16_t channels, uint8_t share)
+{
+    channels &= (1 << (CHAN_MAX + 1)) - 2;
+    if(channels)
+        plan = channels;
+    if(share)
+        plan_share = share < 100 ? share : 100;
+
+    plan_time    = 0;
+    other_time   = 0;
+    other_sweeps = 0;
+}
+
+void chan_dump(void)
+{
+    uint32_t total = 0;
+    for(int i=1; i<=CHAN_MAX; i++)
+        total += chan_stats[i].time;
+    if(!total)
+        total = 1;
+
+    ui_printf("> chan: %s hopping, on %d for %u ms, %u phy switches\n", hop_mode_str(status.hop_mode), cur, millis() - arrived, phy_switches);
+    if(status.hop_mode == HOP_PLAN)
+    {
+        uint32_t all = plan_time + other_time;
+        uint32_t pm  = all ? (uint64_t)plan_time * 1000 / all : 0;
+        ui_printf("> plan (*): %u.%u%% of the airtime for %u%% wanted, %u sweeps of the others\n",
+            pm / 10, pm % 10, plan_share, other_sweeps);
+    }
+    ui_printf("%-3s %8s %5s %6s %5s %7s %6s %5s %6s\n", "ch", "frames", "devs", "visits", "time", "fps", "nps", "dwell", "gap");
+
+    for(int i=1; i<=CHAN_MAX; i++)
+    {
+        chan_stat_t * c = &chan_stats[i];
+        uint32_t pm = (uint64_t)c->time * 1000 / total;
+
+        ui_printf("%-2d%c %8u %5u %6u %3u.%u%% %5u.%u %4u.%u %5u %6u\n",
+            i, status.hop_mode == HOP_PLAN && (plan & (1 << i)) ? '*' : ' ', c->frames, c->devs, c->visits, pm / 10, pm % 10,
+            c->fps / 16, (c->fps % 16) * 10 / 16,
+            c->nps / 16, (c->nps % 16) * 10 / 16,
+            c->dwell, c->gap_max);
+    }
+}
@@ -0,0 +1,78 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : chan.h                                                     //
+// Description : channel hopping policies + per channel activity stats      //
+// ======================================================================== //
+
+#ifndef _CHAN_H
+#define _CHAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CHAN_MAX            14      // 2.4ghz channels 1..14
+
+// adaptive hopping (detect mode)
+// every channel is visited once per sweep, the sweep budget is split between
+// channels by activity, so no channel waits more than ~CHAN_SWEEP_MS
+#define CHAN_SWEEP_MS       3000    // time for a full sweep 1..14
+#define CHAN_DWELL_MIN      60      // guaranteed time on each channel per sweep
+#define CHAN_NEW_WEIGHT     20      // a new device / sec weighs as much as that many frames / sec
+#define CHAN_EWMA_SHIFT     2       // activity average, new sample weighs 1 / (1 << shift)
+#define CHAN_SAMPLE_MIN     20      // dwells shorter than this (ms) are not sampled
+
+// channel plan (detect mode)
+// rounds of CHAN_PLAN_DWELL on each plan channel, between two rounds one of the other
+// channels for as long as keeps the plan at its share of the airtime (or none this
+// round if the plan is behind). with FEATURE_BANDHOP the phy mode only changes once the
+// other channels have all been visited, not on every round
+#define CHAN_PLAN_DEFAULT   ((1 << 1) | (1 << 6) | (1 << 11))  // bit n = channel n
+#define CHAN_PLAN_SHARE     80      // % of the airtime guaranteed to the plan channels
+#define CHAN_PLAN_DWELL     200     // ms on each plan channel per round
+#define CHAN_PLAN_BG_MIN    50      // shorter background visits are not worth the hop, wait a round
+#define CHAN_PLAN_BG_MAX    500
+
+typedef enum hop_mode_t
+{
+    HOP_ROUNDROBIN,                 // fixed status.chanhop on every channel
+    HOP_ADAPTIVE,                   // dwell time follows channel activity
+    HOP_PLAN,                       // plan channels first, the rest in the background
+
+    HOP_MAX,
+} hop_mode_t;
+
+#define hop_mode_str(x) (char*)(x == HOP_ROUNDROBIN ? "roundrobin" : (x == HOP_ADAPTIVE ? "adaptive" : (x == HOP_PLAN ? "plan" : "?")))
+
+// activity seen on one channel
+typedef struct chan_stat_t
+{
+    uint32_t        frames;         // frames received on this channel
+    uint32_t        devs;           // devices discovered while on this channel
+    uint32_t        visits;         // number of times we hopped here
+    uint32_t        time;           // total ms spent here
+    uint32_t        last;           // millis() of the last hop here
+    uint32_t        gap_max;        // longest ms between two visits
+    uint32_t        fps;            // frames / sec average, x16
+    uint32_t        nps;            // new devices / sec average, x16
+    uint16_t        dwell;          // ms allotted on the last visit
+} chan_stat_t;
+
+extern chan_stat_t chan_stats[CHAN_MAX + 1];
+
+void        chan_init(void);
+
+// account a frame received on channel
+void        chan_frame(uint8_t channel);
+
+// leave the current channel for the next one, returns ms to stay there
+uint32_t    chan_hop(void);
+
+// plan channels (bit n = channel n) & their % of the airtime, 0 = unchanged
+// restarts the plan's airtime accounting
+void        chan_plan_set(uint16_t channels, uint8_t share);
+
+void        chan_dump(void);
+
+#endif
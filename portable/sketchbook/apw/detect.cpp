@@ -0,0 +1,441 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : detect.cpp                                                 //
+// Description : attack detection, per bssid & per channel rate windows      //
+// ======================================================================== //
+
+#include "detect.h"
+#include "chan.h"
+#include "devs.h"
+#include "ui.h"
+#include "utils.h"
+#include "Arduino.h"
+
+static_assert((DETECT_BSS & (DETECT_BSS - 1)) == 0, "DETECT_BSS must be a power of 2");
+static_assert(DETECT_BSS >= DETECT_PROBE, "DETECT_PROBE larger than the table");
+
+// counters of one bssid
+typedef struct detect_bss_t
+{
+    uint8_t         mac[6];
+    uint8_t         used;
+    uint8_t         alerts;         // (1 << detect_type_t) raised for this bssid
+    uint8_t         channel;        // where we last saw it
+    detect_win_t    deauth;
+    detect_win_t    essid;
+} detect_bss_t;
+
+// counters of one channel
+typedef struct detect_chan_t
+{
+    uint8_t         alerts;         // channel wide alerts raised
+    detect_win_t    deauth;
+    detect_win_t    beacon_new;
+    detect_win_t    beacon_fake;
+} detect_chan_t;
+
+static detect_bss_t     bss[DETECT_BSS];
+static detect_chan_t    chans[CHAN_MAX + 1];
+static detect_alert_t   alerts[DETECT_ALERTS];
+
+// detection latency of every alert since boot
+static uint32_t         latency_sum = 0;
+static uint32_t         latency_max = 0;
+
+static const uint8_t    no_mac[6]   = {};
+
+
+// ========================================================================= //
+// sliding windows
+// ========================================================================= //
+static inline uint32_t win_epoch(uint32_t now)
+{
+    return now / DETECT_BUCKET_MS;
+}
+
+// forget buckets that left the window, returns events still in it
+static uint16_t win_roll(detect_win_t * w, uint32_t epoch)
+{
+    uint32_t d = epoch - w->epoch;
+
+    if(!d)
+        return w->sum;
+
+    // also covers millis() wrapping
+    if(d >= DETECT_BUCKETS)
+    {
+        memset(w->b, 0, sizeof(w->b));
+        w->sum = 0;
+    }
+    else
+    {
+        for(uint32_t e = w->epoch + 1; e != epoch + 1; e++)
+        {
+            uint8_t * b = &w->b[e % DETECT_BUCKETS];
+            w->sum -= *b;
+            *b = 0;
+        }
+    }
+
+    w->epoch = epoch;
+    return w->sum;
+}
+
+static uint16_t win_add(detect_win_t * w, uint32_t now)
+{
+    uint32_t epoch = win_epoch(now);
+    uint8_t * b = &w->b[epoch % DETECT_BUCKETS];
+
+    // a burst starts after a silent bucket, background noise doesn't hide its onset
+    if(!win_roll(w, epoch) || (!*b && !w->b[(epoch - 1) % DETECT_BUCKETS]))
+        w->first = now;
+
+    if(*b < 0xff)
+    {
+        *b += 1;
+        w->sum += 1;
+    }
+    return w->sum;
+}
+
+
+// ========================================================================= //
+// bssid table (open addressing, bounded probing, quiet entries are reused)
+// ========================================================================= //
+static inline uint32_t detect_hash(const uint8_t * mac)
+{
+    uint32_t h = mac[2] | (mac[3] << 8) | (mac[4] << 16) | ((uint32_t)mac[5] << 24);
+    h ^= (mac[0] << 7) | (mac[1] << 15);
+    return (h * 0x9e3779b1) >> 16;
+}
+
+static int bss_quiet(detect_bss_t * e, uint32_t epoch)
+{
+    return !e->alerts && !win_roll(&e->deauth, epoch) && !win_roll(&e->essid, epoch);
+}
+
+// entry for mac, created if needed. NULL if every candidate slot has an alert up
+static detect_bss_t * bss_get(const uint8_t * mac, uint32_t now)
+{
+    uint32_t        h       = detect_hash(mac);
+    uint32_t        epoch   = win_epoch(now);
+    detect_bss_t *  victim  = NULL;
+
+    for(int i=0; i<DETECT_PROBE; i++)
+    {
+        detect_bss_t * e = &bss[(h + i) & (DETECT_BSS - 1)];
+        if(e->used && !memcmp(e->mac, mac, 6))
+            return e;
+        if(!victim && (!e->used || bss_quiet(e, epoch)))
+            victim = e;
+    }
+
+    // no room: the least active entry without an alert loses its counts
+    if(!victim)
+    {
+        for(int i=0; i<DETECT_PROBE; i++)
+        {
+            detect_bss_t * e = &bss[(h + i) & (DETECT_BSS - 1)];
+            if(!e->alerts && (!victim || e->deauth.sum + e->essid.sum < victim->deauth.sum + victim->essid.sum))
+                victim = e;
+        }
+        if(!victim)
+            return NULL;
+        status.detect_evicts += 1;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    memcpy(victim->mac, mac, 6);
+    victim->used = 1;
+    return victim;
+}
+
+
+// ========================================================================= //
+// alerts
+// ========================================================================= //
+static void detect_flags(void)
+{
+    status.detected_deauth  = 0;
+    status.detected_karma   = 0;
+    status.detected_beacon  = 0;
+
+    for(int i=0; i<DETECT_ALERTS; i++)
+    {
+        detect_alert_t * a = &alerts[i];
+        if(!a->active)
+            continue;
+        if(a->type == DETECT_T_DEAUTH)
+            status.detected_deauth = 1;
+        else if(a->type == DETECT_T_KARMA)
+            status.detected_karma = 1;
+        else if(a->type == DETECT_T_BEACON)
+            status.detected_beacon = 1;
+    }
+}
+
+static detect_alert_t * alert_find(uint8_t * owner, uint8_t type)
+{
+    for(int i=0; i<DETECT_ALERTS; i++)
+        if(alerts[i].active && alerts[i].owner == owner && alerts[i].type == type)
+            return &alerts[i];
+    return NULL;
+}
+
+static void alert_log(detect_alert_t * a, const char * what, uint32_t now)
+{
+    char tmp[20];
+    wifi_ap_t * ap = NULL;
+
+    if(memcmp(a->mac, no_mac, 6))
+    {
+        bin_to_hex(a->mac, 6, tmp, sizeof(tmp));
+        ap = dev_ap_find(a->mac, 0);
+    }
+    else
+        snprintf(tmp, sizeof(tmp), "any bssid");
+
+    if(!a->active)
+        ui_printf("> %s attack %s on %s (%s) ch %d, lasted %d ms, peak %d\n", detect_type_str(a->type), what,
+            tmp, ap ? essid_str(ap->essid) : "-", a->channel, now - a->start, a->peak);
+    else
+        ui_printf("> %s attack %s on %s (%s) ch %d, %d events in %d ms\n", detect_type_str(a->type), what,
+            tmp, ap ? essid_str(ap->essid) : "-", a->channel, a->peak, now - a->win->first);
+}
+
+static void alert_raise(uint8_t type, const uint8_t * mac, uint8_t channel, detect_win_t * w, uint16_t thr, uint8_t * owner, uint32_t now)
+{
+    detect_alert_t * a = NULL;
+
+    // free slot, or the alert that ended first
+    for(int i=0; i<DETECT_ALERTS; i++)
+    {
+        detect_alert_t * s = &alerts[i];
+        if(!s->active && (!a || (int32_t)(s->last - a->last) < 0))
+            a = s;
+    }
+
+    // every slot busy: the ones up already say enough, retried on the next event
+    if(!a)
+    {
+        status.detect_full += 1;
+        return;
+    }
+
+    a->type     = type;
+    a->active   = 1;
+    memcpy(a->mac, mac ? mac : no_mac, 6);
+    a->channel  = channel;
+    a->peak     = w->sum;
+    a->thr      = thr;
+    a->start    = now;
+    a->last     = now;
+    a->latency  = now - w->first;
+    a->win      = w;
+    a->owner    = owner;
+    *owner     |= 1 << type;
+
+    status.detect_alerts += 1;
+    latency_sum += a->latency;
+    if(a->latency > latency_max)
+        latency_max = a->latency;
+
+    // remembered by the device (and its history record)
+    wifi_ap_t * ap = mac ? dev_ap_find((uint8_t *)mac, 0) : NULL;
+    if(ap)
+        ap->alerts |= 1 << type;
+
+    alert_log(a, "detected", now);
+    detect_flags();
+}
+
+// raise or refresh the alert behind counter w
+static void detect_check(uint8_t type, const uint8_t * mac, uint8_t channel, detect_win_t * w, uint16_t thr, uint8_t * owner, uint32_t now)
+{
+    if(w->sum < thr)
+        return;
+
+    if(!(*owner & (1 << type)))
+    {
+        alert_raise(type, mac, channel, w, thr, owner, now);
+        return;
+    }
+
+    detect_alert_t * a = alert_find(owner, type);
+    if(!a)
+        return;
+    a->last = now;
+    if(w->sum > a->peak)
+        a->peak = w->sum;
+}
+
+// bssid alert of that type up on channel?
+static int detect_bss_alerted(uint8_t type, uint8_t channel)
+{
+    for(int i=0; i<DETECT_ALERTS; i++)
+    {
+        detect_alert_t * a = &alerts[i];
+        if(a->active && a->type == type && a->channel == channel && a->owner != &chans[channel].alerts)
+            return 1;
+    }
+    return 0;
+}
+
+
+// ========================================================================= //
+// api
+// ========================================================================= //
+void detect_init(void)
+{
+    memset(bss, 0, sizeof(bss));
+    memset(chans, 0, sizeof(chans));
+    memset(alerts, 0, sizeof(alerts));
+    latency_sum = 0;
+    latency_max = 0;
+    detect_flags();
+}
+
+void detect_deauth(const uint8_t * bssid, uint8_t channel)
+{
+    uint32_t now = millis();
+
+    if(channel > CHAN_MAX)
+        channel = 0;
+
+    detect_chan_t * c = &chans[channel];
+    win_add(&c->deauth, now);
+
+    detect_bss_t * e = is_bad_mac((uint8_t *)bssid) ? NULL : bss_get(bssid, now);
+    if(e)
+    {
+        e->channel = channel;
+        win_add(&e->deauth, now);
+        detect_check(DETECT_T_DEAUTH, e->mac, channel, &e->deauth, DETECT_DEAUTH, &e->alerts, now);
+    }
+
+    // spread over spoofed bssids, only the channel total shows it
+    if(c->deauth.sum >= DETECT_DEAUTH_CHAN && !detect_bss_alerted(DETECT_T_DEAUTH, channel))
+        detect_check(DETECT_T_DEAUTH, NULL, channel, &c->deauth, DETECT_DEAUTH_CHAN, &c->alerts, now);
+}
+
+void detect_essid(wifi_ap_t * ap)
+{
+    uint32_t now = millis();
+    detect_bss_t * e = bss_get(ap->mac, now);
+
+    if(!e)
+        return;
+
+    e->channel = ap->channel <= CHAN_MAX ? ap->channel : 0;
+    win_add(&e->essid, now);
+    detect_check(DETECT_T_KARMA, e->mac, e->channel, &e->essid, DETECT_KARMA, &e->alerts, now);
+}
+
+void detect_ap_new(uint8_t channel)
+{
+    uint32_t now = millis();
+
+    if(channel > CHAN_MAX)
+        return;
+
+    // everything is new while we discover the neighbourhood
+    if(chan_stats[channel].visits <= DETECT_WARMUP)
+        return;
+
+    detect_chan_t * c = &chans[channel];
+    win_add(&c->beacon_new, now);
+    detect_check(DETECT_T_BEACON, NULL, channel, &c->beacon_new, DETECT_BEACON_NEW, &c->alerts, now);
+}
+
+void detect_ap_fake(wifi_ap_t * ap)
+{
+    uint32_t now = millis();
+
+    if(ap->channel > CHAN_MAX)
+        return;
+
+    detect_chan_t * c = &chans[ap->channel];
+    win_add(&c->beacon_fake, now);
+
+    // cleanup removes them in batches, the burst started when they showed up (their only beacon)
+    uint32_t seen = dev_last_ms(ap->time_l, now);
+    if(c->beacon_fake.sum <= DETECT_BEACON_FAKE && (int32_t)(seen - c->beacon_fake.first) < 0)
+        c->beacon_fake.first = seen;
+    detect_check(DETECT_T_BEACON, NULL, ap->channel, &c->beacon_fake, DETECT_BEACON_FAKE, &c->alerts, now);
+}
+
+void detect_tick(void)
+{
+    uint32_t now    = millis();
+    uint32_t epoch  = win_epoch(now);
+
+    for(int i=0; i<DETECT_ALERTS; i++)
+    {
+        detect_alert_t * a = &alerts[i];
+        if(!a->active)
+            continue;
+
+        // hysteresis: quiet for a while & well under the threshold
+        if(win_roll(a->win, epoch) * 2 < a->thr && now - a->last >= DETECT_HOLD_MS)
+        {
+            a->active = 0;
+            a->last = now;
+            *a->owner &= ~(1 << a->type);
+            alert_log(a, "over", now);
+        }
+    }
+
+    detect_flags();
+}
+
+int detect_count(void)
+{
+    int n = 0;
+    for(int i=0; i<DETECT_ALERTS; i++)
+        n += alerts[i].active;
+    return n;
+}
+
+detect_alert_t * detect_get(int idx)
+{
+    for(int i=0; i<DETECT_ALERTS; i++)
+        if(alerts[i].active && idx-- == 0)
+            return &alerts[i];
+    return NULL;
+}
+
+void detect_dump(void)
+{
+    uint32_t now = millis();
+    int used = 0;
+
+    for(int i=0; i<DETECT_BSS; i++)
+        used += bss[i].used;
+
+    ui_printf("alerts %u  latency avg %u ms max %u ms  bssids %d/%d  evicts %u  full %u\n",
+        status.detect_alerts, status.detect_alerts ? latency_sum / status.detect_alerts : 0, latency_max,
+        used, DETECT_BSS, status.detect_evicts, status.detect_full);
+    ui_printf("%-6s  %-12s  %-20s  %2s  %5s  %7s  %8s  %s\n",
+        "type", "bssid", "essid", "ch", "peak", "latency", "duration", "state");
+
+    for(int i=0; i<DETECT_ALERTS; i++)
+    {
+        detect_alert_t * a = &alerts[i];
+        wifi_ap_t * ap = NULL;
+        char tmp[20] = "-";
+
+        if(!a->start)
+            continue;
+        if(memcmp(a->mac, no_mac, 6))
+        {
+            bin_to_hex(a->mac, 6, tmp, sizeof(tmp));
+            ap = dev_ap_find(a->mac, 0);
+        }
+
+        ui_printf("%-6s  %-12s  %-20.20s  %2d  %5d  %7u  %8u  %s\n",
+            detect_type_str(a->type), tmp, ap ? essid_str(ap->essid) : "-", a->channel, a->peak, a->latency,
+            (a->active ? now : a->last) - a->start, a->active ? "active" : "over");
+    }
+}
@@ -0,0 +1,90 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : detect.h                                                   //
+// Description : attack detection, per bssid & per channel rate windows      //
+// ======================================================================== //
+
+#ifndef _DETECT_H
+#define _DETECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "status.h"
+
+// sliding windows: DETECT_BUCKETS buckets of DETECT_BUCKET_MS, updated in O(1) per event
+#define DETECT_BUCKET_MS    500
+#define DETECT_BUCKETS      8
+#define DETECT_WINDOW_MS    (DETECT_BUCKET_MS * DETECT_BUCKETS)
+
+// events per window that raise an alert, it ends below half of that
+#define DETECT_DEAUTH       10      // deauth / disassoc frames for one bssid
+#define DETECT_DEAUTH_CHAN  30      // deauth / disassoc frames on one channel, any bssid (spoofed ones)
+#define DETECT_KARMA        2       // essid changes of one bssid
+#define DETECT_BEACON_NEW   20      // new beacon-only APs on one channel
+#define DETECT_BEACON_FAKE  5       // APs removed after a single beacon, on one channel
+
+#define DETECT_HOLD_MS      3000    // alerts stay up at least that long after the last event
+#define DETECT_WARMUP       2       // channel visits before new APs there count as churn
+#define DETECT_TICK_MS      250     // ms between alert expiry checks
+
+// tracked bssids (power of 2), entries are recycled once quiet
+#define DETECT_BSS          32
+#define DETECT_PROBE        4       // slots searched per lookup
+#define DETECT_ALERTS       8       // alerts kept, active or recent
+
+typedef enum detect_type_t
+{
+    DETECT_T_DEAUTH,                // deauth flood on a bssid, or on a channel if mac is zero
+    DETECT_T_KARMA,                 // bssid answering for several essids
+    DETECT_T_BEACON,                // beacon spam on a channel
+
+    DETECT_T_MAX,
+} detect_type_t;
+
+#define detect_type_str(x) (char*)(x == DETECT_T_DEAUTH ? "deauth" : (x == DETECT_T_KARMA ? "karma" : (x == DETECT_T_BEACON ? "beacon" : "?")))
+
+// event counter over the last DETECT_WINDOW_MS
+typedef struct detect_win_t
+{
+    uint32_t        epoch;          // bucket number (millis / DETECT_BUCKET_MS) of the newest bucket
+    uint32_t        first;          // millis() of the first event after a silent bucket
+    uint16_t        sum;            // events in the window
+    uint8_t         b[DETECT_BUCKETS]; // events per bucket, saturating
+} detect_win_t;
+
+typedef struct detect_alert_t
+{
+    uint8_t         type;           // detect_type_t
+    uint8_t         active;
+    uint8_t         mac[6];         // target bssid, zeros for channel wide alerts
+    uint8_t         channel;
+    uint16_t        peak;           // max events in the window
+    uint16_t        thr;            // events in the window that raised it
+    uint32_t        start;          // millis() when raised
+    uint32_t        last;           // millis() of the last event above the threshold, end once over
+    uint32_t        latency;        // ms from the first event of the burst to the alert
+    detect_win_t *  win;            // counter behind the alert
+    uint8_t *       owner;          // alert bits of the bssid / channel it belongs to
+} detect_alert_t;
+
+void    detect_init(void);
+
+// frame path, O(1)
+void    detect_deauth(const uint8_t * bssid, uint8_t channel);
+void    detect_essid(wifi_ap_t * ap);
+void    detect_ap_new(uint8_t channel);
+void    detect_ap_fake(wifi_ap_t * ap);
+
+// expire alerts & refresh status.detected_* (scheduled every DETECT_TICK_MS)
+void    detect_tick(void);
+
+// active alerts, most recent first
+int                 detect_count(void);
+detect_alert_t *    detect_get(int idx);
+
+void    detect_dump(void);
+
+#endif
@@ -10,11 +10,251 @@
 #include "Arduino.h"
 #include "ui.h"
 #include "utils.h"
+#include "report.h"
+#include "detect.h"
+#include "hist.h"
 
 extern "C" {
     #include "user_interface.h"
 }
 
+static_assert(DEVS_HASH_SIZE >= 2 * MAX_DEVS_APS,     "DEVS_HASH_SIZE too small for MAX_DEVS_APS");
+static_assert(DEVS_HASH_SIZE >= 2 * MAX_DEVS_CLIENTS, "DEVS_HASH_SIZE too small for MAX_DEVS_CLIENTS");
+static_assert(MAX_DEVS_APS < 0xffff && MAX_DEVS_CLIENTS < 0xffff, "dev_idx_t too small");
+static_assert(MAX_DEVS_CLIENTS < 256, "wifi_ap_t.clients_count wraps when every client binds to one AP");
+static_assert(DEVS_RSSI_SLOTS < 0xff, "rssi history slots must fit in wifi_*_t.rh");
+
+// fixed size device pools, no heap churn from the rx path
+wifi_ap_t           devs_ap_slots[MAX_DEVS_APS];
+wifi_client_t       devs_cli_slots[MAX_DEVS_CLIENTS];
+
+typedef struct devs_pool_t
+{
+    dev_idx_t       free;           // released slots, linked through ->next
+    dev_idx_t       bump;           // slots never handed out start here
+} devs_pool_t;
+
+static devs_pool_t  aps_pool;
+static devs_pool_t  clients_pool;
+
+// mac -> device slot, the circular lists are only used for ordered iteration
+static dev_idx_t    aps_hash[DEVS_HASH_SIZE];
+static dev_idx_t    clients_hash[DEVS_HASH_SIZE];
+
+// rssi histories, owner is an ap slot, or a client slot | RSSI_OWNER_CLI, 0 = free
+#define RSSI_OWNER_CLI      0x8000
+
+static rssi_hist_t          rssi_slots[DEVS_RSSI_SLOTS];
+static uint16_t             rssi_owner[DEVS_RSSI_SLOTS];
+static const rssi_hist_t    rssi_none = {};
+
+
+// ========================================================================= //
+// device pools
+// ========================================================================= //
+
+// returns a zeroed slot or NULL if the pool is exhausted
+template <typename T, size_t N> static T * devs_pool_alloc(devs_pool_t * pool, T (&slots)[N])
+{
+    T * dev = NULL;
+
+    if(pool->free)
+    {
+        dev = &slots[pool->free - 1];
+        pool->free = dev->next;
+    }
+    else if(pool->bump < N)
+        dev = &slots[pool->bump++];
+
+    if(dev)
+        memset(dev, 0, sizeof(T));
+    return dev;
+}
+
+template <typename T, size_t N> static void devs_pool_free(devs_pool_t * pool, T (&slots)[N], T * dev)
+{
+    dev->next = pool->free;
+    pool->free = dev - slots + 1;
+}
+
+
+// ========================================================================= //
+// circular lists over slot indexes
+// ========================================================================= //
+
+template <typename T, size_t N> static void devs_list_push(T ** head, T (&slots)[N], T * item)
+{
+    dev_idx_t i = item - slots + 1;
+
+    if(!*head)
+    {
+        item->next = item->prev = i;
+        *head = item;
+        return;
+    }
+
+    T * first = *head;
+    T * last  = &slots[first->prev - 1];
+    item->next  = first - slots + 1;
+    item->prev  = first->prev;
+    last->next  = i;
+    first->prev = i;
+}
+
+template <typename T, size_t N> static void devs_list_unlink(T ** head, T (&slots)[N], T * item)
+{
+    dev_idx_t i = item - slots + 1;
+
+    if(item->next == i)
+        *head = NULL;
+    else
+    {
+        slots[item->prev - 1].next = item->next;
+        slots[item->next - 1].prev = item->prev;
+        if(*head == item)
+            *head = &slots[item->next - 1];
+    }
+    item->next = item->prev = 0;
+}
+
+
+// ========================================================================= //
+// mac index (open addressing, linear probing)
+// ========================================================================= //
+
+static inline uint32_t devs_hash_mac(const uint8_t * mac)
+{
+    uint32_t h = mac[2] | (mac[3] << 8) | (mac[4] << 16) | ((uint32_t)mac[5] << 24);
+    h ^= (mac[0] << 7) | (mac[1] << 15);
+    h *= 0x9e3779b1;
+    return h >> (32 - DEVS_HASH_BITS);
+}
+
+// returns the device with this mac, or NULL
+template <typename T, size_t N> static T * devs_hash_find(dev_idx_t * tab, T (&slots)[N], const uint8_t * mac)
+{
+    // table is never full, an empty slot always ends the probe
+    for(uint32_t i = devs_hash_mac(mac); ; i = (i + 1) & (DEVS_HASH_SIZE - 1))
+    {
+        if(!tab[i])
+            return NULL;
+        if(!memcmp(slots[tab[i] - 1].mac, mac, 6))
+            return &slots[tab[i] - 1];
+    }
+}
+
+template <typename T, size_t N> static void devs_hash_add(dev_idx_t * tab, T (&slots)[N], T * dev)
+{
+    uint32_t i = devs_hash_mac(dev->mac);
+    while(tab[i])
+        i = (i + 1) & (DEVS_HASH_SIZE - 1);
+    tab[i] = dev - slots + 1;
+}
+
+// remove & shift following entries back so probes never need tombstones
+template <typename T, size_t N> static void devs_hash_del(dev_idx_t * tab, T (&slots)[N], T * dev)
+{
+    dev_idx_t d = dev - slots + 1;
+    uint32_t  i = devs_hash_mac(dev->mac);
+    while(tab[i] != d)
+    {
+        if(!tab[i])
+            return;
+        i = (i + 1) & (DEVS_HASH_SIZE - 1);
+    }
+
+    for(uint32_t j = i; ; )
+    {
+        j = (j + 1) & (DEVS_HASH_SIZE - 1);
+        if(!tab[j])
+            break;
+
+        // entry already sits between its home slot & the hole? leave it
+        uint32_t k = devs_hash_mac(slots[tab[j] - 1].mac);
+        if(i <= j ? (i < k && k <= j) : (i < k || k <= j))
+            continue;
+
+        tab[i] = tab[j];
+        i = j;
+    }
+    tab[i] = 0;
+}
+
+
+// ========================================================================= //
+// rssi history slots
+// ========================================================================= //
+
+static uint8_t * rssi_owner_rh(uint16_t owner)
+{
+    if(owner & RSSI_OWNER_CLI)
+        return &dev_cli_at(owner & ~RSSI_OWNER_CLI)->rh;
+    return &dev_ap_at(owner)->rh;
+}
+
+static uint16_t rssi_owner_time(uint16_t owner)
+{
+    if(owner & RSSI_OWNER_CLI)
+        return dev_cli_at(owner & ~RSSI_OWNER_CLI)->time_l;
+    return dev_ap_at(owner)->time_l;
+}
+
+// a zeroed history for owner: a free slot, else the one heard from the longest ago
+// if idle for DEVS_RSSI_IDLE (never the device on screen). returns slot + 1, 0 if none
+static uint8_t rssi_take(uint16_t owner, uint32_t now)
+{
+    uint16_t keep_ap  = dev_ap_slot(status.cur_ap);
+    uint16_t keep_cli = status.cur_cli ? (dev_cli_slot(status.cur_cli) | RSSI_OWNER_CLI) : 0;
+    int      victim   = -1;
+    uint32_t oldest   = DEVS_RSSI_IDLE - 1;
+
+    for(int i=0; i<DEVS_RSSI_SLOTS; i++)
+    {
+        uint16_t o = rssi_owner[i];
+        if(!o)
+        {
+            victim = i;
+            break;
+        }
+        if(o == keep_ap || o == keep_cli)
+            continue;
+
+        uint32_t age = dev_age(rssi_owner_time(o), now);
+        if(age > oldest)
+        {
+            victim = i;
+            oldest = age;
+        }
+    }
+    if(victim < 0)
+        return 0;
+
+    if(rssi_owner[victim])
+    {
+        *rssi_owner_rh(rssi_owner[victim]) = 0;
+        status.rssi_evicts += 1;
+    }
+    rssi_owner[victim] = owner;
+    memset(&rssi_slots[victim], 0, sizeof(rssi_hist_t));
+    return victim + 1;
+}
+
+static inline void rssi_release(uint8_t rh)
+{
+    if(rh)
+        rssi_owner[rh - 1] = 0;
+}
+
+const rssi_hist_t * dev_ap_rssi(const wifi_ap_t * ap)
+{
+    return ap->rh ? &rssi_slots[ap->rh - 1] : &rssi_none;
+}
+
+const rssi_hist_t * dev_cli_rssi(const wifi_client_t * cli)
+{
+    return cli->rh ? &rssi_slots[cli->rh - 1] : &rssi_none;
+}
+
 
 // ========================================================================= //
 // AP functions
@@ -33,7 +273,7 @@ int dev_ap_index(wifi_ap_t * ap)
         if(a == ap)
             return n;
         n += 1;
-        a = a->next;
+        a = dev_ap_next(a);
     } while(a != status.aps);
 
     return -1;
@@ -47,38 +287,36 @@ wifi_ap_t * dev_ap_find(uint8_t * mac, int create)
         return NULL;
 
     // find existing ap
-    if(status.aps)
-    {
-        wifi_ap_t * ap = status.aps;
-        do
-        {
-            if(!memcmp(ap->mac, mac, 6))
-                return ap;
-            ap = ap->next;
-        } while(ap != status.aps);
-    }
+    wifi_ap_t * found = devs_hash_find(aps_hash, devs_ap_slots, mac);
+    if(found)
+        return found;
 
     if(!create)
         return NULL;
 
     // create new one
-    if(status.aps_count < MAX_DEVS_APS)
+    wifi_ap_t * ap = devs_pool_alloc(&aps_pool, devs_ap_slots);
+    if(!ap)
     {
-        wifi_ap_t * ap = (wifi_ap_t *)malloc(sizeof(wifi_ap_t));
-        if(!ap)
-            return NULL;
-
-        memset(ap, 0, sizeof(wifi_ap_t));
-        memcpy(ap->mac, mac, 6);
-        ap->time_l = ap->time_f = millis();
-        search_vendor(mac, ap->vendor);
-
-        clist_push_back(&status.aps, ap);
-        status.aps_count += 1;
-        return ap;
+        status.aps_full += 1;
+        return NULL;
     }
 
-    return NULL;
+    char vendor[9];
+    uint32_t now = millis();
+    memcpy(ap->mac, mac, 6);
+    ap->time_f = devs_min(now);
+    ap->time_l = devs_sec(now);
+    ap->report = REPORT_NEW;
+    ap->vendor = search_vendor(mac, vendor) + 1;
+
+    devs_list_push(&status.aps, devs_ap_slots, ap);
+    devs_hash_add(aps_hash, devs_ap_slots, ap);
+    status.aps_count += 1;
+    status.devs_new += 1;
+    if(status.aps_count > status.aps_peak)
+        status.aps_peak = status.aps_count;
+    return ap;
 }
 
 // update an AP with info parsed
@@ -86,44 +324,64 @@ void dev_ap_update(wifi_ap_t * ap, int8_t rssi, char * essid, uint8_t channel, u
 {
     if(!ap) return;
 
-    ap->time_l      = millis();
+    uint32_t now    = millis();
+    ap->time_l      = devs_sec(now);
     ap->beacons    += 1;
     ap->rssi        = rssi;
+    if(!ap->rh && ap->beacons > 1)
+        ap->rh = rssi_take(dev_ap_slot(ap), now);
+    if(ap->rh)
+        rssi_add(&rssi_slots[ap->rh - 1], rssi, now);
+    if(abs(rssi - ap->rssi_rep) >= REPORT_RSSI_DELTA)
+        ap->report |= REPORT_CHANGED;
+    // same string as last time is the common case, only intern on a change
+    const char * cur = essid_str(ap->essid);
     if(essid && essid[0])
     {
         // changing essid?
-        if(ap->essid[0] && strcmp(ap->essid, "<hidden>") && strcmp(ap->essid, essid))
+        if(cur[0] && strcmp(cur, "<hidden>") && strcmp(cur, essid))
         {
             char tmp[20];
             bin_to_hex(ap->mac, 6, tmp, sizeof(tmp));
-            ui_printf("essid change %s ('%s'[%d] -> '%s'[%d])\n", tmp, ap->essid, strlen(ap->essid), essid, strlen(essid));
+            ui_printf("essid change %s ('%s'[%d] -> '%s'[%d])\n", tmp, cur, strlen(cur), essid, strlen(essid));
 
-            ap->essid_count += 1;
-            ap->essid_time = ap->time_l;
-            snprintf(ap->essid, sizeof(ap->essid), "%s", essid);
+            if(ap->essid_count < 0xff)
+                ap->essid_count += 1;
+            essid_set(&ap->essid, essid, strlen(essid));
+            ap->report |= REPORT_CHANGED;
+            detect_essid(ap);
         }
         // first time seeing this ap
-        else if(strcmp(ap->essid, essid))
+        else if(strcmp(cur, essid))
         {
-            ap->essid_time = 0;
             ap->essid_count = 0;
-            snprintf(ap->essid, sizeof(ap->essid), "%s", essid);
+            essid_set(&ap->essid, essid, strlen(essid));
+            ap->report |= REPORT_CHANGED;
         }
     }
-    else if(!ap->essid[0])
-        snprintf(ap->essid, sizeof(ap->essid), "<hidden>");
-    if(channel)
+    else if(!cur[0])
+        essid_set(&ap->essid, "<hidden>", 8);
+    if(channel && channel <= 14 && channel != ap->channel)
+    {
         ap->channel = channel;
-    if(enc)
+        ap->report |= REPORT_CHANGED;
+    }
+    if(enc && enc != ap->enc)
+    {
         ap->enc = enc;
-    if(ht)
+        ap->report |= REPORT_CHANGED;
+    }
+    if(ht && ht != ap->ht)
+    {
         ap->ht = ht;
+        ap->report |= REPORT_CHANGED;
+    }
 }
 
 // utility to tell if an ap has a specific client
 int dev_ap_has_cli(wifi_ap_t * ap, wifi_client_t * cli)
 {
-    for(wifi_client_t * c = ap->clients; c != NULL; c = c->apnext)
+    for(wifi_client_t * c = dev_ap_clients(ap); c != NULL; c = dev_cli_apnext(c))
         if(c == cli)
             return 1;
 
@@ -143,51 +401,51 @@ wifi_client_t * dev_cli_find(uint8_t * mac)
         return NULL;
 
     // find existing client
-    if(status.clients)
-    {
-        wifi_client_t * cli = status.clients;
-        do
-        {
-            if(!memcmp(cli->mac, mac, 6))
-                return cli;
-            cli = cli->next;
-        } while(cli != status.clients);
-    }
+    wifi_client_t * found = devs_hash_find(clients_hash, devs_cli_slots, mac);
+    if(found)
+        return found;
 
     // create new one
-    if(status.clients_count < MAX_DEVS_CLIENTS)
+    wifi_client_t * cli = devs_pool_alloc(&clients_pool, devs_cli_slots);
+    if(!cli)
     {
-        wifi_client_t * cli = (wifi_client_t *)malloc(sizeof(wifi_client_t));
-        if(!cli)
-            return NULL;
-
-        memset(cli, 0, sizeof(wifi_client_t));
-        memcpy(cli->mac, mac, 6);
-        cli->time_l = cli->time_f = millis();
-        search_vendor(mac, cli->vendor);
-
-
-        clist_push_back(&status.clients, cli);
-        status.clients_count += 1;
-        return cli;
+        status.clients_full += 1;
+        return NULL;
     }
 
-    return NULL;
+    char vendor[9];
+    uint32_t now = millis();
+    memcpy(cli->mac, mac, 6);
+    cli->time_f = devs_min(now);
+    cli->time_l = devs_sec(now);
+    cli->report = REPORT_NEW;
+    cli->vendor = search_vendor(mac, vendor) + 1;
+
+    devs_list_push(&status.clients, devs_cli_slots, cli);
+    devs_hash_add(clients_hash, devs_cli_slots, cli);
+    status.clients_count += 1;
+    status.devs_new += 1;
+    if(status.clients_count > status.clients_peak)
+        status.clients_peak = status.clients_count;
+    return cli;
 }
 
 // bind a client to an AP, client must be unbound! before this call
 void dev_cli_bind(wifi_client_t * cli, wifi_ap_t * ap)
 {
-    cli->ap             = ap;
+    cli->ap             = dev_ap_slot(ap);
     cli->apnext         = ap->clients;
-    ap->clients         = cli;
+    ap->clients         = dev_cli_slot(cli);
     ap->clients_count  += 1;
+
+    cli->report        |= REPORT_CHANGED;
+    ap->report         |= REPORT_CHANGED;
 }
 
 // unbinds cli from ap
 int dev_cli_unbind(wifi_client_t * cli)
 {
-    wifi_ap_t *     ap = cli->ap;
+    wifi_ap_t *     ap = dev_cli_ap(cli);
     wifi_client_t * c, * p;
 
     // not bound? abort
@@ -197,23 +455,26 @@ int dev_cli_unbind(wifi_client_t * cli)
     // make sure cli is bound to ap first
     if(!dev_ap_has_cli(ap, cli))
     {
-        cli->ap = NULL;
-        cli->apnext = NULL;
+        cli->ap = 0;
+        cli->apnext = 0;
         return -1;
     }
 
+    cli->report |= REPORT_CHANGED;
+    ap->report  |= REPORT_CHANGED;
+
     // first client in linked list?
-    if(ap->clients == cli)
+    if(dev_ap_clients(ap) == cli)
     {
-        ap->clients = ap->clients->apnext;
-        cli->ap = NULL;
-        cli->apnext = NULL;
+        ap->clients = cli->apnext;
+        cli->ap = 0;
+        cli->apnext = 0;
         ap->clients_count -= 1;
         return 0;
     }
 
-    p = ap->clients;
-    c = p->apnext;
+    p = dev_ap_clients(ap);
+    c = dev_cli_apnext(p);
 
     while(c)
     {
@@ -221,12 +482,12 @@ int dev_cli_unbind(wifi_client_t * cli)
         {
             p->apnext = c->apnext;
             ap->clients_count -= 1;
-            cli->apnext = NULL;
-            cli->ap = NULL;
+            cli->apnext = 0;
+            cli->ap = 0;
             return 0;
         }
         p = c;
-        c = c->apnext;
+        c = dev_cli_apnext(c);
     }
 
     return -1;
@@ -238,9 +499,16 @@ void dev_cli_update(wifi_client_t * cli, wifi_ap_t * ap, int8_t rssi)
     if(!cli)    return;
 
     // update client dev
-    cli->time_l = millis();
+    uint32_t now = millis();
+    cli->time_l = devs_sec(now);
     cli->pkt_count += 1;
     cli->rssi = rssi;
+    if(!cli->rh && cli->pkt_count > 1)
+        cli->rh = rssi_take(dev_cli_slot(cli) | RSSI_OWNER_CLI, now);
+    if(cli->rh)
+        rssi_add(&rssi_slots[cli->rh - 1], rssi, now);
+    if(abs(rssi - cli->rssi_rep) >= REPORT_RSSI_DELTA)
+        cli->report |= REPORT_CHANGED;
 
     if(!ap)     return;
 
@@ -249,7 +517,7 @@ void dev_cli_update(wifi_client_t * cli, wifi_ap_t * ap, int8_t rssi)
         dev_cli_bind(cli, ap);
 
     // bound to a different AP?
-    else if(cli->ap != ap)
+    else if(dev_cli_ap(cli) != ap)
     {
         dev_cli_unbind(cli);
         dev_cli_bind(cli, ap);
@@ -257,6 +525,28 @@ void dev_cli_update(wifi_client_t * cli, wifi_ap_t * ap, int8_t rssi)
 }
 
 
+// directed probe request from cli, kept most recent first
+void dev_cli_probe(wifi_client_t * cli, const char * essid, size_t len)
+{
+    essid_t h = essid_get(essid, len);
+    if(!h)
+        return;
+
+    // already known: move it to the front
+    int i;
+    for(i=0; i<CLI_PROBES - 1 && cli->probes[i] != h; i++)
+        ;
+    if(cli->probes[i] == h)
+        essid_put(h);
+    else
+        essid_put(cli->probes[i]);
+
+    for(; i>0; i--)
+        cli->probes[i] = cli->probes[i - 1];
+    cli->probes[0] = h;
+}
+
+
 // ========================================================================= //
 // devs cleanup
 // ========================================================================= //
@@ -264,51 +554,81 @@ void dev_cli_update(wifi_client_t * cli, wifi_ap_t * ap, int8_t rssi)
 // remove a client from our list & fixes everything thats needed
 void devs_cli_del(wifi_client_t * cli)
 {
+    // last word for the history log
+    hist_cli_gone(cli);
+
     // unbind first
     dev_cli_unbind(cli);
+    for(int i=0; i<CLI_PROBES; i++)
+        essid_put(cli->probes[i]);
+
+    // reader knows about it? tell it's gone
+    if(!(cli->report & REPORT_NEW))
+        report_gone(REPORT_R_CLI_GONE, cli->mac);
 
     // unlink from circular linked list
-    clist_unlink(&status.clients, cli);
+    devs_list_unlink(&status.clients, devs_cli_slots, cli);
+    devs_hash_del(clients_hash, devs_cli_slots, cli);
     status.clients_count -= 1;
 
     // currently selected / displayed?
     if(status.cur_cli == cli)
         status.cur_cli = NULL;
 
-    // free memory
-    free(cli);
+    // back to the pool
+    rssi_release(cli->rh);
+    devs_pool_free(&clients_pool, devs_cli_slots, cli);
 }
 
 // remove a client from our list & fixes everything thats needed
 void devs_ap_del(wifi_ap_t * ap)
 {
+    // last word for the history log
+    hist_ap_gone(ap);
+
     // unbind all clients first
     while(ap->clients)
     {
-        wifi_client_t * c = ap->clients;
+        wifi_client_t * c = dev_ap_clients(ap);
         ap->clients = c->apnext;
-        c->ap = NULL;
-        c->apnext = NULL;
+        c->ap = 0;
+        c->apnext = 0;
+        c->report |= REPORT_CHANGED;
     }
 
+    // reader knows about it? tell it's gone
+    if(!(ap->report & REPORT_NEW))
+        report_gone(REPORT_R_AP_GONE, ap->mac);
+
     // unlink from circular linked list
-    clist_unlink(&status.aps, ap);
+    devs_list_unlink(&status.aps, devs_ap_slots, ap);
+    devs_hash_del(aps_hash, devs_ap_slots, ap);
     status.aps_count -= 1;
 
     // currently selected / displayed?
     if(status.cur_ap == ap)
         status.cur_ap = NULL;
 
-    // free memory
-    free(ap);
+    essid_put(ap->essid);
+
+    // back to the pool
+    rssi_release(ap->rh);
+    devs_pool_free(&aps_pool, devs_ap_slots, ap);
 }
 
 
+// forget every device (duty.cpp: they are in the rtc summary & ram goes with the sleep)
+void devs_clear(void)
+{
+    while(status.clients)
+        devs_cli_del(status.clients);
+    while(status.aps)
+        devs_ap_del(status.aps);
+}
+
 // remove APs and clients that we havent seen in a long time
 int devs_cleanup(void)
 {
-    devs_lock();
-
     uint32_t now = millis();
     int n = 0;
 
@@ -318,15 +638,15 @@ int devs_cleanup(void)
         wifi_client_t * cli = status.clients;
         do
         {
-            if(cli->time_l + 60000 < now)
+            if(dev_age(cli->time_l, now) > 60)
             {
-                wifi_client_t * next = (cli == cli->next) ? NULL : cli->next;
+                wifi_client_t * next = (cli == dev_cli_next(cli)) ? NULL : dev_cli_next(cli);
                 devs_cli_del(cli);
                 n += 1;
                 cli = next;
             }
             else
-                cli = cli->next;
+                cli = dev_cli_next(cli);
         } while(cli && cli != status.clients);
     }
 
@@ -336,44 +656,26 @@ int devs_cleanup(void)
         wifi_ap_t * ap = status.aps;
         do
         {
-            int is_old = ap->time_l + 60000 < now;
-            int is_fake = (ap->time_l + 5000 < now) && (ap->beacons == 1) && !(ap->clients);
+            int is_old = dev_age(ap->time_l, now) > 60;
+            int is_fake = dev_age(ap->time_l, now) > 5 && (ap->beacons == 1) && !(ap->clients);
 
             if(is_old || is_fake)
             {
-                wifi_ap_t * next = (ap == ap->next) ? NULL : ap->next;
+                if(is_fake)
+                {
+                    status.detected_fake_aps += 1;
+                    detect_ap_fake(ap);
+                }
+
+                wifi_ap_t * next = (ap == dev_ap_next(ap)) ? NULL : dev_ap_next(ap);
                 devs_ap_del(ap);
                 n += 1;
                 ap = next;
-
-                if(is_fake)
-                    status.detected_fake_aps += 1;
             }
             else
-                ap = ap->next;
+                ap = dev_ap_next(ap);
         } while(ap && ap != status.aps);
     }
 
-    devs_unlock();
     return n;
 }
-
-// ========================================================================= //
-// SMP safety :)
-// ========================================================================= //
-
-// esp8266 is dual core :)
-// gota protect promisc cb access when we cleanup old devices!
-static volatile int     devs_spinlock = 0;
-void devs_lock(void)
-{
-    while(devs_spinlock)
-        delay(0);
-    devs_spinlock = 1;
-}
-
-void devs_unlock(void)
-{
-    devs_spinlock = 0;
-}
-
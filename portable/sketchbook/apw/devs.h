@@ -11,8 +11,55 @@
 
 #include "status.h"
 
-#define MAX_DEVS_APS        192
-#define MAX_DEVS_CLIENTS    192
+// ram reserved (statically) for the device tables
+// capacity follows from the struct sizes, so shrinking them buys devices
+// essids live in their own pool (essid.h), rssi histories in the one below
+#define DEVS_MEM_APS        (9 * 1024)
+#define DEVS_MEM_CLIENTS    (9 * 1024)
+
+#define MAX_DEVS_APS        (DEVS_MEM_APS / sizeof(wifi_ap_t))
+// every client may bind to the same AP: no more than wifi_ap_t.clients_count (u8) holds
+#define MAX_DEVS_CLIENTS    (DEVS_MEM_CLIENTS / sizeof(wifi_client_t) < 255 ? DEVS_MEM_CLIENTS / sizeof(wifi_client_t) : (size_t)255)
+
+// mac -> device index size, power of 2 & at least twice the max devices
+#define DEVS_HASH_BITS      10
+#define DEVS_HASH_SIZE      (1 << DEVS_HASH_BITS)
+
+// rssi histories (RSSI_HIST_MAX bytes each) shared by aps & clients, a device
+// gets one on its second frame, the quietest holder gives its up when none is left
+// but only once silent for DEVS_RSSI_IDLE seconds (its fine history is gone by then)
+#define DEVS_RSSI_SLOTS     160
+#define DEVS_RSSI_IDLE      RSSI_FINE
+
+// device pools, for the accessors below
+extern wifi_ap_t        devs_ap_slots[];
+extern wifi_client_t    devs_cli_slots[];
+
+// slot index <-> device
+static inline wifi_ap_t *     dev_ap_at(dev_idx_t i)                { return i ? &devs_ap_slots[i - 1] : NULL; }
+static inline wifi_client_t * dev_cli_at(dev_idx_t i)               { return i ? &devs_cli_slots[i - 1] : NULL; }
+static inline dev_idx_t       dev_ap_slot(const wifi_ap_t * ap)     { return ap ? ap - devs_ap_slots + 1 : 0; }
+static inline dev_idx_t       dev_cli_slot(const wifi_client_t * c) { return c ? c - devs_cli_slots + 1 : 0; }
+
+// links
+static inline wifi_ap_t *     dev_ap_next(const wifi_ap_t * ap)         { return dev_ap_at(ap->next); }
+static inline wifi_ap_t *     dev_ap_prev(const wifi_ap_t * ap)         { return dev_ap_at(ap->prev); }
+static inline wifi_client_t * dev_ap_clients(const wifi_ap_t * ap)      { return dev_cli_at(ap->clients); }
+static inline wifi_ap_t *     dev_cli_ap(const wifi_client_t * cli)     { return dev_ap_at(cli->ap); }
+static inline wifi_client_t * dev_cli_apnext(const wifi_client_t * cli) { return dev_cli_at(cli->apnext); }
+static inline wifi_client_t * dev_cli_next(const wifi_client_t * cli)   { return dev_cli_at(cli->next); }
+static inline wifi_client_t * dev_cli_prev(const wifi_client_t * cli)   { return dev_cli_at(cli->prev); }
+
+// timestamps: last seen in seconds (wrap-safe for 18h), first seen in minutes
+static inline uint16_t devs_sec(uint32_t ms)                { return ms / 1000; }
+static inline uint16_t devs_min(uint32_t ms)                { return ms / 60000 > 0xffff ? 0xffff : ms / 60000; }
+static inline uint32_t dev_age(uint16_t time_l, uint32_t now) { return (uint16_t)(devs_sec(now) - time_l); }
+static inline uint32_t dev_last_ms(uint16_t time_l, uint32_t now) { return (now / 1000 - dev_age(time_l, now)) * 1000; }
+static inline uint32_t dev_first_ms(uint16_t time_f)        { return (uint32_t)time_f * 60000; }
+
+// rssi history, an empty one until the device got a slot
+const rssi_hist_t *     dev_ap_rssi(const wifi_ap_t * ap);
+const rssi_hist_t *     dev_cli_rssi(const wifi_client_t * cli);
 
 
 int             dev_ap_index(wifi_ap_t * ap);
@@ -25,11 +72,10 @@ wifi_client_t * dev_cli_find(uint8_t * mac);
 void            dev_cli_update(wifi_client_t * cli, wifi_ap_t * ap, int8_t rssi);
 void            dev_cli_bind(wifi_client_t * cli, wifi_ap_t * ap);
 int             dev_cli_unbind(wifi_client_t * cli);
+void            dev_cli_probe(wifi_client_t * cli, const char * essid, size_t len);
 void            devs_cli_del(wifi_client_t * cli);
 
 int             devs_cleanup(void);
-
-void devs_lock(void);
-void devs_unlock(void);
+void            devs_clear(void);
 
 #endif
@@ -0,0 +1,350 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : duty.cpp                                                   //
+// Description : duty-cycled monitoring, rtc memory summary & deep sleep    //
+// ======================================================================== //
+
+#include "duty.h"
+#include "status.h"
+#include "wifi.h"
+#include "devs.h"
+#include "ring.h"
+#include "sched.h"
+#include "hist.h"
+#include "utils.h"
+#include "ui.h"
+#include "Arduino.h"
+
+extern "C" {
+    #include "user_interface.h"
+}
+
+// cont.S: gives control back to the sdk, loop() is not resumed (see ESP.deepSleep())
+extern "C" void esp_yield(void);
+
+static_assert(offsetof(duty_rtc_t, devs) == DUTY_HDR_SIZE, "DUTY_HDR_SIZE does not match duty_rtc_t");
+static_assert(sizeof(duty_rtc_t) <= DUTY_RTC_SIZE, "duty_rtc_t does not fit the rtc user memory");
+static_assert(sizeof(duty_rtc_t) % 4 == 0, "rtc memory is written in 4 byte blocks");
+static_assert(DUTY_FLUSH_EVERY < 256, "duty_dev_t.seen wraps after 256 cycles");
+
+static duty_rtc_t   rtc;
+
+static uint16_t     channels    = DUTY_CHANNELS;
+static uint32_t     dwell       = DUTY_DWELL_MS;
+static uint32_t     sleep_ms    = DUTY_SLEEP_MS;
+static uint8_t      flush_every = DUTY_FLUSH_EVERY;
+
+static int          task = -1;
+static uint8_t      chan = 0;       // channel of the burst, 0 = asleep
+static uint32_t     wake_ms;        // millis() at wake up, 0 after a boot
+static uint32_t     wake_frames;    // status.pkt_recv at wake up
+static uint32_t     sleep_until;    // host builds: when the "reboot" is due
+
+
+// ========================================================================= //
+// rtc memory
+// ========================================================================= //
+
+// fnv-1a over everything after the crc
+static uint32_t rtc_crc(void)
+{
+    const uint8_t * p = (const uint8_t *)&rtc + offsetof(duty_rtc_t, cycles);
+    uint32_t h = 2166136261u;
+
+    for(size_t i=0; i<sizeof(rtc) - offsetof(duty_rtc_t, cycles); i++)
+    {
+        h ^= p[i];
+        h *= 16777619;
+    }
+    return h;
+}
+
+// power on leaves garbage in there, a crash or reset keeps the summary
+static void rtc_load(void)
+{
+    if(system_rtc_mem_read(DUTY_RTC_BLOCK, &rtc, sizeof(rtc)) && rtc.magic == DUTY_MAGIC && rtc.crc == rtc_crc())
+        return;
+
+    memset(&rtc, 0, sizeof(rtc));
+    rtc.magic = DUTY_MAGIC;
+}
+
+static void rtc_save(void)
+{
+    rtc.crc = rtc_crc();
+    system_rtc_mem_write(DUTY_RTC_BLOCK, &rtc, sizeof(rtc));
+}
+
+
+// ========================================================================= //
+// summary
+// ========================================================================= //
+
+// entry for this device, a free one or the longest unheard (flushed ones first)
+// NULL if every entry was heard in this very cycle
+static duty_dev_t * sum_get(const uint8_t * mac, uint8_t ap)
+{
+    int      victim = -1;
+    uint32_t worst = 0;
+
+    for(int i=0; i<rtc.count; i++)
+    {
+        duty_dev_t * d = &rtc.devs[i];
+        if((d->flags & DUTY_F_AP) == ap && !memcmp(d->mac, mac, 6))
+            return d;
+
+        uint32_t score = (uint8_t)(rtc.cycles - d->seen) + (d->flags & DUTY_F_DIRTY ? 0 : 256);
+        if(score > worst)
+        {
+            victim = i;
+            worst = score;
+        }
+    }
+
+    duty_dev_t * d;
+    if(rtc.count < DUTY_DEVS)
+        d = &rtc.devs[rtc.count++];
+    else if(victim >= 0)
+    {
+        d = &rtc.devs[victim];
+        if(d->flags & DUTY_F_DIRTY)
+            rtc.lost += 1;
+    }
+    else
+    {
+        rtc.lost += 1;
+        return NULL;
+    }
+
+    memset(d, 0, sizeof(*d));
+    memcpy(d->mac, mac, 6);
+    d->flags = ap;
+    return d;
+}
+
+static void sum_update(duty_dev_t * d, int8_t rssi, uint8_t channel, uint8_t flags)
+{
+    if(!d)
+        return;
+
+    // rssi is the strongest since the last flush
+    if(!(d->flags & DUTY_F_DIRTY) || rssi > d->rssi)
+        d->rssi = rssi;
+    d->seen     = rtc.cycles;
+    d->channel  = channel;
+    d->flags   |= DUTY_F_DIRTY | flags;
+}
+
+// device table & alerts of this burst into the summary, aps first
+static void sum_fold(void)
+{
+    if(status.aps)
+    {
+        wifi_ap_t * ap = status.aps;
+        do
+        {
+            // a single beacon is spam, same rule as the history
+            if(ap->beacons > 1 || ap->clients)
+                sum_update(sum_get(ap->mac, DUTY_F_AP), ap->rssi, ap->channel, ap->alerts << DUTY_F_ALERT);
+            ap = dev_ap_next(ap);
+        } while(ap != status.aps);
+    }
+
+    if(status.clients)
+    {
+        wifi_client_t * cli = status.clients;
+        do
+        {
+            if(cli->pkt_count)
+                sum_update(sum_get(cli->mac, 0), cli->rssi, cli->ap ? dev_cli_ap(cli)->channel : 0, 0);
+            cli = dev_cli_next(cli);
+        } while(cli != status.clients);
+    }
+
+    for(int i=0; i<detect_count(); i++)
+    {
+        detect_alert_t * a = detect_get(i);
+        if((int32_t)(a->start - wake_ms) >= 0 && a->type < DETECT_T_MAX && rtc.alerts[a->type] < 0xffff)
+            rtc.alerts[a->type] += 1;
+    }
+}
+
+// devices heard since the last flush go to the history log, stamped with the time their
+// cycle was into the history boot. flushes carry on in one boot, a new one is counted
+// after a power on or when the seconds of the stamps would run out
+static void sum_flush(void)
+{
+    uint32_t cycle_ms = sleep_ms + (rtc.cycles ? rtc.awake_ms / rtc.cycles : 0);
+    uint32_t span     = rtc.cycles - rtc.flushed;
+    char     vendor[9];
+
+    if(FEATURE_HISTORY)
+    {
+        uint32_t cycles = rtc.hist_cycles + span;
+        if(!rtc.hist_cycles || cycles > 0xffff || (uint64_t)cycles * cycle_ms / 1000 > HIST_SEC_MAX)
+        {
+            hist_init();
+            rtc.hist_cycles = 0;
+        }
+        else
+            hist_open((uint64_t)rtc.hist_cycles * cycle_ms / 1000);
+
+        // the last snapshot is in the log now, hist_init() may have put its devices back
+        devs_clear();
+
+        for(int i=0; i<rtc.count; i++)
+        {
+            duty_dev_t * d = &rtc.devs[i];
+            if(!(d->flags & DUTY_F_DIRTY))
+                continue;
+
+            uint32_t   n = span - (uint8_t)(rtc.cycles - d->seen);
+            hist_rec_t r = {};
+            memcpy(r.mac, d->mac, 6);
+            r.flags     = d->flags & DUTY_F_AP ? HIST_F_AP : (d->channel ? HIST_F_BOUND : 0);
+            r.flags    |= (d->flags >> DUTY_F_ALERT) << HIST_F_ALERT;
+            r.channel   = d->channel;
+            r.first     = r.last = hist_stamp(n * cycle_ms);
+            r.vendor    = search_vendor(d->mac, vendor) + 1;
+            r.rssi_min  = r.rssi_avg = r.rssi_max = d->rssi;
+            hist_add(&r);
+        }
+        hist_close();
+        rtc.hist_cycles += span;
+    }
+
+    for(int i=0; i<rtc.count; i++)
+        rtc.devs[i].flags &= ~DUTY_F_DIRTY;
+    rtc.flushed = rtc.cycles;
+}
+
+
+// ========================================================================= //
+// bursts
+// ========================================================================= //
+
+// next channel of the set after c, 0 once done
+static uint8_t chan_next(uint8_t c)
+{
+    for(c = c + 1; c < 16; c++)
+        if(channels & (1 << c))
+            return c;
+    return 0;
+}
+
+static void chan_set(uint8_t c)
+{
+    chan = c;
+    status.channel = c;
+    wifi_set_channel(c);
+}
+
+static void burst_start(uint32_t now)
+{
+    wake_ms     = now;
+    wake_frames = status.pkt_recv;
+    rtc.cycles += 1;
+
+    uint8_t c = chan_next(0);
+    chan_set(c ? c : status.channel);
+}
+
+static void burst_end(void)
+{
+    // frames still in the ring belong to this burst
+    wifi_drain(RING_SIZE);
+    sum_fold();
+    devs_clear();
+    if(rtc.cycles - rtc.flushed >= flush_every)
+        sum_flush();
+
+    // flash work included, it is what the battery pays
+    uint32_t now    = millis();
+    uint32_t awake  = now - wake_ms;
+    uint32_t frames = status.pkt_recv - wake_frames;
+    rtc.awake_last  = awake > 0xffff ? 0xffff : awake;
+    rtc.frames_last = frames > 0xffff ? 0xffff : frames;
+    rtc.awake_ms   += awake;
+    rtc.frames     += frames;
+    rtc_save();
+    duty_dump();
+    Serial.flush();     // the line above is all this cycle leaves behind
+
+    // no calibration on wake up (less current), except before flushes
+    chan = 0;
+    sleep_until = now + sleep_ms;
+    wifi_promiscuous_enable(0);
+    system_deep_sleep_set_option(rtc.cycles + 1 - rtc.flushed >= flush_every ? RF_CAL : RF_NO_CAL);
+    system_deep_sleep(sleep_ms * 1000);
+    esp_yield();        // the sleep is pending: nothing of ui / sched runs any more
+}
+
+
+// ========================================================================= //
+// interface
+// ========================================================================= //
+
+void duty_init(void)
+{
+    rtc_load();
+    burst_start(0);
+
+    if(task < 0)
+        task = sched_add("duty", duty_tick, dwell);
+    ui_printf("> duty: cycle %u, %u devices in rtc memory\n", rtc.cycles, rtc.count);
+}
+
+void duty_config(uint16_t c, uint32_t dwell_ms, uint32_t sleep, uint8_t flush)
+{
+    if(c)
+        channels = c;
+    if(dwell_ms)
+    {
+        dwell = dwell_ms;
+        sched_set_period(task, dwell);
+    }
+    if(sleep)
+        sleep_ms = sleep;
+    if(flush)
+        flush_every = flush;
+}
+
+void duty_tick(void)
+{
+    uint32_t now = millis();
+
+    // the sdk returns from deep sleep on host builds only: carry on as after a wake up
+    if(!chan)
+    {
+        if((int32_t)(now - sleep_until) < 0)
+            return;
+        rtc_load();
+        wifi_promiscuous_enable(1);
+        burst_start(now);
+        return;
+    }
+
+    uint8_t c = chan_next(chan);
+    if(c)
+        chan_set(c);
+    else
+        burst_end();
+}
+
+const duty_rtc_t * duty_summary(void)
+{
+    return &rtc;
+}
+
+// awake time is what costs energy: per cycle, & frames heard for each awake ms
+void duty_dump(void)
+{
+    uint32_t avg = rtc.cycles ? rtc.awake_ms / rtc.cycles : 0;
+    uint32_t fpm = rtc.awake_ms ? (uint64_t)rtc.frames * 100 / rtc.awake_ms : 0;
+
+    ui_printf("duty        cycle %u  awake %u ms (avg %u)  frames %u (%u.%02u / awake ms)  devices %u/%u  lost %u  alerts %u/%u/%u  flushed @%u\n",
+        rtc.cycles, rtc.awake_last, avg, rtc.frames_last, fpm / 100, fpm % 100, rtc.count, (uint32_t)DUTY_DEVS,
+        rtc.lost, rtc.alerts[DETECT_T_DEAUTH], rtc.alerts[DETECT_T_KARMA], rtc.alerts[DETECT_T_BEACON], rtc.flushed);
+}
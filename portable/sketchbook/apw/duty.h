@@ -0,0 +1,76 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : duty.h                                                     //
+// Description : duty-cycled monitoring, rtc memory summary & deep sleep    //
+// ======================================================================== //
+
+#ifndef _DUTY_H
+#define _DUTY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "detect.h"
+
+// a cycle: wake, listen DUTY_DWELL_MS on each channel of the set, fold the device table
+// into the rtc summary, deep sleep. ram is lost in between, only the summary stays
+#define DUTY_CHANNELS       ((1 << 1) | (1 << 6) | (1 << 11))  // bit n = channel n
+#define DUTY_DWELL_MS       250     // per channel & cycle
+#define DUTY_SLEEP_MS       60000
+#define DUTY_FLUSH_EVERY    15      // cycles between two writes to spiffs (FEATURE_HISTORY)
+
+// rtc user memory: 512 bytes from block 64 (4 bytes per block), survives deep sleep
+#define DUTY_RTC_BLOCK      64
+#define DUTY_RTC_SIZE       512
+#define DUTY_MAGIC          0x44575041  // "APWD"
+
+#define DUTY_F_AP           0x01
+#define DUTY_F_DIRTY        0x02    // heard since the last flush
+#define DUTY_F_ALERT        4       // (1 << detect_type_t) raised for the bssid, from this bit on
+
+// a device heard in some cycle, until a newer one needs the entry
+typedef struct duty_dev_t
+{
+    uint8_t         mac[6];
+    int8_t          rssi;           // strongest frame since the last flush
+    uint8_t         seen;           // cycle last heard, low 8 bits
+    uint8_t         flags;          // DUTY_F_*
+    uint8_t         channel;
+} duty_dev_t;
+
+#define DUTY_HDR_SIZE       40
+#define DUTY_DEVS           ((DUTY_RTC_SIZE - DUTY_HDR_SIZE) / sizeof(duty_dev_t))
+
+// everything kept across deep sleeps
+typedef struct duty_rtc_t
+{
+    uint32_t        magic;
+    uint32_t        crc;            // of the bytes after it
+    uint32_t        cycles;         // wakes since power on
+    uint32_t        flushed;        // cycle of the last flush to spiffs
+    uint32_t        awake_ms;       // summed over every cycle
+    uint32_t        frames;         // summed over every cycle
+    uint16_t        awake_last;     // ms awake in the last cycle
+    uint16_t        frames_last;    // frames heard in the last cycle
+    uint16_t        count;          // devs[] in use
+    uint16_t        lost;           // devices pushed out before they were flushed
+    uint16_t        alerts[DETECT_T_MAX];   // alerts raised, per detect_type_t
+    uint16_t        hist_cycles;    // cycles stamped in the current history boot, 0 = none counted yet
+    duty_dev_t      devs[DUTY_DEVS];
+} duty_rtc_t;
+
+// load the summary (fresh one after a power on), start the first burst
+void    duty_init(void);
+
+// channel set (bit n = channel n), dwell & sleep times, cycles between flushes. 0 = unchanged
+void    duty_config(uint16_t channels, uint32_t dwell_ms, uint32_t sleep_ms, uint8_t flush_every);
+
+// hop through the set, then fold, maybe flush & sleep (scheduled every dwell)
+void    duty_tick(void);
+
+const duty_rtc_t * duty_summary(void);
+void    duty_dump(void);
+
+#endif
@@ -0,0 +1,214 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : essid.cpp                                                  //
+// Description : interned essids, refcounted strings in a fixed arena       //
+// ======================================================================== //
+
+#include "essid.h"
+#include "status.h"
+#include "ui.h"
+
+#include <string.h>
+
+static_assert(ESSID_MAX <= 255, "essid handles must fit the arena tag");
+static_assert(ESSID_ARENA <= 65535, "essid arena offsets are 16 bits");
+
+// arena layout: [handle][string][nul], handle 0 marks a released string
+typedef struct essid_ent_t
+{
+    uint16_t        off;            // string offset in the arena (after the tag)
+    uint8_t         len;
+    uint8_t         next;           // hash chain, or free list when unused
+    uint16_t        refs;           // 0 = free entry
+} essid_ent_t;
+
+static essid_ent_t  ents[ESSID_MAX + 1];    // [0] is never used
+static uint8_t      heads[ESSID_HASH_SIZE];
+static uint8_t      free_ents = 0;
+static uint16_t     bump = 1;               // entries never handed out start here
+
+static uint8_t      arena[ESSID_ARENA];
+static uint16_t     top = 0;                // arena bytes handed out
+static uint16_t     dead = 0;               // released bytes below top
+
+
+// ========================================================================= //
+// internals
+// ========================================================================= //
+
+// fnv-1a
+static inline uint32_t essid_hash(const char * s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for(size_t i=0; i<len; i++)
+    {
+        h ^= (uint8_t)s[i];
+        h *= 16777619;
+    }
+    return (h ^ (h >> 16)) & (ESSID_HASH_SIZE - 1);
+}
+
+// slide the live strings down over the released ones, handles do not move
+static void essid_compact(void)
+{
+    uint16_t w = 0;
+
+    for(uint16_t r = 0; r < top; )
+    {
+        uint8_t  tag  = arena[r];
+        uint16_t size = strlen((char *)arena + r + 1) + 2;
+
+        if(tag)
+        {
+            if(w != r)
+                memmove(arena + w, arena + r, size);
+            ents[tag].off = w + 1;
+            w += size;
+        }
+        r += size;
+    }
+
+    top  = w;
+    dead = 0;
+}
+
+
+// ========================================================================= //
+// interface
+// ========================================================================= //
+
+essid_t essid_get(const char * s, size_t len)
+{
+    char tmp[33];
+
+    // what we print & compare is the c string
+    if(len > 32)
+        len = 32;
+    const char * z = (const char *)memchr(s, 0, len);
+    if(z)
+        len = z - s;
+    if(!len)
+        return 0;
+
+    uint32_t b = essid_hash(s, len);
+    for(uint8_t i = heads[b]; i; i = ents[i].next)
+        if(ents[i].len == len && !memcmp(arena + ents[i].off, s, len))
+        {
+            ents[i].refs += 1;
+            return i;
+        }
+
+    // room in the arena, compacting if the holes are enough
+    uint16_t need = len + 2;
+    if(top + need > ESSID_ARENA)
+    {
+        if(top + need - dead > ESSID_ARENA)
+        {
+            status.essid_full += 1;
+            return 0;
+        }
+        memcpy(tmp, s, len);
+        s = tmp;
+        essid_compact();
+    }
+
+    uint8_t i;
+    if(free_ents)
+    {
+        i = free_ents;
+        free_ents = ents[i].next;
+    }
+    else if(bump <= ESSID_MAX)
+        i = bump++;
+    else
+    {
+        status.essid_full += 1;
+        return 0;
+    }
+
+    arena[top] = i;
+    memcpy(arena + top + 1, s, len);
+    arena[top + 1 + len] = 0;
+
+    ents[i].off     = top + 1;
+    ents[i].len     = len;
+    ents[i].refs    = 1;
+    ents[i].next    = heads[b];
+    heads[b]        = i;
+    top            += need;
+    return i;
+}
+
+void essid_put(essid_t h)
+{
+    if(!h || h > ESSID_MAX || !ents[h].refs)
+        return;
+    if(--ents[h].refs)
+        return;
+
+    essid_ent_t * e = &ents[h];
+
+    // off the hash chain
+    uint8_t * p = &heads[essid_hash((char *)arena + e->off, e->len)];
+    while(*p != h)
+        p = &ents[*p].next;
+    *p = e->next;
+
+    // last string of the arena goes right away, others wait for a compaction
+    arena[e->off - 1] = 0;
+    if(e->off + e->len + 1 == top)
+        top -= e->len + 2;
+    else
+        dead += e->len + 2;
+
+    e->next = free_ents;
+    free_ents = h;
+}
+
+int essid_set(essid_t * h, const char * s, size_t len)
+{
+    essid_t n = essid_get(s, len);
+
+    if(n == *h)
+    {
+        essid_put(n);
+        return 0;
+    }
+
+    essid_put(*h);
+    *h = n;
+    return 1;
+}
+
+const char * essid_str(essid_t h)
+{
+    if(!h || h > ESSID_MAX || !ents[h].refs)
+        return "";
+    return (const char *)arena + ents[h].off;
+}
+
+void essid_usage(uint32_t * strings, uint32_t * refs, uint32_t * bytes)
+{
+    *strings = 0;
+    *refs = 0;
+    for(int i=1; i<bump; i++)
+        if(ents[i].refs)
+        {
+            *strings += 1;
+            *refs += ents[i].refs;
+        }
+    *bytes = top - dead;
+}
+
+// saved: what the references would take as char[33] each instead of a handle, minus the pool
+void essid_dump(void)
+{
+    uint32_t strings, refs, bytes;
+    essid_usage(&strings, &refs, &bytes);
+
+    int32_t pool = sizeof(ents) + sizeof(heads) + sizeof(arena);
+    ui_printf("essids      %u strings  %u refs  arena %u/%u bytes (%u dead)  full %u  pool %d bytes  saved %d bytes\n",
+        strings, refs, bytes, ESSID_ARENA, dead, status.essid_full, pool, (int32_t)(refs * (33 - sizeof(essid_t))) - pool);
+}
@@ -0,0 +1,40 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : essid.h                                                    //
+// Description : interned essids, refcounted strings in a fixed arena       //
+// ======================================================================== //
+
+#ifndef _ESSID_H
+#define _ESSID_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// handles are 1..ESSID_MAX (0 = none), they fit the one byte arena tag
+#define ESSID_MAX           255
+#define ESSID_ARENA         2560    // tag + string + terminator per essid
+#define ESSID_HASH_BITS     6
+#define ESSID_HASH_SIZE     (1 << ESSID_HASH_BITS)
+
+typedef uint16_t essid_t;
+
+// the essid s[0..len) (cut at the first nul, at most 32 bytes), one more reference to it
+// returns 0 if it is empty or the pool is full
+essid_t         essid_get(const char * s, size_t len);
+
+// one reference less, the string goes once nobody holds it
+void            essid_put(essid_t h);
+
+// point *h at s, dropping the old one. returns 1 if it changed
+int             essid_set(essid_t * h, const char * s, size_t len);
+
+// "" for 0. only valid until the next essid_get() (the arena gets compacted)
+const char *    essid_str(essid_t h);
+
+// pool usage: distinct strings, references, arena bytes in use
+void            essid_usage(uint32_t * strings, uint32_t * refs, uint32_t * bytes);
+void            essid_dump(void);
+
+#endif
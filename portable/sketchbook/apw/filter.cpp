@@ -0,0 +1,164 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : filter.cpp                                                 //
+// Description : rx prefilter, drops frames before they reach the ring      //
+// ======================================================================== //
+
+#include "filter.h"
+#include "status.h"
+#include "ui.h"
+
+#include <string.h>
+
+static_assert((FILTER_BLOOM_BITS & (FILTER_BLOOM_BITS - 1)) == 0, "FILTER_BLOOM_BITS must be a power of 2");
+
+static uint64_t     types = FILTER_DEFAULT;
+static uint8_t      ouis[FILTER_OUIS][3];
+static uint8_t      ouis_count = 0;
+static uint32_t     bloom[FILTER_BLOOM_BITS / 32];
+
+
+// ========================================================================= //
+// internals
+// ========================================================================= //
+
+// two bloom bits from the oui (fibonacci hashing, top bits)
+static inline uint32_t oui_hash(const uint8_t * mac)
+{
+    return ((mac[0] << 16) | (mac[1] << 8) | mac[2]) * 2654435761u;
+}
+
+#define BLOOM_BIT(h, shift)     (((h) >> (shift)) & (FILTER_BLOOM_BITS - 1))
+#define BLOOM_TEST(n)           (bloom[(n) >> 5] & (1u << ((n) & 31)))
+
+static int oui_ignored(const uint8_t * mac)
+{
+    uint32_t h = oui_hash(mac);
+    if(!BLOOM_TEST(BLOOM_BIT(h, 24)) || !BLOOM_TEST(BLOOM_BIT(h, 16)))
+        return 0;
+
+    // maybe, the list says for sure
+    for(int i=0; i<ouis_count; i++)
+        if(ouis[i][0] == mac[0] && ouis[i][1] == mac[1] && ouis[i][2] == mac[2])
+            return 1;
+    return 0;
+}
+
+// 1 if mac cannot be a device: group bit (multicast / broadcast) or all zeroes
+static inline int mac_bad(const uint8_t * mac)
+{
+    return (mac[0] & 0x01) || !(mac[0] | mac[1] | mac[2] | mac[3] | mac[4] | mac[5]);
+}
+
+
+// ========================================================================= //
+// interface
+// ========================================================================= //
+
+void filter_init(void)
+{
+    types       = FILTER_DEFAULT;
+    ouis_count  = 0;
+    memset(bloom, 0, sizeof(bloom));
+}
+
+void filter_set_types(uint64_t t)
+{
+    types = t;
+}
+
+int filter_ignore_oui(const uint8_t oui[3])
+{
+    for(int i=0; i<ouis_count; i++)
+        if(!memcmp(ouis[i], oui, 3))
+            return 0;
+    if(ouis_count >= FILTER_OUIS)
+        return -1;
+
+    // entry first, the rx callback may be looking
+    memcpy(ouis[ouis_count], oui, 3);
+    uint32_t h = oui_hash(oui);
+    bloom[BLOOM_BIT(h, 24) >> 5] |= 1u << (BLOOM_BIT(h, 24) & 31);
+    bloom[BLOOM_BIT(h, 16) >> 5] |= 1u << (BLOOM_BIT(h, 16) & 31);
+    ouis_count += 1;
+    return 0;
+}
+
+// checks the addresses wifi_frame() would make a device of, cheapest test first
+filter_verdict_t filter_frame(const frame_t * frame, size_t frame_len)
+{
+    // the sdk hands most control frames over with no bytes at all: not even a type to read
+    if(frame_len == 0)
+    {
+        status.filter_short += 1;
+        return FILTER_SHORT;
+    }
+
+    uint8_t type    = (frame->type >> 2) & 0x03;
+    uint8_t subtype = frame->type >> 4;
+
+    // the type first: frames we do not want count as such, even when shorter than a header
+    if(types && !(types & FILTER_TYPE(type, subtype)))
+    {
+        status.filter_types += 1;
+        return FILTER_TYPES;
+    }
+    if(frame_len < sizeof(frame_t))
+    {
+        status.filter_short += 1;
+        return FILTER_SHORT;
+    }
+    if(!types)
+        return FILTER_PASS;
+
+    const uint8_t * dev  = NULL;
+    const uint8_t * dev2 = NULL;
+
+    // data: client & bssid depend on the direction
+    if(type == 2)
+    {
+        uint8_t ds = frame->flags & 0x03;
+        if(ds == 0 || ds == 3)
+        {
+            status.filter_ds += 1;
+            return FILTER_DS;
+        }
+        dev  = frame->addr1;
+        dev2 = frame->addr2;
+    }
+    // beacon / probe response: bssid
+    else if(frame->type == 0x80 || frame->type == 0x50)
+        dev = frame->addr3;
+    // probe request: client
+    else if(frame->type == 0x40)
+        dev = frame->addr2;
+    // deauth / disassoc are counted whoever sends them
+    else
+        return FILTER_PASS;
+
+    if(mac_bad(dev) || (dev2 && mac_bad(dev2)))
+    {
+        status.filter_mac += 1;
+        return FILTER_MAC;
+    }
+    if(ouis_count && (oui_ignored(dev) || (dev2 && oui_ignored(dev2))))
+    {
+        status.filter_oui += 1;
+        return FILTER_OUI;
+    }
+
+    return FILTER_PASS;
+}
+
+void filter_dump(void)
+{
+    uint32_t drops = status.filter_short + status.filter_types + status.filter_ds + status.filter_mac + status.filter_oui;
+
+    ui_printf("prefilter   types %08x%08x  drops %u (short %u type %u ds %u mac %u oui %u) of %u\n",
+        (uint32_t)(types >> 32), (uint32_t)types, drops, status.filter_short, status.filter_types,
+        status.filter_ds, status.filter_mac, status.filter_oui, status.pkt_recv);
+    for(int i=0; i<ouis_count; i++)
+        ui_printf("            ignore %02x:%02x:%02x\n", ouis[i][0], ouis[i][1], ouis[i][2]);
+}
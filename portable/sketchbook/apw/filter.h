@@ -0,0 +1,55 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : filter.h                                                   //
+// Description : rx prefilter, drops frames before they reach the ring      //
+// ======================================================================== //
+
+#ifndef _FILTER_H
+#define _FILTER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "wifi.h"
+
+#define FILTER_OUIS         8       // ignored vendors, exact list behind the bloom bits
+#define FILTER_BLOOM_BITS   256     // power of 2, 2 bits set per oui
+
+// frame type bit: type (0 mgmt, 1 ctrl, 2 data) & subtype from the frame control, as CAPTURE_TYPE()
+#define FILTER_TYPE(type, subtype)      (1ull << (((type) << 4) | (subtype)))
+#define FILTER_DATA                     0x0000ffff00000000ull
+
+// what wifi_frame() does something with, nothing else gets past the rx callback
+#define FILTER_DEFAULT      (FILTER_TYPE(0, 4) | FILTER_TYPE(0, 5) | FILTER_TYPE(0, 8) | \
+                             FILTER_TYPE(0, 10) | FILTER_TYPE(0, 12) | FILTER_DATA)
+
+// why a frame was dropped, see status.filter_*
+typedef enum filter_verdict_t
+{
+    FILTER_PASS,
+    FILTER_SHORT,                   // shorter than an 802.11 header
+    FILTER_TYPES,                   // type / subtype not wanted
+    FILTER_DS,                      // data frame, not exactly one of to_ds / from_ds
+    FILTER_MAC,                     // device address is group (multicast / broadcast) or zero
+    FILTER_OUI,                     // device address from an ignored vendor
+
+    FILTER_MAX,
+} filter_verdict_t;
+
+// back to FILTER_DEFAULT & no ignored vendors
+void                filter_init(void);
+
+// FILTER_TYPE() bits, 0 = prefilter off (every frame goes to the ring)
+void                filter_set_types(uint64_t types);
+
+// stop tracking devices from this vendor (first 3 bytes of the mac), -1 if the list is full
+int                 filter_ignore_oui(const uint8_t oui[3]);
+
+// rx callback side, a handful of compares for the frames we drop
+filter_verdict_t    filter_frame(const frame_t * frame, size_t frame_len);
+
+void                filter_dump(void);
+
+#endif
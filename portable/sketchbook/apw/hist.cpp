@@ -0,0 +1,751 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : hist.cpp                                                   //
+// Description : device history on SPIFFS, append-only log + compaction     //
+// ======================================================================== //
+
+#include "hist.h"
+#include "devs.h"
+#include "ui.h"
+#include "utils.h"
+#include "Arduino.h"
+#include "FS.h"
+
+static_assert(sizeof(hist_rec_t) == 24, "hist_rec_t is a flash format, keep it packed");
+static_assert((HIST_QUEUE & (HIST_QUEUE - 1)) == 0, "HIST_QUEUE must be a power of 2");
+static_assert(HIST_BATCH <= HIST_QUEUE, "HIST_BATCH larger than the queue");
+
+#define HIST_AGE_BINS       16      // log2 bins of record age, for retention
+
+enum { CP_IDLE, CP_LOAD, CP_MERGE };
+
+static uint8_t      active = 0;
+static uint16_t     boot = 0;
+static uint32_t     base_sec = 0;   // stamps of this boot start there (see hist_open)
+
+// records waiting for the log, only touched from loop()
+static hist_rec_t   queue[HIST_QUEUE];
+static uint32_t     q_head = 0;
+static uint32_t     q_tail = 0;
+static uint32_t     q_since;        // millis() when the oldest waiting record was queued
+static uint32_t     last_write;
+static uint32_t     log_size;
+
+// flash budget in bytes, refilled at HIST_RATE
+static int32_t      budget;
+static uint32_t     budget_t;
+
+// snapshot in progress, the cursor follows deletions (see hist_*_gone)
+static File         snap_f;
+static uint32_t     snap_last;      // millis() of the last snapshot start
+static uint8_t      snap_phase;     // 0 idle, 1 aps, 2 clients
+static void *       snap_cur;
+static uint16_t     snap_left;      // devices left to visit in the current list
+static uint16_t     snap_count;
+
+// compaction in progress: cp_buf (sorted, distinct) merged with HIST_FILE into HIST_TMP
+static uint8_t      cp_state = CP_IDLE;
+static hist_rec_t   cp_buf[HIST_MERGE];
+static int          cp_n;
+static int          cp_i;
+static uint32_t     cp_off;         // log bytes folded so far
+static File         cp_in;
+static File         cp_out;
+static hist_rec_t   cp_cur;         // next record of HIST_FILE
+static uint8_t      cp_has;
+static uint32_t     cp_kept;
+static uint32_t     cp_cutoff;      // records older than that are dropped, 0 = keep all
+static uint16_t     cp_ages[HIST_AGE_BINS];
+
+
+// ========================================================================= //
+// records
+// ========================================================================= //
+
+static uint8_t hist_crc(const hist_rec_t * r)
+{
+    const uint8_t * p = (const uint8_t *)r;
+    uint8_t crc = 0;
+
+    for(size_t i=0; i<offsetof(hist_rec_t, crc); i++)
+    {
+        crc ^= p[i];
+        for(int b=0; b<8; b++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+uint32_t hist_stamp(uint32_t ms)
+{
+    uint32_t sec = base_sec + ms / 1000;
+    return ((uint32_t)boot << HIST_SEC_BITS) | (sec > HIST_SEC_MAX ? HIST_SEC_MAX : sec);
+}
+
+// fnv-1a folded to 16 bits, never 0
+static uint16_t hist_essid(const char * essid)
+{
+    uint32_t h = 2166136261u;
+    while(*essid)
+    {
+        h ^= (uint8_t)*essid++;
+        h *= 16777619;
+    }
+    h ^= h >> 16;
+    return (h & 0xffff) ? h : 1;
+}
+
+// min / avg / max over the coarse rssi history
+static void rec_rssi(hist_rec_t * r, const rssi_hist_t * h, int8_t rssi, uint32_t now)
+{
+    int8_t      fine[RSSI_FINE];
+    rssi_span_t coarse[RSSI_COARSE];
+    int         sum = 0;
+    int         n = 0;
+
+    rssi_get(h, now, fine, coarse);
+    r->rssi_min = r->rssi_max = rssi;
+    for(int i=0; i<RSSI_COARSE; i++)
+    {
+        if(!coarse[i].max)
+            continue;
+        if(coarse[i].min < r->rssi_min)
+            r->rssi_min = coarse[i].min;
+        if(coarse[i].max > r->rssi_max)
+            r->rssi_max = coarse[i].max;
+        sum += coarse[i].avg;
+        n += 1;
+    }
+    r->rssi_avg = n ? sum / n : rssi;
+}
+
+static void rec_ap(hist_rec_t * r, wifi_ap_t * ap, uint32_t now)
+{
+    const char * essid = essid_str(ap->essid);
+    int  hidden = !essid[0] || !strcmp(essid, "<hidden>");
+
+    memset(r, 0, sizeof(*r));
+    memcpy(r->mac, ap->mac, 6);
+    r->flags    = HIST_F_AP | (ap->alerts << HIST_F_ALERT);
+    r->flags   |= hidden ? HIST_F_HIDDEN : 0;
+    r->flags   |= (ap->beacons == 1 && !ap->clients) ? HIST_F_FAKE : 0;
+    r->channel  = ap->channel;
+    r->first    = hist_stamp(dev_first_ms(ap->time_f));
+    r->last     = hist_stamp(dev_last_ms(ap->time_l, now));
+    r->essid    = hidden ? 0 : hist_essid(essid);
+    r->vendor   = ap->vendor;
+    rec_rssi(r, dev_ap_rssi(ap), ap->rssi, now);
+    r->crc      = hist_crc(r);
+}
+
+static void rec_cli(hist_rec_t * r, wifi_client_t * cli, uint32_t now)
+{
+    memset(r, 0, sizeof(*r));
+    memcpy(r->mac, cli->mac, 6);
+    r->flags    = cli->ap ? HIST_F_BOUND : 0;
+    r->channel  = cli->ap ? dev_cli_ap(cli)->channel : 0;
+    r->first    = hist_stamp(dev_first_ms(cli->time_f));
+    r->last     = hist_stamp(dev_last_ms(cli->time_l, now));
+    r->vendor   = cli->vendor;
+    rec_rssi(r, dev_cli_rssi(cli), cli->rssi, now);
+    r->crc      = hist_crc(r);
+}
+
+static int rec_cmp(const hist_rec_t * a, const hist_rec_t * b)
+{
+    int d = memcmp(a->mac, b->mac, 6);
+    return d ? d : (a->flags & HIST_F_AP) - (b->flags & HIST_F_AP);
+}
+
+// fold b into a (same device), merging the same record twice changes nothing
+static void rec_merge(hist_rec_t * a, const hist_rec_t * b)
+{
+    if(b->last > a->last)
+    {
+        a->last     = b->last;
+        a->channel  = b->channel;
+        a->essid    = b->essid;
+        a->vendor   = b->vendor;
+        a->rssi_avg = b->rssi_avg;
+    }
+    if(b->first < a->first)
+        a->first = b->first;
+    if(b->rssi_min < a->rssi_min)
+        a->rssi_min = b->rssi_min;
+    if(b->rssi_max > a->rssi_max)
+        a->rssi_max = b->rssi_max;
+    a->flags |= b->flags;
+    a->crc = hist_crc(a);
+}
+
+
+// ========================================================================= //
+// queue & log
+// ========================================================================= //
+
+static void hist_queue(const hist_rec_t * r)
+{
+    if(q_head - q_tail >= HIST_QUEUE)
+    {
+        status.hist_drops += 1;
+        return;
+    }
+
+    if(q_head == q_tail)
+        q_since = millis();
+    queue[q_head % HIST_QUEUE] = *r;
+    q_head += 1;
+    status.hist_queued = q_head - q_tail;
+}
+
+static void budget_refill(uint32_t now)
+{
+    uint32_t add = (uint64_t)(now - budget_t) * HIST_RATE / 60000;
+    if(!add)
+        return;
+
+    budget_t += (uint64_t)add * 60000 / HIST_RATE;
+    budget = budget + (int32_t)add > HIST_BURST ? HIST_BURST : budget + add;
+}
+
+static void budget_spend(size_t bytes)
+{
+    budget -= bytes;
+    status.hist_flash += bytes;
+}
+
+// append the queue to the log once a batch is ready, returns 1 if it wrote
+static int hist_flush(uint32_t now, int force)
+{
+    uint32_t n = q_head - q_tail;
+    if(!n)
+        return 0;
+
+    if(!force)
+    {
+        if(n < HIST_BATCH && now - q_since < HIST_FLUSH_MS)
+            return 0;
+        if(now - last_write < HIST_WRITE_MS || budget < (int32_t)(n * sizeof(hist_rec_t)))
+            return 0;
+    }
+
+    File f = SPIFFS.open(HIST_LOG, "a");
+    if(!f)
+        return 0;
+
+    // the ring wraps at most once
+    while(q_tail != q_head)
+    {
+        uint32_t i = q_tail % HIST_QUEUE;
+        uint32_t k = q_head - q_tail < HIST_QUEUE - i ? q_head - q_tail : HIST_QUEUE - i;
+        size_t   w = f.write((uint8_t *)&queue[i], k * sizeof(hist_rec_t));
+
+        // a short write (fs full) leaves a torn record, readers resync on the crc
+        log_size += w;
+        budget_spend(w);
+        if(w != k * sizeof(hist_rec_t))
+            break;
+
+        q_tail += k;
+        status.hist_written += k;
+    }
+    f.close();
+
+    last_write = now;
+    q_since = now;
+    status.hist_queued = q_head - q_tail;
+    return 1;
+}
+
+
+// ========================================================================= //
+// snapshot of the device table
+// ========================================================================= //
+
+static void snap_start(uint32_t now)
+{
+    snap_last = now;
+    snap_f = SPIFFS.open(HIST_LIVE_TMP, "w");
+    if(!snap_f)
+        return;
+
+    snap_phase  = 1;
+    snap_cur    = status.aps;
+    snap_left   = status.aps_count;
+    snap_count  = 0;
+}
+
+// write the next devices, returns 1 once the snapshot is complete
+static int snap_step(uint32_t now)
+{
+    hist_rec_t  r[HIST_SNAP_STEP];
+    int         n = 0;
+
+    while(n < HIST_SNAP_STEP && snap_phase)
+    {
+        if(!snap_cur || !snap_left || snap_count + n >= HIST_LIVE_MAX)
+        {
+            if(snap_phase == 1 && snap_count + n < HIST_LIVE_MAX)
+            {
+                snap_phase  = 2;
+                snap_cur    = status.clients;
+                snap_left   = status.clients_count;
+            }
+            else
+                snap_phase = 0;
+            continue;
+        }
+
+        // devices restored at boot but not heard since are left out
+        if(snap_phase == 1)
+        {
+            wifi_ap_t * ap = (wifi_ap_t *)snap_cur;
+            if(ap->beacons)
+                rec_ap(&r[n++], ap, now);
+            snap_cur = dev_ap_next(ap);
+        }
+        else
+        {
+            wifi_client_t * cli = (wifi_client_t *)snap_cur;
+            if(cli->pkt_count)
+                rec_cli(&r[n++], cli, now);
+            snap_cur = dev_cli_next(cli);
+        }
+        snap_left -= 1;
+    }
+
+    if(n)
+    {
+        budget_spend(snap_f.write((uint8_t *)r, n * sizeof(hist_rec_t)));
+        snap_count += n;
+    }
+    if(snap_phase)
+        return 0;
+
+    snap_f.close();
+    SPIFFS.remove(HIST_LIVE);
+    SPIFFS.rename(HIST_LIVE_TMP, HIST_LIVE);
+    return 1;
+}
+
+// the snapshot cursor must not point at a freed device
+static void snap_unlink(void * dev, void * next)
+{
+    if(snap_cur != dev)
+        return;
+
+    snap_cur = next != dev ? next : NULL;
+    if(snap_left)
+        snap_left -= 1;
+}
+
+
+// ========================================================================= //
+// compaction
+// ========================================================================= //
+
+// position of r in cp_buf (or where it goes), 1 if it is there
+static int cp_find(const hist_rec_t * r, int * pos)
+{
+    int beg = 0;
+    int end = cp_n;
+
+    while(beg < end)
+    {
+        int mid = (beg + end) / 2;
+        int c = rec_cmp(&cp_buf[mid], r);
+        if(!c)
+        {
+            *pos = mid;
+            return 1;
+        }
+        if(c < 0)
+            beg = mid + 1;
+        else
+            end = mid;
+    }
+    *pos = beg;
+    return 0;
+}
+
+// fold log records into cp_buf until it holds HIST_MERGE distinct devices, then open the merge
+static void cp_load(void)
+{
+    File        f = SPIFFS.open(HIST_LOG, "r");
+    hist_rec_t  r;
+
+    cp_n = 0;
+    if(f)
+    {
+        f.seek(cp_off, SeekSet);
+        while(cp_off + sizeof(r) <= log_size && f.read((uint8_t *)&r, sizeof(r)) == sizeof(r))
+        {
+            // torn write: resync a byte further
+            if(r.crc != hist_crc(&r))
+            {
+                cp_off += 1;
+                f.seek(cp_off, SeekSet);
+                continue;
+            }
+
+            int pos;
+            if(cp_find(&r, &pos))
+                rec_merge(&cp_buf[pos], &r);
+            else if(cp_n < HIST_MERGE)
+            {
+                memmove(&cp_buf[pos + 1], &cp_buf[pos], (cp_n - pos) * sizeof(hist_rec_t));
+                cp_buf[pos] = r;
+                cp_n += 1;
+            }
+            else
+                break;
+            cp_off += sizeof(r);
+        }
+        f.close();
+    }
+
+    cp_in   = SPIFFS.open(HIST_FILE, "r");      // none before the first compaction
+    cp_out  = SPIFFS.open(HIST_TMP, "w");
+    cp_i    = 0;
+    cp_has  = 0;
+    cp_kept = 0;
+    memset(cp_ages, 0, sizeof(cp_ages));
+    cp_state = cp_out ? CP_MERGE : CP_IDLE;
+}
+
+static void cp_emit(hist_rec_t * r, uint32_t now)
+{
+    uint32_t age = now > r->last ? now - r->last : 0;
+    if((cp_cutoff && age >= cp_cutoff) || cp_kept >= HIST_MAX_RECS)
+        return;
+
+    int b = 0;
+    while(b < HIST_AGE_BINS - 1 && age >= (64u << b))
+        b += 1;
+    cp_ages[b] += 1;
+    cp_kept += 1;
+
+    budget_spend(cp_out.write((uint8_t *)r, sizeof(*r)));
+}
+
+static void cp_done(void)
+{
+    cp_in.close();
+    cp_out.close();
+    SPIFFS.remove(HIST_FILE);
+    SPIFFS.rename(HIST_TMP, HIST_FILE);
+    status.hist_compacts += 1;
+
+    // close to full: the next pass keeps the ~3/4 most recently seen
+    cp_cutoff = 0;
+    if(cp_kept >= HIST_MAX_RECS * 7 / 8)
+    {
+        uint32_t n = 0;
+        int b = 0;
+        while(b < HIST_AGE_BINS - 1 && n + cp_ages[b] <= HIST_MAX_RECS * 3 / 4)
+            n += cp_ages[b++];
+        cp_cutoff = 64u << b;
+    }
+
+    // log folded entirely? start a new one
+    if(cp_off + sizeof(hist_rec_t) > log_size)
+    {
+        SPIFFS.remove(HIST_LOG);
+        log_size = 0;
+        cp_off = 0;
+        cp_state = CP_IDLE;
+    }
+    else
+        cp_state = CP_LOAD;
+}
+
+// merge up to HIST_STEP records of cp_buf & HIST_FILE, both sorted
+static void cp_step(uint32_t now)
+{
+    uint32_t stamp = hist_stamp(now);
+
+    for(int k=0; k<HIST_STEP; k++)
+    {
+        while(!cp_has && cp_in)
+        {
+            if(cp_in.read((uint8_t *)&cp_cur, sizeof(cp_cur)) != sizeof(cp_cur))
+                cp_in.close();
+            else
+                cp_has = cp_cur.crc == hist_crc(&cp_cur);
+        }
+
+        if(!cp_has && cp_i >= cp_n)
+        {
+            cp_done();
+            return;
+        }
+
+        int c = !cp_has ? 1 : (cp_i >= cp_n ? -1 : rec_cmp(&cp_cur, &cp_buf[cp_i]));
+        if(c < 0)
+            cp_emit(&cp_cur, stamp);
+        else if(c > 0)
+            cp_emit(&cp_buf[cp_i++], stamp);
+        else
+        {
+            rec_merge(&cp_cur, &cp_buf[cp_i++]);
+            cp_emit(&cp_cur, stamp);
+        }
+        if(c <= 0)
+            cp_has = 0;
+    }
+}
+
+
+// ========================================================================= //
+// boot
+// ========================================================================= //
+
+static void hist_restore(const hist_rec_t * r)
+{
+    uint8_t mac[6];
+    memcpy(mac, r->mac, 6);
+
+    // restored devices count no frames, they expire unless heard again
+    if(r->flags & HIST_F_AP)
+    {
+        wifi_ap_t * ap = dev_ap_find(mac, 1);
+        if(!ap || ap->beacons)
+            return;
+        ap->channel = r->channel;
+        ap->rssi    = r->rssi_avg;
+        ap->alerts  = r->flags >> HIST_F_ALERT;
+        if(r->flags & HIST_F_HIDDEN)
+            essid_set(&ap->essid, "<hidden>", 8);
+    }
+    else
+    {
+        wifi_client_t * cli = dev_cli_find(mac);
+        if(!cli || cli->pkt_count)
+            return;
+        cli->rssi = r->rssi_avg;
+    }
+    status.hist_reloaded += 1;
+}
+
+// the last snapshot goes to the log (it has the final state of those devices) & back in the table
+// when it is from the boot before this one
+static void hist_reload(int restore)
+{
+    File        f = SPIFFS.open(HIST_LIVE, "r");
+    hist_rec_t  r[HIST_SNAP_STEP];
+    size_t      n;
+
+    if(!f)
+        return;
+
+    File log = SPIFFS.open(HIST_LOG, "a");
+    while((n = f.read((uint8_t *)r, sizeof(r)) / sizeof(hist_rec_t)) > 0)
+    {
+        if(log)
+        {
+            size_t w = log.write((uint8_t *)r, n * sizeof(hist_rec_t));
+            log_size += w;
+            status.hist_flash += w;
+        }
+
+        for(size_t i=0; i<n; i++)
+            if(restore && r[i].crc == hist_crc(&r[i]) && hist_boot(r[i].last) + 1 == boot)
+                hist_restore(&r[i]);
+    }
+    log.close();
+    f.close();
+    SPIFFS.remove(HIST_LIVE);
+}
+
+// mount, read (& count) the boot, finish what a reset cut, bring the snapshot back
+static int hist_mount(int count_boot)
+{
+    uint32_t now = millis();
+
+    active = 0;
+    if(!SPIFFS.begin())
+    {
+        ui_printf("> history: no spiffs\n");
+        return -1;
+    }
+
+    // boot counter, the high bits of every timestamp
+    File f = SPIFFS.open(HIST_BOOT, "r");
+    boot = 0;
+    if(f)
+        f.read((uint8_t *)&boot, sizeof(boot));
+    f.close();
+    if(count_boot)
+    {
+        boot = (boot + 1) & ((1u << (32 - HIST_SEC_BITS)) - 1);
+        f = SPIFFS.open(HIST_BOOT, "w");
+        if(f)
+            f.write((uint8_t *)&boot, sizeof(boot));
+        f.close();
+    }
+
+    // work cut by the reset: the log is only removed once merged, redoing it is harmless
+    if(SPIFFS.exists(HIST_TMP))
+    {
+        if(SPIFFS.exists(HIST_FILE))
+            SPIFFS.remove(HIST_TMP);
+        else
+            SPIFFS.rename(HIST_TMP, HIST_FILE);
+    }
+    SPIFFS.remove(HIST_LIVE_TMP);
+
+    f = SPIFFS.open(HIST_LOG, "r");
+    log_size = f ? f.size() : 0;
+    f.close();
+
+    q_head = q_tail = 0;
+    budget      = HIST_BURST;
+    budget_t    = now;
+    last_write  = now - HIST_WRITE_MS;
+    snap_last   = now;
+    snap_phase  = 0;
+    snap_cur    = NULL;
+    cp_state    = CP_IDLE;
+    cp_off      = 0;
+    cp_cutoff   = 0;
+
+    hist_reload(count_boot);
+    active = 1;
+    return 0;
+}
+
+void hist_init(void)
+{
+    base_sec = 0;
+    if(hist_mount(1) == 0)
+        ui_printf("> history: boot %d, log %d bytes, %d devices back\n", boot, log_size, status.hist_reloaded);
+}
+
+void hist_open(uint32_t sec)
+{
+    base_sec = sec;
+    if(hist_mount(0) == 0)
+        ui_printf("> history: boot %d from %u s, log %d bytes\n", boot, sec, log_size);
+}
+
+
+// ========================================================================= //
+// main loop side
+// ========================================================================= //
+
+void hist_ap_gone(wifi_ap_t * ap)
+{
+    hist_rec_t r;
+
+    snap_unlink(ap, dev_ap_next(ap));
+    if(!active || !ap->beacons)
+        return;
+
+    // beacon spam would flush the real devices out of the history
+    if(ap->beacons == 1 && !ap->clients)
+        return;
+
+    rec_ap(&r, ap, millis());
+    hist_queue(&r);
+}
+
+void hist_cli_gone(wifi_client_t * cli)
+{
+    hist_rec_t r;
+
+    snap_unlink(cli, dev_cli_next(cli));
+    if(!active || !cli->pkt_count)
+        return;
+
+    rec_cli(&r, cli, millis());
+    hist_queue(&r);
+}
+
+void hist_pump(void)
+{
+    if(!active)
+        return;
+
+    uint32_t now = millis();
+    budget_refill(now);
+
+    // a single flash job per step: log, snapshot, then compaction
+    if(hist_flush(now, 0))
+        return;
+
+    if(budget <= 0)
+        return;
+
+    if(snap_phase)
+        snap_step(now);
+    else if(now - snap_last >= HIST_SNAP_MS)
+        snap_start(now);
+    else if(cp_state == CP_LOAD || (cp_state == CP_IDLE && log_size >= HIST_COMPACT_AT))
+        cp_load();
+    else if(cp_state == CP_MERGE)
+        cp_step(now);
+}
+
+void hist_sync(void)
+{
+    if(!active)
+        return;
+
+    uint32_t now = millis();
+    hist_flush(now, 1);
+
+    if(!snap_phase)
+        snap_start(now);
+    while(snap_phase && !snap_step(now))
+        ;
+}
+
+void hist_add(hist_rec_t * r)
+{
+    if(!active)
+        return;
+
+    r->crc = hist_crc(r);
+    if(q_head - q_tail >= HIST_QUEUE)
+        hist_flush(millis(), 1);
+    hist_queue(r);
+}
+
+void hist_close(void)
+{
+    if(!active)
+        return;
+
+    uint32_t now = millis();
+    hist_flush(now, 1);
+
+    // nobody pumps until the next hist_init(), fold the log now if it is due
+    if(cp_state == CP_IDLE && log_size >= HIST_COMPACT_AT)
+        cp_state = CP_LOAD;
+    while(cp_state != CP_IDLE)
+    {
+        if(cp_state == CP_LOAD)
+            cp_load();
+        else
+            cp_step(now);
+    }
+
+    // a snapshot cut here is dropped by hist_init()
+    if(snap_phase)
+    {
+        snap_f.close();
+        snap_phase = 0;
+    }
+    active = 0;
+}
+
+void hist_dump(void)
+{
+    ui_printf("history %s  boot %d  log %u bytes  queued %u  written %u  drops %u  reloaded %u\n",
+        active ? "on" : "off", boot, log_size, status.hist_queued, status.hist_written,
+        status.hist_drops, status.hist_reloaded);
+    ui_printf("flash %u bytes  budget %d  compactions %u  state %d  cutoff %u\n",
+        status.hist_flash, budget, status.hist_compacts, cp_state, cp_cutoff);
+}
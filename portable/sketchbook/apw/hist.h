@@ -0,0 +1,99 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : hist.h                                                     //
+// Description : device history on SPIFFS, append-only log + compaction     //
+// ======================================================================== //
+
+#ifndef _HIST_H
+#define _HIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "status.h"
+
+// expired devices are queued in ram & appended to HIST_LOG in batches from loop()
+// compaction folds the log into HIST_FILE: one record per device, sorted by mac
+// HIST_LIVE is a snapshot of the device table, it brings it back after a reboot
+#define HIST_LOG            "/apw/log"
+#define HIST_FILE           "/apw/hist"
+#define HIST_TMP            "/apw/hist.tmp"
+#define HIST_LIVE           "/apw/live"
+#define HIST_LIVE_TMP       "/apw/live.tmp"
+#define HIST_BOOT           "/apw/boot"
+
+#define HIST_PUMP_MS        500     // ms between two steps of flash work
+#define HIST_QUEUE          32      // records waiting for the log, power of 2
+#define HIST_BATCH          16      // queued records that trigger a write
+#define HIST_FLUSH_MS       60000   // longest a record waits for its batch
+#define HIST_WRITE_MS       10000   // shortest time between two log writes
+
+// flash budget (token bucket) shared by the log, the snapshots & compaction
+#define HIST_RATE           8192    // bytes per minute
+#define HIST_BURST          16384
+
+#define HIST_SNAP_MS        300000  // device table snapshot period
+#define HIST_SNAP_STEP      16      // devices written per step
+#define HIST_LIVE_MAX       256     // devices in a snapshot
+
+#define HIST_COMPACT_AT     4096    // log size that starts a compaction
+#define HIST_MERGE          64      // distinct devices folded per compaction round
+#define HIST_STEP           32      // records copied per step
+#define HIST_MAX_RECS       512     // devices kept in HIST_FILE, least recently seen go first
+
+// timestamps: boot number << HIST_SEC_BITS | seconds since that boot
+#define HIST_SEC_BITS       20
+#define HIST_SEC_MAX        ((1u << HIST_SEC_BITS) - 1)
+#define hist_boot(stamp)    ((stamp) >> HIST_SEC_BITS)
+
+#define HIST_F_AP           0x01
+#define HIST_F_FAKE         0x02    // AP that sent a single beacon
+#define HIST_F_HIDDEN       0x04    // AP without essid
+#define HIST_F_BOUND        0x08    // client seen talking to an AP
+#define HIST_F_ALERT        4       // (1 << detect_type_t) raised for the bssid, from this bit on
+
+// one device, merged per mac (+ HIST_F_AP) by compaction
+typedef struct hist_rec_t
+{
+    uint8_t         mac[6];
+    uint8_t         flags;          // HIST_F_*, or-ed when merged
+    uint8_t         channel;
+    uint32_t        first;          // first seen (see HIST_SEC_BITS)
+    uint32_t        last;           // last seen
+    uint16_t        essid;          // essid hash, 0 = none
+    uint16_t        vendor;         // oui vendor id + 1, 0 = unknown
+    int8_t          rssi_min;
+    int8_t          rssi_avg;       // over the last minutes of the newest visit
+    int8_t          rssi_max;
+    uint8_t         crc;            // crc8 of the bytes before it, torn writes fail it
+} hist_rec_t;
+
+// mount, count the boot, bring back the devices of the last snapshot
+void    hist_init(void);
+
+// same without counting a boot: stamps carry on in the current one from sec on. for
+// duty.cpp, a boot at every flush would wrap the counter within weeks
+void    hist_open(uint32_t sec);
+
+// device leaving the table (devs_*_del), queued for the log
+void    hist_ap_gone(wifi_ap_t * ap);
+void    hist_cli_gone(wifi_client_t * cli);
+
+// flash work, one step at a time (scheduled every HIST_PUMP_MS)
+void    hist_pump(void);
+
+// write the queue & a full snapshot now, ignoring the budget (before sleeping)
+void    hist_sync(void);
+
+// records built elsewhere (duty.cpp): the stamp of ms after this boot, queue one (crc is set)
+uint32_t hist_stamp(uint32_t ms);
+void    hist_add(hist_rec_t * r);
+
+// write the queue, run a due compaction to the end & stop, until the next hist_init() / hist_open()
+void    hist_close(void);
+
+void    hist_dump(void);
+
+#endif
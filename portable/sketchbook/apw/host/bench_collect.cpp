@@ -0,0 +1,147 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_collect.cpp                                     //
+// Description : collector throughput & lag against the serial line rate    //
+// ======================================================================== //
+
+#include "collector.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#define FLAT_BYTES      (4 << 20)   // per sensor, recordings repeated up to that
+#define PACED_SECONDS   3
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-n sensors] [-t s] report.bin [...]\n"
+        "  -n n  most sensors (default & max: %d)\n"
+        "  -t s  line rate run length (default: %d)\n"
+        "recordings from apw_replay -p -o, sensor i replays file i %% count\n", prog, COLLECT_SENSORS, PACED_SECONDS);
+    exit(1);
+}
+
+static int load(const char * path, std::vector<uint8_t> & out)
+{
+    FILE * f = fopen(path, "rb");
+    if(!f)
+        return -1;
+
+    uint8_t buf[65536];
+    size_t  n;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        out.insert(out.end(), buf, buf + n);
+    fclose(f);
+    return out.empty() ? -1 : 0;
+}
+
+// every sensor streams its recording, bps = 0 flat out; returns wall time in s
+static double run(std::vector<std::vector<uint8_t> > & streams, int sensors, uint32_t bps, size_t len, collector_t * c)
+{
+    collect_init(c);
+    for(int i=0; i<sensors; i++)
+    {
+        std::vector<uint8_t> & s = streams[i % streams.size()];
+        collect_add_mem(c, "mem", s.data(), std::min(len, s.size()), bps);
+    }
+
+    uint64_t start = host_now_ns();
+    collect_start(c);
+
+    int n;
+    while((n = collect_poll(c)) >= 0)
+        if(!n)
+            usleep(100);
+
+    collect_stop(c);
+    return (host_now_ns() - start) / 1e9;
+}
+
+static void sensor_stats(collector_t * c, uint64_t * bytes, uint64_t * stalls, uint32_t * depth)
+{
+    *bytes = *stalls = *depth = 0;
+    for(auto s : c->sensors)
+    {
+        *bytes  += s->bytes;
+        *stalls += s->stalls;
+        *depth   = std::max(*depth, s->max_depth);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<std::vector<uint8_t> > files;
+    std::vector<std::vector<uint8_t> > streams;
+    int max_sensors = COLLECT_SENSORS;
+    int seconds = PACED_SECONDS;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:t:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': max_sensors = atoi(optarg);   break;
+            case 't': seconds = atoi(optarg);       break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind >= argc || max_sensors < 1 || max_sensors > COLLECT_SENSORS || seconds < 1)
+        usage(argv[0]);
+
+    for(int i=optind; i<argc; i++)
+    {
+        files.push_back(std::vector<uint8_t>());
+        if(load(argv[i], files.back()) < 0)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    // long enough to measure: each recording back to back (the collector sees reboots)
+    for(auto & f : files)
+    {
+        streams.push_back(std::vector<uint8_t>());
+        while(streams.back().size() < FLAT_BYTES)
+            streams.back().insert(streams.back().end(), f.begin(), f.end());
+    }
+
+    printf("flat out, %d mb per sensor\n", FLAT_BYTES >> 20);
+    printf("%-8s %10s %12s %12s %10s %8s %8s %10s %10s\n",
+        "sensors", "mb/s", "events/s", "x line rate", "devices", "stalls", "depth", "lag avg", "lag max");
+    for(int n=1; n<=max_sensors; n*=2)
+    {
+        collector_t c;
+        uint64_t bytes, stalls;
+        uint32_t depth;
+
+        double t = run(streams, n, 0, FLAT_BYTES, &c);
+        sensor_stats(&c, &bytes, &stalls, &depth);
+        printf("%-8d %10.1f %12.0f %12.0f %10zu %8llu %8u %7.1f us %7.1f us\n", n, bytes / t / 1e6, c.events / t,
+            bytes / t / ((double)COLLECT_LINE_BPS * n), c.devs.size(), (unsigned long long)stalls, depth,
+            c.events ? c.lag_sum_ns / 1e3 / c.events : 0.0, c.lag_max_ns / 1e3);
+        collect_free(&c);
+    }
+
+    // every sensor at 115200 8n1 at once: the merger has to stay on top of the queues
+    collector_t c;
+    uint64_t bytes, stalls;
+    uint32_t depth;
+
+    double t = run(streams, max_sensors, COLLECT_LINE_BPS, (size_t)COLLECT_LINE_BPS * seconds, &c);
+    sensor_stats(&c, &bytes, &stalls, &depth);
+    printf("\nline rate, %d sensors for %d s: %.0f bytes/s (%.2f x line rate per sensor), %llu events, "
+        "stalls %llu, depth max %u, lag avg %.1f us max %.1f us\n",
+        max_sensors, seconds, bytes / t, bytes / t / ((double)COLLECT_LINE_BPS * max_sensors),
+        (unsigned long long)c.events, (unsigned long long)stalls, depth,
+        c.events ? c.lag_sum_ns / 1e3 / c.events : 0.0, c.lag_max_ns / 1e3);
+    collect_free(&c);
+
+    return 0;
+}
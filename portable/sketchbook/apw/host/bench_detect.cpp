@@ -0,0 +1,105 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_detect.cpp                                      //
+// Description : attack detection cost per frame                            //
+// ======================================================================== //
+
+#include "host.h"
+#include "status.h"
+#include "detect.h"
+#include "chan.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define EVENTS      1000000
+#define STEP_US     250         // virtual time between two events
+
+typedef struct mac_t
+{
+    uint8_t b[6];
+} mac_t;
+
+static mac_t rand_dev_mac(void)
+{
+    mac_t m;
+    do
+    {
+        for(int i=0; i<6; i++)
+            m.b[i] = rand() & 0xff;
+        m.b[0] &= 0xfe;     // unicast
+    } while(is_bad_mac(m.b));
+    return m;
+}
+
+// deauths spread over n bssids (0 = a new random one every frame)
+static double bench_deauth(int n)
+{
+    std::vector<mac_t> macs;
+    for(int i=0; i<(n ? n : 4096); i++)
+        macs.push_back(rand_dev_mac());
+
+    detect_init();
+    status.detect_evicts = 0;
+    status.detect_alerts = 0;
+    status.detect_full   = 0;
+
+    uint64_t t = 1000000;
+    uint64_t start = host_now_ns();
+    for(int i=0; i<EVENTS; i++)
+    {
+        if(!(i & 63))
+        {
+            host_set_time_us(t += 64 * STEP_US);
+            detect_tick();
+        }
+        detect_deauth(macs[i % macs.size()].b, 1 + i % 3 * 5);
+    }
+    return (double)(host_now_ns() - start) / EVENTS;
+}
+
+static double bench_ap_new(void)
+{
+    detect_init();
+    for(int c=1; c<=CHAN_MAX; c++)
+        chan_stats[c].visits = DETECT_WARMUP + 1;
+
+    uint64_t t = 1000000;
+    uint64_t start = host_now_ns();
+    for(int i=0; i<EVENTS; i++)
+    {
+        if(!(i & 63))
+        {
+            host_set_time_us(t += 64 * STEP_US);
+            detect_tick();
+        }
+        detect_ap_new(1 + i % 13);
+    }
+    return (double)(host_now_ns() - start) / EVENTS;
+}
+
+int main(int argc, char ** argv)
+{
+    static const int spreads[] = { 1, 8, 24, 64, 0 };
+
+    srand(1);
+    host_serial_quiet(1);
+
+    printf("%-8s  %10s  %8s  %8s  %8s\n", "bssids", "deauth", "alerts", "evicts", "full");
+    for(size_t i=0; i<sizeof(spreads)/sizeof(spreads[0]); i++)
+    {
+        double ns = bench_deauth(spreads[i]);
+        if(spreads[i])
+            printf("%-8d  %7.1f ns  %8u  %8u  %8u\n", spreads[i], ns, status.detect_alerts, status.detect_evicts, status.detect_full);
+        else
+            printf("%-8s  %7.1f ns  %8u  %8u  %8u\n", "random", ns, status.detect_alerts, status.detect_evicts, status.detect_full);
+    }
+
+    printf("\nnew ap    %7.1f ns\n", bench_ap_new());
+    return 0;
+}
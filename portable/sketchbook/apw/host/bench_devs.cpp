@@ -0,0 +1,218 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_devs.cpp                                        //
+// Description : device table layout, lookup cost vs. table fill           //
+// ======================================================================== //
+
+#include "host.h"
+#include "status.h"
+#include "devs.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LOOKUPS     200000
+
+// the pointer based records before dev_idx_t, sizes on the esp (32-bit)
+#define OLD_AP_SIZE         108
+#define OLD_CLI_SIZE        104
+#define OLD_MEM_APS         (14 * 1024)
+#define OLD_MEM_CLIENTS     (13 * 1024)
+
+typedef struct mac_t
+{
+    uint8_t b[6];
+} mac_t;
+
+static mac_t rand_dev_mac(void)
+{
+    mac_t m;
+    do
+    {
+        for(int i=0; i<6; i++)
+            m.b[i] = rand() & 0xff;
+        m.b[0] &= 0xfe;     // unicast
+    } while(is_bad_mac(m.b));
+    return m;
+}
+
+// what dev_ap_find() used to do: walk the circular list
+static wifi_ap_t * linear_find(uint8_t * mac)
+{
+    if(!status.aps)
+        return NULL;
+
+    wifi_ap_t * ap = status.aps;
+    do
+    {
+        if(!memcmp(ap->mac, mac, 6))
+            return ap;
+        ap = dev_ap_next(ap);
+    } while(ap != status.aps);
+    return NULL;
+}
+
+static void clear_aps(void)
+{
+    while(status.aps)
+        devs_ap_del(status.aps);
+}
+
+// add & remove devices at random, make sure the index agrees with the list
+static int check_churn(void)
+{
+    std::vector<mac_t> live;
+
+    for(int i=0; i<100000; i++)
+    {
+        if(live.size() < MAX_DEVS_APS && (live.empty() || rand() % 3))
+        {
+            mac_t m = rand_dev_mac();
+            if(dev_ap_find(m.b, 0))
+                continue;
+            if(!dev_ap_find(m.b, 1))
+                return -1;
+            live.push_back(m);
+        }
+        else
+        {
+            size_t k = rand() % live.size();
+            wifi_ap_t * ap = dev_ap_find(live[k].b, 0);
+            if(!ap)
+                return -1;
+            devs_ap_del(ap);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+
+    for(size_t k=0; k<live.size(); k++)
+        if(dev_ap_find(live[k].b, 0) != linear_find(live[k].b) || !linear_find(live[k].b))
+            return -1;
+    if(live.size() != status.aps_count)
+        return -1;
+
+    clear_aps();
+    return 0;
+}
+
+// no pointers left in the records, so these are the esp sizes too
+static void print_layout(void)
+{
+    size_t hash = 2 * DEVS_HASH_SIZE * sizeof(dev_idx_t);
+    size_t rssi = DEVS_RSSI_SLOTS * (sizeof(rssi_hist_t) + sizeof(uint16_t));
+    size_t used = MAX_DEVS_APS * sizeof(wifi_ap_t) + MAX_DEVS_CLIENTS * sizeof(wifi_client_t);
+
+    printf("%-8s  %6s  %6s  %8s  %8s\n", "", "size", "max", "old size", "old max");
+    printf("%-8s  %6zu  %6zu  %8d  %8d\n", "ap", sizeof(wifi_ap_t), MAX_DEVS_APS, OLD_AP_SIZE, OLD_MEM_APS / OLD_AP_SIZE);
+    printf("%-8s  %6zu  %6zu  %8d  %8d\n", "client", sizeof(wifi_client_t), MAX_DEVS_CLIENTS, OLD_CLI_SIZE, OLD_MEM_CLIENTS / OLD_CLI_SIZE);
+    printf("ram       slots %zu  hash %zu  rssi %zu (%d x %zu)  total %zu bytes\n\n",
+        used, hash, rssi, DEVS_RSSI_SLOTS, sizeof(rssi_hist_t), used + hash + rssi);
+}
+
+// more aps than rssi slots: everyone heard twice has a history until the pool
+// runs out, then the quietest ones give theirs up, never the one on screen
+static int check_rssi_pool(void)
+{
+    std::vector<wifi_ap_t *> aps;
+    uint32_t evicts = status.rssi_evicts;
+    uint64_t t = host_get_time_us();
+
+    for(size_t i=0; i<MAX_DEVS_APS; i++)
+    {
+        mac_t m = rand_dev_mac();
+        wifi_ap_t * ap = dev_ap_find(m.b, 1);
+        if(!ap)
+            continue;
+        aps.push_back(ap);
+        if(i == 0)
+            status.cur_ap = ap;
+        for(int b=0; b<2; b++)
+        {
+            host_set_time_us(t += 1000000);
+            dev_ap_update(ap, -40 - (i % 40), (char *)"x", 1, 0, 0);
+        }
+    }
+
+    int8_t      fine[RSSI_FINE];
+    rssi_span_t coarse[RSSI_COARSE];
+    rssi_get(dev_ap_rssi(aps.back()), t / 1000, fine, coarse);
+
+    size_t held = 0;
+    for(size_t i=0; i<aps.size(); i++)
+        held += aps[i]->rh != 0;
+
+    int ok = aps.size() > DEVS_RSSI_SLOTS
+          && held == DEVS_RSSI_SLOTS
+          && status.rssi_evicts - evicts == aps.size() - DEVS_RSSI_SLOTS
+          && status.cur_ap->rh
+          && aps.back()->rh
+          && fine[RSSI_FINE - 1];
+
+    status.cur_ap = NULL;
+    clear_aps();
+    return ok ? 0 : -1;
+}
+
+int main(int argc, char ** argv)
+{
+    static const int fills[] = { 12, 25, 50, 75, 100 };
+
+    srand(1);
+    host_serial_quiet(1);
+
+    if(check_churn() < 0)
+    {
+        fprintf(stderr, "index / list mismatch after churn\n");
+        return 1;
+    }
+    if(check_rssi_pool() < 0)
+    {
+        fprintf(stderr, "rssi history pool handed out wrong\n");
+        return 1;
+    }
+
+    print_layout();
+
+    printf("%-6s  %6s  %12s  %12s  %12s  %12s\n", "fill", "aps", "hash hit", "hash miss", "list hit", "list miss");
+
+    for(size_t f=0; f<sizeof(fills)/sizeof(fills[0]); f++)
+    {
+        std::vector<mac_t> in, out;
+        int n = MAX_DEVS_APS * fills[f] / 100;
+
+        while((int)in.size() < n)
+        {
+            mac_t m = rand_dev_mac();
+            if(!dev_ap_find(m.b, 0) && dev_ap_find(m.b, 1))
+                in.push_back(m);
+        }
+        for(int i=0; i<1024; i++)
+            out.push_back(rand_dev_mac());
+
+        double   res[4];
+        volatile uintptr_t sink = 0;
+        for(int t=0; t<4; t++)
+        {
+            std::vector<mac_t> & set = (t & 1) ? out : in;
+            uint64_t start = host_now_ns();
+            for(int i=0; i<LOOKUPS; i++)
+            {
+                uint8_t * mac = set[i % set.size()].b;
+                sink += (uintptr_t)(t < 2 ? dev_ap_find(mac, 0) : linear_find(mac));
+            }
+            res[t] = (double)(host_now_ns() - start) / LOOKUPS;
+        }
+
+        printf("%5d%%  %6d  %9.1f ns  %9.1f ns  %9.1f ns  %9.1f ns\n",
+            fills[f], n, res[0], res[1], res[2], res[3]);
+        clear_aps();
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_ie.cpp                                          //
+// Description : beacon element decoding throughput, old walk vs ie_parse   //
+// ======================================================================== //
+
+#include "host.h"
+#include "pcap.h"
+#include "wifi.h"
+#include "ring.h"
+#include "ie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define ROUNDS      200
+
+// what parse_beacon() used to do
+static int old_parse_beacon(frame_t * frame, size_t len, char essid[33], uint8_t * channel, uint8_t * enc, uint8_t * ht)
+{
+    int ret = -1;
+
+    if((frame->type & 0xf0) != 0x80)
+        if((frame->type & 0xf0) != 0x50)
+            return -1;
+
+    if(*(uint16_t*)&frame->data[10] & 0x10)
+        *enc = AP_ENC_WEP;
+
+    uint8_t * p = &frame->data[0] + 12;
+    while(p + 3 < ((uint8_t*)frame + len))
+    {
+        uint8_t t = p[0];
+        uint8_t l = p[1];
+
+        if(p + l >= ((uint8_t*)frame + len))
+            break;
+        ret = 0;
+
+        if(t == 0)
+        {
+            memcpy(essid, p + 2, l > 32 ? 32 : l);
+            essid[l > 32 ? 32 : l] = 0;
+        }
+        else if(t == 3)
+            *channel = p[2];
+        else if(t == 0x2d)
+            *ht = 1;
+        else if(t == 0xbf)
+            *ht = 2;
+        else if(t == 0xdd)
+        {
+            if(!memcmp(&p[2], "\x00\x50\xf2", 3))
+                *enc = AP_ENC_WPA1;
+        }
+        else if(t == 0x30)
+            *enc = AP_ENC_WPA2;
+
+        p += l + 2;
+    }
+    return ret;
+}
+
+// a typical wpa2 / ht beacon, with its vendor elements
+static void synth_beacon(std::vector<uint8_t> & f, int i)
+{
+    static const uint8_t ies[] =
+    {
+        0x01, 0x08, 0x82, 0x84, 0x8b, 0x96, 0x24, 0x30, 0x48, 0x6c,
+        0x03, 0x01, 0x06,
+        0x05, 0x04, 0x00, 0x01, 0x00, 0x00,
+        0x2a, 0x01, 0x04,
+        0x30, 0x14, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04, 0x01, 0x00, 0x00, 0x0f, 0xac, 0x04,
+                    0x01, 0x00, 0x00, 0x0f, 0xac, 0x02, 0x0c, 0x00,
+        0x2d, 0x1a, 0xad, 0x01, 0x1b, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xdd, 0x18, 0x00, 0x50, 0xf2, 0x02, 0x01, 0x01, 0x00, 0x00, 0x03, 0xa4, 0x00, 0x00, 0x27,
+                    0xa4, 0x00, 0x00, 0x42, 0x43, 0x5e, 0x00, 0x62, 0x32, 0x2f, 0x00,
+    };
+    char essid[16];
+    int  l = snprintf(essid, sizeof(essid), "network-%d", i);
+
+    f.assign(36, 0);
+    f[0] = 0x80;
+    f[34] = 0x11;
+    f.push_back(0);
+    f.push_back(l);
+    f.insert(f.end(), essid, essid + l);
+    f.insert(f.end(), ies, ies + sizeof(ies));
+}
+
+typedef int (*parse_fn_t)(frame_t * frame, size_t len, char essid[33], uint8_t * channel, uint8_t * enc, uint8_t * ht);
+
+static double bench(const std::vector< std::vector<uint8_t> > & frames, parse_fn_t fn, int * parsed)
+{
+    char    essid[33];
+    uint8_t chan, enc, ht;
+    int     n = 0;
+
+    uint64_t start = host_now_ns();
+    for(int r=0; r<ROUNDS; r++)
+        for(size_t i=0; i<frames.size(); i++)
+        {
+            chan = enc = ht = 0;
+            n += fn((frame_t *)frames[i].data(), frames[i].size(), essid, &chan, &enc, &ht) == 0;
+        }
+    *parsed = n / ROUNDS;
+    return (double)(host_now_ns() - start) / ROUNDS / frames.size();
+}
+
+static double bench_want(const std::vector< std::vector<uint8_t> > & frames, uint8_t want)
+{
+    ie_info_t info;
+    uint32_t  sum = 0;
+
+    uint64_t start = host_now_ns();
+    for(int r=0; r<ROUNDS; r++)
+        for(size_t i=0; i<frames.size(); i++)
+            sum += ie_parse(frames[i].data() + sizeof(frame_t) + BEACON_FIXED_LEN,
+                frames[i].size() - sizeof(frame_t) - BEACON_FIXED_LEN, want, &info);
+    if(sum == 0xffffffff)
+        printf("\n");
+    return (double)(host_now_ns() - start) / ROUNDS / frames.size();
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<pcap_pkt_t>                 pkts;
+    std::vector< std::vector<uint8_t> >     frames;
+
+    for(int i=1; i<argc; i++)
+        if(pcap_load(argv[i], pkts) < 0)
+            return 1;
+
+    // beacons & probe responses, cut like the ring does (header + RING_BODY_LEN)
+    for(size_t i=0; i<pkts.size(); i++)
+    {
+        const std::vector<uint8_t> & d = pkts[i].data;
+        if(d.size() < sizeof(frame_t) + BEACON_FIXED_LEN || (d[0] != 0x80 && d[0] != 0x50))
+            continue;
+        size_t l = d.size() < sizeof(frame_t) + RING_BODY_LEN ? d.size() : sizeof(frame_t) + RING_BODY_LEN;
+        frames.push_back(std::vector<uint8_t>(d.begin(), d.begin() + l));
+    }
+    if(frames.empty())
+    {
+        std::vector<uint8_t> f;
+        for(int i=0; i<256; i++)
+        {
+            synth_beacon(f, i);
+            frames.push_back(f);
+        }
+        printf("no capture given, %zu synthetic wpa2 beacons\n", frames.size());
+    }
+    else
+        printf("%zu beacons / probe responses\n", frames.size());
+
+    // enc as seen by each decoder
+    int enc_old[6] = {}, enc_new[6] = {};
+    for(size_t i=0; i<frames.size(); i++)
+    {
+        char    essid[33];
+        uint8_t chan = 0, e1 = 0, e2 = 0, ht = 0;
+        if(old_parse_beacon((frame_t *)frames[i].data(), frames[i].size(), essid, &chan, &e1, &ht) == 0 && e1 < 6)
+            enc_old[e1] += 1;
+        if(parse_beacon((frame_t *)frames[i].data(), frames[i].size(), essid, &chan, &e2, &ht) == 0 && e2 < 6)
+            enc_new[e2] += 1;
+    }
+
+    int p_old, p_new;
+    double t_old = bench(frames, old_parse_beacon, &p_old);
+    double t_new = bench(frames, parse_beacon, &p_new);
+
+    printf("%-18s  %8s  %7s  %s\n", "decoder", "ns/frame", "parsed", "open/wep/wpa1/wpa1-eap/wpa2/wpa2-eap");
+    printf("%-18s  %8.1f  %7d  %d/%d/%d/%d/%d/%d\n", "old walk", t_old, p_old,
+        enc_old[0], enc_old[1], enc_old[2], enc_old[3], enc_old[4], enc_old[5]);
+    printf("%-18s  %8.1f  %7d  %d/%d/%d/%d/%d/%d\n", "parse_beacon", t_new, p_new,
+        enc_new[0], enc_new[1], enc_new[2], enc_new[3], enc_new[4], enc_new[5]);
+    printf("%-18s  %8.1f\n", "ie_parse all", bench_want(frames, IE_F_ALL));
+    printf("%-18s  %8.1f\n", "ie_parse ssid+ds", bench_want(frames, IE_F_SSID | IE_F_DS));
+    printf("%-18s  %8.1f\n", "ie_parse ssid", bench_want(frames, IE_F_SSID));
+    return 0;
+}
@@ -0,0 +1,150 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_oui.cpp                                         //
+// Description : oui lookup, bucketed layout vs. the old flat tables        //
+// ======================================================================== //
+
+#include "host.h"
+#include "utils.h"
+#include "Arduino.h"
+#include "oui.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define LOOKUPS     1000000
+
+// the previous layout: 5 bytes per oui (3 oui + 2 vendor index) & 8 bytes per vendor
+static std::vector<uint8_t> old_macs;
+static std::vector<uint8_t> old_vendors;
+
+static void build_old_layout(void)
+{
+    std::vector<int> vendor_idx(OUI_VENDORS, -1);
+    uint8_t          mac[3];
+    char             name[9];
+
+    for(int b=0; b<256; b++)
+    {
+        for(int n = oui_index[b]; n < oui_index[b + 1]; n++)
+        {
+            uint32_t e  = oui_entries[n];
+            uint16_t id = e & 0xffff;
+
+            mac[0] = b;
+            mac[1] = e >> 24;
+            mac[2] = e >> 16;
+
+            if(vendor_idx[id] < 0)
+            {
+                memset(name, 0, sizeof(name));
+                search_vendor(mac, name);
+                vendor_idx[id] = old_vendors.size() / 8;
+                old_vendors.insert(old_vendors.end(), name, name + 8);
+            }
+
+            old_macs.insert(old_macs.end(), mac, mac + 3);
+            old_macs.push_back(vendor_idx[id] & 0xff);
+            old_macs.push_back(vendor_idx[id] >> 8);
+        }
+    }
+}
+
+// what search_vendor() used to do
+static int old_search_vendor(uint8_t * search, char vendor[9])
+{
+    const uint8_t * data_macs = old_macs.data();
+    uint8_t cur[3];
+    int     beg = 0;
+    int     end = old_macs.size() / 5 - 1;
+    int     mid = (beg + end) / 2;
+    int     idx = -1;
+
+    while(beg <= end)
+    {
+        cur[0] = pgm_read_byte_near(data_macs + mid * 5);
+        cur[1] = pgm_read_byte_near(data_macs + mid * 5 + 1);
+        cur[2] = pgm_read_byte_near(data_macs + mid * 5 + 2);
+
+        int res = memcmp(search, cur, 3);
+        if(res == 0)
+        {
+            idx = mid;
+            break;
+        }
+        else if(res < 0)
+            end = mid - 1;
+        else
+            beg = mid + 1;
+        mid = (beg + end) / 2;
+    }
+
+    if(idx < 0)
+        return -1;
+
+    int pos = pgm_read_byte_near(data_macs + idx * 5 + 3) | pgm_read_byte_near(data_macs + idx * 5 + 4) << 8;
+    for(int i=0; i<8; i++)
+        vendor[i] = (char)pgm_read_byte_near(old_vendors.data() + pos * 8 + i);
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<uint8_t> known, random_macs;
+    char a[9], b[9];
+
+    srand(1);
+    build_old_layout();
+
+    // both layouts must agree on every oui
+    for(size_t i=0; i<old_macs.size(); i+=5)
+    {
+        memset(a, 0, sizeof(a));
+        memset(b, 0, sizeof(b));
+        if(search_vendor(&old_macs[i], a) < 0 || old_search_vendor(&old_macs[i], b) < 0 || strcmp(a, b))
+        {
+            fprintf(stderr, "mismatch for %02x:%02x:%02x '%s' / '%s'\n", old_macs[i], old_macs[i+1], old_macs[i+2], a, b);
+            return 1;
+        }
+    }
+
+    for(int i=0; i<4096; i++)
+    {
+        size_t n = rand() % (old_macs.size() / 5);
+        known.insert(known.end(), &old_macs[n * 5], &old_macs[n * 5] + 3);
+        for(int j=0; j<3; j++)
+            random_macs.push_back(rand() & 0xff);
+    }
+
+    size_t old_size = old_macs.size() + old_vendors.size();
+    size_t new_size = sizeof(oui_index) + sizeof(oui_entries) + sizeof(oui_vendors) + sizeof(oui_group_id) + sizeof(oui_group_off);
+
+    printf("ouis        %d  vendors %d\n", OUI_COUNT, OUI_VENDORS);
+    printf("flash size  old %zu bytes  new %zu bytes (%.1f%%)\n", old_size, new_size, 100.0 * new_size / old_size);
+
+    std::vector<uint8_t> * sets[] = { &known, &random_macs };
+    const char * names[] = { "known ouis", "random macs" };
+    for(int s=0; s<2; s++)
+    {
+        double   res[2];
+        volatile int sink = 0;
+
+        for(int t=0; t<2; t++)
+        {
+            uint64_t start = host_now_ns();
+            for(int i=0; i<LOOKUPS; i++)
+            {
+                uint8_t * mac = &(*sets[s])[(i % 4096) * 3];
+                sink += t ? old_search_vendor(mac, a) : search_vendor(mac, a);
+            }
+            res[t] = (double)(host_now_ns() - start) / LOOKUPS;
+        }
+        printf("%-12s new %6.1f ns  old %6.1f ns\n", names[s], res[0], res[1]);
+    }
+
+    return 0;
+}
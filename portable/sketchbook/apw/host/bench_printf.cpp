@@ -0,0 +1,381 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_printf.cpp                                      //
+// Description : core printf_cb against the 1460b stack buffer printf       //
+// ======================================================================== //
+
+#include "printf_cb.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <string>
+
+#define ITERS           200000
+#define RANDOM_CASES    200000
+#define STACK_SIZE      (32 << 10)  // the measured calls run on this, painted
+#define OLD_BUF         1460        // Print::printf's temp buffer
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+// sinks: Print::write() stand-in, copies into a ring like the uart buffer would
+
+static char     sink_ring[4096];
+static size_t   sink_pos;
+static uint64_t sink_bytes;
+static uint64_t sink_calls;
+
+static void sink_write(const char * buf, size_t len)
+{
+    sink_bytes += len;
+    sink_calls += 1;
+    while(len)
+    {
+        size_t part = std::min(len, sizeof(sink_ring) - sink_pos);
+        memcpy(sink_ring + sink_pos, buf, part);
+        sink_pos = (sink_pos + part) % sizeof(sink_ring);
+        buf += part;
+        len -= part;
+    }
+}
+
+static void sink_cb(void * arg, const char * buf, size_t len)
+{
+    sink_write(buf, len);
+}
+
+static void string_cb(void * arg, const char * buf, size_t len)
+{
+    ((std::string *)arg)->append(buf, len);
+}
+
+// what Print::printf did: format on the stack, then print(temp)
+static size_t __attribute__((noinline)) old_printf(const char * fmt, ...)
+{
+    va_list ap;
+    char    temp[OLD_BUF];
+
+    va_start(ap, fmt);
+    vsnprintf(temp, sizeof(temp), fmt, ap);
+    va_end(ap);
+
+    size_t len = strlen(temp);
+    sink_write(temp, len);
+    return len;
+}
+
+static size_t __attribute__((noinline)) new_printf(const char * fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    size_t len = vprintf_cb(sink_cb, NULL, fmt, ap);
+    va_end(ap);
+    return len;
+}
+
+static std::string cb_string(const char * fmt, ...)
+{
+    std::string s;
+    va_list     ap;
+
+    va_start(ap, fmt);
+    vprintf_cb(string_cb, &s, fmt, ap);
+    va_end(ap);
+    return s;
+}
+
+static std::string cb_string_P(const char * fmt, ...)
+{
+    std::string s;
+    va_list     ap;
+
+    va_start(ap, fmt);
+    vprintf_cb_P(string_cb, &s, fmt, ap);
+    va_end(ap);
+    return s;
+}
+
+static std::string libc_string(const char * fmt, ...)
+{
+    char    buf[4096];
+    va_list ap;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    return std::string(buf, n < 0 ? 0 : std::min((size_t)n, sizeof(buf) - 1));
+}
+
+// ----------------------------------------------------------------------------
+// workload: lines like the ones apw logs, one longer than the old buffer
+
+static const char * essid = "apw-lab-5th-floor";
+static uint8_t      mac[6] = { 0xc0, 0x25, 0xe9, 0x12, 0x34, 0x56 };
+static char         long_str[2000];
+
+typedef size_t (*printf_fn_t)(const char * fmt, ...);
+
+static void line_chan(printf_fn_t p)    { p("> chan %2d  %6u frames %5u devs %3u%% %s\n", 11, 123456u, 321u, 42u, "*"); }
+static void line_sched(printf_fn_t p)   { p("%-8s %5u %7u %5u %4u/%-4u %6u/%-6u %5u.%u%%\n", "rpump", 10u, 22477u, 99u, 0u, 990u, 3u, 39u, 0u, 0u); }
+static void line_focus(printf_fn_t p)   { p("> focusing on AP #%d (%s chan: %d)\n", 7, essid, 6); }
+static void line_dev(printf_fn_t p)     { p("%02x:%02x:%02x:%02x:%02x:%02x %-20.20s %4d %c\n", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], essid, -67, 'W'); }
+static void line_short(printf_fn_t p)   { p("> stats reset\n"); }
+static void line_long(printf_fn_t p)    { p("> dump %s\n", long_str); }
+
+typedef struct bench_line_t
+{
+    const char *    name;
+    void            (*fn)(printf_fn_t p);
+} bench_line_t;
+
+static const bench_line_t lines[] =
+{
+    { "chan",   line_chan },
+    { "sched",  line_sched },
+    { "focus",  line_focus },
+    { "dev",    line_dev },
+    { "short",  line_short },
+    { "long",   line_long },
+};
+#define LINES (sizeof(lines) / sizeof(lines[0]))
+
+// ----------------------------------------------------------------------------
+// peak stack: run on a painted stack of our own (the esp runs loop() on its 4k cont stack)
+
+static uint8_t      stack_mem[STACK_SIZE] __attribute__((aligned(16)));
+static ucontext_t   main_ctx;
+static ucontext_t   bench_ctx;
+static void         (*stack_line)(printf_fn_t p);
+static printf_fn_t  stack_printf;
+
+static void stack_entry(void)
+{
+    if(stack_line)
+        stack_line(stack_printf);
+}
+
+static size_t stack_used(void (*line)(printf_fn_t p), printf_fn_t p)
+{
+    memset(stack_mem, 0xa5, sizeof(stack_mem));
+    getcontext(&bench_ctx);
+    bench_ctx.uc_stack.ss_sp   = stack_mem;
+    bench_ctx.uc_stack.ss_size = sizeof(stack_mem);
+    bench_ctx.uc_link          = &main_ctx;
+    stack_line   = line;
+    stack_printf = p;
+    makecontext(&bench_ctx, stack_entry, 0);
+    swapcontext(&main_ctx, &bench_ctx);
+
+    size_t i = 0;
+    while(i < sizeof(stack_mem) && stack_mem[i] == 0xa5)
+        i++;
+    return sizeof(stack_mem) - i;
+}
+
+// ----------------------------------------------------------------------------
+// output has to match libc for everything the formatter claims to support
+
+static int check_case(const std::string & got, const std::string & want, const char * fmt)
+{
+    if(got == want)
+        return 0;
+    printf("MISMATCH \"%s\": got \"%s\" want \"%s\"\n", fmt, got.c_str(), want.c_str());
+    return 1;
+}
+
+static int check_fixed(void)
+{
+    int bad = 0;
+
+#define CHECK(fmt, args...) \
+    bad += check_case(cb_string(fmt, ##args), libc_string(fmt, ##args), fmt); \
+    bad += check_case(cb_string_P(fmt, ##args), libc_string(fmt, ##args), fmt)
+
+    CHECK("plain text, no conversion");
+    CHECK("");
+    CHECK("%%");
+    CHECK("%d %i %u", 0, -1, 4294967295u);
+    CHECK("%d %d", 2147483647, (int)-2147483648ll);
+    CHECK("%x %X %o", 0xdeadbeef, 0xdeadbeef, 0777);
+    CHECK("%#x %#X %#o %#o %#x", 0x1f, 0x1f, 8, 0, 0);
+    CHECK("%5d|%-5d|%05d|%+d|% d|%+5d|%-+5d|", 42, 42, 42, 42, 42, -42, 42);
+    CHECK("%.3d|%.0d|%.0d|%5.3d|%-5.3d|%05.3d|", 7, 0, 1, -7, 7, 7);
+    CHECK("%*d|%-*d|%*d|%.*d|%.*d|", 6, 1, 6, 1, -6, 1, 3, 1, -3, 1);
+    CHECK("%hhd %hhu %hd %hu", 300, 300, 70000, 70000);
+    CHECK("%ld %lu %lx", -123456789l, 123456789ul, 0xfeedul);
+    CHECK("%lld %llu %llx %llo", -9223372036854775807ll - 1, 18446744073709551615ull, 0x123456789abcdefull, 01234567012345670ull);
+    CHECK("%zu %zd %zx", (size_t)12345, (size_t)-5, (size_t)0xabc);
+    CHECK("%jd %ju", (intmax_t)-77, (uintmax_t)77);
+    CHECK("%c|%3c|%-3c|", 'a', 'b', 'c');
+    CHECK("%s|%8s|%-8s|%.3s|%8.3s|%-8.3s|%.0s|", "abcde", "abcde", "abcde", "abcde", "abcde", "abcde", "abcde");
+    CHECK("%s", (const char *)NULL);
+    CHECK("%02x:%02x:%02x:%02x:%02x:%02x", 0xc0, 0x25, 0xe9, 0x12, 0x34, 0x56);
+    CHECK("%-20.20s|%4d|", "a rather long essid that goes on", -67);
+    CHECK("%s", long_str);
+
+    // %S takes a PROGMEM string (plain memory here), libc has no such thing
+    bad += check_case(cb_string("[%S|%6S|%-6S|%.2S]", "flash", "fl", "fl", "flash"), "[flash|    fl|fl    |fl]", "%S");
+
+    // no floating point, the argument is still taken
+    bad += check_case(cb_string("%f|%.2e|%d", 1.5, 2.5, 7), "%f|%.2e|7", "%f");
+
+    // a format that ends inside a conversion is printed as it is
+    bad += check_case(cb_string("abc %-5"), "abc %-5", "abc %-5");
+
+    return bad;
+#undef CHECK
+}
+
+static int check_random(uint32_t cases)
+{
+    static const char * convs = "diuxXoc";
+    static const char * flagset = "-+ #0";
+    static const char * sizes[] = { "", "hh", "h", "l", "ll" };
+    int bad = 0;
+
+    srand(1);
+    for(uint32_t i=0; i<cases && bad<10; i++)
+    {
+        char conv = rand() % 9 ? convs[rand() % 7] : 's';
+        int  text = conv == 'c' || conv == 's';
+        const char * size = text ? "" : sizes[rand() % 5];
+        char fmt[64];
+        int  len = 0;
+
+        // flags libc leaves undefined for the conversion are not drawn: no reference there
+        fmt[len++] = '>';
+        fmt[len++] = '%';
+        for(int f=0; f<5; f++)
+        {
+            if(rand() % 4)
+                continue;
+            if(flagset[f] == '#' && (text || conv == 'd' || conv == 'i' || conv == 'u'))
+                continue;
+            if(flagset[f] != '-' && text)
+                continue;
+            fmt[len++] = flagset[f];
+        }
+        if(rand() % 2)
+            len += sprintf(fmt + len, "%d", rand() % 24);
+        if(rand() % 3 == 0 && conv != 'c')
+            len += sprintf(fmt + len, ".%d", rand() % 24);
+        len += sprintf(fmt + len, "%s%c<", size, conv);
+
+        uint64_t v = ((uint64_t)rand() << 33) ^ ((uint64_t)rand() << 11) ^ rand();
+        v >>= rand() % 64;
+        if(rand() % 2)
+            v = -v;
+
+        std::string got, want;
+        if(conv == 's')
+        {
+            char str[32];
+            snprintf(str, sizeof(str), "%.*s", rand() % 30, "the quick brown fox jumps over");
+            got = cb_string(fmt, str);
+            want = libc_string(fmt, str);
+        }
+        else if(!strcmp(size, "ll"))
+        {
+            got = cb_string(fmt, (long long)v);
+            want = libc_string(fmt, (long long)v);
+        }
+        else if(!strcmp(size, "l"))
+        {
+            got = cb_string(fmt, (long)v);
+            want = libc_string(fmt, (long)v);
+        }
+        else
+        {
+            got = cb_string(fmt, (int)v);
+            want = libc_string(fmt, (int)v);
+        }
+        bad += check_case(got, want, fmt);
+    }
+    return bad;
+}
+
+// ----------------------------------------------------------------------------
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-n iters] [-r cases]\n"
+        "  -n n  calls per line and implementation (default: %d)\n"
+        "  -r n  random formats checked against libc (default: %d)\n"
+        "the old printf formats with the host libc, not the esp rom: its stack is libc's + the %d b buffer\n",
+        prog, ITERS, RANDOM_CASES, OLD_BUF);
+    exit(1);
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t iters = ITERS;
+    uint32_t cases = RANDOM_CASES;
+    int      opt;
+
+    while((opt = getopt(argc, argv, "n:r:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': iters = atoi(optarg);     break;
+            case 'r': cases = atoi(optarg);     break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind != argc || !iters)
+        usage(argv[0]);
+
+    for(size_t i=0; i<sizeof(long_str)-1; i++)
+        long_str[i] = 'a' + i % 26;
+
+    int bad = check_fixed() + check_random(cases);
+    printf("check: %s against libc (%u random formats)\n\n", bad ? "MISMATCH" : "ok", cases);
+
+    size_t base = stack_used(NULL, NULL);
+
+    printf("%-8s %10s %10s %8s   %10s %10s %8s %8s   %s\n",
+        "line", "old ns", "old stack", "old out", "new ns", "new stack", "new out", "writes", "speedup");
+    for(size_t l=0; l<LINES; l++)
+    {
+        uint64_t t0, t1, t2;
+        uint64_t old_bytes, new_bytes, new_calls;
+
+        sink_bytes = sink_calls = 0;
+        t0 = now_ns();
+        for(uint32_t i=0; i<iters; i++)
+            lines[l].fn(old_printf);
+        t1 = now_ns();
+        old_bytes = sink_bytes / iters;
+
+        sink_bytes = sink_calls = 0;
+        for(uint32_t i=0; i<iters; i++)
+            lines[l].fn(new_printf);
+        t2 = now_ns();
+        new_bytes = sink_bytes / iters;
+        new_calls = sink_calls / iters;
+
+        double old_ns = (double)(t1 - t0) / iters;
+        double new_ns = (double)(t2 - t1) / iters;
+        printf("%-8s %10.1f %10zu %8llu   %10.1f %10zu %8llu %8llu   %.2fx\n", lines[l].name,
+            old_ns, stack_used(lines[l].fn, old_printf) - base, (unsigned long long)old_bytes,
+            new_ns, stack_used(lines[l].fn, new_printf) - base, (unsigned long long)new_bytes,
+            (unsigned long long)new_calls, old_ns / new_ns);
+    }
+    printf("\nstack in bytes past an empty call, out in bytes per call (old stops at %d), "
+        "writes: sink calls per line\n", OLD_BUF - 1);
+
+    return bad ? 1 : 0;
+}
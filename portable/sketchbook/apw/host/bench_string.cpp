@@ -0,0 +1,348 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/bench_string.cpp                                      //
+// Description : core String on common workloads, time and heap calls       //
+// ======================================================================== //
+
+#include <WString.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <utility>
+
+#define ITERS           100000
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// ----------------------------------------------------------------------------
+// heap calls, counted on top of glibc's allocator
+
+extern "C" void * __libc_malloc(size_t size);
+extern "C" void * __libc_calloc(size_t n, size_t size);
+extern "C" void * __libc_realloc(void * p, size_t size);
+extern "C" void   __libc_free(void * p);
+
+static uint64_t n_malloc;
+static uint64_t n_realloc;
+static uint64_t n_free;
+
+extern "C" void * malloc(size_t size)
+{
+    n_malloc++;
+    return __libc_malloc(size);
+}
+
+extern "C" void * calloc(size_t n, size_t size)
+{
+    n_malloc++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void * realloc(void * p, size_t size)
+{
+    if(p)
+        n_realloc++;
+    else
+        n_malloc++;
+    return __libc_realloc(p, size);
+}
+
+extern "C" void free(void * p)
+{
+    if(p)
+        n_free++;
+    __libc_free(p);
+}
+
+// ----------------------------------------------------------------------------
+// behaviour the sketch and the libraries count on, short and heap strings alike
+
+static int bad;
+
+#define CHECK(c)    do { if(!(c)) { printf("check failed, line %d: %s\n", __LINE__, #c); bad++; } } while(0)
+
+static String make_label(int i)
+{
+    String s = "dev-";
+    s += i;
+    return s;
+}
+
+static int check(void)
+{
+    const char * longer = "a string too long to be kept in place";
+
+    // construction, validity
+    String e;
+    CHECK(e && e.length() == 0 && !strcmp(e.c_str(), ""));
+    String n((const char *)NULL);
+    CHECK(!n);
+    CHECK(n.reserve(0) && n && n.length() == 0);
+    String s("short");
+    CHECK(s == "short" && s.length() == 5);
+    String l(longer);
+    CHECK(l == longer && l.length() == strlen(longer));
+    CHECK(String(-1234) == "-1234" && String(255u, 16) == "ff" && String('c') == "c");
+    CHECK(String(3.25f) == "3.25" && String(4000000000ul) == "4000000000");
+
+    // exactly at the in place limit and one past it
+    String ten("0123456789"), eleven("0123456789a");
+    CHECK(ten.length() == 10 && ten == "0123456789");
+    CHECK(eleven.length() == 11 && eleven == "0123456789a");
+    ten += 'a';
+    CHECK(ten == eleven);
+
+    // copies and moves
+    String c1(s), c2(l);
+    CHECK(c1 == s && c2 == l && c2.c_str() != l.c_str());
+    String m1(std::move(c1)), m2(std::move(c2));
+    CHECK(m1 == "short" && m2 == longer && c1 == "" && c2 == "" && c1 && c2);
+    m1 = std::move(m2);
+    CHECK(m1 == longer && m2 == "");
+    m1 = m1;
+    CHECK(m1 == longer);
+    m1 = std::move(m1);
+    CHECK(m1 == longer);
+    m1 = make_label(42);
+    CHECK(m1 == "dev-42");
+    m1 = String("x") + longer + 1;
+    CHECK(m1.length() == strlen(longer) + 2 && m1.startsWith("xa string") && m1.endsWith("place1"));
+    String inv((const char *)NULL);
+    m1 = inv;
+    CHECK(!m1);
+    m1 = "back";
+    CHECK(m1 && m1 == "back");
+
+    // concat, including pieces of itself
+    String a("ab");
+    a += a;
+    CHECK(a == "abab");
+    for(int i=0; i<4; i++)
+        a += a;
+    CHECK(a.length() == 64 && a.startsWith("abab") && a.endsWith("abab"));
+    a += a.c_str() + 60;
+    CHECK(a.length() == 68 && a.endsWith("ababab"));
+    String g;
+    for(int i=0; i<1000; i++)
+        g += (char)('a' + i % 26);
+    CHECK(g.length() == 1000 && g[0] == 'a' && g[999] == 'a' + 999 % 26);
+    CHECK(!g.concat((const char *)NULL));
+    String f = F("flash");
+    f += F(" string, long enough for the heap");
+    CHECK(f == "flash string, long enough for the heap");
+
+    // search and slices
+    String h("Host: example.org ");
+    CHECK(h.indexOf(':') == 4 && h.indexOf("example") == 6 && h.lastIndexOf('e') == 12);
+    CHECK(h.lastIndexOf('e', 11) == 6 && h.lastIndexOf('H', 0) == 0 && h.lastIndexOf('z') == -1);
+    CHECK(h.lastIndexOf("o") == 14 && h.lastIndexOf("o", 13) == 1);
+    CHECK(h.substring(0, 4) == "Host" && h.substring(6) == "example.org " && h.substring(4, 0) == "Host");
+    CHECK(h.substring(100) == "" && h.substring(6, 100) == "example.org ");
+    h = h.substring(6);
+    CHECK(h == "example.org ");
+    h.trim();
+    CHECK(h == "example.org");
+    CHECK(h.equalsIgnoreCase("EXAMPLE.ORG") && h.compareTo("example.orh") < 0);
+    String t("   \t  ");
+    t.trim();
+    CHECK(t == "" && t.length() == 0);
+    char buf[8];
+    h.toCharArray(buf, sizeof(buf));
+    CHECK(!strcmp(buf, "example"));
+
+    // in place edits
+    String r("a-b-c-d-e-f-g-h");
+    r.replace("-", "");
+    CHECK(r == "abcdefgh");
+    r.replace("c", "<c>");
+    CHECK(r == "ab<c>defgh");
+    r.replace("<c>", "c");
+    r.replace('h', 'H');
+    CHECK(r == "abcdefgH");
+    r.remove(2, 3);
+    CHECK(r == "abfgH");
+    r.remove(3);
+    CHECK(r == "abf");
+    r.toUpperCase();
+    CHECK(r == "ABF");
+    r.setCharAt(1, 'x');
+    CHECK(r == "AxF" && r.charAt(2) == 'F' && r[3] == 0);
+    CHECK(String("123").toInt() == 123);
+
+    return bad;
+}
+
+// ----------------------------------------------------------------------------
+// workloads
+
+static const char * request =
+    "GET /scan?chan=6 HTTP/1.1\r\n"
+    "Host: 192.168.4.1\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36\r\n"
+    "Accept: text/html,application/json\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Connection: keep-alive\r\n"
+    "\r\n";
+
+static uint32_t sink;
+
+// readStringUntil('\n') one char at a time, then the usual header picking
+static void work_http(void)
+{
+    const char * p = request;
+    while(*p)
+    {
+        String line;
+        while(*p && *p != '\n')
+            line += *p++;
+        if(*p)
+            p++;
+        line.trim();
+        int colon = line.indexOf(':');
+        if(colon < 0)
+            continue;
+        String key = line.substring(0, colon);
+        String val = line.substring(colon + 1);
+        val.trim();
+        if(key.equalsIgnoreCase("host") || key.equalsIgnoreCase("connection"))
+            sink += val.length();
+    }
+}
+
+// a scan result as json, piece by piece and with sums of temporaries
+static void work_json(void)
+{
+    String out = "[";
+    for(int i=0; i<8; i++)
+    {
+        if(i)
+            out += ",";
+        out += "{\"ssid\":\"";
+        out += "apw-lab-";
+        out += i;
+        out += "\",\"rssi\":";
+        out += String(-40 - i * 3);
+        out += ",\"bssid\":\"" + String(0xc025e9 + i, 16) + "\"}";
+    }
+    out += "]";
+    sink += out.length();
+}
+
+// the number to text conversions the ui and the web pages do
+static void work_numbers(void)
+{
+    String a = String(6);
+    String b = String(-67);
+    String c = String(123456u);
+    String d = String(0xdeadbeeful, 16);
+    String e = String(3.14159f, 3);
+    sink += a.length() + b.length() + c.length() + d.length() + e.length();
+}
+
+// labels built by a function and passed around by value
+static String devs[8];
+
+static void work_return(void)
+{
+    for(int i=0; i<8; i++)
+        devs[i] = make_label(i * 1000);
+    String tmp = std::move(devs[0]);
+    for(int i=1; i<8; i++)
+        devs[i - 1] = std::move(devs[i]);
+    devs[7] = std::move(tmp);
+    sink += devs[3].length();
+}
+
+// long buffer grown a char at a time
+static void work_grow(void)
+{
+    String s;
+    for(int i=0; i<1000; i++)
+        s += 'x';
+    sink += s.length();
+}
+
+// short tokens, compare and throw away
+static void work_short(void)
+{
+    String cmd = "chan";
+    String arg = String(11);
+    String both = cmd + " " + arg;
+    if(both == "chan 11")
+        sink++;
+}
+
+typedef struct bench_work_t
+{
+    const char *    name;
+    void            (* fn)(void);
+    uint32_t        iters;  // divisor of the command line count
+} bench_work_t;
+
+static bench_work_t works[] =
+{
+    { "http",       work_http,      10  },
+    { "json",       work_json,      10  },
+    { "numbers",    work_numbers,   1   },
+    { "return",     work_return,    1   },
+    { "grow",       work_grow,      100 },
+    { "short",      work_short,     1   },
+};
+#define WORKS   (sizeof(works) / sizeof(works[0]))
+
+// ----------------------------------------------------------------------------
+
+static void usage(const char * self)
+{
+    fprintf(stderr, "usage: %s [-n iterations]\n", self);
+    exit(1);
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t iters = ITERS;
+    int      opt;
+
+    while((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': iters = atoi(optarg);     break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind != argc || !iters)
+        usage(argv[0]);
+
+    int failed = check();
+    printf("check: %s, sizeof(String) %zu\n\n", failed ? "FAILED" : "ok", sizeof(String));
+
+    printf("%-8s %10s %10s %10s %10s\n", "work", "ns", "malloc", "realloc", "free");
+    for(size_t w=0; w<WORKS; w++)
+    {
+        uint32_t n = iters / works[w].iters ? iters / works[w].iters : 1;
+
+        works[w].fn();  // warm up, devs[] keeps its buffers
+        n_malloc = n_realloc = n_free = 0;
+        uint64_t t0 = now_ns();
+        for(uint32_t i=0; i<n; i++)
+            works[w].fn();
+        uint64_t t1 = now_ns();
+
+        printf("%-8s %10.1f %10.2f %10.2f %10.2f\n", works[w].name, (double)(t1 - t0) / n,
+            (double)n_malloc / n, (double)n_realloc / n, (double)n_free / n);
+    }
+    printf("\nper run of each workload, heap columns are calls\n");
+
+    return failed ? 1 : 0;
+}
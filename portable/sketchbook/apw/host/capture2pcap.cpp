@@ -0,0 +1,174 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/capture2pcap.cpp                                      //
+// Description : serial capture stream -> pcap with radiotap headers        //
+// ======================================================================== //
+
+#include "report_parse.h"
+#include "capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// radiotap: flags, channel, antenna signal
+#define RT_PRESENT      ((1 << 1) | (1 << 3) | (1 << 5))
+#define RT_LEN          (8 + 1 + 1 + 4 + 1)
+
+typedef struct conv_t
+{
+    FILE *      out;
+    uint64_t    base_us;        // added to the device timestamps
+    uint64_t    ts_hi;          // micros() wraps every ~71 min
+    uint32_t    ts_last;
+    int         have_ts;
+    uint64_t    frames;
+    uint64_t    bytes;
+    uint64_t    truncated;      // frames longer than what we got
+    uint32_t    drops;          // frames the device dropped since capture_start()
+} conv_t;
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-t epoch] in.bin out.pcap\n"
+        "  -t s  unix time of the device boot (default: 0)\n"
+        "in.bin is the raw serial stream ('-' = stdin), other frames & text are ignored\n", prog);
+    exit(1);
+}
+
+static void put16(uint8_t * p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t * p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static uint16_t chan_to_freq(uint8_t channel)
+{
+    if(channel == 14)
+        return 2484;
+    return channel ? 2407 + 5 * channel : 0;
+}
+
+static void on_frame(void * ctx, uint8_t type, uint8_t seq, const uint8_t * p, size_t len)
+{
+    conv_t * c = (conv_t *)ctx;
+    uint8_t  rec[16 + RT_LEN];
+
+    if(type != REPORT_T_CAPTURE || len < CAPTURE_HDR_LEN)
+        return;
+
+    uint32_t ts     = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    uint16_t flen   = p[4] | (p[5] << 8);
+    int8_t   rssi   = p[6];
+    uint8_t  chan   = p[7];
+    uint16_t drops  = p[8] | (p[9] << 8);
+    size_t   caplen = len - CAPTURE_HDR_LEN;
+
+    // unwrap the 32 bit device clock & the 16 bit drop counter
+    if(!c->have_ts)
+        c->drops = drops;
+    else
+    {
+        if(ts < c->ts_last)
+            c->ts_hi += 1ull << 32;
+        c->drops += (uint16_t)(drops - (uint16_t)c->drops);
+    }
+    c->have_ts = 1;
+    c->ts_last = ts;
+
+    uint64_t us = c->base_us + c->ts_hi + ts;
+    if(flen < caplen)
+        flen = caplen;
+    if(flen > caplen)
+        c->truncated += 1;
+
+    // pcap record header
+    put32(rec + 0, us / 1000000);
+    put32(rec + 4, us % 1000000);
+    put32(rec + 8, RT_LEN + caplen);
+    put32(rec + 12, RT_LEN + flen);
+
+    // radiotap
+    uint8_t * rt = rec + 16;
+    rt[0] = 0;
+    rt[1] = 0;
+    put16(rt + 2, RT_LEN);
+    put32(rt + 4, RT_PRESENT);
+    rt[8] = 0;                              // flags: no fcs
+    rt[9] = 0;                              // pad, channel is 2 byte aligned
+    put16(rt + 10, chan_to_freq(chan));
+    put16(rt + 12, 0x00a0);                 // 2.4 ghz, dynamic cck-ofdm
+    rt[14] = rssi;
+
+    fwrite(rec, 1, sizeof(rec), c->out);
+    fwrite(p + CAPTURE_HDR_LEN, 1, caplen, c->out);
+
+    c->frames += 1;
+    c->bytes += caplen;
+}
+
+int main(int argc, char ** argv)
+{
+    conv_t c = {};
+    report_parser_t parser;
+    uint8_t buf[4096];
+    FILE * in;
+    size_t n;
+    int opt;
+
+    while((opt = getopt(argc, argv, "t:")) != -1)
+    {
+        switch(opt)
+        {
+            case 't': c.base_us = strtoull(optarg, NULL, 10) * 1000000ull; break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind + 2 != argc)
+        usage(argv[0]);
+
+    in = strcmp(argv[optind], "-") ? fopen(argv[optind], "rb") : stdin;
+    if(!in)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if(!(c.out = fopen(argv[optind + 1], "wb")))
+    {
+        perror(argv[optind + 1]);
+        return 1;
+    }
+
+    // pcap global header, snaplen covers the largest capture frame
+    uint8_t hdr[24];
+    put32(hdr + 0, 0xa1b2c3d4);
+    put16(hdr + 4, 2);
+    put16(hdr + 6, 4);
+    put32(hdr + 8, 0);
+    put32(hdr + 12, 0);
+    put32(hdr + 16, 65535);
+    put32(hdr + 20, 127);                   // LINKTYPE_IEEE802_11_RADIOTAP
+    fwrite(hdr, 1, sizeof(hdr), c.out);
+
+    report_parser_init(&parser);
+    while((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        report_parser_feed(&parser, buf, n, on_frame, &c);
+
+    fclose(c.out);
+
+    fprintf(stderr, "frames %llu (%llu bytes, %llu truncated)  lost on device %u  lost on the wire %llu  crc errors %llu\n",
+        (unsigned long long)c.frames, (unsigned long long)c.bytes, (unsigned long long)c.truncated,
+        c.drops, (unsigned long long)parser.lost, (unsigned long long)parser.crc_errors);
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/collect.cpp                                           //
+// Description : one table from the serial reports of several sensors       //
+// ======================================================================== //
+
+#include "collector.h"
+#include "host.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop = 0;
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-i s] [-r] [-s] port|file [...]\n"
+        "  -i s  print the tables every s seconds (default: once every input is done / on ctrl-c)\n"
+        "  -r    replay recorded files at line rate (115200 8n1) instead of as fast as they read\n"
+        "  -s    sensors & alerts only, no device table\n"
+        "one reader thread per input (up to %d), serial ports are set to 115200 raw.\n"
+        "record one with: cat /dev/ttyUSB0 > sensor.bin, or apw_replay -p -o sensor.bin\n", prog, COLLECT_SENSORS);
+    exit(1);
+}
+
+static void on_signal(int sig)
+{
+    stop = 1;
+}
+
+int main(int argc, char ** argv)
+{
+    collector_t c;
+    int         interval = 0;
+    int         paced = 0;
+    int         devices = 1;
+    int         opt;
+
+    while((opt = getopt(argc, argv, "i:rs")) != -1)
+    {
+        switch(opt)
+        {
+            case 'i': interval = atoi(optarg);  break;
+            case 'r': paced = 1;                break;
+            case 's': devices = 0;              break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind >= argc)
+        usage(argv[0]);
+
+    collect_init(&c);
+    for(int i=optind; i<argc; i++)
+    {
+        if(collect_add(&c, argv[i], paced ? COLLECT_LINE_BPS : 0) < 0)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    collect_start(&c);
+
+    uint64_t next = host_now_ns() + interval * 1000000000ull;
+    int      n;
+    while(!stop && (n = collect_poll(&c)) >= 0)
+    {
+        if(!n)
+            usleep(1000);
+        if(interval && host_now_ns() >= next)
+        {
+            collect_print(&c, stdout, devices);
+            printf("\n");
+            fflush(stdout);
+            next += interval * 1000000000ull;
+        }
+    }
+
+    collect_print(&c, stdout, devices);
+
+    // readers may sit in a read() that never returns, no joining on a signal
+    if(stop)
+        _exit(0);
+    collect_free(&c);
+    return 0;
+}
@@ -0,0 +1,531 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/collector.cpp                                         //
+// Description : merge the serial reports of several sensors (see collect)  //
+// ======================================================================== //
+
+#include "collector.h"
+#include "host.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+
+static_assert((COLLECT_QUEUE & (COLLECT_QUEUE - 1)) == 0, "COLLECT_QUEUE must be a power of 2");
+static_assert(COLLECT_SENSORS <= 16, "sensor masks are 16 bits");
+
+
+// ========================================================================= //
+// reader side
+// ========================================================================= //
+
+static int64_t collect_clock_ms(collector_t * c)
+{
+    return (int64_t)((host_now_ns() - c->start_ns) / 1000000);
+}
+
+// waits for room rather than dropping: the serial driver buffers meanwhile
+static void queue_push(collect_sensor_t * s, const collect_event_t * ev)
+{
+    uint32_t head = s->q->head.load(std::memory_order_relaxed);
+
+    while(head - s->q->tail.load(std::memory_order_acquire) >= COLLECT_QUEUE)
+    {
+        s->stalls += 1;
+        std::this_thread::yield();
+    }
+
+    s->q->ev[head & (COLLECT_QUEUE - 1)] = *ev;
+    s->q->head.store(head + 1, std::memory_order_release);
+}
+
+typedef struct reader_ctx_t
+{
+    collector_t *       c;
+    collect_sensor_t *  s;
+} reader_ctx_t;
+
+// frames are decoded on the reader thread, the merger only sees records
+static void reader_frame(void * ctx, uint8_t type, uint8_t seq, const uint8_t * payload, size_t len)
+{
+    reader_ctx_t *     r = (reader_ctx_t *)ctx;
+    collect_sensor_t * s = r->s;
+    collect_event_t    ev;
+    size_t             off = 0;
+
+    ev.arrival_ms = s->live ? collect_clock_ms(r->c) : -1;
+    ev.push_ns    = host_now_ns();
+
+    switch(type)
+    {
+        case REPORT_T_BEGIN:
+            ev.kind = COLLECT_E_BEGIN;
+            if(report_parse_begin(payload, len, &ev.begin) == 0)
+                queue_push(s, &ev);
+            break;
+
+        case REPORT_T_DEVS:
+            ev.kind = COLLECT_E_REC;
+            while(report_next_rec(payload, len, &off, &ev.rec) == 0)
+                if(ev.rec.type != REPORT_R_CHAN && ev.rec.type != REPORT_R_TASK)
+                    queue_push(s, &ev);
+            break;
+
+        case REPORT_T_END:
+            ev.kind = COLLECT_E_END;
+            if(report_parse_end(payload, len, &ev.end) == 0)
+                queue_push(s, &ev);
+            break;
+    }
+}
+
+static void reader(collector_t * c, collect_sensor_t * s)
+{
+    reader_ctx_t ctx = { c, s };
+    uint8_t      buf[256];
+    uint64_t     start = host_now_ns();
+
+    // paced streams go out in 10 ms worth of bytes, like a uart fifo would
+    size_t chunk = s->bps ? std::max<size_t>(1, std::min<size_t>(sizeof(buf), s->bps / 100)) : sizeof(buf);
+
+    report_parser_init(&s->parser);
+    for(;;)
+    {
+        const uint8_t * data = buf;
+        ssize_t         n;
+
+        if(s->mem)
+        {
+            data = s->mem + s->bytes;
+            n = std::min<size_t>(chunk, s->mem_len - s->bytes);
+        }
+        else if((n = read(s->fd, buf, chunk)) < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            break;
+
+        if(s->bps)
+        {
+            uint64_t due = start + (s->bytes + n) * 1000000000ull / s->bps;
+            uint64_t now = host_now_ns();
+            if(due > now)
+                std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+        }
+
+        s->bytes += n;
+        report_parser_feed(&s->parser, data, n, reader_frame, &ctx);
+    }
+
+    s->done.store(1, std::memory_order_release);
+}
+
+
+// ========================================================================= //
+// merger side
+// ========================================================================= //
+
+static uint64_t mac_key(const uint8_t * mac)
+{
+    uint64_t k = 0;
+    for(int i=0; i<6; i++)
+        k = (k << 8) | mac[i];
+    return k;
+}
+
+// sensor uptime -> collector clock. live: transport only ever delays a report, so the
+// smallest arrival - uptime is the best offset, let it creep up for crystal drift.
+// recordings have no arrival times: their first report is at 0, reboots carry on
+static void clock_update(collect_sensor_t * s, uint32_t uptime, int64_t arrival)
+{
+    int reboot = s->have_clock && uptime < s->uptime;
+
+    if(reboot)
+        s->reboots += 1;
+
+    if(arrival >= 0)
+    {
+        int64_t est = arrival - (int64_t)uptime;
+        if(!s->have_clock || reboot || est < s->offset + COLLECT_DRIFT_MS)
+            s->offset = est;
+        else
+            s->offset += COLLECT_DRIFT_MS;
+    }
+    else if(!s->have_clock)
+        s->offset = -(int64_t)uptime;
+    else if(reboot)
+        s->offset = s->now + REPORT_PERIOD - uptime;
+
+    s->have_clock = 1;
+    s->uptime = uptime;
+    s->now = uptime + s->offset;
+}
+
+static void alert_onset(collector_t * c, int sensor, uint8_t type, int64_t t)
+{
+    for(auto & a : c->alerts)
+    {
+        if(a.type != type || t < a.first - COLLECT_ALERT_MS || t > a.last + COLLECT_ALERT_MS)
+            continue;
+        a.sensors |= 1 << sensor;
+        a.active  |= 1 << sensor;
+        a.first    = std::min(a.first, t);
+        a.last     = std::max(a.last, t);
+        a.end      = 0;
+        return;
+    }
+
+    collect_alert_t a = {};
+    a.type      = type;
+    a.sensors   = a.active = 1 << sensor;
+    a.first     = a.last = t;
+    c->alerts.push_back(a);
+}
+
+static void alert_over(collector_t * c, int sensor, uint8_t type, int64_t t)
+{
+    for(auto & a : c->alerts)
+    {
+        if(a.type != type || !(a.active & (1 << sensor)))
+            continue;
+        a.active &= ~(1 << sensor);
+        if(!a.active)
+            a.end = t;
+    }
+}
+
+// the sensor lost it: it stays in the table while another sensor has it
+static void dev_drop(collector_t * c, std::unordered_map<uint64_t, collect_dev_t>::iterator it, int sensor)
+{
+    it->second.sensors &= ~(1 << sensor);
+    if(!it->second.sensors)
+        c->devs.erase(it);
+}
+
+static void merge_begin(collector_t * c, int sensor, collect_sensor_t * s, const collect_event_t * ev)
+{
+    clock_update(s, ev->begin.uptime, ev->arrival_ms);
+    s->reports += 1;
+    s->full = ev->begin.flags & REPORT_F_FULL;
+
+    uint8_t changed = ev->begin.alerts ^ s->alerts;
+    for(int t=0; t<3; t++)
+    {
+        if(!(changed & (1 << t)))
+            continue;
+        if(ev->begin.alerts & (1 << t))
+            alert_onset(c, sensor, t, s->now);
+        else
+            alert_over(c, sensor, t, s->now);
+    }
+    s->alerts = ev->begin.alerts;
+}
+
+// a full snapshot is complete: what the sensor did not list is gone from its table
+static void merge_end(collector_t * c, int sensor, collect_sensor_t * s)
+{
+    if(!s->full)
+        return;
+
+    for(auto it = c->devs.begin(); it != c->devs.end(); )
+    {
+        auto cur = it++;
+        if((cur->second.sensors & (1 << sensor)) && cur->second.seen[sensor] < s->now)
+            dev_drop(c, cur, sensor);
+    }
+    s->full = 0;
+}
+
+static void merge_rec(collector_t * c, int sensor, collect_sensor_t * s, const report_rec_t * rec)
+{
+    uint64_t key = mac_key(rec->mac);
+
+    if(rec->type == REPORT_R_AP_GONE || rec->type == REPORT_R_CLI_GONE)
+    {
+        auto it = c->devs.find(key);
+        if(it != c->devs.end() && it->second.type == (rec->type == REPORT_R_AP_GONE ? REPORT_R_AP : REPORT_R_CLI))
+            dev_drop(c, it, sensor);
+        return;
+    }
+    if(!s->have_clock)
+        return;
+
+    auto ins = c->devs.emplace(key, collect_dev_t());
+    collect_dev_t & d = ins.first->second;
+    if(ins.second)
+    {
+        d.type  = rec->type;
+        d.first = s->now;
+        memcpy(d.mac, rec->mac, 6);
+    }
+
+    d.sensors        |= 1 << sensor;
+    d.rssi[sensor]    = rec->rssi;
+    d.seen[sensor]    = s->now;
+    d.last            = std::max(d.last, s->now);
+    d.first           = std::min(d.first, s->now);
+
+    if(rec->type == REPORT_R_AP)
+    {
+        d.channel = rec->channel;
+        d.enc     = rec->enc;
+        memcpy(d.essid, rec->name, sizeof(d.essid));
+    }
+    else if(rec->bssid[0] | rec->bssid[1] | rec->bssid[2] | rec->bssid[3] | rec->bssid[4] | rec->bssid[5])
+        memcpy(d.bssid, rec->bssid, 6);
+}
+
+
+// ========================================================================= //
+// interface
+// ========================================================================= //
+
+void collect_init(collector_t * c)
+{
+    c->sensors.clear();
+    c->devs.clear();
+    c->alerts.clear();
+    c->start_ns     = host_now_ns();
+    c->events       = 0;
+    c->lag_max_ns   = 0;
+    c->lag_sum_ns   = 0;
+}
+
+static int add_sensor(collector_t * c, collect_sensor_t * s)
+{
+    void * mem = NULL;
+
+    if(c->sensors.size() >= COLLECT_SENSORS || posix_memalign(&mem, 64, sizeof(collect_queue_t)))
+    {
+        delete s;
+        return -1;
+    }
+
+    s->q = new(mem) collect_queue_t();
+    s->q->head.store(0);
+    s->q->tail.store(0);
+    s->done.store(0);
+    c->sensors.push_back(s);
+    return c->sensors.size() - 1;
+}
+
+int collect_add(collector_t * c, const char * path, uint32_t bps)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_NOCTTY);
+    if(fd < 0 || fstat(fd, &st) < 0)
+        return -1;
+
+    // serial port: raw bytes at the sketch's 115200
+    if(isatty(fd))
+    {
+        struct termios tio;
+        if(tcgetattr(fd, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, B115200);
+            cfsetospeed(&tio, B115200);
+            tio.c_cc[VMIN]  = 1;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+
+    collect_sensor_t * s = new collect_sensor_t();
+    s->name = path;
+    s->fd   = fd;
+    s->bps  = bps;
+    s->live = bps || !S_ISREG(st.st_mode);
+    if(add_sensor(c, s) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return c->sensors.size() - 1;
+}
+
+int collect_add_mem(collector_t * c, const char * name, const uint8_t * data, size_t len, uint32_t bps)
+{
+    collect_sensor_t * s = new collect_sensor_t();
+    s->name     = name;
+    s->fd       = -1;
+    s->mem      = data;
+    s->mem_len  = len;
+    s->bps      = bps;
+    s->live     = bps != 0;
+    return add_sensor(c, s);
+}
+
+void collect_start(collector_t * c)
+{
+    for(auto s : c->sensors)
+        s->thread = std::thread(reader, c, s);
+}
+
+int collect_poll(collector_t * c)
+{
+    int merged = 0;
+    int done = 1;
+
+    for(size_t i=0; i<c->sensors.size(); i++)
+    {
+        collect_sensor_t * s = c->sensors[i];
+
+        // done first: once it is set, everything the reader queued is visible
+        int      eof  = s->done.load(std::memory_order_acquire);
+        uint32_t tail = s->q->tail.load(std::memory_order_relaxed);
+        uint32_t head = s->q->head.load(std::memory_order_acquire);
+
+        s->max_depth = std::max(s->max_depth, head - tail);
+        if(!eof || head != tail)
+            done = 0;
+
+        uint64_t now = head != tail ? host_now_ns() : 0;
+        for(; tail != head; tail++)
+        {
+            const collect_event_t * ev = &s->q->ev[tail & (COLLECT_QUEUE - 1)];
+
+            uint64_t lag = now > ev->push_ns ? now - ev->push_ns : 0;
+            c->lag_sum_ns += lag;
+            c->lag_max_ns  = std::max(c->lag_max_ns, lag);
+
+            if(ev->kind == COLLECT_E_BEGIN)
+                merge_begin(c, i, s, ev);
+            else if(ev->kind == COLLECT_E_END)
+                merge_end(c, i, s);
+            else
+                merge_rec(c, i, s, &ev->rec);
+            merged += 1;
+        }
+        s->q->tail.store(tail, std::memory_order_release);
+    }
+
+    c->events += merged;
+    return done ? -1 : merged;
+}
+
+void collect_stop(collector_t * c)
+{
+    for(auto s : c->sensors)
+        if(s->thread.joinable())
+            s->thread.join();
+}
+
+int collect_best(const collect_dev_t * d)
+{
+    int best = -1;
+    for(int i=0; i<COLLECT_SENSORS; i++)
+        if((d->sensors & (1 << i)) && (best < 0 || d->rssi[i] > d->rssi[best]))
+            best = i;
+    return best;
+}
+
+static std::string sensor_list(uint16_t mask)
+{
+    std::string r;
+    for(int i=0; i<COLLECT_SENSORS; i++)
+        if(mask & (1 << i))
+            r += (r.empty() ? "" : ",") + std::to_string(i);
+    return r.empty() ? "-" : r;
+}
+
+void collect_print(collector_t * c, FILE * f, int devices)
+{
+    static const char * alert_names[] = { "deauth", "beacon", "karma" };
+
+    fprintf(f, "%-3s %-24s %9s %7s %6s %6s %5s %4s %10s %7s %6s\n",
+        "#", "sensor", "bytes", "frames", "lost", "crc", "skip", "boot", "offset ms", "stalls", "depth");
+    for(size_t i=0; i<c->sensors.size(); i++)
+    {
+        collect_sensor_t * s = c->sensors[i];
+        fprintf(f, "%-3zu %-24.24s %9llu %7llu %6llu %6llu %5llu %4u %10lld %7llu %6u\n", i, s->name,
+            (unsigned long long)s->bytes, (unsigned long long)s->parser.frames, (unsigned long long)s->parser.lost,
+            (unsigned long long)s->parser.crc_errors, (unsigned long long)s->parser.skipped, s->reboots,
+            (long long)s->offset, (unsigned long long)s->stalls, s->max_depth);
+    }
+
+    size_t aps = 0, shared = 0;
+    for(auto & it : c->devs)
+    {
+        aps += it.second.type == REPORT_R_AP;
+        shared += __builtin_popcount(it.second.sensors) > 1;
+    }
+    fprintf(f, "\ndevices %zu (aps %zu clients %zu, %zu heard by several sensors)  events %llu  lag avg %.1f us max %.1f us\n",
+        c->devs.size(), aps, c->devs.size() - aps, shared, (unsigned long long)c->events,
+        c->events ? c->lag_sum_ns / 1e3 / c->events : 0.0, c->lag_max_ns / 1e3);
+
+    if(devices && !c->devs.empty())
+    {
+        std::vector<const collect_dev_t *> list;
+        for(auto & it : c->devs)
+            list.push_back(&it.second);
+        std::sort(list.begin(), list.end(), [](const collect_dev_t * a, const collect_dev_t * b) {
+            return a->type != b->type ? a->type < b->type : memcmp(a->mac, b->mac, 6) < 0;
+        });
+
+        fprintf(f, "\n%-3s %-17s %-8s %3s %4s %5s %9s %9s  %-18s %s\n",
+            "", "mac", "vendor", "ch", "best", "rssi", "first s", "last s", "sensors", "essid / bssid");
+        for(auto d : list)
+        {
+            char vendor[9] = {};
+            char mac[18], bssid[18];
+            int  best = collect_best(d);
+
+            search_vendor((uint8_t *)d->mac, vendor);
+            snprintf(mac, sizeof(mac), "%02x:%02x:%02x:%02x:%02x:%02x", d->mac[0], d->mac[1], d->mac[2], d->mac[3], d->mac[4], d->mac[5]);
+            snprintf(bssid, sizeof(bssid), "%02x:%02x:%02x:%02x:%02x:%02x", d->bssid[0], d->bssid[1], d->bssid[2], d->bssid[3], d->bssid[4], d->bssid[5]);
+
+            std::string rssi;
+            for(int i=0; i<COLLECT_SENSORS; i++)
+                if(d->sensors & (1 << i))
+                    rssi += (rssi.empty() ? "" : " ") + std::to_string(i) + ":" + std::to_string(d->rssi[i]);
+
+            fprintf(f, "%-3s %-17s %-8s %3u %4d %5d %9.1f %9.1f  %-18s %s\n",
+                d->type == REPORT_R_AP ? "ap" : "cli", mac, vendor, d->channel, best, best >= 0 ? d->rssi[best] : 0,
+                d->first / 1000.0, d->last / 1000.0, rssi.c_str(),
+                d->type == REPORT_R_AP ? d->essid : (d->bssid[0] | d->bssid[1] | d->bssid[2] ? bssid : ""));
+        }
+    }
+
+    if(!c->alerts.empty())
+    {
+        std::vector<collect_alert_t> list(c->alerts);
+        std::stable_sort(list.begin(), list.end(), [](const collect_alert_t & a, const collect_alert_t & b) {
+            return a.first < b.first;
+        });
+
+        fprintf(f, "\n%-8s %9s %9s %9s  %-12s %s\n", "alert", "first s", "spread s", "end s", "sensors", "still up");
+        for(auto & a : list)
+        {
+            char end[16] = "-";
+            if(a.end)
+                snprintf(end, sizeof(end), "%.1f", a.end / 1000.0);
+            fprintf(f, "%-8s %9.1f %9.1f %9s  %-12s %s\n", alert_names[a.type], a.first / 1000.0,
+                (a.last - a.first) / 1000.0, end, sensor_list(a.sensors).c_str(), sensor_list(a.active).c_str());
+        }
+    }
+}
+
+void collect_free(collector_t * c)
+{
+    collect_stop(c);
+    for(auto s : c->sensors)
+    {
+        if(s->fd >= 0)
+            close(s->fd);
+        s->q->~collect_queue_t();
+        free(s->q);
+        delete s;
+    }
+    c->sensors.clear();
+}
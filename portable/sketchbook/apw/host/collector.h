@@ -0,0 +1,147 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/collector.h                                           //
+// Description : merge the serial reports of several sensors (see collect)  //
+// ======================================================================== //
+
+#ifndef _HOST_COLLECTOR_H
+#define _HOST_COLLECTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "report_parse.h"
+
+#define COLLECT_SENSORS     16      // sensor bit masks are 16 bits wide
+#define COLLECT_QUEUE       4096    // events per sensor between its reader & the merger (power of 2)
+#define COLLECT_ALERT_MS    10000   // onsets on different sensors closer than that are one alert
+#define COLLECT_DRIFT_MS    1       // clock offset may creep up that much per report (200 ppm at 5 s)
+#define COLLECT_LINE_BPS    11520   // 115200 8n1
+
+typedef enum collect_kind_t
+{
+    COLLECT_E_BEGIN,
+    COLLECT_E_REC,
+    COLLECT_E_END,
+} collect_kind_t;
+
+// one decoded frame / record, reader -> merger
+typedef struct collect_event_t
+{
+    uint8_t             kind;           // collect_kind_t
+    int64_t             arrival_ms;     // collector clock when the frame was complete, -1 for recordings
+    uint64_t            push_ns;        // host_now_ns() when queued
+    union
+    {
+        report_begin_t  begin;
+        report_rec_t    rec;
+        report_end_t    end;
+    };
+} collect_event_t;
+
+// single producer (reader thread), single consumer (merger): no locks, one release store each side
+typedef struct collect_queue_t
+{
+    alignas(64) std::atomic<uint32_t>   head;   // next slot the reader fills
+    alignas(64) std::atomic<uint32_t>   tail;   // next slot the merger takes
+    alignas(64) collect_event_t         ev[COLLECT_QUEUE];
+} collect_queue_t;
+
+typedef struct collect_sensor_t
+{
+    const char *        name;
+    int                 fd;             // file / serial port, -1 for memory
+    const uint8_t *     mem;            // or a stream in memory (benchmarks)
+    size_t              mem_len;
+    uint32_t            bps;            // deliver at that rate, 0 = as fast as it reads
+    int                 live;           // arrival times mean something (serial port, pipe, paced)
+
+    // reader thread
+    std::thread         thread;
+    report_parser_t     parser;
+    collect_queue_t *   q;
+    uint64_t            bytes;
+    uint64_t            stalls;         // queue full, had to wait for the merger
+    std::atomic<int>    done;
+
+    // merger
+    int                 have_clock;
+    int64_t             offset;         // collector clock = sensor uptime + offset
+    uint32_t            uptime;         // of the last report
+    int64_t             now;            // collector clock of the report being merged
+    uint32_t            reboots;
+    uint32_t            reports;
+    uint8_t             full;           // report being merged is a full snapshot
+    uint8_t             alerts;         // REPORT_T_BEGIN alert bits of the last report
+    uint32_t            max_depth;      // most events seen waiting in the queue
+} collect_sensor_t;
+
+// a device as all the sensors see it
+typedef struct collect_dev_t
+{
+    uint8_t             type;           // REPORT_R_AP / REPORT_R_CLI
+    uint8_t             mac[6];
+    uint8_t             bssid[6];       // client's ap, latest any sensor reported
+    uint8_t             channel;
+    uint8_t             enc;
+    char                essid[33];
+    uint16_t            sensors;        // bit n = sensor n has it in its table
+    int64_t             first;          // collector clock
+    int64_t             last;
+    int8_t              rssi[COLLECT_SENSORS];
+    int64_t             seen[COLLECT_SENSORS];  // last report from that sensor with the device in it
+} collect_dev_t;
+
+// an alert raised by one or more sensors around the same time
+typedef struct collect_alert_t
+{
+    uint8_t             type;           // bit of report_begin_t.alerts (0 deauth, 1 beacon, 2 karma)
+    uint16_t            sensors;        // raised it
+    uint16_t            active;         // still have it up
+    int64_t             first;          // first & last onset
+    int64_t             last;
+    int64_t             end;            // last sensor dropped it, 0 while active
+} collect_alert_t;
+
+typedef struct collector_t
+{
+    std::vector<collect_sensor_t *>                 sensors;
+    std::unordered_map<uint64_t, collect_dev_t>     devs;
+    std::vector<collect_alert_t>                    alerts;
+    uint64_t                                        start_ns;
+    uint64_t                                        events;
+    uint64_t                                        lag_max_ns;     // queued -> merged
+    uint64_t                                        lag_sum_ns;
+} collector_t;
+
+void    collect_init(collector_t * c);
+
+// a serial port (115200 raw), fifo or recorded stream. -1 if it cannot be opened or too many
+int     collect_add(collector_t * c, const char * path, uint32_t bps);
+
+// a stream in memory, delivered at bps (0 = flat out)
+int     collect_add_mem(collector_t * c, const char * name, const uint8_t * data, size_t len, uint32_t bps);
+
+// one reader thread per sensor
+void    collect_start(collector_t * c);
+
+// merge what the readers queued: events merged, -1 once every reader is done & drained
+int     collect_poll(collector_t * c);
+
+// join the readers (after collect_poll() returned -1)
+void    collect_stop(collector_t * c);
+
+// sensor with the strongest reading of d, -1 if none has it
+int     collect_best(const collect_dev_t * d);
+
+void    collect_print(collector_t * c, FILE * f, int devices);
+void    collect_free(collector_t * c);
+
+#endif
@@ -0,0 +1,165 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/fs.cpp                                                //
+// Description : SPIFFS stand-in for host builds, files in a host directory //
+// ======================================================================== //
+
+#include "host.h"
+#include "FS.h"
+
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+
+#define HOST_FS_SIZE        (1024 * 1024)   // 1M spiffs layout
+#define HOST_FS_BLOCK       8192
+#define HOST_FS_PAGE        256
+
+FS          SPIFFS;
+host_fs_t   host_fs = {};
+
+static std::string host_fs_dir;
+
+
+// ========================================================================= //
+// host control
+// ========================================================================= //
+
+void host_fs_root(const char * dir)
+{
+    host_fs_dir = dir ? dir : "";
+}
+
+static std::string host_fs_path(const char * path)
+{
+    std::string p = host_fs_dir + "/";
+    for(const char * c = path[0] == '/' ? path + 1 : path; *c; c++)
+        p += *c == '/' ? '_' : *c;
+    return p;
+}
+
+
+// ========================================================================= //
+// File
+// ========================================================================= //
+
+File & File::operator=(const File & o)
+{
+    if(o._f)
+        o._f->refs += 1;
+    close();
+    _f = o._f;
+    return *this;
+}
+
+size_t File::write(const uint8_t * buf, size_t size)
+{
+    if(!_f)
+        return 0;
+
+    size_t n = fwrite(buf, 1, size, _f->f);
+    host_fs.writes += 1;
+    host_fs.bytes_written += n;
+    return n;
+}
+
+size_t File::read(uint8_t * buf, size_t size)
+{
+    if(!_f)
+        return 0;
+
+    size_t n = fread(buf, 1, size, _f->f);
+    host_fs.bytes_read += n;
+    return n;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+    return _f && fseek(_f->f, pos, whence[mode]) == 0;
+}
+
+size_t File::position(void) const
+{
+    return _f ? ftell(_f->f) : 0;
+}
+
+size_t File::size(void) const
+{
+    struct stat st;
+    if(!_f)
+        return 0;
+    fflush(_f->f);
+    return fstat(fileno(_f->f), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close(void)
+{
+    if(_f && --_f->refs == 0)
+    {
+        fclose(_f->f);
+        delete _f;
+    }
+    _f = NULL;
+}
+
+
+// ========================================================================= //
+// FS
+// ========================================================================= //
+
+bool FS::begin(void)
+{
+    struct stat st;
+    return !host_fs_dir.empty() && stat(host_fs_dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool FS::format(void)
+{
+    return false;
+}
+
+bool FS::info(FSInfo & info)
+{
+    memset(&info, 0, sizeof(info));
+    info.totalBytes     = HOST_FS_SIZE;
+    info.blockSize      = HOST_FS_BLOCK;
+    info.pageSize       = HOST_FS_PAGE;
+    info.maxOpenFiles   = 5;
+    info.maxPathLength  = 32;
+    return begin();
+}
+
+// spiffs modes are the stdio ones ("r", "w", "a", "r+", ...)
+File FS::open(const char * path, const char * mode)
+{
+    std::string m = mode;
+    if(m.find('b') == std::string::npos)
+        m += 'b';
+
+    FILE * f = fopen(host_fs_path(path).c_str(), m.c_str());
+    if(!f)
+        return File();
+    return File(new host_file_t { f, 1 });
+}
+
+bool FS::exists(const char * path)
+{
+    struct stat st;
+    return stat(host_fs_path(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char * path)
+{
+    return ::remove(host_fs_path(path).c_str()) == 0;
+}
+
+bool FS::rename(const char * from, const char * to)
+{
+    // spiffs refuses to overwrite
+    if(exists(to))
+        return false;
+    return ::rename(host_fs_path(from).c_str(), host_fs_path(to).c_str()) == 0;
+}
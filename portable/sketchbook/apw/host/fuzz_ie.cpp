@@ -0,0 +1,376 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/fuzz_ie.cpp                                           //
+// Description : parse_beacon() fuzzing against a plain reference decoder   //
+// ======================================================================== //
+
+// built with libfuzzer (-DAPW_LIBFUZZER -fsanitize=fuzzer) or as a standalone
+// driver that mutates generated beacons, see 'make fuzz' for the asan build
+
+#include "host.h"
+#include "wifi.h"
+#include "devs.h"
+#include "ring.h"
+#include "status.h"
+#include "ie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// ========================================================================= //
+// reference: offsets & one check per read, no iterator
+// ========================================================================= //
+
+typedef struct ref_t
+{
+    int         ok;
+    char        essid[33];
+    uint8_t     channel;
+    uint8_t     enc;
+    uint8_t     ht;
+    uint8_t     rsn[3];         // group, pairwise, akm
+    uint8_t     wpa[3];
+} ref_t;
+
+static uint8_t ref_cipher(const uint8_t * s, uint8_t o2)
+{
+    if(s[0] != 0x00 || s[1] != (o2 == 0xac ? 0x0f : 0x50) || s[2] != o2)
+        return IE_C_OTHER;
+    if(s[3] == 1 || s[3] == 5)  return IE_C_WEP;
+    if(s[3] == 2)               return IE_C_TKIP;
+    if(s[3] == 4 || s[3] == 10) return IE_C_CCMP;
+    if(s[3] == 8 || s[3] == 9)  return IE_C_GCMP;
+    return IE_C_OTHER;
+}
+
+static uint8_t ref_akm(const uint8_t * s, uint8_t o2)
+{
+    static const uint8_t eap[] = { 1, 3, 5, 11, 12, 13 };
+    static const uint8_t psk[] = { 2, 4, 6 };
+    static const uint8_t sae[] = { 8, 9, 24, 25 };
+
+    if(s[0] != 0x00 || s[1] != (o2 == 0xac ? 0x0f : 0x50) || s[2] != o2)
+        return IE_AKM_OTHER;
+    for(size_t i=0; i<sizeof(eap); i++) if(s[3] == eap[i]) return IE_AKM_EAP;
+    for(size_t i=0; i<sizeof(psk); i++) if(s[3] == psk[i]) return IE_AKM_PSK;
+    for(size_t i=0; i<sizeof(sae); i++) if(s[3] == sae[i]) return IE_AKM_SAE;
+    if(s[3] == 18)
+        return IE_AKM_OWE;
+    return IE_AKM_OTHER;
+}
+
+// suites of a rsn / wpa body (after the oui + type for wpa), missing ones keep the defaults
+static void ref_suites(const uint8_t * b, size_t len, uint8_t o2, uint8_t def, uint8_t s[3])
+{
+    s[0] = s[1] = def;
+    s[2] = IE_AKM_EAP;
+
+    if(len < 6)
+        return;
+    s[0] = ref_cipher(b + 2, o2);
+
+    size_t off = 6;
+    if(len < off + 2)
+        return;
+    size_t n = b[off] | (b[off + 1] << 8);
+    off += 2;
+    if(off + n * 4 > len)
+        return;
+    s[1] = 0;
+    for(size_t i=0; i<n; i++)
+        s[1] |= ref_cipher(b + off + i * 4, o2);
+    off += n * 4;
+
+    if(off + 2 > len)
+        return;
+    size_t m = b[off] | (b[off + 1] << 8);
+    off += 2;
+    if(off + m * 4 > len)
+        return;
+    s[2] = 0;
+    for(size_t i=0; i<m; i++)
+        s[2] |= ref_akm(b + off + i * 4, o2);
+}
+
+static void ref_parse(const uint8_t * f, size_t len, ref_t * r)
+{
+    int ssid = 0, ds = 0, rsn = 0, wpa = 0, htc = 0, vht = 0;
+
+    memset(r, 0, sizeof(*r));
+    if(len < 24 + 12 || (f[0] != 0x80 && f[0] != 0x50))
+        return;
+
+    for(size_t off = 36; off + 2 <= len && off + 2 + f[off + 1] <= len; off += 2 + f[off + 1])
+    {
+        uint8_t id = f[off];
+        uint8_t l  = f[off + 1];
+        const uint8_t * d = f + off + 2;
+
+        if(id == 0 && !ssid)
+        {
+            ssid = 1;
+            memcpy(r->essid, d, l > 32 ? 32 : l);
+        }
+        else if(id == 3 && !ds && l >= 1)
+        {
+            ds = 1;
+            r->channel = d[0];
+        }
+        else if(id == 48 && !rsn)
+        {
+            rsn = 1;
+            ref_suites(d, l, 0xac, IE_C_CCMP, r->rsn);
+        }
+        else if(id == 45)
+            htc = 1;
+        else if(id == 191)
+            vht = 1;
+        else if(id == 221 && !wpa && l >= 4 && d[0] == 0x00 && d[1] == 0x50 && d[2] == 0xf2 && d[3] == 1)
+        {
+            wpa = 1;
+            ref_suites(d + 4, l - 4, 0xf2, IE_C_TKIP, r->wpa);
+        }
+    }
+    if(!ssid)
+        return;
+
+    r->ok = 1;
+    r->ht = vht ? AP_BAND_VHT : (htc ? AP_BAND_HT : 0);
+    if(rsn)
+        r->enc = (r->rsn[2] & IE_AKM_EAP) && !(r->rsn[2] & (IE_AKM_PSK | IE_AKM_SAE)) ? AP_ENC_WPA2_MGT : AP_ENC_WPA2_PSK;
+    else if(wpa)
+        r->enc = (r->wpa[2] & IE_AKM_EAP) && !(r->wpa[2] & IE_AKM_PSK) ? AP_ENC_WPA1_MGT : AP_ENC_WPA1_PSK;
+    else
+        r->enc = (f[24 + 10] & 0x10) ? AP_ENC_WEP : AP_ENC_OPEN;
+}
+
+
+// ========================================================================= //
+// one input
+// ========================================================================= //
+
+static uint64_t checked = 0;
+static uint64_t beacons = 0;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t * data, size_t size)
+{
+    // exact size heap copy so asan sees any read past the end
+    uint8_t * buf = (uint8_t *)malloc(size ? size : 1);
+    memcpy(buf, data, size);
+
+    ref_t   ref;
+    char    essid[33];
+    uint8_t chan = 0, enc = 0, ht = 0;
+
+    ref_parse(buf, size, &ref);
+    int ret = size >= sizeof(frame_t) ? parse_beacon((frame_t *)buf, size, essid, &chan, &enc, &ht) : -1;
+
+    // the suites themselves
+    int suites = 1;
+    if(ref.ok)
+    {
+        ie_info_t info;
+        ie_parse(buf + sizeof(frame_t) + BEACON_FIXED_LEN, size - sizeof(frame_t) - BEACON_FIXED_LEN, IE_F_ALL, &info);
+        if(info.found & IE_F_RSN)
+            suites &= info.rsn_group == ref.rsn[0] && info.rsn_pairwise == ref.rsn[1] && info.rsn_akm == ref.rsn[2];
+        if(info.found & IE_F_WPA)
+            suites &= info.wpa_group == ref.wpa[0] && info.wpa_pairwise == ref.wpa[1] && info.wpa_akm == ref.wpa[2];
+    }
+
+    if((ret == 0) != ref.ok || (ref.ok && (!suites || strcmp(essid, ref.essid) || chan != ref.channel || enc != ref.enc || ht != ref.ht)))
+    {
+        fprintf(stderr, "mismatch on %zu bytes: ret %d/%d essid '%s'/'%s' chan %d/%d enc %d/%d ht %d/%d suites %s\n",
+            size, ret, ref.ok ? 0 : -1, ret ? "" : essid, ref.essid, chan, ref.channel, enc, ref.enc, ht, ref.ht, suites ? "ok" : "differ");
+        for(size_t i=0; i<size; i++)
+            fprintf(stderr, "%02x%s", buf[i], (i & 31) == 31 ? "\n" : "");
+        fprintf(stderr, "\n");
+        abort();
+    }
+
+    checked += 1;
+    beacons += ref.ok;
+    free(buf);
+    return 0;
+}
+
+#ifndef APW_LIBFUZZER
+
+// ========================================================================= //
+// standalone driver: generated beacons, then mutated
+// ========================================================================= //
+
+static void put_suite(std::vector<uint8_t> & v, uint8_t o2)
+{
+    static const uint8_t types[] = { 1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 18, 24, 0, 7, 200 };
+    v.push_back(0x00);
+    v.push_back(rand() % 8 ? (o2 == 0xac ? 0x0f : 0x50) : rand());
+    v.push_back(rand() % 8 ? o2 : rand());
+    v.push_back(types[rand() % sizeof(types)]);
+}
+
+static void put_suites(std::vector<uint8_t> & v, uint8_t o2)
+{
+    v.push_back(1);
+    v.push_back(0);
+    put_suite(v, o2);
+    for(int l=0; l<2; l++)
+    {
+        int n = rand() % 4;
+        v.push_back(n);
+        v.push_back(0);
+        for(int i=0; i<n; i++)
+            put_suite(v, o2);
+    }
+    v.push_back(0);
+    v.push_back(0);
+}
+
+static void put_ie(std::vector<uint8_t> & f, uint8_t id, const std::vector<uint8_t> & body)
+{
+    f.push_back(id);
+    f.push_back(body.size() > 255 ? 255 : body.size());
+    f.insert(f.end(), body.begin(), body.begin() + (body.size() > 255 ? 255 : body.size()));
+}
+
+static void gen_beacon(std::vector<uint8_t> & f)
+{
+    f.assign(36, 0);
+    f[0] = rand() % 4 ? 0x80 : 0x50;
+    for(int i=4; i<22; i++)
+        f[i] = rand();
+    f[34] = rand() % 2 ? 0x11 : 0x01;
+
+    int n = rand() % 10;
+    for(int i=0; i<n; i++)
+    {
+        std::vector<uint8_t> b;
+        int kind = rand() % 8;
+
+        if(kind == 0)
+        {
+            b.resize(rand() % 40);
+            for(size_t k=0; k<b.size(); k++)
+                b[k] = 'a' + rand() % 26;
+            put_ie(f, IE_SSID, b);
+        }
+        else if(kind == 1)
+            put_ie(f, IE_DS, std::vector<uint8_t>(rand() % 2, 1 + rand() % 14));
+        else if(kind == 2)
+        {
+            put_suites(b, 0xac);
+            b.resize(rand() % 4 ? b.size() : rand() % (b.size() + 1));
+            put_ie(f, IE_RSN, b);
+        }
+        else if(kind == 3)
+        {
+            b.push_back(0x00); b.push_back(0x50); b.push_back(0xf2); b.push_back(rand() % 4 ? 1 : 4);
+            put_suites(b, 0xf2);
+            b.resize(rand() % 4 ? b.size() : rand() % (b.size() + 1));
+            put_ie(f, IE_VENDOR, b);
+        }
+        else if(kind == 4)
+            put_ie(f, rand() % 2 ? IE_HT_CAPA : IE_VHT_CAPA, std::vector<uint8_t>(rand() % 30, 0));
+        else
+            put_ie(f, rand(), std::vector<uint8_t>(rand() % 20, rand()));
+    }
+}
+
+static void mutate(std::vector<uint8_t> & f)
+{
+    int n = rand() % 4;
+    for(int i=0; i<n && !f.empty(); i++)
+    {
+        switch(rand() % 4)
+        {
+            case 0: f[rand() % f.size()] = rand();                  break;
+            case 1: f.resize(rand() % (f.size() + 1));              break;
+            case 2: f[rand() % f.size()] ^= 1 << (rand() % 8);     break;
+            case 3: if(f.size() > 37) f[36 + rand() % (f.size() - 36)] = rand() % 4 ? rand() % 64 : 255; break;
+        }
+    }
+}
+
+// the sdk reuses its rx buffer: past sb->len, a short beacon is followed by what the
+// previous frame left there. a wpa2 beacon, then an open one of the same layout but
+// cut right before where the rsn element was, the open AP must stay open
+static uint8_t stale_beacon(uint8_t * b, uint8_t last, int rsn)
+{
+    static const uint8_t rsn_ie[] = { IE_RSN, 20, 1, 0, 0x00, 0x0f, 0xac, 4, 1, 0, 0x00, 0x0f, 0xac, 4, 1, 0, 0x00, 0x0f, 0xac, 2, 0, 0 };
+    uint8_t * f = b + sizeof(struct RxControl);
+    uint8_t n = 0;
+
+    memset(f, 0, sizeof(frame_t) + BEACON_FIXED_LEN);
+    f[0] = 0x80;
+    memset(f + 4, 0xff, 6);
+    uint8_t mac[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, last };
+    memcpy(f + 10, mac, 6);
+    memcpy(f + 16, mac, 6);
+    f[34] = rsn ? 0x11 : 0x01;
+    n = sizeof(frame_t) + BEACON_FIXED_LEN;
+    f[n++] = IE_SSID;
+    f[n++] = 4;
+    memcpy(f + n, rsn ? "wpa2" : "open", 4);
+    n += 4;
+    if(rsn)
+    {
+        memcpy(f + n, rsn_ie, sizeof(rsn_ie));
+        n += sizeof(rsn_ie);
+    }
+
+    struct sniffer_buf2 * sb = (struct sniffer_buf2 *)b;
+    sb->rx_ctrl.rssi    = -50;
+    sb->rx_ctrl.channel = 6;
+    sb->cnt             = 1;
+    sb->len             = n;
+    wifi_sniff(b, sizeof(struct sniffer_buf2));
+    wifi_drain(RING_SIZE);
+    return mac[5];
+}
+
+static int check_stale_tail(void)
+{
+    uint8_t b[sizeof(struct sniffer_buf2)] = {};
+    uint8_t mac[6] = { 0x02, 0x11, 0x22, 0x33, 0x44, 0 };
+
+    host_serial_quiet(1);
+    wifi_init();
+    mac[5] = stale_beacon(b, 1, 1);
+    wifi_ap_t * wpa = dev_ap_find(mac, 0);
+    mac[5] = stale_beacon(b, 2, 0);
+    wifi_ap_t * open = dev_ap_find(mac, 0);
+
+    if(!wpa || !open || wpa->enc == 0 || open->enc != 0)
+    {
+        fprintf(stderr, "stale tail: wpa2 AP enc %d, open AP enc %d\n", wpa ? wpa->enc : -1, open ? open->enc : -1);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    long iters = argc > 1 ? atol(argv[1]) : 1000000;
+    unsigned seed = argc > 2 ? atoi(argv[2]) : 1;
+    std::vector<uint8_t> f;
+
+    if(check_stale_tail() < 0)
+        return 1;
+
+    srand(seed);
+    for(long i=0; i<iters; i++)
+    {
+        gen_beacon(f);
+        if(i & 1)
+            mutate(f);
+        LLVMFuzzerTestOneInput(f.data(), f.size());
+    }
+
+    printf("%llu inputs, %llu parsed as beacons, no mismatch\n", (unsigned long long)checked, (unsigned long long)beacons);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,334 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/host.cpp                                              //
+// Description : arduino core + esp8266 sdk stand-ins for host builds       //
+// ======================================================================== //
+
+#include "host.h"
+#include "Arduino.h"
+#include "status.h"
+#include "printf_cb.h"
+
+#include <time.h>
+
+extern "C" {
+    #include "user_interface.h"
+}
+
+// globals normally defined by apw.ino / the core
+status_t        status = {};
+HardwareSerial  Serial;
+EspClass        ESP;
+host_sdk_t      host_sdk = {};
+host_uart_t     host_uart = { SERIAL_TX_BUFFER_SIZE };
+
+static uint64_t host_time_us = 0;
+static int      host_quiet = 0;
+static FILE *   host_out = NULL;
+
+
+// ========================================================================= //
+// host control
+// ========================================================================= //
+
+void host_set_time_us(uint64_t us)
+{
+    host_time_us = us;
+}
+
+uint64_t host_get_time_us(void)
+{
+    return host_time_us;
+}
+
+void host_serial_quiet(int quiet)
+{
+    host_quiet = quiet;
+}
+
+void host_serial_file(FILE * f)
+{
+    host_out = f;
+}
+
+// bytes queued on the modelled line
+static uint64_t host_uart_queued(uint64_t now)
+{
+    return host_uart.idle_at > now ? (host_uart.idle_at - now + HOST_UART_BYTE_NS - 1) / HOST_UART_BYTE_NS : 0;
+}
+
+// queue n bytes on the modelled line, account the time we would block: bytes taken
+static size_t host_uart_push(size_t n)
+{
+    uint64_t now = host_time_us * 1000;
+    uint64_t cap = (uint64_t)(host_uart.txbuf + HOST_UART_FIFO) * HOST_UART_BYTE_NS;
+
+    if(host_uart.policy == SERIAL_TX_DROP)
+    {
+        uint64_t queued = host_uart_queued(now);
+        uint64_t room = queued < host_uart.txbuf + HOST_UART_FIFO ? host_uart.txbuf + HOST_UART_FIFO - queued : 0;
+        if(n > room)
+        {
+            host_uart.dropped += n - room;
+            n = room;
+        }
+    }
+
+    if(host_uart.idle_at < now)
+        host_uart.idle_at = now;
+    host_uart.idle_at += n * HOST_UART_BYTE_NS;
+    host_uart.bytes += n;
+
+    if(host_uart.idle_at - now > cap)
+    {
+        uint64_t blocked = host_uart.idle_at - now - cap;
+        host_uart.waits += 1;
+        host_uart.blocked_ns += blocked;
+        if(blocked > host_uart.blocked_max)
+            host_uart.blocked_max = blocked;
+    }
+    return n;
+}
+
+uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+// ========================================================================= //
+// arduino core
+// ========================================================================= //
+
+uint32_t millis(void)
+{
+    return (uint32_t)(host_time_us / 1000);
+}
+
+uint32_t micros(void)
+{
+    return (uint32_t)host_time_us;
+}
+
+void delay(uint32_t ms)
+{
+    host_time_us += (uint64_t)ms * 1000;
+}
+
+void yield(void)
+{
+}
+
+long random(long max)
+{
+    return max > 0 ? rand() % max : 0;
+}
+
+long random(long min, long max)
+{
+    return max > min ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed)
+{
+    srand(seed);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+    return HIGH;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint8_t config, uint8_t mode, size_t tx_size)
+{
+    host_uart.txbuf   = tx_size;
+    host_uart.dropped = 0;
+    host_uart.waits   = 0;
+}
+
+void HardwareSerial::setTxOverflow(uint8_t policy)
+{
+    host_uart.policy = policy;
+}
+
+uint32_t HardwareSerial::txDropped(void) const
+{
+    return host_uart.dropped;
+}
+
+uint32_t HardwareSerial::txWaits(void) const
+{
+    return host_uart.waits;
+}
+
+// the core's Print::printf: formatter chunks straight to write()
+static void host_serial_chunk(void * arg, const char * buf, size_t len)
+{
+    *(size_t *)arg += Serial.write((const uint8_t *)buf, len);
+}
+
+size_t HardwareSerial::printf(const char * fmt, ...)
+{
+    va_list ap;
+    size_t  sent = 0;
+
+    va_start(ap, fmt);
+    vprintf_cb(host_serial_chunk, &sent, fmt, ap);
+    va_end(ap);
+    return sent;
+}
+
+size_t HardwareSerial::print(const char * s)
+{
+    return printf("%s", s);
+}
+
+size_t HardwareSerial::println(const char * s)
+{
+    return printf("%s\r\n", s);
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t * buf, size_t len)
+{
+    len = host_uart_push(len);
+
+    if((host_quiet && !host_out) || !len)
+        return len;
+    return fwrite(buf, 1, len, host_out ? host_out : stdout);
+}
+
+int HardwareSerial::availableForWrite(void)
+{
+    // the core counts the fifo in while nothing is queued ahead of it: buffer + fifo - queued
+    int64_t room = (int64_t)(host_uart.txbuf + HOST_UART_FIFO) - (int64_t)host_uart_queued(host_time_us * 1000);
+
+    return room < 0 ? 0 : (int)room;
+}
+
+// the wait is not modelled: whatever was accepted is already out
+void HardwareSerial::flush(void)
+{
+    fflush(host_out ? host_out : stdout);
+}
+
+int HardwareSerial::available(void)
+{
+    return 0;
+}
+
+int HardwareSerial::read(void)
+{
+    return -1;
+}
+
+uint32_t EspClass::getCycleCount(void)
+{
+    // 80 mhz worth of cycles, from the real clock
+    return (uint32_t)(host_now_ns() * 80 / 1000);
+}
+
+uint32_t EspClass::getFreeHeap(void)
+{
+    return 40 * 1024;
+}
+
+
+// ========================================================================= //
+// esp8266 sdk
+// ========================================================================= //
+
+bool wifi_set_opmode(uint8 opmode)
+{
+    return true;
+}
+
+bool wifi_set_phy_mode(enum phy_mode mode)
+{
+    host_sdk.phy = mode;
+    host_sdk.phy_switches += 1;
+    return true;
+}
+
+enum phy_mode wifi_get_phy_mode(void)
+{
+    return (enum phy_mode)host_sdk.phy;
+}
+
+uint8 wifi_get_channel(void)
+{
+    return host_sdk.channel;
+}
+
+bool wifi_set_channel(uint8 channel)
+{
+    host_sdk.channel = channel;
+    host_sdk.chan_switches += 1;
+    return true;
+}
+
+void wifi_promiscuous_enable(uint8 promiscuous)
+{
+    host_sdk.promisc = promiscuous;
+}
+
+void wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb)
+{
+    host_sdk.rx_cb = cb;
+}
+
+int wifi_send_pkt_freedom(uint8 * buf, int len, bool sys_seq)
+{
+    host_sdk.pkt_sent += 1;
+    return 0;
+}
+
+// back from the "sleep" right away: duty.cpp waits for its wake up time in the loop
+extern "C" void esp_yield(void)
+{
+}
+
+bool system_deep_sleep_set_option(uint8 option)
+{
+    host_sdk.rf_option = option;
+    return true;
+}
+
+void system_deep_sleep(uint32 time_in_us)
+{
+    host_sdk.sleeps += 1;
+    host_sdk.sleep_us += time_in_us;
+}
+
+// same limits as the sdk: block aligned, nothing below the user part for writes
+bool system_rtc_mem_read(uint8 src_addr, void * des_addr, uint16 load_size)
+{
+    if((size_t)src_addr * 4 + load_size > sizeof(host_sdk.rtc_mem))
+        return false;
+    memcpy(des_addr, host_sdk.rtc_mem + src_addr * 4, load_size);
+    return true;
+}
+
+bool system_rtc_mem_write(uint8 des_addr, const void * src_addr, uint16 save_size)
+{
+    if(des_addr < 64 || (size_t)des_addr * 4 + save_size > sizeof(host_sdk.rtc_mem))
+        return false;
+    memcpy(host_sdk.rtc_mem + des_addr * 4, src_addr, save_size);
+    return true;
+}
@@ -0,0 +1,111 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/host.h                                                //
+// Description : host side control of the arduino / sdk stand-ins           //
+// ======================================================================== //
+
+#ifndef _HOST_H
+#define _HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// virtual clock seen by millis() / micros()
+void     host_set_time_us(uint64_t us);
+uint64_t host_get_time_us(void);
+
+// serial output: 0 = stdout, 1 = dropped (unless sent to a file)
+void     host_serial_quiet(int quiet);
+
+// send serial output to f instead of stdout (NULL = back to stdout)
+void     host_serial_file(FILE * f);
+
+// serial line model: 115200 8n1 behind the core's tx buffer (Serial.begin()) + 128b fifo
+// a write that overflows them would block loop() until the line drains, or lose
+// what does not fit with SERIAL_TX_DROP
+#define HOST_UART_BYTE_NS   86806   // 10 bits at 115200
+#define HOST_UART_FIFO      128     // UART_TX_FIFO_SIZE
+
+typedef struct host_uart_t
+{
+    uint32_t    txbuf;          // tx buffer size from Serial.begin()
+    uint8_t     policy;         // SERIAL_TX_BLOCK / SERIAL_TX_DROP
+    uint64_t    bytes;          // bytes written
+    uint64_t    dropped;        // bytes that did not fit (SERIAL_TX_DROP)
+    uint32_t    waits;          // writes that would have blocked
+    uint64_t    blocked_ns;     // total time writes would have blocked
+    uint64_t    blocked_max;    // longest single block
+    uint64_t    idle_at;        // virtual time (ns) the line is drained
+} host_uart_t;
+
+extern host_uart_t host_uart;
+
+// monotonic wall clock for measurements
+uint64_t host_now_ns(void);
+
+// sdk stand-in state
+typedef struct host_sdk_t
+{
+    uint8_t     channel;        // last wifi_set_channel()
+    uint8_t     phy;            // last wifi_set_phy_mode()
+    uint32_t    chan_switches;  // number of wifi_set_channel() calls
+    uint32_t    phy_switches;   // number of wifi_set_phy_mode() calls
+    uint32_t    pkt_sent;       // number of wifi_send_pkt_freedom() calls
+    uint8_t     promisc;        // last wifi_promiscuous_enable(), frames are only heard when on
+    uint32_t    sleeps;         // system_deep_sleep() calls, time goes on & the call returns
+    uint64_t    sleep_us;       // asked for in total
+    uint8_t     rf_option;      // last system_deep_sleep_set_option()
+    uint8_t     rtc_mem[768];   // rtc memory, survives the "sleeps"
+    void        (*rx_cb)(uint8_t * buf, uint16_t len);
+} host_sdk_t;
+
+extern host_sdk_t host_sdk;
+
+// SPIFFS stand-in (stubs/FS.h): files live in dir, NULL = no filesystem (begin() fails)
+void     host_fs_root(const char * dir);
+
+typedef struct host_fs_t
+{
+    uint64_t    writes;         // File::write() calls
+    uint64_t    bytes_written;
+    uint64_t    bytes_read;
+} host_fs_t;
+
+extern host_fs_t host_fs;
+
+// ssd1306 behind the Wire stand-in (stubs/Wire.h): the real OLED library runs on top,
+// the model keeps what the panel would show & what it cost on the bus
+#define HOST_OLED_ADDR      0x3c
+#define HOST_OLED_WIDTH     128
+#define HOST_OLED_PAGES     4       // 8 pixel rows each, bit 0 on top
+
+typedef struct host_oled_t
+{
+    uint8_t     ram[HOST_OLED_WIDTH * HOST_OLED_PAGES];    // gddram, page addressing mode
+    uint8_t     on;             // 0xaf / 0xae
+    uint8_t     page;           // ram pointer
+    uint8_t     col;
+    uint8_t     args;           // parameter bytes still due to the last command
+    uint32_t    clock;          // Wire.setClock()
+    uint64_t    transactions;
+    uint64_t    bytes;          // on the bus, address byte included
+    uint64_t    pixels;         // gddram bytes written
+    uint64_t    dropped;        // bytes past the Wire buffer, lost
+} host_oled_t;
+
+extern host_oled_t host_oled;
+
+// pixel at x, y (0, 0 = top left)
+int      host_oled_pixel(int x, int y);
+
+// bus time for a number of transactions & bytes at host_oled.clock (9 bits a byte, start & stop)
+uint32_t host_oled_bus_us(uint64_t transactions, uint64_t bytes);
+
+// plain pbm (P1), one text line per pixel row. -1 on a write error / not a 128x32 one
+int      host_oled_save_pbm(FILE * f);
+int      host_oled_load_pbm(FILE * f, uint8_t ram[HOST_OLED_WIDTH * HOST_OLED_PAGES]);
+
+#endif
@@ -0,0 +1,201 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/oui_gen.cpp                                           //
+// Description : builds oui.h from the wireshark manuf file                 //
+// ======================================================================== //
+
+// usage: oui_gen manuf > ../oui.h
+//
+// layout of the generated tables (all PROGMEM, read with aligned 32-bit loads):
+//  - oui_index[b] .. oui_index[b+1]-1 : entries whose oui starts with byte b
+//  - oui_entries[i] : (oui[1] << 24) | (oui[2] << 16) | vendor id, sorted
+//  - oui_vendors    : deduplicated names grouped by length, no terminators.
+//    ids oui_group_id[l] .. oui_group_id[l+1]-1 have length l and start at
+//    oui_group_off[l] + (id - oui_group_id[l]) * l
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#define VENDOR_LEN      8       // wifi_*_t.vendor is char[9]
+
+typedef struct oui_t
+{
+    uint32_t        oui;
+    std::string     name;
+} oui_t;
+
+static int parse_hex_byte(const char * p)
+{
+    if(!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]))
+        return -1;
+    char tmp[3] = { p[0], p[1], 0 };
+    return strtol(tmp, NULL, 16);
+}
+
+// "00:00:0C<tab>Cisco<tab>Cisco Systems, Inc" -> oui + short name
+// only plain /24 assignments are kept (no /28 /36 sub-blocks)
+static int parse_line(const char * line, oui_t & out)
+{
+    int b[3];
+
+    for(int i=0; i<3; i++)
+    {
+        b[i] = parse_hex_byte(line + i * 3);
+        if(b[i] < 0)
+            return -1;
+        if(i < 2 && line[i * 3 + 2] != ':' && line[i * 3 + 2] != '-')
+            return -1;
+    }
+    if(line[8] != '\t')
+        return -1;
+
+    const char * p = line + 9;
+
+    std::string name;
+    while(*p && *p != '\t' && *p != '\r' && *p != '\n' && *p != '#')
+        name += *p++;
+    while(!name.empty() && name[name.size() - 1] == ' ')
+        name.erase(name.size() - 1);
+    if(name.empty())
+        return -1;
+
+    if(name.size() > VENDOR_LEN)
+        name.resize(VENDOR_LEN);
+
+    out.oui  = (b[0] << 16) | (b[1] << 8) | b[2];
+    out.name = name;
+    return 0;
+}
+
+static void print_bytes(const std::vector<uint8_t> & v)
+{
+    for(size_t i=0; i<v.size(); i++)
+        printf("0x%02x,%s", v[i], (i % 16 == 15 || i + 1 == v.size()) ? "\n" : " ");
+}
+
+int main(int argc, char ** argv)
+{
+    std::map<uint32_t, std::string> ouis;
+    char line[1024];
+
+    if(argc != 2)
+    {
+        fprintf(stderr, "usage: %s manuf > oui.h\n", argv[0]);
+        return 1;
+    }
+
+    FILE * f = fopen(argv[1], "r");
+    if(!f)
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    while(fgets(line, sizeof(line), f))
+    {
+        oui_t o;
+        if(parse_line(line, o) == 0 && !ouis.count(o.oui))
+            ouis[o.oui] = o.name;
+    }
+    fclose(f);
+
+    if(ouis.empty() || ouis.size() > 0xffff)
+    {
+        fprintf(stderr, "bad oui count: %zu\n", ouis.size());
+        return 1;
+    }
+
+    // dedup names, then order them by length so they need no terminator
+    std::vector<std::string> names;
+    for(std::map<uint32_t, std::string>::iterator it = ouis.begin(); it != ouis.end(); ++it)
+        names.push_back(it->second);
+    std::sort(names.begin(), names.end(), [](const std::string & a, const std::string & b)
+    {
+        return a.size() != b.size() ? a.size() < b.size() : a < b;
+    });
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    std::map<std::string, uint16_t> ids;
+    std::vector<uint8_t>            pool;
+    uint16_t                        group_id[VENDOR_LEN + 2];
+    uint32_t                        group_off[VENDOR_LEN + 2];
+
+    for(size_t l=0, i=0; l<=VENDOR_LEN + 1; l++)
+    {
+        group_id[l]  = i;
+        group_off[l] = pool.size();
+        for(; i < names.size() && names[i].size() == l; i++)
+        {
+            ids[names[i]] = i;
+            pool.insert(pool.end(), names[i].begin(), names[i].end());
+        }
+    }
+    while(pool.size() % 4)
+        pool.push_back(0);
+
+    // first byte buckets + sorted entries
+    std::vector<uint32_t> entries;
+    uint16_t              index[257];
+    int                   b = 0;
+
+    for(std::map<uint32_t, std::string>::iterator it = ouis.begin(); it != ouis.end(); ++it)
+    {
+        while(b <= (int)(it->first >> 16))
+            index[b++] = entries.size();
+        entries.push_back(((it->first & 0xffff) << 16) | ids[it->second]);
+    }
+    while(b <= 256)
+        index[b++] = entries.size();
+
+    printf("#ifndef oui_h\n#define oui_h\n");
+    printf("/*\n"
+           "  Based on Wireshark manufacturer database\n"
+           "  source: https://www.wireshark.org/tools/oui-lookup.html\n"
+           "  Wireshark is released under the GNU General Public License version 2\n"
+           "\n"
+           "  Generated by host/oui_gen, do not edit. Layout is described there.\n"
+           "*/\n\n");
+    printf("#define ENABLE_MAC_LIST // comment out if you want to save memory\n\n");
+    printf("#define OUI_COUNT       %zu\n", entries.size());
+    printf("#define OUI_VENDORS     %zu\n", names.size());
+    printf("#define OUI_VENDOR_LEN  %d\n\n", VENDOR_LEN);
+    printf("#ifdef ENABLE_MAC_LIST\n\n");
+
+    printf("const static uint16_t oui_group_id[OUI_VENDOR_LEN + 2] PROGMEM = {\n");
+    for(int l=0; l<=VENDOR_LEN + 1; l++)
+        printf("%u,%s", group_id[l], l == VENDOR_LEN + 1 ? "\n" : " ");
+    printf("};\n\n");
+
+    printf("const static uint32_t oui_group_off[OUI_VENDOR_LEN + 2] PROGMEM = {\n");
+    for(int l=0; l<=VENDOR_LEN + 1; l++)
+        printf("%u,%s", group_off[l], l == VENDOR_LEN + 1 ? "\n" : " ");
+    printf("};\n\n");
+
+    printf("const static uint16_t oui_index[257] PROGMEM = {\n");
+    for(int i=0; i<257; i++)
+        printf("%u,%s", index[i], (i % 16 == 15 || i == 256) ? "\n" : " ");
+    printf("};\n\n");
+
+    printf("const static uint32_t oui_entries[OUI_COUNT] PROGMEM = {\n");
+    for(size_t i=0; i<entries.size(); i++)
+        printf("0x%08x,%s", entries[i], (i % 8 == 7 || i + 1 == entries.size()) ? "\n" : " ");
+    printf("};\n\n");
+
+    printf("const static uint8_t oui_vendors[%zu] PROGMEM __attribute__((aligned(4))) = {\n", pool.size());
+    print_bytes(pool);
+    printf("};\n\n");
+
+    printf("#endif\n#endif\n");
+
+    fprintf(stderr, "%zu ouis, %zu vendors, %zu bytes\n", entries.size(), names.size(),
+        sizeof(index) + entries.size() * 4 + pool.size() + sizeof(group_id) + sizeof(group_off));
+    return 0;
+}
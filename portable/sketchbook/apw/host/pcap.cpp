@@ -0,0 +1,195 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/pcap.cpp                                              //
+// Description : pcap file loading (raw 802.11 & radiotap link types)       //
+// ======================================================================== //
+
+#include "pcap.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PCAP_MAGIC_US       0xa1b2c3d4
+#define PCAP_MAGIC_NS       0xa1b23c4d
+
+// radiotap fields we care about
+#define RT_TSFT             0
+#define RT_FLAGS            1
+#define RT_RATE             2
+#define RT_CHANNEL          3
+#define RT_FHSS             4
+#define RT_DBM_ANTSIGNAL    5
+#define RT_EXT              31
+
+#define RT_FLAG_FCS         0x10
+
+static uint32_t swap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static uint16_t rd16(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint8_t pcap_freq_to_chan(uint16_t freq)
+{
+    if(freq == 2484)
+        return 14;
+    if(freq >= 2412 && freq <= 2472)
+        return (freq - 2407) / 5;
+    return 0;
+}
+
+// strip the radiotap header, fill rssi / channel / flags
+// returns the radiotap header length, or -1 if malformed
+static int parse_radiotap(const uint8_t * buf, size_t len, pcap_pkt_t & pkt, int * fcs)
+{
+    // fixed alignment & size of the first fields, indexed by bit
+    static const uint8_t align[] = { 8, 1, 1, 2, 2, 1 };
+    static const uint8_t size[]  = { 8, 1, 1, 4, 2, 1 };
+
+    if(len < 8 || buf[0] != 0)
+        return -1;
+
+    uint16_t rt_len = rd16(buf + 2);
+    if(rt_len < 8 || rt_len > len)
+        return -1;
+
+    // skip all present bitmaps
+    const uint8_t * p = buf + 4;
+    uint32_t present = rd32(p);
+    while(rd32(p) & (1u << RT_EXT))
+    {
+        p += 4;
+        if(p + 4 > buf + rt_len)
+            return -1;
+    }
+    p += 4;
+
+    size_t off = p - buf;
+    for(int bit=0; bit<=RT_DBM_ANTSIGNAL; bit++)
+    {
+        if(!(present & (1u << bit)))
+            continue;
+
+        off = (off + align[bit] - 1) & ~(size_t)(align[bit] - 1);
+        if(off + size[bit] > rt_len)
+            return -1;
+
+        if(bit == RT_FLAGS)
+            *fcs = (buf[off] & RT_FLAG_FCS) != 0;
+        else if(bit == RT_CHANNEL)
+            pkt.channel = pcap_freq_to_chan(rd16(buf + off));
+        else if(bit == RT_DBM_ANTSIGNAL)
+            pkt.rssi = (int8_t)buf[off];
+
+        off += size[bit];
+    }
+
+    // mcs field (bit 19) means ht
+    if(present & (1u << 19))
+        pkt.ht = 1;
+
+    return rt_len;
+}
+
+// load all frames from a pcap file
+// returns number of frames loaded, -1 on error
+int pcap_load(const char * path, std::vector<pcap_pkt_t> & pkts)
+{
+    FILE *  f = fopen(path, "rb");
+    uint8_t ghdr[24];
+    uint8_t phdr[16];
+    int     n = 0;
+
+    if(!f)
+    {
+        fprintf(stderr, "pcap: cannot open %s\n", path);
+        return -1;
+    }
+
+    if(fread(ghdr, 1, sizeof(ghdr), f) != sizeof(ghdr))
+    {
+        fprintf(stderr, "pcap: %s: truncated header\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t magic = rd32(ghdr);
+    int      swap  = 0;
+    int      nsec  = 0;
+
+    if(magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS)
+        nsec = magic == PCAP_MAGIC_NS;
+    else if(swap32(magic) == PCAP_MAGIC_US || swap32(magic) == PCAP_MAGIC_NS)
+    {
+        swap = 1;
+        nsec = swap32(magic) == PCAP_MAGIC_NS;
+    }
+    else
+    {
+        fprintf(stderr, "pcap: %s: not a pcap file (pcapng is not supported)\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    uint32_t link = swap ? swap32(rd32(ghdr + 20)) : rd32(ghdr + 20);
+    if(link != PCAP_LINK_80211 && link != PCAP_LINK_RADIOTAP)
+    {
+        fprintf(stderr, "pcap: %s: unsupported link type %u\n", path, link);
+        fclose(f);
+        return -1;
+    }
+
+    std::vector<uint8_t> buf;
+    while(fread(phdr, 1, sizeof(phdr), f) == sizeof(phdr))
+    {
+        uint32_t sec  = swap ? swap32(rd32(phdr + 0))  : rd32(phdr + 0);
+        uint32_t frac = swap ? swap32(rd32(phdr + 4))  : rd32(phdr + 4);
+        uint32_t caplen = swap ? swap32(rd32(phdr + 8)) : rd32(phdr + 8);
+
+        if(caplen > 65535)
+        {
+            fprintf(stderr, "pcap: %s: bad record length %u\n", path, caplen);
+            break;
+        }
+
+        buf.resize(caplen);
+        if(fread(buf.data(), 1, caplen, f) != caplen)
+            break;
+
+        pcap_pkt_t  pkt = {};
+        int         fcs = 0;
+        size_t      off = 0;
+
+        pkt.ts_us = (uint64_t)sec * 1000000 + (nsec ? frac / 1000 : frac);
+
+        if(link == PCAP_LINK_RADIOTAP)
+        {
+            int l = parse_radiotap(buf.data(), caplen, pkt, &fcs);
+            if(l < 0)
+                continue;
+            off = l;
+        }
+
+        size_t flen = caplen - off;
+        if(fcs && flen >= 4)
+            flen -= 4;
+
+        pkt.data.assign(buf.begin() + off, buf.begin() + off + flen);
+        pkts.push_back(pkt);
+        n += 1;
+    }
+
+    fclose(f);
+    return n;
+}
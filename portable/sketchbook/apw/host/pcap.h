@@ -0,0 +1,32 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/pcap.h                                                //
+// Description : pcap file loading (raw 802.11 & radiotap link types)       //
+// ======================================================================== //
+
+#ifndef _HOST_PCAP_H
+#define _HOST_PCAP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define PCAP_LINK_80211         105
+#define PCAP_LINK_RADIOTAP      127
+
+// one captured 802.11 frame, radiotap header stripped
+typedef struct pcap_pkt_t
+{
+    uint64_t                ts_us;      // capture timestamp
+    int8_t                  rssi;       // dbm, 0 if unknown
+    uint8_t                 channel;    // 2.4ghz channel, 0 if unknown
+    uint8_t                 ht;         // frame received with ht rates
+    std::vector<uint8_t>    data;       // 802.11 frame (no fcs)
+} pcap_pkt_t;
+
+int     pcap_load(const char * path, std::vector<pcap_pkt_t> & pkts);
+uint8_t pcap_freq_to_chan(uint16_t freq);
+
+#endif
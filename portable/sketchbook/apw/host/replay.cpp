@@ -0,0 +1,450 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/replay.cpp                                            //
+// Description : replay pcap files through wifi_sniff() & benchmark it      //
+// ======================================================================== //
+
+#include "host.h"
+#include "pcap.h"
+#include "status.h"
+#include "wifi.h"
+#include "devs.h"
+#include "utils.h"
+#include "ring.h"
+#include "sched.h"
+#include "chan.h"
+#include "capture.h"
+#include "detect.h"
+#include "hist.h"
+#include "prof.h"
+#include "filter.h"
+#include "duty.h"
+#include "ui.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+#define DEFAULT_RSSI        -60
+
+// esp8266 sdk promiscuous buffer layouts
+#define ESP_MGMT_LEN        112     // sniffer_buf2.buf
+#define ESP_DATA_LEN        36      // sniffer_buf.buf
+#define ESP_BUF_MGMT        128     // sizeof(struct sniffer_buf2)
+#define ESP_BUF_DATA        60      // sizeof(struct sniffer_buf) with one LenSeq
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-b n] [-c] [-C plan] [-d ms] [-f] [-g] [-H dir] [-l] [-o file] [-p] [-P] [-q] [-r n] [-R] [-t] [-u] [-X oui] [-w [-B mac] [-F mask] [-S n]] file.pcap [...]\n"
+        "  -b n  run the main loop every n frames (default: 1)\n"
+        "  -c    only deliver frames captured on the channel we are tuned to\n"
+        "  -C p  channel plan hopping (FEATURE_CHANPLAN): plan channels & airtime %%, e.g. 1,6,11:80\n"
+        "  -d ms duty-cycled monitoring (FEATURE_DUTY), deep sleep ms between bursts\n"
+        "  -f    pass full frames (default: truncate like the esp8266 sdk)\n"
+        "  -g    hop through the b / g / n phy modes too (FEATURE_BANDHOP)\n"
+        "  -H d  device history on SPIFFS, kept in directory d (sync at the end, rerun to reload)\n"
+        "  -l    only drain the rx ring, do not run the scheduled jobs\n"
+        "  -o f  write serial output to f (default: stdout)\n"
+        "  -p    turn on the binary serial report (FEATURE_REPORT)\n"
+        "  -P    rx prefilter off, every frame goes to the ring\n"
+        "  -q    silence serial output\n"
+        "  -r n  replay the captures n times\n"
+        "  -R    round-robin channel hopping (default: adaptive)\n"
+        "  -t    skip the final ap / client tables\n"
+        "  -u    serial like the stock core: 256 b tx buffer, writes block when full\n"
+        "  -X o  ignore devices from vendor o (aa:bb:cc, up to %d)\n"
+        "  -w    raw frame capture over the serial port (see capture2pcap)\n"
+        "  -B m  capture: only frames to / from mac m (aa:bb:cc:dd:ee:ff, up to 4)\n"
+        "  -F x  capture: frame type mask, hex, bit (type << 4 | subtype)\n"
+        "  -S n  capture: snaplen (default & max: %d / %d)\n", prog, FILTER_OUIS, CAPTURE_SNAPLEN, CAPTURE_SNAPLEN_MAX);
+    exit(1);
+}
+
+// build the buffer the sdk hands to the promiscuous callback
+static uint16_t build_rx(const pcap_pkt_t & pkt, int full, std::vector<uint8_t> & buf)
+{
+    size_t flen = pkt.data.size();
+    size_t copy = flen;
+    size_t total;
+
+    buf.assign(sizeof(struct RxControl) + (full ? flen : ESP_BUF_MGMT), 0);
+
+    struct RxControl * rx = (struct RxControl *)buf.data();
+    rx->rssi        = pkt.rssi ? pkt.rssi : DEFAULT_RSSI;
+    rx->channel     = pkt.channel ? pkt.channel : host_sdk.channel;
+    rx->sig_mode    = pkt.ht ? 1 : 0;
+    if(pkt.ht)
+        rx->HT_length = flen;
+    else
+        rx->legacy_length = flen;
+
+    if(full)
+        total = sizeof(struct RxControl) + flen;
+    // control frames: the sdk only gives us the rx header
+    else if(flen < 1 || (pkt.data[0] & 0x0c) == 0x04)
+        return sizeof(struct RxControl);
+    // management frames: struct sniffer_buf2
+    else if((pkt.data[0] & 0x0c) == 0x00)
+    {
+        copy = std::min(flen, (size_t)ESP_MGMT_LEN);
+        buf[sizeof(struct RxControl) + ESP_MGMT_LEN + 0] = 1;
+        buf[sizeof(struct RxControl) + ESP_MGMT_LEN + 2] = flen & 0xff;
+        buf[sizeof(struct RxControl) + ESP_MGMT_LEN + 3] = flen >> 8;
+        total = ESP_BUF_MGMT;
+    }
+    // everything else: struct sniffer_buf
+    else
+    {
+        copy = std::min(flen, (size_t)ESP_DATA_LEN);
+        buf[sizeof(struct RxControl) + ESP_DATA_LEN + 0] = 1;
+        buf[sizeof(struct RxControl) + ESP_DATA_LEN + 2] = flen & 0xff;
+        buf[sizeof(struct RxControl) + ESP_DATA_LEN + 3] = flen >> 8;
+        total = ESP_BUF_DATA;
+    }
+
+    memcpy(buf.data() + sizeof(struct RxControl), pkt.data.data(), copy);
+    return total;
+}
+
+static uint64_t percentile(const std::vector<uint32_t> & sorted, double p)
+{
+    if(sorted.empty())
+        return 0;
+    size_t i = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+static void print_tables(void)
+{
+    char * enc_str[] = { "open", "wep", "wpa1", "eap1", "wpa2", "eap2" };
+    char   mac[20];
+    char   amac[20];
+    char   vendor[9];
+
+    printf("\n%-12s  %-32s  %2s  %-4s  %2s  %8s  %4s  %3s  %s\n",
+        "bssid", "essid", "ch", "enc", "ht", "beacons", "rssi", "cli", "vendor");
+    if(status.aps)
+    {
+        wifi_ap_t * ap = status.aps;
+        do
+        {
+            bin_to_hex(ap->mac, 6, mac, sizeof(mac));
+            vendor_name(ap->vendor - 1, vendor);
+            printf("%-12s  %-32s  %2d  %-4s  %2d  %8u  %4d  %3d  %s\n",
+                mac, essid_str(ap->essid), ap->channel, ap->enc < 6 ? enc_str[ap->enc] : "?",
+                ap->ht, ap->beacons, ap->rssi, ap->clients_count, vendor);
+            ap = dev_ap_next(ap);
+        } while(ap != status.aps);
+    }
+
+    printf("\n%-12s  %-12s  %8s  %4s  %-8s  %s\n", "client", "bssid", "packets", "rssi", "vendor", "probes");
+    if(status.clients)
+    {
+        wifi_client_t * cli = status.clients;
+        do
+        {
+            bin_to_hex(cli->mac, 6, mac, sizeof(mac));
+            vendor_name(cli->vendor - 1, vendor);
+            if(cli->ap)
+                bin_to_hex(dev_cli_ap(cli)->mac, 6, amac, sizeof(amac));
+            else
+                snprintf(amac, sizeof(amac), "-");
+            printf("%-12s  %-12s  %8u  %4d  %-8s ", mac, amac, cli->pkt_count, cli->rssi, vendor);
+            for(int i=0; i<CLI_PROBES && cli->probes[i]; i++)
+                printf(" '%s'", essid_str(cli->probes[i]));
+            printf("\n");
+            cli = dev_cli_next(cli);
+        } while(cli != status.clients);
+    }
+}
+
+typedef struct mac_t
+{
+    uint8_t b[6];
+} mac_t;
+
+static int parse_mac(const char * s, uint8_t mac[6])
+{
+    unsigned int b[6];
+    if(sscanf(s, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6)
+        return -1;
+    for(int i=0; i<6; i++)
+        mac[i] = b[i];
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<pcap_pkt_t> pkts;
+    int full        = 0;
+    int no_loop     = 0;
+    int quiet       = 0;
+    int repeat      = 1;
+    int no_tables   = 0;
+    int batch       = 1;
+    int tuned       = 0;
+    int roundrobin  = 0;
+    FILE * out      = NULL;
+    int capture     = 0;
+    const char * fs = NULL;
+    capture_filter_t filter = {};
+    int no_prefilter = 0;
+    uint32_t duty   = 0;
+    uint16_t plan   = 0;
+    int plan_share  = 0;
+    int stock_uart  = 0;
+    std::vector<mac_t> ouis;
+    int c;
+
+    while((c = getopt(argc, argv, "b:cC:d:fgH:lo:pPqr:RtuwX:B:F:S:")) != -1)
+    {
+        switch(c)
+        {
+            case 'b': batch = atoi(optarg);     break;
+            case 'c': tuned = 1;                break;
+            case 'C':
+            {
+                char * s = optarg;
+                while(*s && *s != ':')
+                {
+                    int ch = strtol(s, &s, 10);
+                    if(ch < 1 || ch > CHAN_MAX || (*s && *s != ',' && *s != ':'))
+                        usage(argv[0]);
+                    plan |= 1 << ch;
+                    s += *s == ',';
+                }
+                if(*s == ':' && ((plan_share = atoi(s + 1)) < 1 || plan_share > 100))
+                    usage(argv[0]);
+                if(!plan)
+                    usage(argv[0]);
+                FEATURE_CHANPLAN = 1;
+                break;
+            }
+            case 'd': duty = atoi(optarg);      break;
+            case 'f': full = 1;                 break;
+            case 'g': FEATURE_BANDHOP = 1;      break;
+            case 'H': fs = optarg;              break;
+            case 'l': no_loop = 1;              break;
+            case 'o':
+                if(!(out = fopen(optarg, "wb")))
+                {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            case 'p': FEATURE_REPORT = 1;       break;
+            case 'P': no_prefilter = 1;         break;
+            case 'q': quiet = 1;                break;
+            case 'r': repeat = atoi(optarg);    break;
+            case 'R': roundrobin = 1;           break;
+            case 't': no_tables = 1;            break;
+            case 'u': stock_uart = 1;           break;
+            case 'w': capture = 1;              break;
+            case 'X':
+            {
+                unsigned int b[3];
+                mac_t o;
+                if(sscanf(optarg, "%x:%x:%x", &b[0], &b[1], &b[2]) != 3 || ouis.size() >= FILTER_OUIS)
+                    usage(argv[0]);
+                for(int i=0; i<3; i++)
+                    o.b[i] = b[i];
+                ouis.push_back(o);
+                break;
+            }
+            case 'B':
+                if(filter.bssid_count >= CAPTURE_BSSIDS || parse_mac(optarg, filter.bssids[filter.bssid_count]) < 0)
+                    usage(argv[0]);
+                filter.bssid_count += 1;
+                break;
+            case 'F': filter.types = strtoull(optarg, NULL, 16); break;
+            case 'S': filter.snaplen = atoi(optarg);            break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind >= argc || repeat < 1 || batch < 1)
+        usage(argv[0]);
+
+    for(int i=optind; i<argc; i++)
+        if(pcap_load(argv[i], pkts) < 0)
+            return 1;
+    if(pkts.empty())
+    {
+        fprintf(stderr, "no frames to replay\n");
+        return 1;
+    }
+
+    host_serial_quiet(quiet);
+    host_serial_file(out);
+    if(!stock_uart)
+    {
+        // as ui_init() sets it up
+        Serial.begin(115200, SERIAL_8N1, SERIAL_FULL, UI_SERIAL_TXBUF);
+        Serial.setTxOverflow(SERIAL_TX_DROP);
+    }
+    if(fs)
+    {
+        host_fs_root(fs);
+        FEATURE_HISTORY = 1;
+    }
+    if(duty)
+    {
+        FEATURE_DUTY = 1;
+        duty_config(0, 0, duty, 0);
+    }
+    wifi_init();
+    if(!host_sdk.rx_cb)
+    {
+        fprintf(stderr, "wifi_init() did not register a promiscuous callback\n");
+        return 1;
+    }
+    if(roundrobin)
+        status.hop_mode = HOP_ROUNDROBIN;
+    if(plan)
+        chan_plan_set(plan, plan_share);
+    if(no_prefilter)
+        filter_set_types(0);
+    for(size_t i=0; i<ouis.size(); i++)
+        filter_ignore_oui(ouis[i].b);
+    if(capture)
+        capture_start(&filter);
+
+    // rebase capture time so the firmware sees a fresh boot
+    uint64_t t0     = pkts.front().ts_us;
+    uint64_t span   = pkts.back().ts_us - t0 + 1000;
+    uint64_t base   = 1000000;
+
+    std::vector<uint8_t>    buf;
+    std::vector<uint32_t>   lat;
+    uint64_t                busy = 0;
+    uint64_t                proc = 0;
+    uint64_t                wall = host_now_ns();
+    int                     pending = 0;
+    size_t                  missed = 0;
+    size_t                  asleep = 0;
+
+    lat.reserve(pkts.size() * repeat);
+
+    for(int r=0; r<repeat; r++)
+    {
+        for(size_t i=0; i<pkts.size(); i++)
+        {
+            const pcap_pkt_t & pkt = pkts[i];
+            uint64_t ts = pkt.ts_us >= t0 ? pkt.ts_us - t0 : 0;
+
+            host_set_time_us(base + r * span + ts);
+
+            // the radio only hears the channel it is tuned to
+            if(!host_sdk.promisc)
+                asleep += 1;
+            else if(tuned && pkt.channel && pkt.channel != host_sdk.channel)
+                missed += 1;
+            else
+            {
+                uint16_t len = build_rx(pkt, full, buf);
+
+                uint64_t start = host_now_ns();
+                host_sdk.rx_cb(buf.data(), len);
+                uint64_t d = host_now_ns() - start;
+
+                busy += d;
+                lat.push_back(d > 0xffffffff ? 0xffffffff : (uint32_t)d);
+            }
+
+            if(++pending < batch)
+                continue;
+            pending = 0;
+
+            uint64_t start = host_now_ns();
+            if(no_loop)
+                wifi_drain(RING_BATCH);
+            else
+            {
+                wifi_loop();
+                sched_loop();
+            }
+            proc += host_now_ns() - start;
+        }
+    }
+
+    // whatever is still queued
+    uint64_t start = host_now_ns();
+    while(wifi_drain(RING_SIZE))
+        ;
+    if(fs)
+        hist_sync();
+    proc += host_now_ns() - start;
+
+    wall = host_now_ns() - wall;
+    std::sort(lat.begin(), lat.end());
+
+    host_serial_quiet(0);
+    host_serial_file(NULL);
+    if(out)
+        fclose(out);
+    if(!no_tables)
+        print_tables();
+
+    printf("\nframes      %zu (%zu x %d)\n", lat.size(), pkts.size(), repeat);
+    if(tuned)
+        printf("tuned       heard %zu  missed %zu (off channel)\n", lat.size(), missed);
+    if(duty)
+    {
+        printf("asleep      %zu frames not heard, %u sleeps, %.1f s asleep\n", asleep, host_sdk.sleeps, host_sdk.sleep_us / 1e6);
+        duty_dump();
+    }
+    printf("sniff rate  %.0f frames/s (%.3f ms in wifi_sniff)\n", lat.size() * 1e9 / (busy ? busy : 1), busy / 1e6);
+    printf("loop        %.1f ns/frame (%.3f ms in main loop, timers %s)\n", (double)proc / lat.size(), proc / 1e6, no_loop ? "off" : "on");
+    printf("wall rate   %.0f frames/s (%.3f ms total)\n", lat.size() * 1e9 / (wall ? wall : 1), wall / 1e6);
+    printf("latency ns  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  max %llu\n",
+        (unsigned long long)percentile(lat, 50),
+        (unsigned long long)percentile(lat, 90),
+        (unsigned long long)percentile(lat, 99),
+        (unsigned long long)percentile(lat, 99.9),
+        (unsigned long long)lat.back());
+    printf("devices     ap %u  cli %u  fake aps %u  deauths %u\n",
+        status.aps_count, status.clients_count, status.detected_fake_aps, status.detected_pkt_deauth);
+    printf("rx ring     drops %u  peak %u/%u\n", status.ring_drops, status.ring_peak, RING_SIZE);
+    filter_dump();
+    printf("pools       ap peak %u/%u full %u  cli peak %u/%u full %u  rssi evicts %u\n",
+        status.aps_peak, (uint32_t)MAX_DEVS_APS, status.aps_full,
+        status.clients_peak, (uint32_t)MAX_DEVS_CLIENTS, status.clients_full, status.rssi_evicts);
+    essid_dump();
+    printf("probes      %u directed probe requests\n", status.probes_seen);
+    printf("sdk         chan switches %u  phy switches %u  pkts sent %u\n", host_sdk.chan_switches, host_sdk.phy_switches, host_sdk.pkt_sent);
+    if(capture)
+        printf("capture     frames %u  sent %u  drops %u  filtered %u\n",
+            status.capture_frames, status.capture_sent, status.capture_drops, status.capture_filtered);
+    printf("serial      %llu bytes (report %u)  dropped %llu  blocked %.1f ms (max %.1f ms)  report waits %u\n",
+        (unsigned long long)host_uart.bytes, status.report_bytes, (unsigned long long)host_uart.dropped,
+        host_uart.blocked_ns / 1e6, host_uart.blocked_max / 1e6, status.report_waits);
+
+    if(!no_loop)
+    {
+        printf("\n");
+        sched_dump();
+        printf("\n");
+        chan_dump();
+        printf("\n");
+        detect_dump();
+    }
+#ifdef APW_PROF
+    printf("\n");
+    prof_dump();
+#endif
+    if(fs)
+    {
+        printf("\n");
+        hist_dump();
+        printf("spiffs      %llu writes  %llu bytes written  %llu read\n",
+            (unsigned long long)host_fs.writes, (unsigned long long)host_fs.bytes_written,
+            (unsigned long long)host_fs.bytes_read);
+    }
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/report_decode.cpp                                     //
+// Description : serial report stream -> csv / json                         //
+// ======================================================================== //
+
+#include "report_parse.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+
+typedef struct decode_t
+{
+    int                                 json;
+    int                                 state_only;     // print the final tables, not the events
+    report_begin_t                      begin;          // report being decoded
+    uint32_t                            reports;
+    std::map<uint64_t, report_rec_t>    aps;
+    std::map<uint64_t, report_rec_t>    clients;
+} decode_t;
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-j] [-s] [file]\n"
+        "  -j    json lines (default: csv)\n"
+        "  -s    only print the device tables as of the end of the stream\n"
+        "reads stdin without file, text between frames is ignored\n", prog);
+    exit(1);
+}
+
+static uint64_t mac_key(const uint8_t * mac)
+{
+    uint64_t k = 0;
+    for(int i=0; i<6; i++)
+        k = (k << 8) | mac[i];
+    return k;
+}
+
+static std::string mac_str(const uint8_t * mac)
+{
+    char tmp[18];
+    snprintf(tmp, sizeof(tmp), "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return tmp;
+}
+
+static std::string csv_str(const char * s)
+{
+    std::string r = "\"";
+    for(; *s; s++)
+        r += *s == '"' ? std::string("\"\"") : std::string(1, *s);
+    return r + "\"";
+}
+
+static std::string json_str(const char * s)
+{
+    std::string r = "\"";
+    for(; *s; s++)
+    {
+        char tmp[8];
+        if(*s == '"' || *s == '\\')
+            r += std::string("\\") + *s;
+        else if((uint8_t)*s < 0x20)
+        {
+            snprintf(tmp, sizeof(tmp), "\\u%04x", (uint8_t)*s);
+            r += tmp;
+        }
+        else
+            r += *s;
+    }
+    return r + "\"";
+}
+
+static const char * event_name(const report_rec_t * rec)
+{
+    switch(rec->type)
+    {
+        case REPORT_R_AP:       return rec->flags & REPORT_NEW ? "ap_new" : "ap";
+        case REPORT_R_CLI:      return rec->flags & REPORT_NEW ? "cli_new" : "cli";
+        case REPORT_R_AP_GONE:  return "ap_gone";
+        case REPORT_R_CLI_GONE: return "cli_gone";
+        case REPORT_R_CHAN:     return "chan";
+        case REPORT_R_TASK:     return "task";
+    }
+    return "?";
+}
+
+static void print_dev(decode_t * d, const char * event, const report_rec_t * rec)
+{
+    static const uint8_t zero[6] = {};
+    char vendor[9] = {};
+    int  has_bssid = memcmp(rec->bssid, zero, 6) != 0;
+
+    search_vendor((uint8_t *)rec->mac, vendor);
+
+    if(d->json)
+    {
+        printf("{\"report\":%u,\"uptime\":%u,\"event\":\"%s\",\"mac\":\"%s\",\"vendor\":%s",
+            d->begin.id, d->begin.uptime, event, mac_str(rec->mac).c_str(), json_str(vendor).c_str());
+        if(rec->type == REPORT_R_AP)
+            printf(",\"essid\":%s,\"channel\":%u,\"rssi\":%d,\"enc\":%u,\"ht\":%u,\"clients\":%u,\"beacons\":%u",
+                json_str(rec->name).c_str(), rec->channel, rec->rssi, rec->enc, rec->ht, rec->clients, rec->count);
+        if(rec->type == REPORT_R_CLI)
+            printf(",\"bssid\":%s,\"rssi\":%d,\"packets\":%u",
+                has_bssid ? ("\"" + mac_str(rec->bssid) + "\"").c_str() : "null", rec->rssi, rec->count);
+        printf("}\n");
+        return;
+    }
+
+    if(rec->type == REPORT_R_AP)
+        printf("%u,%u,%s,%s,,%u,%d,%u,%u,%u,%u,%s,%s\n",
+            d->begin.id, d->begin.uptime, event, mac_str(rec->mac).c_str(),
+            rec->channel, rec->rssi, rec->enc, rec->ht, rec->clients, rec->count,
+            csv_str(vendor).c_str(), csv_str(rec->name).c_str());
+    else if(rec->type == REPORT_R_CLI)
+        printf("%u,%u,%s,%s,%s,,%d,,,,%u,%s,\n",
+            d->begin.id, d->begin.uptime, event, mac_str(rec->mac).c_str(),
+            has_bssid ? mac_str(rec->bssid).c_str() : "",
+            rec->rssi, rec->count, csv_str(vendor).c_str());
+    else
+        printf("%u,%u,%s,%s,,,,,,,,%s,\n",
+            d->begin.id, d->begin.uptime, event, mac_str(rec->mac).c_str(), csv_str(vendor).c_str());
+}
+
+static void print_stats(decode_t * d, const report_rec_t * rec)
+{
+    if(!d->json)
+        return;
+
+    if(rec->type == REPORT_R_CHAN)
+        printf("{\"report\":%u,\"uptime\":%u,\"event\":\"chan\",\"channel\":%u,\"frames\":%u,\"devs\":%u,\"time\":%u,"
+            "\"fps\":%.1f,\"nps\":%.1f,\"dwell\":%u,\"gap\":%u}\n",
+            d->begin.id, d->begin.uptime, rec->channel, rec->frames, rec->devs, rec->time,
+            rec->fps / 16.0, rec->nps / 16.0, rec->dwell, rec->gap);
+    else
+        printf("{\"report\":%u,\"uptime\":%u,\"event\":\"task\",\"task\":%s,\"period\":%u,\"runs\":%u,\"skips\":%u,"
+            "\"late_max\":%u,\"cost_avg\":%u,\"cost_max\":%u}\n",
+            d->begin.id, d->begin.uptime, json_str(rec->name).c_str(), rec->period, rec->runs, rec->skips,
+            rec->late_max, rec->cost_avg, rec->cost_max);
+}
+
+static void on_frame(void * ctx, uint8_t type, uint8_t seq, const uint8_t * payload, size_t len)
+{
+    decode_t * d = (decode_t *)ctx;
+    report_rec_t rec;
+    report_end_t end;
+    size_t off = 0;
+
+    switch(type)
+    {
+        case REPORT_T_BEGIN:
+            if(report_parse_begin(payload, len, &d->begin) < 0)
+                return;
+            d->reports += 1;
+            if(d->begin.flags & REPORT_F_FULL)
+            {
+                d->aps.clear();
+                d->clients.clear();
+            }
+            if(d->json && !d->state_only)
+                printf("{\"report\":%u,\"uptime\":%u,\"event\":\"begin\",\"full\":%d,\"aps\":%u,\"clients\":%u,"
+                    "\"pkt_recv\":%u,\"ring_drops\":%u,\"channel\":%u,\"alerts\":%u}\n",
+                    d->begin.id, d->begin.uptime, d->begin.flags & REPORT_F_FULL, d->begin.aps, d->begin.clients,
+                    d->begin.pkt_recv, d->begin.ring_drops, d->begin.channel, d->begin.alerts);
+            break;
+
+        case REPORT_T_DEVS:
+            while(report_next_rec(payload, len, &off, &rec) == 0)
+            {
+                uint64_t k = mac_key(rec.mac);
+
+                if(rec.type == REPORT_R_AP)
+                    d->aps[k] = rec;
+                else if(rec.type == REPORT_R_CLI)
+                    d->clients[k] = rec;
+                else if(rec.type == REPORT_R_AP_GONE)
+                    d->aps.erase(k);
+                else if(rec.type == REPORT_R_CLI_GONE)
+                    d->clients.erase(k);
+
+                if(d->state_only)
+                    continue;
+                if(rec.type == REPORT_R_CHAN || rec.type == REPORT_R_TASK)
+                    print_stats(d, &rec);
+                else
+                    print_dev(d, event_name(&rec), &rec);
+            }
+            break;
+
+        case REPORT_T_END:
+            if(report_parse_end(payload, len, &end) < 0)
+                return;
+            if(d->json && !d->state_only)
+                printf("{\"report\":%u,\"event\":\"end\",\"records\":%u,\"overruns\":%u}\n",
+                    end.id, end.records, end.overruns);
+            break;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    decode_t d = {};
+    report_parser_t parser;
+    uint8_t buf[4096];
+    FILE * f = stdin;
+    size_t n;
+    int c;
+
+    while((c = getopt(argc, argv, "js")) != -1)
+    {
+        switch(c)
+        {
+            case 'j': d.json = 1;           break;
+            case 's': d.state_only = 1;     break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind + 1 < argc)
+        usage(argv[0]);
+    if(optind < argc && !(f = fopen(argv[optind], "rb")))
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+
+    if(!d.json)
+        printf("report,uptime,event,mac,bssid,channel,rssi,enc,ht,clients,count,vendor,essid\n");
+
+    report_parser_init(&parser);
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        report_parser_feed(&parser, buf, n, on_frame, &d);
+
+    if(d.state_only)
+    {
+        for(auto & it : d.aps)
+            print_dev(&d, "ap", &it.second);
+        for(auto & it : d.clients)
+            print_dev(&d, "cli", &it.second);
+    }
+
+    fprintf(stderr, "reports %u  frames %llu  lost %llu  crc errors %llu  skipped bytes %llu  aps %zu  clients %zu\n",
+        d.reports, (unsigned long long)parser.frames, (unsigned long long)parser.lost,
+        (unsigned long long)parser.crc_errors, (unsigned long long)parser.skipped,
+        d.aps.size(), d.clients.size());
+
+    return 0;
+}
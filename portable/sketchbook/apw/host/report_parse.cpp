@@ -0,0 +1,211 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/report_parse.cpp                                      //
+// Description : reader side of the binary serial report (see ../report.h)  //
+// ======================================================================== //
+
+#include "report_parse.h"
+
+#include <string.h>
+
+
+// ========================================================================= //
+// framing
+// ========================================================================= //
+void report_parser_init(report_parser_t * p)
+{
+    memset(p, 0, sizeof(*p));
+}
+
+static void drop(report_parser_t * p, size_t n)
+{
+    memmove(p->buf, p->buf + n, p->len - n);
+    p->len -= n;
+}
+
+void report_parser_feed(report_parser_t * p, const uint8_t * data, size_t len, report_frame_cb cb, void * ctx)
+{
+    for(size_t i=0; i<len; i++)
+    {
+        p->buf[p->len++] = data[i];
+
+        while(p->len)
+        {
+            // hunt for the sync bytes
+            if(p->buf[0] != REPORT_SYNC0 || (p->len > 1 && p->buf[1] != REPORT_SYNC1))
+            {
+                p->skipped += 1;
+                drop(p, 1);
+                continue;
+            }
+            if(p->len < REPORT_HDR_LEN)
+                break;
+
+            size_t plen = p->buf[4];
+            size_t flen = REPORT_HDR_LEN + plen + 2;
+            if(plen > REPORT_PAYLOAD_MAX)
+            {
+                p->crc_errors += 1;
+                p->skipped += 1;
+                drop(p, 1);
+                continue;
+            }
+            if(p->len < flen)
+                break;
+
+            uint16_t crc = p->buf[flen - 2] | (p->buf[flen - 1] << 8);
+            if(crc != report_crc16(p->buf + 2, 3 + plen, 0xffff))
+            {
+                // false sync, retry from the next byte
+                p->crc_errors += 1;
+                p->skipped += 1;
+                drop(p, 1);
+                continue;
+            }
+
+            uint8_t seq = p->buf[3];
+            if(p->have_seq)
+                p->lost += (uint8_t)(seq - p->seq - 1);
+            p->have_seq = 1;
+            p->seq = seq;
+            p->frames += 1;
+
+            if(cb)
+                cb(ctx, p->buf[2], seq, p->buf + REPORT_HDR_LEN, plen);
+            drop(p, flen);
+        }
+    }
+}
+
+
+// ========================================================================= //
+// payloads
+// ========================================================================= //
+static inline uint16_t get_u16(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int report_next_rec(const uint8_t * payload, size_t len, size_t * off, report_rec_t * rec)
+{
+    const uint8_t * p = payload + *off;
+    size_t left = len - *off;
+    size_t n, l;
+
+    if(*off >= len)
+        return -1;
+
+    memset(rec, 0, sizeof(*rec));
+    rec->type = p[0];
+
+    switch(rec->type)
+    {
+        case REPORT_R_AP:
+            n = 1 + 1 + 6 + 5 + 4 + 1;
+            if(left < n || left < n + p[n - 1] || p[n - 1] > 32)
+                return -1;
+            rec->flags      = p[1];
+            memcpy(rec->mac, p + 2, 6);
+            rec->channel    = p[8];
+            rec->rssi       = p[9];
+            rec->enc        = p[10];
+            rec->ht         = p[11];
+            rec->clients    = p[12];
+            rec->count      = get_u32(p + 13);
+            l = p[17];
+            memcpy(rec->name, p + 18, l);
+            n += l;
+            break;
+
+        case REPORT_R_CLI:
+            n = 1 + 1 + 6 + 6 + 1 + 4;
+            if(left < n)
+                return -1;
+            rec->flags      = p[1];
+            memcpy(rec->mac, p + 2, 6);
+            memcpy(rec->bssid, p + 8, 6);
+            rec->rssi       = p[14];
+            rec->count      = get_u32(p + 15);
+            break;
+
+        case REPORT_R_AP_GONE:
+        case REPORT_R_CLI_GONE:
+            n = 1 + 6;
+            if(left < n)
+                return -1;
+            memcpy(rec->mac, p + 1, 6);
+            break;
+
+        case REPORT_R_CHAN:
+            n = 1 + 1 + 12 + 8;
+            if(left < n)
+                return -1;
+            rec->channel    = p[1];
+            rec->frames     = get_u32(p + 2);
+            rec->devs       = get_u32(p + 6);
+            rec->time       = get_u32(p + 10);
+            rec->fps        = get_u16(p + 14);
+            rec->nps        = get_u16(p + 16);
+            rec->dwell      = get_u16(p + 18);
+            rec->gap        = get_u16(p + 20);
+            break;
+
+        case REPORT_R_TASK:
+            n = 1 + 1 + 2 + 4 + 8 + 1;
+            if(left < n || left < n + p[n - 1] || p[n - 1] > 32)
+                return -1;
+            rec->id         = p[1];
+            rec->period     = get_u16(p + 2);
+            rec->runs       = get_u32(p + 4);
+            rec->skips      = get_u16(p + 8);
+            rec->late_max   = get_u16(p + 10);
+            rec->cost_avg   = get_u16(p + 12);
+            rec->cost_max   = get_u16(p + 14);
+            l = p[16];
+            memcpy(rec->name, p + 17, l);
+            n += l;
+            break;
+
+        default:
+            return -1;
+    }
+
+    *off += n;
+    return 0;
+}
+
+int report_parse_begin(const uint8_t * p, size_t len, report_begin_t * b)
+{
+    if(len < 22)
+        return -1;
+
+    b->id           = get_u16(p);
+    b->flags        = p[2];
+    b->uptime       = get_u32(p + 3);
+    b->aps          = get_u16(p + 7);
+    b->clients      = get_u16(p + 9);
+    b->pkt_recv     = get_u32(p + 11);
+    b->ring_drops   = get_u32(p + 15);
+    b->channel      = p[19];
+    b->hop_mode     = p[20];
+    b->alerts       = p[21];
+    return 0;
+}
+
+int report_parse_end(const uint8_t * p, size_t len, report_end_t * e)
+{
+    if(len < 6)
+        return -1;
+
+    e->id           = get_u16(p);
+    e->records      = get_u16(p + 2);
+    e->overruns     = get_u16(p + 4);
+    return 0;
+}
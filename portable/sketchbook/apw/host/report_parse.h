@@ -0,0 +1,99 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/report_parse.h                                        //
+// Description : reader side of the binary serial report (see ../report.h)  //
+// ======================================================================== //
+
+#ifndef _HOST_REPORT_PARSE_H
+#define _HOST_REPORT_PARSE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "report.h"
+
+// called for every frame with a valid crc
+typedef void (*report_frame_cb)(void * ctx, uint8_t type, uint8_t seq, const uint8_t * payload, size_t len);
+
+// byte stream -> frames, skips whatever is not a valid frame (text logs, line noise)
+typedef struct report_parser_t
+{
+    uint8_t     buf[REPORT_FRAME_MAX];
+    size_t      len;
+
+    uint64_t    frames;         // good frames
+    uint64_t    crc_errors;     // headers whose crc did not match
+    uint64_t    skipped;        // bytes outside of frames
+    uint64_t    lost;           // frames missing according to seq
+    int         have_seq;
+    uint8_t     seq;
+} report_parser_t;
+
+void    report_parser_init(report_parser_t * p);
+void    report_parser_feed(report_parser_t * p, const uint8_t * data, size_t len, report_frame_cb cb, void * ctx);
+
+// one record of a REPORT_T_DEVS frame, fields unused by a record type are zero
+typedef struct report_rec_t
+{
+    uint8_t     type;           // REPORT_R_*
+    uint8_t     flags;          // REPORT_NEW / REPORT_CHANGED
+    uint8_t     mac[6];
+    uint8_t     bssid[6];       // client's ap
+    uint8_t     channel;
+    int8_t      rssi;
+    uint8_t     enc;
+    uint8_t     ht;
+    uint8_t     clients;
+    uint32_t    count;          // ap beacons, client packets
+    char        name[33];       // ap essid, task name
+
+    // REPORT_R_CHAN
+    uint32_t    frames;
+    uint32_t    devs;
+    uint32_t    time;
+    uint16_t    fps;            // x16
+    uint16_t    nps;            // x16
+    uint16_t    dwell;
+    uint16_t    gap;
+
+    // REPORT_R_TASK
+    uint8_t     id;
+    uint16_t    period;
+    uint32_t    runs;
+    uint16_t    skips;
+    uint16_t    late_max;
+    uint16_t    cost_avg;
+    uint16_t    cost_max;
+} report_rec_t;
+
+// decode the record at *off, advances *off. returns 0, -1 at the end or on a bad record
+int     report_next_rec(const uint8_t * payload, size_t len, size_t * off, report_rec_t * rec);
+
+// REPORT_T_BEGIN / REPORT_T_END payloads
+typedef struct report_begin_t
+{
+    uint16_t    id;
+    uint8_t     flags;
+    uint32_t    uptime;
+    uint16_t    aps;
+    uint16_t    clients;
+    uint32_t    pkt_recv;
+    uint32_t    ring_drops;
+    uint8_t     channel;
+    uint8_t     hop_mode;
+    uint8_t     alerts;         // deauth | beacon << 1 | karma << 2
+} report_begin_t;
+
+typedef struct report_end_t
+{
+    uint16_t    id;
+    uint16_t    records;
+    uint16_t    overruns;
+} report_end_t;
+
+int     report_parse_begin(const uint8_t * payload, size_t len, report_begin_t * b);
+int     report_parse_end(const uint8_t * payload, size_t len, report_end_t * e);
+
+#endif
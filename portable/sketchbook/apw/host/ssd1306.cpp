@@ -0,0 +1,200 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/ssd1306.cpp                                           //
+// Description : Wire stand-in & 128x32 ssd1306 model for host builds       //
+// ======================================================================== //
+
+#include "host.h"
+#include "Wire.h"
+
+#include <string.h>
+
+TwoWire         Wire;
+host_oled_t     host_oled = {};
+
+
+// ========================================================================= //
+// controller
+// ========================================================================= //
+
+// parameter bytes following a command, for the ones the OLED library sends
+static uint8_t cmd_args(uint8_t c)
+{
+    switch(c)
+    {
+        case 0x20: case 0x81: case 0x8d: case 0xa8: case 0xd3:
+        case 0xd5: case 0xd9: case 0xda: case 0xdb:
+            return 1;
+        case 0x21: case 0x22:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+// page addressing only, which is what init_OLED() sets
+static void oled_command(uint8_t c)
+{
+    if(host_oled.args)
+    {
+        host_oled.args -= 1;
+        return;
+    }
+
+    if(c >= 0xb0 && c <= 0xb7)
+        host_oled.page = (c & 0x07) % HOST_OLED_PAGES;
+    else if(c <= 0x0f)
+        host_oled.col = (host_oled.col & 0xf0) | c;
+    else if(c >= 0x10 && c <= 0x1f)
+        host_oled.col = ((c & 0x0f) << 4) | (host_oled.col & 0x0f);
+    else if(c == 0xae || c == 0xaf)
+        host_oled.on = c & 1;
+    else
+        host_oled.args = cmd_args(c);
+}
+
+// the column pointer wraps within the page
+static void oled_data(uint8_t d)
+{
+    host_oled.ram[host_oled.page * HOST_OLED_WIDTH + (host_oled.col % HOST_OLED_WIDTH)] = d;
+    host_oled.col = (host_oled.col + 1) % HOST_OLED_WIDTH;
+    host_oled.pixels += 1;
+}
+
+// control byte: bit 7 = one byte follows then another control byte, else a stream to the end
+// bit 6 = data (gddram) rather than commands
+static void oled_transaction(const uint8_t * buf, size_t len)
+{
+    size_t i = 0;
+
+    while(i < len)
+    {
+        uint8_t ctl = buf[i++];
+        size_t  end = ctl & 0x80 ? (i + 1 < len ? i + 1 : len) : len;
+
+        for(; i<end; i++)
+        {
+            if(ctl & 0x40)
+                oled_data(buf[i]);
+            else
+                oled_command(buf[i]);
+        }
+    }
+}
+
+
+// ========================================================================= //
+// Wire
+// ========================================================================= //
+
+void TwoWire::begin(int sda, int scl)
+{
+    transmitting = 0;
+    len = 0;
+}
+
+void TwoWire::setClock(uint32_t freq)
+{
+    host_oled.clock = freq;
+}
+
+void TwoWire::beginTransmission(uint8_t addr)
+{
+    address = addr;
+    transmitting = 1;
+    len = 0;
+}
+
+uint8_t TwoWire::endTransmission(void)
+{
+    // no one else on the bus: anything but the screen is a nack on the address
+    host_oled.transactions += 1;
+    host_oled.bytes += 1 + len;
+    transmitting = 0;
+    if(address != HOST_OLED_ADDR)
+        return 2;
+
+    oled_transaction(buf, len);
+    len = 0;
+    return 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if(!transmitting)
+        return 0;
+    if(len >= BUFFER_LENGTH)
+    {
+        host_oled.dropped += 1;
+        return 0;
+    }
+    buf[len++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t * data, size_t quantity)
+{
+    for(size_t i=0; i<quantity; i++)
+        if(!write(data[i]))
+            return i;
+    return quantity;
+}
+
+
+// ========================================================================= //
+// host control
+// ========================================================================= //
+
+int host_oled_pixel(int x, int y)
+{
+    if(x < 0 || x >= HOST_OLED_WIDTH || y < 0 || y >= HOST_OLED_PAGES * 8)
+        return 0;
+    return (host_oled.ram[(y >> 3) * HOST_OLED_WIDTH + x] >> (y & 7)) & 1;
+}
+
+uint32_t host_oled_bus_us(uint64_t transactions, uint64_t bytes)
+{
+    uint32_t clock = host_oled.clock ? host_oled.clock : 100000;
+    return (uint32_t)((bytes * 9 + transactions * 2) * 1000000 / clock);
+}
+
+int host_oled_save_pbm(FILE * f)
+{
+    fprintf(f, "P1\n%d %d\n", HOST_OLED_WIDTH, HOST_OLED_PAGES * 8);
+    for(int y=0; y<HOST_OLED_PAGES * 8; y++)
+    {
+        for(int x=0; x<HOST_OLED_WIDTH; x++)
+            fputc('0' + host_oled_pixel(x, y), f);
+        fputc('\n', f);
+    }
+    return ferror(f) ? -1 : 0;
+}
+
+int host_oled_load_pbm(FILE * f, uint8_t ram[HOST_OLED_WIDTH * HOST_OLED_PAGES])
+{
+    int w, h, c;
+
+    if(fscanf(f, "P1 %d %d", &w, &h) != 2 || w != HOST_OLED_WIDTH || h != HOST_OLED_PAGES * 8)
+        return -1;
+
+    memset(ram, 0, HOST_OLED_WIDTH * HOST_OLED_PAGES);
+    for(int n=0; n<w * h; )
+    {
+        if((c = fgetc(f)) == EOF)
+            return -1;
+        if(c == '#')
+        {
+            while((c = fgetc(f)) != EOF && c != '\n');
+            continue;
+        }
+        if(c != '0' && c != '1')
+            continue;
+
+        int x = n % w, y = n / w;
+        ram[(y >> 3) * HOST_OLED_WIDTH + x] |= (c - '0') << (y & 7);
+        n++;
+    }
+    return 0;
+}
@@ -0,0 +1,94 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/Arduino.h                                       //
+// Description : minimal arduino core stand-in for host builds              //
+// ======================================================================== //
+
+#ifndef _HOST_ARDUINO_H
+#define _HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgmspace.h"
+
+#define ICACHE_RAM_ATTR
+
+#define F_CPU           80000000L   // cycle counts as at the default clock
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define D6              12
+#define D7              13
+#define D8              15
+
+// time is virtual, driven by the host program (see host.h)
+uint32_t millis(void);
+uint32_t micros(void);
+void     delay(uint32_t ms);
+void     yield(void);
+
+long     random(long max);
+long     random(long min, long max);
+void     randomSeed(unsigned long seed);
+
+void     pinMode(uint8_t pin, uint8_t mode);
+void     digitalWrite(uint8_t pin, uint8_t val);
+int      digitalRead(uint8_t pin);
+
+#define SERIAL_TX_BUFFER_SIZE   256
+#define SERIAL_8N1              0x1c
+#define SERIAL_FULL             0
+#define SERIAL_TX_BLOCK         0
+#define SERIAL_TX_DROP          1
+
+// serial port goes to stdout (or nowhere, see host_serial_quiet)
+class HardwareSerial
+{
+    public:
+        void    begin(unsigned long baud, uint8_t config = SERIAL_8N1, uint8_t mode = SERIAL_FULL,
+                    size_t tx_size = SERIAL_TX_BUFFER_SIZE);
+        void    setTxOverflow(uint8_t policy);
+        uint32_t txDropped(void) const;
+        uint32_t txWaits(void) const;
+        size_t  printf(const char * fmt, ...) __attribute__((format(printf, 2, 3)));
+        size_t  print(const char * s);
+        size_t  println(const char * s = "");
+        size_t  write(uint8_t c);
+        size_t  write(const uint8_t * buf, size_t len);
+        void    flush(void);
+        int     available(void);
+        int     availableForWrite(void);
+        int     read(void);
+};
+
+extern HardwareSerial Serial;
+
+enum RFMode
+{
+    RF_DEFAULT      = 0,
+    RF_CAL          = 1,
+    RF_NO_CAL       = 2,
+    RF_DISABLED     = 4,
+};
+
+class EspClass
+{
+    public:
+        uint32_t getCycleCount(void);
+        uint32_t getFreeHeap(void);
+};
+
+extern EspClass ESP;
+
+#endif
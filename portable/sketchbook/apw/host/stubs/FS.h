@@ -0,0 +1,76 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/FS.h                                            //
+// Description : SPIFFS stand-in for host builds, files in a host directory //
+// ======================================================================== //
+
+#ifndef _HOST_FS_H
+#define _HOST_FS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2,
+};
+
+// an open host file, shared by the copies of a File (no <memory>: our sched.h shadows <sched.h>)
+struct host_file_t
+{
+    FILE *  f;
+    int     refs;
+};
+
+// same subset of the core's fs::File we use, copies share the open file
+class File
+{
+    public:
+        File(host_file_t * f = NULL) : _f(f) {}
+        File(const File & o) : _f(o._f) { if(_f) _f->refs += 1; }
+        File & operator=(const File & o);
+        ~File() { close(); }
+
+        size_t  write(const uint8_t * buf, size_t size);
+        size_t  read(uint8_t * buf, size_t size);
+        bool    seek(uint32_t pos, SeekMode mode);
+        size_t  position(void) const;
+        size_t  size(void) const;
+        void    close(void);
+        operator bool() const { return _f != NULL; }
+
+    protected:
+        host_file_t * _f;
+};
+
+struct FSInfo
+{
+    size_t totalBytes;
+    size_t usedBytes;
+    size_t blockSize;
+    size_t pageSize;
+    size_t maxOpenFiles;
+    size_t maxPathLength;
+};
+
+// paths map to <root>/<path with '/' -> '_'>, see host_fs_root()
+class FS
+{
+    public:
+        bool    begin(void);
+        bool    format(void);
+        bool    info(FSInfo & info);
+        File    open(const char * path, const char * mode);
+        bool    exists(const char * path);
+        bool    remove(const char * path);
+        bool    rename(const char * from, const char * to);
+};
+
+extern FS SPIFFS;
+
+#endif
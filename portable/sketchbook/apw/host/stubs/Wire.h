@@ -0,0 +1,37 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/Wire.h                                          //
+// Description : i2c stand-in for host builds, feeds the ssd1306 model      //
+// ======================================================================== //
+
+#ifndef _HOST_WIRE_H
+#define _HOST_WIRE_H
+
+#include "Arduino.h"
+
+// same tx buffer as the core, writes past it are dropped
+#define BUFFER_LENGTH 32
+
+// transactions to the oled address go to the screen model (host/ssd1306.cpp, see host.h)
+class TwoWire
+{
+    public:
+        void    begin(int sda, int scl);
+        void    setClock(uint32_t freq);
+        void    beginTransmission(uint8_t address);
+        uint8_t endTransmission(void);
+        size_t  write(uint8_t data);
+        size_t  write(const uint8_t * data, size_t quantity);
+
+    private:
+        uint8_t address;
+        uint8_t buf[BUFFER_LENGTH];
+        uint8_t len;
+        uint8_t transmitting;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,19 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/c_types.h                                       //
+// Description : esp8266 sdk types stand-in for host builds of core code    //
+// ======================================================================== //
+
+#ifndef _HOST_C_TYPES_H
+#define _HOST_C_TYPES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+
+#endif
@@ -0,0 +1,9 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/ets_sys.h                                       //
+// Description : esp8266 sdk ets_sys.h stand-in, nothing used on the host   //
+// ======================================================================== //
+
+#include "c_types.h"
@@ -0,0 +1,30 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/pgmspace.h                                      //
+// Description : flash access stand-in for host builds (plain memory)       //
+// ======================================================================== //
+
+#ifndef _HOST_PGMSPACE_H
+#define _HOST_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P                       const char *
+#define PSTR(s)                     (s)
+#define pgm_read_byte(addr)         (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)         (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr)        (*(const uint32_t *)(addr))
+#define pgm_read_byte_near(addr)    pgm_read_byte(addr)
+#define pgm_read_word_near(addr)    pgm_read_word(addr)
+#define pgm_read_dword_near(addr)   pgm_read_dword(addr)
+#define memcpy_P(dst, src, n)       memcpy((dst), (src), (n))
+#define strlen_P(s)                 strlen(s)
+#define strcpy_P(dst, src)          strcpy((dst), (src))
+#define strncpy_P(dst, src, n)      strncpy((dst), (src), (n))
+#define strcmp_P(a, b)              strcmp((a), (b))
+
+#endif
@@ -0,0 +1,47 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/stubs/user_interface.h                                //
+// Description : esp8266 sdk stand-in for host builds                       //
+// ======================================================================== //
+
+#ifndef _HOST_USER_INTERFACE_H
+#define _HOST_USER_INTERFACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+
+#define STATION_MODE    0x01
+#define SOFTAP_MODE     0x02
+
+enum phy_mode
+{
+    PHY_MODE_11B    = 1,
+    PHY_MODE_11G    = 2,
+    PHY_MODE_11N    = 3
+};
+
+typedef void (* wifi_promiscuous_cb_t)(uint8 *buf, uint16 len);
+
+bool    wifi_set_opmode(uint8 opmode);
+bool    wifi_set_phy_mode(enum phy_mode mode);
+enum phy_mode wifi_get_phy_mode(void);
+uint8   wifi_get_channel(void);
+bool    wifi_set_channel(uint8 channel);
+void    wifi_promiscuous_enable(uint8 promiscuous);
+void    wifi_set_promiscuous_rx_cb(wifi_promiscuous_cb_t cb);
+int     wifi_send_pkt_freedom(uint8 *buf, int len, bool sys_seq);
+
+bool    system_deep_sleep_set_option(uint8 option);
+void    system_deep_sleep(uint32 time_in_us);
+
+// 768 bytes in 4 byte blocks, the user part starts at block 64
+bool    system_rtc_mem_read(uint8 src_addr, void * des_addr, uint16 load_size);
+bool    system_rtc_mem_write(uint8 des_addr, const void * src_addr, uint16 save_size);
+
+#endif
@@ -0,0 +1,270 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : host/ui_frames.cpp                                         //
+// Description : screen states through ui.cpp, golden frames & i2c cost     //
+// ======================================================================== //
+
+#include "host.h"
+#include "status.h"
+#include "wifi.h"
+#include "devs.h"
+#include "detect.h"
+#include "ui.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define T0_MS           (3 * 3600000 + 17 * 60000)  // uptime of the first frame
+#define HISTORY_MS      (12 * 60000)                // rssi history built before it
+#define FRAME_MS        (1000 / 8)                  // DISPLAY_FPS
+
+static const char * golden_dir = NULL;
+static const char * out_dir = NULL;
+static int          update = 0;
+static int          failed = 0;
+static uint64_t     frame_ms;
+
+static uint8_t      ap_mac[6]  = { 0xc0, 0x25, 0xe9, 0x12, 0x34, 0x56 };
+static uint8_t      cli_mac[6] = { 0x3c, 0x5a, 0xb4, 0x65, 0x43, 0x21 };
+
+static void usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [-g dir [-u]] [-o dir]\n"
+        "  -g dir   compare every frame with dir/<frame>.pbm\n"
+        "  -u       write the frames to the -g dir instead (new golden frames)\n"
+        "  -o dir   write every frame to dir/<frame>.pbm\n", prog);
+    exit(1);
+}
+
+static void set_time_ms(uint64_t ms)
+{
+    frame_ms = ms;
+    host_set_time_us(ms * 1000);
+}
+
+static int save_frame(const char * dir, const char * name)
+{
+    char  path[256];
+    snprintf(path, sizeof(path), "%s/%s.pbm", dir, name);
+
+    FILE * f = fopen(path, "w");
+    if(!f || host_oled_save_pbm(f) < 0)
+    {
+        fprintf(stderr, "cannot write %s\n", path);
+        if(f)
+            fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+// pixels off from the golden frame, -1 without one
+static int cmp_frame(const char * name)
+{
+    char    path[256];
+    uint8_t ram[HOST_OLED_WIDTH * HOST_OLED_PAGES];
+
+    snprintf(path, sizeof(path), "%s/%s.pbm", golden_dir, name);
+    FILE * f = fopen(path, "r");
+    if(!f)
+        return -1;
+    int r = host_oled_load_pbm(f, ram);
+    fclose(f);
+    if(r < 0)
+        return -1;
+
+    int diff = 0;
+    for(size_t i=0; i<sizeof(ram); i++)
+        diff += __builtin_popcount(ram[i] ^ host_oled.ram[i]);
+    return diff;
+}
+
+// one ui_loop() tick into the state the script just set up, then the one after it
+static void frame(const char * name)
+{
+    host_oled_t a = host_oled;
+    ui_loop();
+    host_oled_t b = host_oled;
+
+    set_time_ms(frame_ms + FRAME_MS);
+    char result[32] = "";
+    if(golden_dir && update)
+        snprintf(result, sizeof(result), save_frame(golden_dir, name) < 0 ? "write error" : "updated");
+    else if(golden_dir)
+    {
+        int diff = cmp_frame(name);
+        if(diff)
+            failed += 1;
+        if(diff < 0)
+            snprintf(result, sizeof(result), "no golden");
+        else if(diff)
+            snprintf(result, sizeof(result), "FAIL %d px", diff);
+        else
+            snprintf(result, sizeof(result), "ok");
+    }
+    if(out_dir)
+        save_frame(out_dir, name);
+
+    ui_loop();
+    host_oled_t c = host_oled;
+
+    printf("%-18s %4u %6u %7u us   %4u %6u %7u us   %s\n", name,
+        (uint32_t)(b.transactions - a.transactions), (uint32_t)(b.bytes - a.bytes),
+        host_oled_bus_us(b.transactions - a.transactions, b.bytes - a.bytes),
+        (uint32_t)(c.transactions - b.transactions), (uint32_t)(c.bytes - b.bytes),
+        host_oled_bus_us(c.transactions - b.transactions, c.bytes - b.bytes), result);
+}
+
+// an ap with one client, heard for HISTORY_MS, fading in & out
+static void script_devices(void)
+{
+    uint64_t t = T0_MS - HISTORY_MS;
+    wifi_ap_t * ap = dev_ap_find(ap_mac, 1);
+    wifi_client_t * cli = dev_cli_find(cli_mac);
+
+    for(int i=0; t<T0_MS; i++, t+=250)
+    {
+        set_time_ms(t);
+        int wave = i / 16 % 40;
+        wave = wave < 20 ? wave : 40 - wave;
+        dev_ap_update(ap, -80 + wave * 2, "apw-lab", 6, AP_ENC_WPA2_PSK, 1);
+        if(i % 3 == 0)
+            dev_cli_update(cli, ap, -50 - wave);
+    }
+}
+
+// deauths on our ap, then on random bssids all over channel 11 (alert for the channel)
+static void script_deauth(int random_bssids)
+{
+    for(int i=0; i<(random_bssids ? 40 : 20); i++)
+    {
+        uint8_t mac[6] = { 0x02, 0x11, 0x22, 0x33, (uint8_t)(i >> 8), (uint8_t)i };
+        set_time_ms(frame_ms + 20);
+        detect_deauth(random_bssids ? mac : ap_mac, random_bssids ? 11 : 6);
+    }
+    detect_tick();
+}
+
+static void script(void)
+{
+    // screen init, intro & clear: not a frame, only the cost
+    set_time_ms(T0_MS - HISTORY_MS - 2000);
+    ui_init();
+    printf("%-18s %4u %6u %7u us\n", "ui_init", (uint32_t)host_oled.transactions, (uint32_t)host_oled.bytes,
+        host_oled_bus_us(host_oled.transactions, host_oled.bytes));
+
+    detect_init();
+    wifi_set_channel(6);
+    status.phy  = 3;
+    status.mode = MODE_DETECT;
+    frame("scan_boot");
+
+    script_devices();
+    set_time_ms(T0_MS);
+
+    frame("scan");
+
+    status.ui_level = 1;
+    status.cur_ap   = dev_ap_find(ap_mac, 0);
+    frame("ap");
+
+    status.ui_level = 2;
+    status.ui_idx   = 3;
+    frame("ap_menu");
+
+    status.ui_level = 3;
+    status.ui_idx   = 0;
+    status.cur_cli  = dev_cli_find(cli_mac);
+    frame("client");
+
+    status.ui_level = 4;
+    frame("ap_rssi");
+
+    status.ui_level = 5;
+    frame("client_rssi");
+
+    // alerts take the whole screen whatever the level, several take turns every 2 s
+    script_deauth(0);
+    set_time_ms(frame_ms / 4000 * 4000 + 4000);
+    frame("alert_deauth");
+
+    script_deauth(1);
+    set_time_ms(frame_ms / 4000 * 4000 + 4000);
+    frame("alert_1_of_2");
+    set_time_ms(frame_ms + 2000);
+    frame("alert_2_of_2");
+
+    set_time_ms(frame_ms + DETECT_WINDOW_MS + DETECT_HOLD_MS);
+    detect_tick();
+    frame("alert_over");
+
+    // the ap leaves the table while on screen, then its client
+    devs_ap_del(status.cur_ap);
+    status.ui_level = 1;
+    frame("lost_ap");
+
+    status.ui_level = 4;
+    frame("lost_ap_rssi");
+
+    devs_cli_del(status.cur_cli);
+    status.ui_level = 3;
+    frame("no_client");
+
+    status.ui_level = 5;
+    frame("lost_client_rssi");
+
+    status.ui_level = 0;
+    frame("scan_empty");
+
+    status.mode             = MODE_BEACON;
+    status.spoofed_aps      = 1234;
+    status.spoofed_clients  = 56789;
+    status.pkt_sent         = 123456;
+    status.pkt_errs         = 12;
+    frame("beacon");
+
+    status.mode             = MODE_DEAUTH;
+    status.deauth_mode      = 1;
+    memcpy(status.deauth_mac, ap_mac, 6);
+    status.attack_time      = frame_ms;
+    frame("deauth");
+}
+
+int main(int argc, char ** argv)
+{
+    int c;
+    while((c = getopt(argc, argv, "g:o:u")) != -1)
+    {
+        switch(c)
+        {
+            case 'g': golden_dir = optarg;  break;
+            case 'o': out_dir = optarg;     break;
+            case 'u': update = 1;           break;
+            default:  usage(argv[0]);
+        }
+    }
+    if(optind != argc || (update && !golden_dir))
+        usage(argv[0]);
+
+    host_serial_quiet(1);
+
+    printf("%-18s %4s %6s %10s   %4s %6s %10s\n", "frame", "txn", "bytes", "bus", "txn", "next", "bus");
+    script();
+
+    // what a flush(true) after each draw would cost
+    host_oled_t a = host_oled;
+    display.flush(true);
+    printf("\n%-18s %4u %6u %7u us\n", "full refresh", (uint32_t)(host_oled.transactions - a.transactions),
+        (uint32_t)(host_oled.bytes - a.bytes), host_oled_bus_us(host_oled.transactions - a.transactions, host_oled.bytes - a.bytes));
+    printf("%-18s %u bytes past the wire buffer, i2c at %u khz\n", "dropped", (uint32_t)host_oled.dropped, host_oled.clock / 1000);
+
+    if(golden_dir && !update)
+        printf("\n%s\n", failed ? "golden frames: MISMATCH" : "golden frames: ok");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,195 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : ie.cpp                                                     //
+// Description : 802.11 information elements, iterator & beacon decoding    //
+// ======================================================================== //
+
+#include "ie.h"
+#include "wifi.h"
+
+#include <string.h>
+
+#define OUI_IEEE            0x000fac    // rsn suites
+#define OUI_MSFT            0x0050f2    // wpa1 suites & element
+
+static inline uint32_t ie_oui(const uint8_t * s)
+{
+    return (s[0] << 16) | (s[1] << 8) | s[2];
+}
+
+
+// ========================================================================= //
+// rsn / wpa suites
+// ========================================================================= //
+
+static uint8_t ie_cipher(const uint8_t * s, uint32_t oui)
+{
+    if(ie_oui(s) != oui)
+        return IE_C_OTHER;
+
+    switch(s[3])
+    {
+        case 1: case 5:     return IE_C_WEP;
+        case 2:             return IE_C_TKIP;
+        case 4: case 10:    return IE_C_CCMP;
+        case 8: case 9:     return IE_C_GCMP;
+        default:            return IE_C_OTHER;
+    }
+}
+
+static uint8_t ie_akm(const uint8_t * s, uint32_t oui)
+{
+    if(ie_oui(s) != oui)
+        return IE_AKM_OTHER;
+
+    // wpa1 only knows 1 & 2, they mean the same there
+    switch(s[3])
+    {
+        case 1: case 3: case 5: case 11: case 12: case 13:  return IE_AKM_EAP;
+        case 2: case 4: case 6:                             return IE_AKM_PSK;
+        case 8: case 9: case 24: case 25:                   return IE_AKM_SAE;
+        case 18:                                            return IE_AKM_OWE;
+        default:                                            return IE_AKM_OTHER;
+    }
+}
+
+// version, group suite, pairwise suites, akm suites. fields left out at the end keep the defaults
+static void ie_suites(const uint8_t * p, size_t len, uint32_t oui, uint8_t def, uint8_t * group, uint8_t * pairwise, uint8_t * akm)
+{
+    size_t n;
+
+    *group      = def;
+    *pairwise   = def;
+    *akm        = IE_AKM_EAP;
+
+    if(len < 2 + 4)
+        return;
+    *group = ie_cipher(p + 2, oui);
+    p += 6;
+    len -= 6;
+
+    if(len < 2)
+        return;
+    n = p[0] | (p[1] << 8);
+    if(len - 2 < n * 4)
+        return;
+    *pairwise = 0;
+    for(p += 2, len -= 2; n; n--, p += 4, len -= 4)
+        *pairwise |= ie_cipher(p, oui);
+
+    if(len < 2)
+        return;
+    n = p[0] | (p[1] << 8);
+    if(len - 2 < n * 4)
+        return;
+    *akm = 0;
+    for(p += 2; n; n--, p += 4)
+        *akm |= ie_akm(p, oui);
+}
+
+
+// ========================================================================= //
+// element handlers, return 1 if the element carried the field
+// ========================================================================= //
+
+typedef int (*ie_fn_t)(const ie_t * ie, ie_info_t * info);
+
+static int ie_ssid(const ie_t * ie, ie_info_t * info)
+{
+    info->ssid      = ie->data;
+    info->ssid_len  = ie->len;
+    return 1;
+}
+
+static int ie_ds(const ie_t * ie, ie_info_t * info)
+{
+    if(ie->len < 1)
+        return 0;
+    info->channel = ie->data[0];
+    return 1;
+}
+
+static int ie_rsn(const ie_t * ie, ie_info_t * info)
+{
+    ie_suites(ie->data, ie->len, OUI_IEEE, IE_C_CCMP, &info->rsn_group, &info->rsn_pairwise, &info->rsn_akm);
+    return 1;
+}
+
+// only the wpa1 one (00:50:f2 type 1), wps & co use the same id
+static int ie_vendor(const ie_t * ie, ie_info_t * info)
+{
+    if(ie->len < 4 || ie_oui(ie->data) != OUI_MSFT || ie->data[3] != 1)
+        return 0;
+
+    ie_suites(ie->data + 4, ie->len - 4, OUI_MSFT, IE_C_TKIP, &info->wpa_group, &info->wpa_pairwise, &info->wpa_akm);
+    return 1;
+}
+
+static const struct
+{
+    uint8_t     field;
+    ie_fn_t     fn;                 // NULL: being there is enough
+} ie_table[] =
+{
+    { IE_F_SSID,    ie_ssid   },
+    { IE_F_DS,      ie_ds     },
+    { IE_F_RSN,     ie_rsn    },
+    { IE_F_HT,      NULL      },
+    { IE_F_VHT,     NULL      },
+    { IE_F_WPA,     ie_vendor },
+};
+
+// element id -> ie_table slot, -1 for the ones we skip
+static inline int ie_slot(uint8_t id)
+{
+    switch(id)
+    {
+        case IE_SSID:       return 0;
+        case IE_DS:         return 1;
+        case IE_RSN:        return 2;
+        case IE_HT_CAPA:    return 3;
+        case IE_VHT_CAPA:   return 4;
+        case IE_VENDOR:     return 5;
+        default:            return -1;
+    }
+}
+
+
+// ========================================================================= //
+// decoding
+// ========================================================================= //
+
+uint8_t ie_parse(const uint8_t * buf, size_t len, uint8_t want, ie_info_t * info)
+{
+    ie_iter_t   it;
+    ie_t        ie;
+
+    memset(info, 0, sizeof(*info));
+    ie_begin(&it, buf, len);
+
+    // first element of each kind wins, fields not wanted are not decoded
+    while((info->found & want) != want && ie_next(&it, &ie))
+    {
+        int i = ie_slot(ie.id);
+        if(i < 0)
+            continue;
+
+        uint8_t field = ie_table[i].field;
+        if((want & ~info->found & field) && (!ie_table[i].fn || ie_table[i].fn(&ie, info)))
+            info->found |= field;
+    }
+
+    return info->found;
+}
+
+uint8_t ie_enc(const ie_info_t * info, int privacy)
+{
+    // enterprise only when no personal akm is offered next to 802.1x
+    if(info->found & IE_F_RSN)
+        return (info->rsn_akm & IE_AKM_EAP) && !(info->rsn_akm & (IE_AKM_PSK | IE_AKM_SAE)) ? AP_ENC_WPA2_MGT : AP_ENC_WPA2_PSK;
+    if(info->found & IE_F_WPA)
+        return (info->wpa_akm & IE_AKM_EAP) && !(info->wpa_akm & IE_AKM_PSK) ? AP_ENC_WPA1_MGT : AP_ENC_WPA1_PSK;
+    return privacy ? AP_ENC_WEP : AP_ENC_OPEN;
+}
@@ -0,0 +1,101 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : ie.h                                                       //
+// Description : 802.11 information elements, iterator & beacon decoding    //
+// ======================================================================== //
+
+#ifndef _IE_H
+#define _IE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// element ids we decode
+#define IE_SSID             0
+#define IE_DS               3
+#define IE_HT_CAPA          45
+#define IE_RSN              48
+#define IE_VHT_CAPA         191
+#define IE_VENDOR           221
+
+// fields found by ie_parse(), also what the caller wants
+#define IE_F_SSID           0x01
+#define IE_F_DS             0x02
+#define IE_F_HT             0x04
+#define IE_F_VHT            0x08
+#define IE_F_RSN            0x10
+#define IE_F_WPA            0x20    // vendor specific wpa1 element
+#define IE_F_ALL            0x3f
+
+// cipher suites (group & pairwise), bits
+#define IE_C_WEP            0x01    // wep-40 & wep-104
+#define IE_C_TKIP           0x02
+#define IE_C_CCMP           0x04    // ccmp-128 & ccmp-256
+#define IE_C_GCMP           0x08    // gcmp-128 & gcmp-256
+#define IE_C_OTHER          0x80
+
+// akm suites, bits
+#define IE_AKM_EAP          0x01    // 802.1x, ft & sha256 variants, suite-b
+#define IE_AKM_PSK          0x02    // psk, ft & sha256 variants
+#define IE_AKM_SAE          0x04    // wpa3 personal, sae & ft-sae
+#define IE_AKM_OWE          0x08
+#define IE_AKM_OTHER        0x80
+
+// a complete element, data points into the frame
+typedef struct ie_t
+{
+    uint8_t         id;
+    uint8_t         len;
+    const uint8_t * data;
+} ie_t;
+
+typedef struct ie_iter_t
+{
+    const uint8_t * p;
+    const uint8_t * end;
+} ie_iter_t;
+
+static inline void ie_begin(ie_iter_t * it, const uint8_t * buf, size_t len)
+{
+    it->p   = buf;
+    it->end = buf + len;
+}
+
+// next complete element, 0 at the end of the buffer or on a truncated one
+static inline int ie_next(ie_iter_t * it, ie_t * ie)
+{
+    size_t left = it->end - it->p;
+    if(left < 2 || left - 2 < it->p[1])
+        return 0;
+
+    ie->id      = it->p[0];
+    ie->len     = it->p[1];
+    ie->data    = it->p + 2;
+    it->p      += 2 + ie->len;
+    return 1;
+}
+
+// what a beacon / probe response tells about its AP
+typedef struct ie_info_t
+{
+    uint8_t         found;          // IE_F_*
+    uint8_t         ssid_len;
+    const uint8_t * ssid;           // points into the frame, not terminated
+    uint8_t         channel;
+    uint8_t         rsn_group;      // IE_C_*
+    uint8_t         rsn_pairwise;
+    uint8_t         rsn_akm;        // IE_AKM_*
+    uint8_t         wpa_group;
+    uint8_t         wpa_pairwise;
+    uint8_t         wpa_akm;
+} ie_info_t;
+
+// decode the wanted elements of buf, stops once every one is found. returns the fields found
+uint8_t ie_parse(const uint8_t * buf, size_t len, uint8_t want, ie_info_t * info);
+
+// AP_ENC_* from the elements & the privacy bit of the capabilities
+uint8_t ie_enc(const ie_info_t * info, int privacy);
+
+#endif
@@ -0,0 +1,128 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : prof.cpp                                                   //
+// Description : cycle count probes on the hot paths, log2 histograms       //
+// ======================================================================== //
+
+#include "prof.h"
+#include "Arduino.h"
+#include "sched.h"
+#include "ui.h"
+
+#include <string.h>
+
+#ifdef APW_PROF
+
+static const char * names[PROF_MAX] = { "sniff", "beacon", "ap", "cli", "cleanup", "draw", "flush" };
+
+// each probe is only hit from one context (sdk callback or loop), no locking
+static prof_t       probes[PROF_MAX];
+static uint32_t     stats_since = 0;
+
+static inline int bucket(uint32_t cycles)
+{
+    if(cycles < (1u << PROF_MIN_LOG2))
+        return 0;
+
+    int b = 31 - __builtin_clz(cycles) - PROF_MIN_LOG2 + 1;
+    return b < PROF_BUCKETS ? b : PROF_BUCKETS - 1;
+}
+
+// upper bound of a bucket in usecs, what the percentiles below report
+static uint32_t bucket_us(int b)
+{
+    if(b == PROF_BUCKETS - 1)
+        return 0xffffffff;
+    return ((1u << (PROF_MIN_LOG2 + b)) + SCHED_CYCLES_US - 1) / SCHED_CYCLES_US;
+}
+
+static int percentile(const prof_t * p, uint32_t per_mille)
+{
+    uint32_t want = (uint64_t)p->calls * per_mille / 1000;
+    uint32_t seen = 0;
+
+    for(int b=0; b<PROF_BUCKETS; b++)
+    {
+        seen += p->hist[b];
+        if(seen > want)
+            return b;
+    }
+    return PROF_BUCKETS - 1;
+}
+
+void prof_add(int probe, uint32_t cycles)
+{
+    prof_t * p = &probes[probe];
+
+    p->calls += 1;
+    p->sum += cycles;
+    if(cycles > p->max)
+        p->max = cycles;
+    p->hist[bucket(cycles)] += 1;
+}
+
+prof_t * prof_get(int probe)
+{
+    if(probe < 0 || probe >= PROF_MAX)
+        return NULL;
+    return &probes[probe];
+}
+
+void prof_reset(void)
+{
+    memset(probes, 0, sizeof(probes));
+    stats_since = millis();
+}
+
+// percentiles are bucket upper bounds, load is the share of wall time spent in the probe
+void prof_dump(void)
+{
+    uint32_t span = millis() - stats_since;
+    if(!span)
+        span = 1;
+
+    ui_printf("> prof: %d probes over %u ms, %u cycles / us\n", PROF_MAX, span, SCHED_CYCLES_US);
+    ui_printf("%-8s %8s %8s %8s %6s %6s %6s\n", "probe", "calls", "avg us", "max us", "p50<", "p99<", "load");
+
+    for(int i=0; i<PROF_MAX; i++)
+    {
+        prof_t * p = &probes[i];
+        uint32_t avg = p->calls ? p->sum * 10 / p->calls / SCHED_CYCLES_US : 0;
+        uint32_t load = p->sum / SCHED_CYCLES_US / span;    // usecs per msec = per mille
+
+        if(!p->calls)
+        {
+            ui_printf("%-8s %8u\n", names[i], 0);
+            continue;
+        }
+        ui_printf("%-8s %8u %6u.%u %8u %6u %6u %2u.%u%%\n",
+            names[i], p->calls, avg / 10, avg % 10, p->max / SCHED_CYCLES_US,
+            bucket_us(percentile(p, 500)), bucket_us(percentile(p, 990)),
+            load / 10, load % 10);
+    }
+
+    // raw buckets, "log2 of cycles:count" for the non empty ones
+    for(int i=0; i<PROF_MAX; i++)
+    {
+        prof_t * p = &probes[i];
+        if(!p->calls)
+            continue;
+
+        ui_printf("%-8s", names[i]);
+        for(int b=0; b<PROF_BUCKETS; b++)
+            if(p->hist[b])
+                ui_printf(" %s%d:%u", b ? "" : "<", PROF_MIN_LOG2 + (b ? b - 1 : 0), p->hist[b]);
+        ui_printf("\n");
+    }
+}
+
+#else
+
+void prof_dump(void)
+{
+    ui_printf("> prof: built without APW_PROF\n");
+}
+
+#endif
@@ -0,0 +1,67 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : prof.h                                                     //
+// Description : cycle count probes on the hot paths, log2 histograms       //
+// ======================================================================== //
+
+#ifndef _PROF_H
+#define _PROF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// build the probes in (or -DAPW_PROF, 'make prof' on the host)
+//#define APW_PROF
+
+// log2 buckets of cpu cycles: bucket 0 is below 2^PROF_MIN_LOG2, the last one is open ended
+#define PROF_MIN_LOG2       6       // 64 cycles, 0.8 us at 80 mhz
+#define PROF_BUCKETS        20      // last one from 2^24 cycles, 0.2 s
+
+typedef enum prof_probe_t
+{
+    PROF_SNIFF,                     // wifi_sniff(), sdk rx callback
+    PROF_BEACON,                    // parse_beacon()
+    PROF_AP,                        // ap lookup + update
+    PROF_CLI,                       // client lookup + update
+    PROF_CLEANUP,                   // devs_cleanup()
+    PROF_DRAW,                      // ui_draw()
+    PROF_FLUSH,                     // oled framebuffer flush
+
+    PROF_MAX,
+} prof_probe_t;
+
+typedef struct prof_t
+{
+    uint32_t        calls;
+    uint32_t        max;            // cycles
+    uint64_t        sum;
+    uint32_t        hist[PROF_BUCKETS];
+} prof_t;
+
+#ifdef APW_PROF
+
+#include "Arduino.h"
+
+// PROF_START(x) ... PROF_END(x) in one scope, every exit path needs its PROF_END
+#define PROF_START(p)   uint32_t prof_t0_##p = ESP.getCycleCount()
+#define PROF_END(p)     prof_add(p, ESP.getCycleCount() - prof_t0_##p)
+
+void            prof_add(int probe, uint32_t cycles);
+prof_t *        prof_get(int probe);
+void            prof_reset(void);
+void            prof_dump(void);
+
+#else
+
+#define PROF_START(p)
+#define PROF_END(p)
+
+static inline prof_t *  prof_get(int probe) { return NULL; }
+static inline void      prof_reset(void) {}
+void                    prof_dump(void);
+
+#endif
+
+#endif
@@ -0,0 +1,422 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : report.cpp                                                 //
+// Description : binary device report streamed over the serial port         //
+// ======================================================================== //
+
+#include "report.h"
+#include "status.h"
+#include "devs.h"
+#include "wifi.h"
+#include "chan.h"
+#include "sched.h"
+#include "ui.h"
+#include "Arduino.h"
+
+static_assert(REPORT_PAYLOAD_MAX <= 255, "payload length is a single byte");
+static_assert(2 * REPORT_FRAME_MAX + REPORT_TX_RESERVE <= UI_SERIAL_TXBUF, "frames do not fit the serial tx buffer");
+
+typedef enum report_state_t
+{
+    REPORT_IDLE,
+    REPORT_DEVS,                    // sending records
+    REPORT_END,                     // records done, end frame next
+} report_state_t;
+
+// report in progress
+static report_state_t   state       = REPORT_IDLE;
+static uint16_t         report_id   = 0;
+static uint16_t         records     = 0;
+static uint16_t         overruns    = 0;    // reports skipped, previous one still streaming
+static uint8_t          synced      = 0;    // reader got a full report since reporting was turned on
+static uint8_t          chan_next   = 1;    // next channel stats record
+static uint8_t          task_next   = 0;    // next scheduler stats record
+
+// frame waiting for room in the uart
+static uint8_t          out[REPORT_FRAME_MAX];
+static size_t           out_len     = 0;
+static uint8_t          seq         = 0;
+
+// devices that expired since the last report
+static uint8_t          gone[REPORT_GONE_MAX][7];
+static uint32_t         gone_head   = 0;
+static uint32_t         gone_tail   = 0;
+static uint8_t          gone_lost   = 0;    // ring overflowed, next report must be full
+
+
+// ========================================================================= //
+// framing
+// ========================================================================= //
+static inline size_t put_u8(uint8_t * p, uint8_t v)
+{
+    p[0] = v;
+    return 1;
+}
+
+static inline size_t put_u16(uint8_t * p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return 2;
+}
+
+static inline size_t put_u32(uint8_t * p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return 4;
+}
+
+static inline uint16_t sat_u16(uint32_t v)
+{
+    return v > 0xffff ? 0xffff : v;
+}
+
+// ccitt, 4 bits at a time
+uint16_t report_crc16(const uint8_t * buf, size_t len, uint16_t crc)
+{
+    static const uint16_t tab[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    };
+
+    for(size_t i=0; i<len; i++)
+    {
+        crc = (crc << 4) ^ tab[(crc >> 12) ^ (buf[i] >> 4)];
+        crc = (crc << 4) ^ tab[(crc >> 12) ^ (buf[i] & 0x0f)];
+    }
+    return crc;
+}
+
+// build a frame in buf, returns its length
+static size_t report_frame(uint8_t * buf, uint8_t type, const uint8_t * payload, size_t len)
+{
+    buf[0] = REPORT_SYNC0;
+    buf[1] = REPORT_SYNC1;
+    buf[2] = type;
+    buf[3] = seq++;
+    buf[4] = len;
+    memcpy(buf + REPORT_HDR_LEN, payload, len);
+    put_u16(buf + REPORT_HDR_LEN + len, report_crc16(buf + 2, 3 + len, 0xffff));
+    return REPORT_HDR_LEN + len + 2;
+}
+
+size_t report_send(uint8_t type, const uint8_t * payload, size_t len)
+{
+    uint8_t buf[REPORT_FRAME_MAX];
+
+    if(len > REPORT_PAYLOAD_MAX)
+        return 0;
+
+    len = report_frame(buf, type, payload, len);
+    Serial.write(buf, len);
+    status.report_bytes += len;
+    return len;
+}
+
+size_t report_try_send(uint8_t type, const uint8_t * payload, size_t len)
+{
+    if(Serial.availableForWrite() < (int)(REPORT_HDR_LEN + len + 2 + REPORT_TX_RESERVE))
+    {
+        status.report_waits += 1;
+        return 0;
+    }
+
+    return report_send(type, payload, len);
+}
+
+
+// ========================================================================= //
+// records
+// ========================================================================= //
+static size_t rec_ap(uint8_t * p, wifi_ap_t * ap)
+{
+    size_t n = 0;
+    const char * essid = essid_str(ap->essid);
+    size_t l = strlen(essid);
+
+    n += put_u8(p + n, REPORT_R_AP);
+    n += put_u8(p + n, ap->report & ~REPORT_QUEUED);
+    memcpy(p + n, ap->mac, 6);
+    n += 6;
+    n += put_u8(p + n, ap->channel);
+    n += put_u8(p + n, ap->rssi);
+    n += put_u8(p + n, ap->enc);
+    n += put_u8(p + n, ap->ht);
+    n += put_u8(p + n, ap->clients_count);
+    n += put_u32(p + n, ap->beacons);
+    n += put_u8(p + n, l);
+    memcpy(p + n, essid, l);
+    return n + l;
+}
+
+static size_t rec_cli(uint8_t * p, wifi_client_t * cli)
+{
+    size_t n = 0;
+
+    n += put_u8(p + n, REPORT_R_CLI);
+    n += put_u8(p + n, cli->report & ~REPORT_QUEUED);
+    memcpy(p + n, cli->mac, 6);
+    n += 6;
+    if(cli->ap)
+        memcpy(p + n, dev_cli_ap(cli)->mac, 6);
+    else
+        memset(p + n, 0, 6);
+    n += 6;
+    n += put_u8(p + n, cli->rssi);
+    n += put_u32(p + n, cli->pkt_count);
+    return n;
+}
+
+static size_t rec_chan(uint8_t * p, uint8_t channel)
+{
+    chan_stat_t * c = &chan_stats[channel];
+    size_t n = 0;
+
+    n += put_u8(p + n, REPORT_R_CHAN);
+    n += put_u8(p + n, channel);
+    n += put_u32(p + n, c->frames);
+    n += put_u32(p + n, c->devs);
+    n += put_u32(p + n, c->time);
+    n += put_u16(p + n, sat_u16(c->fps));
+    n += put_u16(p + n, sat_u16(c->nps));
+    n += put_u16(p + n, c->dwell);
+    n += put_u16(p + n, sat_u16(c->gap_max));
+    return n;
+}
+
+static size_t rec_task(uint8_t * p, uint8_t id, sched_task_t * t)
+{
+    size_t n = 0;
+    size_t l = strlen(t->name);
+
+    if(l > 8)
+        l = 8;
+
+    n += put_u8(p + n, REPORT_R_TASK);
+    n += put_u8(p + n, id);
+    n += put_u16(p + n, sat_u16(t->period));
+    n += put_u32(p + n, t->runs);
+    n += put_u16(p + n, sat_u16(t->skips));
+    n += put_u16(p + n, sat_u16(t->late_max));
+    n += put_u16(p + n, sat_u16(t->runs ? t->cost_sum / t->runs : 0));
+    n += put_u16(p + n, sat_u16(t->cost_max));
+    n += put_u8(p + n, l);
+    memcpy(p + n, t->name, l);
+    return n + l;
+}
+
+// pack as many pending records as fit in a payload
+// order: expired devices, APs, clients, channel stats, task stats
+static size_t report_fill(uint8_t * p)
+{
+    uint8_t rec[64];
+    size_t  n = 0;
+    size_t  l;
+
+    #define REPORT_ADD(len)                         \
+        if(n + (len) > REPORT_PAYLOAD_MAX)          \
+            return n;                               \
+        memcpy(p + n, rec, len);                    \
+        n += len;                                   \
+        records += 1;
+
+    while(gone_tail != gone_head)
+    {
+        memcpy(rec, gone[gone_tail % REPORT_GONE_MAX], 7);
+        REPORT_ADD(7);
+        gone_tail += 1;
+    }
+
+    if(status.aps)
+    {
+        wifi_ap_t * ap = status.aps;
+        do
+        {
+            if(ap->report & REPORT_QUEUED)
+            {
+                l = rec_ap(rec, ap);
+                REPORT_ADD(l);
+                ap->report = 0;
+                ap->rssi_rep = ap->rssi;
+            }
+            ap = dev_ap_next(ap);
+        } while(ap != status.aps);
+    }
+
+    if(status.clients)
+    {
+        wifi_client_t * cli = status.clients;
+        do
+        {
+            if(cli->report & REPORT_QUEUED)
+            {
+                l = rec_cli(rec, cli);
+                REPORT_ADD(l);
+                cli->report = 0;
+                cli->rssi_rep = cli->rssi;
+            }
+            cli = dev_cli_next(cli);
+        } while(cli != status.clients);
+    }
+
+    for(; chan_next <= CHAN_MAX; chan_next++)
+    {
+        l = rec_chan(rec, chan_next);
+        REPORT_ADD(l);
+    }
+
+    for(sched_task_t * t; (t = sched_task(task_next)) != NULL; task_next++)
+    {
+        l = rec_task(rec, task_next, t);
+        REPORT_ADD(l);
+    }
+
+    #undef REPORT_ADD
+    return n;
+}
+
+// queue the next frame of the report in out
+static void report_next(void)
+{
+    uint8_t p[REPORT_PAYLOAD_MAX];
+    size_t  n = 0;
+
+    if(state == REPORT_DEVS)
+    {
+        n = report_fill(p);
+        if(n)
+        {
+            out_len = report_frame(out, REPORT_T_DEVS, p, n);
+            return;
+        }
+        state = REPORT_END;
+    }
+
+    n += put_u16(p + n, report_id);
+    n += put_u16(p + n, records);
+    n += put_u16(p + n, overruns);
+    out_len = report_frame(out, REPORT_T_END, p, n);
+    state = REPORT_IDLE;
+}
+
+
+// ========================================================================= //
+// api
+// ========================================================================= //
+void report_start(void)
+{
+    uint8_t p[REPORT_PAYLOAD_MAX];
+    size_t  n = 0;
+
+    if(!FEATURE_REPORT)
+    {
+        synced = 0;
+        return;
+    }
+
+    // can't keep up: let the current report finish
+    if(state != REPORT_IDLE || out_len)
+    {
+        overruns += 1;
+        return;
+    }
+
+    report_id   += 1;
+    records     = 0;
+    chan_next   = 1;
+    task_next   = 0;
+
+    // full snapshot: every device goes, expired ones don't matter anymore
+    uint8_t full = !synced || gone_lost || report_id % REPORT_FULL_EVERY == 0;
+    if(full)
+    {
+        gone_tail   = gone_head;
+        gone_lost   = 0;
+        synced      = 1;
+    }
+
+    // freeze the set of devices to send
+    if(status.aps)
+    {
+        wifi_ap_t * ap = status.aps;
+        do
+        {
+            if(full || ap->report)
+                ap->report |= REPORT_QUEUED;
+            ap = dev_ap_next(ap);
+        } while(ap != status.aps);
+    }
+
+    if(status.clients)
+    {
+        wifi_client_t * cli = status.clients;
+        do
+        {
+            if(full || cli->report)
+                cli->report |= REPORT_QUEUED;
+            cli = dev_cli_next(cli);
+        } while(cli != status.clients);
+    }
+
+    n += put_u16(p + n, report_id);
+    n += put_u8(p + n, full ? REPORT_F_FULL : 0);
+    n += put_u32(p + n, millis());
+    n += put_u16(p + n, status.aps_count);
+    n += put_u16(p + n, status.clients_count);
+    n += put_u32(p + n, status.pkt_recv);
+    n += put_u32(p + n, status.ring_drops);
+    n += put_u8(p + n, wifi_get_channel());
+    n += put_u8(p + n, status.hop_mode);
+    n += put_u8(p + n, status.detected_deauth | (status.detected_beacon << 1) | (status.detected_karma << 2));
+
+    out_len = report_frame(out, REPORT_T_BEGIN, p, n);
+    state = REPORT_DEVS;
+    report_pump();
+}
+
+void report_pump(void)
+{
+    while(1)
+    {
+        if(out_len)
+        {
+            // never block loop() on the serial port
+            if(Serial.availableForWrite() < (int)(out_len + REPORT_TX_RESERVE))
+            {
+                status.report_waits += 1;
+                return;
+            }
+
+            Serial.write(out, out_len);
+            status.report_bytes += out_len;
+            out_len = 0;
+        }
+
+        if(state == REPORT_IDLE)
+            return;
+
+        report_next();
+    }
+}
+
+void report_gone(uint8_t rec, const uint8_t * mac)
+{
+    if(!synced)
+        return;
+
+    if(gone_head - gone_tail >= REPORT_GONE_MAX)
+    {
+        gone_lost = 1;
+        return;
+    }
+
+    uint8_t * g = gone[gone_head % REPORT_GONE_MAX];
+    g[0] = rec;
+    memcpy(g + 1, mac, 6);
+    gone_head += 1;
+}
@@ -0,0 +1,78 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : report.h                                                   //
+// Description : binary device report streamed over the serial port         //
+// ======================================================================== //
+
+#ifndef _REPORT_H
+#define _REPORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// frame on the wire, multi-byte values are little endian
+//  0  sync     0xa5 0x5a
+//  2  type     REPORT_T_*
+//  3  seq      +1 every frame, lets the reader count lost frames
+//  4  len      payload length
+//  5  payload
+//  .  crc16    ccitt (0x1021, init 0xffff) of type .. end of payload
+// text logged with ui_printf() can sit between frames, readers resync on the header
+#define REPORT_SYNC0        0xa5
+#define REPORT_SYNC1        0x5a
+#define REPORT_HDR_LEN      5
+#define REPORT_PAYLOAD_MAX  120     // two frames + REPORT_TX_RESERVE fit UI_SERIAL_TXBUF (checked in report.cpp)
+#define REPORT_FRAME_MAX    (REPORT_HDR_LEN + REPORT_PAYLOAD_MAX + 2)
+
+// frame types
+#define REPORT_T_BEGIN      'B'     // id u16, flags u8, uptime u32, aps u16, clients u16,
+                                    // pkt_recv u32, ring_drops u32, channel u8, hop_mode u8, alerts u8
+#define REPORT_T_DEVS       'D'     // records, see below
+#define REPORT_T_END        'E'     // id u16, records u16, overruns u16
+
+#define REPORT_F_FULL       0x01    // begin flag: every device follows, drop previous state
+
+// records packed in REPORT_T_DEVS frames, first byte is the record type
+#define REPORT_R_AP         1       // flags u8, mac[6], channel u8, rssi i8, enc u8, ht u8, clients u8,
+                                    // beacons u32, essid_len u8, essid
+#define REPORT_R_CLI        2       // flags u8, mac[6], bssid[6] (zeros if unknown), rssi i8, pkts u32
+#define REPORT_R_AP_GONE    3       // mac[6]
+#define REPORT_R_CLI_GONE   4       // mac[6]
+#define REPORT_R_CHAN       5       // channel u8, frames u32, devs u32, time u32, fps u16 (x16), nps u16 (x16),
+                                    // dwell u16, gap u16
+#define REPORT_R_TASK       6       // id u8, period u16, runs u32, skips u16, late_max u16,
+                                    // cost_avg u16, cost_max u16, name_len u8, name
+
+// what changed on a device since the last report (wifi_ap_t / wifi_client_t .report)
+#define REPORT_NEW          0x01
+#define REPORT_CHANGED      0x02
+#define REPORT_QUEUED       0x80    // part of the report being sent, later changes wait for the next one
+
+// reporting policy
+#define REPORT_PERIOD       5000    // ms between reports
+#define REPORT_PUMP_MS      10      // ms between attempts to push frames to the uart
+#define REPORT_FULL_EVERY   12      // every n-th report is a full snapshot
+#define REPORT_RSSI_DELTA   6       // rssi change (db) worth reporting
+#define REPORT_GONE_MAX     32      // expired devices kept until the next report
+#define REPORT_TX_RESERVE   128     // serial tx buffer left to the log lines, they are dropped when full
+
+uint16_t    report_crc16(const uint8_t * buf, size_t len, uint16_t crc);
+
+// frame & write payload, returns bytes written. blocks if the uart is full
+size_t      report_send(uint8_t type, const uint8_t * payload, size_t len);
+
+// same, but only if the whole frame fits in the uart buffer. 0 = try later
+size_t      report_try_send(uint8_t type, const uint8_t * payload, size_t len);
+
+// start a new report (scheduled every REPORT_PERIOD)
+void        report_start(void);
+
+// stream the current report, only as fast as the uart drains (scheduled every REPORT_PUMP_MS)
+void        report_pump(void);
+
+// a device left the tables, tell the reader next time
+void        report_gone(uint8_t rec, const uint8_t * mac);
+
+#endif
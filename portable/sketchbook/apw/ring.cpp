@@ -0,0 +1,76 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : ring.cpp                                                   //
+// Description : lock-free frame ring (promisc callback -> main loop)       //
+// ======================================================================== //
+
+#include "ring.h"
+#include "status.h"
+
+static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE must be a power of 2");
+
+// single producer (rx callback) / single consumer (loop)
+// head is only written by the producer, tail only by the consumer
+static frame_sum_t          ring[RING_SIZE];
+static volatile uint32_t    ring_head = 0;
+static volatile uint32_t    ring_tail = 0;
+
+
+// ========================================================================= //
+// producer
+// ========================================================================= //
+
+// get a free slot to fill, NULL (and a drop) if the ring is full
+frame_sum_t * ring_claim(void)
+{
+    uint32_t depth = ring_head - ring_tail;
+
+    if(depth >= RING_SIZE)
+    {
+        status.ring_drops += 1;
+        return NULL;
+    }
+
+    if(depth + 1 > status.ring_peak)
+        status.ring_peak = depth + 1;
+
+    return &ring[ring_head & (RING_SIZE - 1)];
+}
+
+// publish the slot returned by ring_claim()
+void ring_commit(void)
+{
+    // slot contents must be visible before the new head
+    __sync_synchronize();
+    ring_head = ring_head + 1;
+}
+
+
+// ========================================================================= //
+// consumer
+// ========================================================================= //
+
+// oldest pending frame, NULL if empty
+frame_sum_t * ring_peek(void)
+{
+    if(ring_tail == ring_head)
+        return NULL;
+
+    // don't read the slot before we saw the head move
+    __sync_synchronize();
+    return &ring[ring_tail & (RING_SIZE - 1)];
+}
+
+// done with the frame returned by ring_peek()
+void ring_release(void)
+{
+    __sync_synchronize();
+    ring_tail = ring_tail + 1;
+}
+
+uint32_t ring_depth(void)
+{
+    return ring_head - ring_tail;
+}
@@ -0,0 +1,40 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : ring.h                                                     //
+// Description : lock-free frame ring (promisc callback -> main loop)       //
+// ======================================================================== //
+
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "wifi.h"
+
+#define RING_SIZE           32      // frame summaries, power of 2
+#define RING_BODY_LEN       88      // mgmt body bytes kept (sdk gives us 112 - 24)
+#define RING_BATCH          16      // max frames handled per wifi_loop()
+
+// what the rx callback keeps of a frame
+typedef struct frame_sum_t
+{
+    int8_t      rssi;               // from rx control header
+    uint8_t     channel;            // channel the frame was received on
+    uint16_t    len;                // bytes valid in frame
+    uint8_t     frame[sizeof(frame_t) + RING_BODY_LEN]; // 802.11 header (type, flags, addresses, seq)
+                                                        // + fixed params & first IEs for beacons / probes
+} frame_sum_t;
+
+// producer side, only called from the rx callback
+frame_sum_t *   ring_claim(void);
+void            ring_commit(void);
+
+// consumer side, only called from loop()
+frame_sum_t *   ring_peek(void);
+void            ring_release(void);
+uint32_t        ring_depth(void);
+
+#endif
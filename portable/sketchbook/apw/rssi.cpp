@@ -0,0 +1,111 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : rssi.cpp                                                   //
+// Description : per device rssi history, fine + downsampled rings          //
+// ======================================================================== //
+
+#include "rssi.h"
+
+#include <string.h>
+
+static_assert(sizeof(rssi_hist_t) <= RSSI_HIST_MAX, "rssi history larger than RSSI_HIST_MAX");
+static_assert((RSSI_FINE & (RSSI_FINE - 1)) == 0 && RSSI_FINE <= 256, "RSSI_FINE must be a power of 2");
+static_assert((RSSI_COARSE & (RSSI_COARSE - 1)) == 0 && RSSI_COARSE <= 256, "RSSI_COARSE must be a power of 2");
+static_assert(RSSI_COARSE_N * 128 <= 0x7fff, "coarse sum would overflow");
+
+// a finished second goes to the coarse ring
+static void rssi_fold(rssi_hist_t * h, uint32_t sec, int8_t v)
+{
+    uint16_t b = sec / RSSI_COARSE_N;
+    uint16_t d = b - h->bucket;
+
+    if(d)
+    {
+        if(d > RSSI_COARSE)
+            d = RSSI_COARSE;
+        while(d--)
+            memset(&h->coarse[(uint16_t)(b - d) % RSSI_COARSE], 0, sizeof(rssi_span_t));
+        h->bucket = b;
+        h->sum = 0;
+        h->n = 0;
+    }
+
+    rssi_span_t * c = &h->coarse[b % RSSI_COARSE];
+    if(!h->n || v < c->min)
+        c->min = v;
+    if(!h->n || v > c->max)
+        c->max = v;
+    h->sum += v;
+    h->n += 1;
+    c->avg = h->sum / h->n;
+}
+
+void rssi_add(rssi_hist_t * h, int8_t rssi, uint32_t now)
+{
+    uint32_t sec = now / RSSI_FINE_MS;
+    uint16_t d = (uint16_t)sec - h->sec;
+
+    // 0 marks silence
+    if(rssi >= 0)
+        rssi = -1;
+
+    if(d)
+    {
+        if(h->fine[h->sec % RSSI_FINE])
+            rssi_fold(h, sec - d, h->fine[h->sec % RSSI_FINE]);
+
+        if(d > RSSI_FINE)
+            d = RSSI_FINE;
+        while(d--)
+            h->fine[(uint16_t)(sec - d) % RSSI_FINE] = 0;
+        h->sec = sec;
+    }
+
+    int8_t * f = &h->fine[h->sec % RSSI_FINE];
+    if(!*f || rssi > *f)
+        *f = rssi;
+}
+
+void rssi_get(const rssi_hist_t * h, uint32_t now, int8_t fine[RSSI_FINE], rssi_span_t coarse[RSSI_COARSE])
+{
+    uint32_t sec    = now / RSSI_FINE_MS;
+    uint16_t d      = (uint16_t)sec - h->sec;      // seconds since the newest sample
+    uint32_t last   = sec - d;                      // its second
+    uint16_t b      = sec / RSSI_COARSE_N;
+
+    for(int i=0; i<RSSI_FINE; i++)
+    {
+        uint32_t age = RSSI_FINE - 1 - i;
+        fine[i] = 0;
+        if(age >= d && age - d < RSSI_FINE)
+            fine[i] = h->fine[(uint16_t)(sec - age) % RSSI_FINE];
+    }
+
+    for(int i=0; i<RSSI_COARSE; i++)
+    {
+        uint16_t age = h->bucket - (uint16_t)(b - (RSSI_COARSE - 1 - i));
+        memset(&coarse[i], 0, sizeof(rssi_span_t));
+        if(age < RSSI_COARSE)
+            coarse[i] = h->coarse[(uint16_t)(h->bucket - age) % RSSI_COARSE];
+    }
+
+    // the newest second is only folded once the next one starts
+    int8_t v = h->fine[h->sec % RSSI_FINE];
+    uint16_t age = b - (uint16_t)(last / RSSI_COARSE_N);
+    if(!v || age >= RSSI_COARSE)
+        return;
+
+    rssi_span_t * c = &coarse[RSSI_COARSE - 1 - age];
+    if((uint16_t)(last / RSSI_COARSE_N) == h->bucket && h->n)
+    {
+        if(v < c->min)
+            c->min = v;
+        if(v > c->max)
+            c->max = v;
+        c->avg = (h->sum + v) / (h->n + 1);
+    }
+    else
+        c->min = c->avg = c->max = v;
+}
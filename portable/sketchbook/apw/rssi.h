@@ -0,0 +1,49 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : rssi.h                                                     //
+// Description : per device rssi history, fine + downsampled rings          //
+// ======================================================================== //
+
+#ifndef _RSSI_H
+#define _RSSI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// last RSSI_FINE seconds at 1 sample / sec (strongest frame of the second)
+// then RSSI_COARSE buckets of RSSI_COARSE_N seconds as min / avg / max
+// ring sizes are powers of 2, slots are indexed by the 16 bit second / bucket numbers
+#define RSSI_FINE           16
+#define RSSI_FINE_MS        1000
+#define RSSI_COARSE         8
+#define RSSI_COARSE_N       15      // 2 min of coarse history
+
+// size of one history, devs.h keeps DEVS_RSSI_SLOTS of them for the aps & clients
+#define RSSI_HIST_MAX       48
+
+typedef struct rssi_span_t
+{
+    int8_t          min;
+    int8_t          avg;
+    int8_t          max;            // 0 = nothing heard
+} rssi_span_t;
+
+typedef struct rssi_hist_t
+{
+    uint16_t        sec;            // newest second (millis / RSSI_FINE_MS), low 16 bits
+    uint16_t        bucket;         // newest coarse bucket (seconds / RSSI_COARSE_N), low 16 bits
+    int16_t         sum;            // seconds folded into the newest bucket
+    uint8_t         n;
+    int8_t          fine[RSSI_FINE];        // 0 = nothing heard that second
+    rssi_span_t     coarse[RSSI_COARSE];
+} rssi_hist_t;
+
+// a frame from the device, O(1) unless it was silent for a while (then O(RSSI_FINE))
+void    rssi_add(rssi_hist_t * h, int8_t rssi, uint32_t now);
+
+// history as of now, oldest first, silent slots are 0
+void    rssi_get(const rssi_hist_t * h, uint32_t now, int8_t fine[RSSI_FINE], rssi_span_t coarse[RSSI_COARSE]);
+
+#endif
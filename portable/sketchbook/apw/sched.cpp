@@ -0,0 +1,231 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : sched.cpp                                                  //
+// Description : cooperative scheduler for the periodic jobs of loop()      //
+// ======================================================================== //
+
+#include "sched.h"
+#include "Arduino.h"
+#include "ui.h"
+
+// tasks never move, the heap holds their ids ordered by deadline
+static sched_task_t tasks[SCHED_MAX_TASKS];
+static uint8_t      heap[SCHED_MAX_TASKS];
+static int          count = 0;
+static uint32_t     stats_since = 0;
+
+// a before b, valid as long as deadlines are less than 24 days apart
+static inline int before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+
+// ========================================================================= //
+// deadline heap
+// ========================================================================= //
+static void heap_set(int pos, uint8_t id)
+{
+    heap[pos] = id;
+    tasks[id].slot = pos;
+}
+
+static void heap_up(int pos)
+{
+    uint8_t id = heap[pos];
+
+    while(pos > 0)
+    {
+        int parent = (pos - 1) / 2;
+        if(!before(tasks[id].due, tasks[heap[parent]].due))
+            break;
+        heap_set(pos, heap[parent]);
+        pos = parent;
+    }
+    heap_set(pos, id);
+}
+
+static void heap_down(int pos)
+{
+    uint8_t id = heap[pos];
+
+    while(1)
+    {
+        int child = 2 * pos + 1;
+        if(child >= count)
+            break;
+        if(child + 1 < count && before(tasks[heap[child + 1]].due, tasks[heap[child]].due))
+            child += 1;
+        if(!before(tasks[heap[child]].due, tasks[id].due))
+            break;
+        heap_set(pos, heap[child]);
+        pos = child;
+    }
+    heap_set(pos, id);
+}
+
+// deadline of a task changed, put it back in place
+static void heap_fix(int pos)
+{
+    uint8_t id = heap[pos];
+
+    heap_up(pos);
+    heap_down(tasks[id].slot);
+}
+
+
+// ========================================================================= //
+// api
+// ========================================================================= //
+int sched_add(const char * name, sched_cb_t cb, uint32_t period)
+{
+    if(count >= SCHED_MAX_TASKS || !cb)
+        return -1;
+
+    uint32_t now = millis();
+    int id = count;
+    sched_task_t * t = &tasks[id];
+
+    memset(t, 0, sizeof(*t));
+    t->name     = name;
+    t->cb       = cb;
+    t->period   = period ? period : 1;
+    t->last     = now;
+    t->due      = now + t->period;
+
+    if(!count)
+        stats_since = now;
+
+    count += 1;
+    heap_set(id, id);
+    heap_up(id);
+    return id;
+}
+
+void sched_set_period(int id, uint32_t period)
+{
+    if(id < 0 || id >= count)
+        return;
+
+    sched_task_t * t = &tasks[id];
+    period = period ? period : 1;
+    if(t->period == period)
+        return;
+
+    t->period = period;
+    t->due = t->last + period;
+
+    // shorter period and already overdue: run on the next loop
+    if(before(t->due, millis()))
+        t->due = millis();
+
+    heap_fix(t->slot);
+}
+
+void sched_defer(int id, uint32_t delay)
+{
+    if(id < 0 || id >= count)
+        return;
+
+    sched_task_t * t = &tasks[id];
+    t->due = millis() + delay;
+    heap_fix(t->slot);
+}
+
+int sched_loop(void)
+{
+    uint32_t now = millis();
+    int n = 0;
+
+    // every task runs at most once: its new deadline is always after now
+    while(count && !before(now, tasks[heap[0]].due))
+    {
+        sched_task_t * t = &tasks[heap[0]];
+        uint32_t late = now - t->due;
+
+        t->runs     += 1;
+        t->late_sum += late;
+        if(late > t->late_max)
+            t->late_max = late;
+
+        // keep the phase, unless we fell a whole period behind
+        t->last = now;
+        t->due += t->period;
+        if(!before(now, t->due))
+        {
+            t->skips += (now - t->due) / t->period + 1;
+            t->due = now + t->period;
+        }
+        heap_down(0);
+
+        // the callback may reschedule itself or others
+        uint32_t start = ESP.getCycleCount();
+        t->cb();
+        uint32_t cost = (ESP.getCycleCount() - start) / SCHED_CYCLES_US;
+
+        t->cost_sum += cost;
+        if(cost > t->cost_max)
+            t->cost_max = cost;
+
+        n += 1;
+    }
+
+    return n;
+}
+
+uint32_t sched_idle(void)
+{
+    if(!count)
+        return 0;
+
+    uint32_t now = millis();
+    uint32_t due = tasks[heap[0]].due;
+    return before(now, due) ? due - now : 0;
+}
+
+sched_task_t * sched_task(int id)
+{
+    if(id < 0 || id >= count)
+        return NULL;
+    return &tasks[id];
+}
+
+void sched_reset_stats(void)
+{
+    for(int i=0; i<count; i++)
+    {
+        sched_task_t * t = &tasks[i];
+        t->runs     = 0;
+        t->skips    = 0;
+        t->late_sum = 0;
+        t->late_max = 0;
+        t->cost_sum = 0;
+        t->cost_max = 0;
+    }
+    stats_since = millis();
+}
+
+// per task timings, load is the share of wall time spent in the callback
+void sched_dump(void)
+{
+    uint32_t span = millis() - stats_since;
+    if(!span)
+        span = 1;
+
+    ui_printf("> sched: %d tasks over %u ms\n", count, span);
+    ui_printf("%-8s %6s %7s %5s %9s %11s %5s\n", "task", "period", "runs", "skip", "late ms", "cost us", "load");
+
+    for(int i=0; i<count; i++)
+    {
+        sched_task_t * t = &tasks[i];
+        uint32_t late_avg = t->runs ? t->late_sum / t->runs : 0;
+        uint32_t cost_avg = t->runs ? t->cost_sum / t->runs : 0;
+        uint32_t load = t->cost_sum / span;    // usecs per msec = per mille
+        ui_printf("%-8s %6u %7u %5u %4u/%-4u %5u/%-5u %3u.%u%%\n",
+            t->name, t->period, t->runs, t->skips,
+            late_avg, t->late_max, cost_avg, t->cost_max,
+            load / 10, load % 10);
+    }
+}
@@ -0,0 +1,58 @@
+// ======================================================================== //
+// ixty                                                                2018 //
+// ======================================================================== //
+// Project     : ESP8266 fun                                                //
+// Filename    : sched.h                                                    //
+// Description : cooperative scheduler for the periodic jobs of loop()      //
+// ======================================================================== //
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SCHED_MAX_TASKS     12      // wifi timers + ui refresh, with room to spare
+#define SCHED_CYCLES_US     ((uint32_t)(F_CPU / 1000000L))  // cpu cycles per usec (80 or 160 mhz)
+
+typedef void (*sched_cb_t)(void);
+
+// a periodic job, deadlines are millis() values and compared wrap-safe
+typedef struct sched_task_t
+{
+    const char *    name;
+    sched_cb_t      cb;
+    uint32_t        period;         // ms between two runs
+    uint32_t        due;            // next deadline
+    uint32_t        last;           // time of the last run
+    uint8_t         slot;           // position in the deadline heap
+
+    // stats since boot / last sched_reset_stats()
+    uint32_t        runs;
+    uint32_t        skips;          // deadlines dropped because we were more than a period late
+    uint32_t        late_sum;       // ms between deadline and actual run
+    uint32_t        late_max;
+    uint32_t        cost_sum;       // usecs spent in the callback
+    uint32_t        cost_max;
+} sched_task_t;
+
+// register a job, first run one period from now. returns task id or -1
+int             sched_add(const char * name, sched_cb_t cb, uint32_t period);
+
+// change the period, next deadline becomes last run + new period
+void            sched_set_period(int id, uint32_t period);
+
+// push the next run to delay ms from now (0 = asap)
+void            sched_defer(int id, uint32_t delay);
+
+// run every job whose deadline passed, each at most once. returns jobs run
+int             sched_loop(void);
+
+// ms until the next deadline (0 if something is due)
+uint32_t        sched_idle(void);
+
+sched_task_t *  sched_task(int id);
+void            sched_reset_stats(void);
+void            sched_dump(void);
+
+#endif
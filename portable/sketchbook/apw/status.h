@@ -14,23 +14,33 @@
 #include <stdint.h>
 #include <stddef.h>
 
-struct wifi_ap_s;
+#include "rssi.h"
+#include "essid.h"
+
+#define CLI_PROBES          4       // essids a client probed for, most recent first
+
+// device slot + 1 in its pool, 0 = none. links & times go through devs.h accessors
+typedef uint16_t dev_idx_t;
 
 // structure for a connected client device
 typedef struct wifi_client_s
 {
     uint8_t         mac[6];         // mac address
-    uint32_t        time_f;         // first seen timestamp
-    uint32_t        time_l;         // last seen timestamp
+    uint16_t        time_f;         // first seen, minutes since boot (devs_min)
     uint32_t        pkt_count;      // number of packets seen
-    int8_t          rssi;           // last (or average) signal strenght
-    char            vendor[9];      // oui lookup
+    uint16_t        time_l;         // last seen, seconds (devs_sec), wraps after 18h
+    uint16_t        vendor;         // oui vendor id + 1, 0 = unknown
+    essid_t         probes[CLI_PROBES]; // directed probe requests (see essid.h)
 
-    struct wifi_ap_s *      ap;     // ptr to current access point
-    struct wifi_client_s *  apnext; // next client connected to AP
+    dev_idx_t       ap;             // current access point
+    dev_idx_t       apnext;         // next client connected to AP
+    dev_idx_t       next;           // next in circular linked list
+    dev_idx_t       prev;           // prev in circular linked list
 
-    struct wifi_client_s *  next;   // next in circular linked list
-    struct wifi_client_s *  prev;   // prev in circular linked list
+    int8_t          rssi;           // last (or average) signal strenght
+    int8_t          rssi_rep;       // rssi in the last report
+    uint8_t         report;         // REPORT_* changes not reported yet
+    uint8_t         rh;             // rssi history slot + 1, 0 = none yet (see devs.h)
 } wifi_client_t;
 
 
@@ -38,24 +48,26 @@ typedef struct wifi_client_s
 typedef struct wifi_ap_s
 {
     uint8_t         mac[6];         // mac address
-    uint32_t        time_f;         // first seen timestamp
-    uint32_t        time_l;         // last seen timestamp
-    char            vendor[9];      // oui lookup
-
-    int8_t          rssi;           // last (or average) signal strenght
-    uint8_t         channel;        // advertised channel
-    char            essid[33];      // network name (max 32b + null)
-    uint32_t        essid_time;     // timestamp of last essid change
-    uint16_t        essid_count;    // number of essid switches
+    essid_t         essid;          // network name, interned (see essid.h)
     uint32_t        beacons;        // number of beacons seen
-    uint8_t         enc;            // 0=open, 1=wep,  2=wpa1-psk, 3=wpa1-mgt, 4=wpa2-psk, 5=wpa2-mgt
-    uint8_t         ht;             // 0=bg,   1=ht(n) 2=vht(ac)
+    uint16_t        time_f;         // first seen, minutes since boot (devs_min)
+    uint16_t        time_l;         // last seen, seconds (devs_sec), wraps after 18h
+    uint16_t        vendor;         // oui vendor id + 1, 0 = unknown
 
-    wifi_client_t * clients;        // linked list of current clients
-    uint8_t         clients_count;  // number of clients
+    dev_idx_t       clients;        // linked list of current clients
+    dev_idx_t       next;           // next in circular linked list
+    dev_idx_t       prev;           // prev in circular linked list
 
-    struct wifi_ap_s *  next;       // next in circular linked list
-    struct wifi_ap_s *  prev;       // prev in circular linked list
+    int8_t          rssi;           // last (or average) signal strenght
+    int8_t          rssi_rep;       // rssi in the last report
+    uint8_t         report;         // REPORT_* changes not reported yet
+    uint8_t         clients_count;  // number of clients
+    uint16_t        channel : 4;    // advertised channel
+    uint16_t        enc     : 3;    // 0=open, 1=wep,  2=wpa1-psk, 3=wpa1-mgt, 4=wpa2-psk, 5=wpa2-mgt
+    uint16_t        ht      : 2;    // 0=bg,   1=ht(n) 2=vht(ac)
+    uint16_t        alerts  : 3;    // (1 << detect_type_t) ever raised for this bssid
+    uint8_t         essid_count;    // number of essid switches, saturates
+    uint8_t         rh;             // rssi history slot + 1, 0 = none yet (see devs.h)
 } wifi_ap_t;
 
 
@@ -78,6 +90,7 @@ typedef struct status_t
     uint8_t         channel;        // current channel
     uint32_t        chanhop;        // interval between channel hops
     uint8_t         channel_focus;  // do we want to focus on a specific channel (chan hop but stay there half the time)
+    uint8_t         hop_mode;       // channel hopping policy in detect mode (see chan.h)
 
     // internal status
     wmode_t         mode;           // detect / deauth / beacon
@@ -85,13 +98,40 @@ typedef struct status_t
     uint32_t        pkt_sent;
     uint32_t        pkt_recv;
     uint32_t        pkt_errs;
+    uint32_t        ring_drops;     // frames lost, rx ring full
+    uint32_t        ring_peak;      // max frames waiting in the rx ring
+
+    // rx prefilter drops (see filter.h)
+    uint32_t        filter_short;   // shorter than an 802.11 header
+    uint32_t        filter_types;   // frame type / subtype not wanted
+    uint32_t        filter_ds;      // data frames with neither or both of to_ds / from_ds
+    uint32_t        filter_mac;     // group or zero device address
+    uint32_t        filter_oui;     // device from an ignored vendor
 
     // device lists
     wifi_ap_t *     aps;
     uint32_t        aps_count;
+    uint32_t        aps_peak;       // high-water mark of aps_count
+    uint32_t        aps_full;       // new APs dropped, pool exhausted
 
     wifi_client_t * clients;
     uint32_t        clients_count;
+    uint32_t        clients_peak;   // high-water mark of clients_count
+    uint32_t        clients_full;   // new clients dropped, pool exhausted
+    uint32_t        devs_new;       // devices (aps + clients) discovered since boot
+    uint32_t        rssi_evicts;    // rssi histories taken over from a quieter device
+    uint32_t        essid_full;     // essids not stored, pool or arena full
+    uint32_t        probes_seen;    // directed probe requests
+
+    // serial report
+    uint32_t        report_bytes;   // bytes sent
+    uint32_t        report_waits;   // times the report waited for room in the uart
+
+    // raw capture
+    uint32_t        capture_frames; // frames queued for the uart
+    uint32_t        capture_sent;   // frames written to the uart
+    uint32_t        capture_drops;  // frames lost, capture buffer full
+    uint32_t        capture_filtered; // frames rejected by the filter
 
     // attack detection
     uint32_t        detected_pkt_deauth;
@@ -99,6 +139,17 @@ typedef struct status_t
     uint8_t         detected_deauth;
     uint8_t         detected_karma;
     uint8_t         detected_beacon;
+    uint32_t        detect_alerts;  // alerts raised since boot (see detect.h)
+    uint32_t        detect_evicts;  // tracked bssids recycled while still counting
+    uint32_t        detect_full;    // alerts not raised, every alert slot in use
+
+    // device history on flash (see hist.h)
+    uint32_t        hist_queued;    // records waiting for the next flash write
+    uint32_t        hist_written;   // records appended to the log since boot
+    uint32_t        hist_drops;     // records lost, queue full or flash budget spent
+    uint32_t        hist_flash;     // bytes written to flash since boot (log + compaction)
+    uint32_t        hist_compacts;  // compaction passes completed
+    uint32_t        hist_reloaded;  // devices restored from the log at boot
 
     // attack stats
     uint32_t        spoofed_aps;
@@ -116,10 +167,6 @@ typedef struct status_t
     uint8_t         deauth_mode;    // 0 = attack everybody, 1 = blacklist, 2 = whitelist
     uint8_t         deauth_mac[6];  // blacklist or whitelist (single AP mac)
 
-    // graph view data
-    int             graph_data[128];
-    int             graph_count;
-
 } status_t;
 
 
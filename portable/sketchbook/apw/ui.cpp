@@ -11,6 +11,11 @@
 #include "ui.h"
 #include "utils.h"
 #include "devs.h"
+#include "sched.h"
+#include "detect.h"
+#include "prof.h"
+#include "filter.h"
+#include "chan.h"
 
 #define RST_OLED 16
 #define DISPLAY_FPS 8
@@ -20,7 +25,8 @@ OLED display(4, 5);
 void ui_init(void)
 {
     // init serial io
-    Serial.begin(115200);
+    Serial.begin(115200, SERIAL_8N1, SERIAL_FULL, UI_SERIAL_TXBUF);
+    Serial.setTxOverflow(SERIAL_TX_DROP);
     Serial.println("\n");
     Serial.println("> init_ui\n");
 
@@ -38,8 +44,13 @@ void ui_init(void)
 
     // display intro & clear screen
     display.begin();
+    display.enableFramebuffer();
     ui_intro();
     display.clear();
+    display.flush();
+
+    // screen refresh + buttons
+    sched_add("ui", ui_loop, 1000 / DISPLAY_FPS);
 }
 
 void ui_clear(void)
@@ -50,19 +61,18 @@ void ui_clear(void)
     display.print("                ", 3, 0);
 }
 
+// scheduled every 1000 / DISPLAY_FPS ms
 void ui_loop(void)
 {
-    static uint32_t time_draw = 0;
-    uint32_t now = millis();
+    ui_input();
 
-    // update
-    if(now - time_draw > (1000 / DISPLAY_FPS))
-    {
-        time_draw = now;
+    PROF_START(PROF_DRAW);
+    ui_draw();
+    PROF_END(PROF_DRAW);
 
-        ui_input();
-        ui_draw();
-    }
+    PROF_START(PROF_FLUSH);
+    display.flush();
+    PROF_END(PROF_FLUSH);
 }
 
 void ui_led(int on)
@@ -86,6 +96,7 @@ void ui_intro(void)
         display.print("*", 0, 8+i);
         display.print("*", 3, 7-i);
         display.print("*", 3, 8+i);
+        display.flush();
         delay(33);
     }
     delay(500);
@@ -115,6 +126,37 @@ void ui_input(void)
     HANDLE_CLICK(both,      btn1 && btn2,                           ui_click(3, 0));
     HANDLE_CLICK(btn1,      btn1,                                   ui_click(1, 0));
     HANDLE_CLICK(btn2,      btn2,                                   ui_click(2, 0));
+
+    // single key commands over serial, asked for: their dumps wait for the line
+    if(Serial.available() > 0)
+    {
+        Serial.setTxOverflow(SERIAL_TX_BLOCK);
+        while(Serial.available() > 0)
+            ui_key(Serial.read());
+        Serial.setTxOverflow(SERIAL_TX_DROP);
+    }
+}
+
+// p: probe timings, s: scheduler stats, f: prefilter drops, c: channels, u: serial, r: reset timings & scheduler
+void ui_key(int c)
+{
+    if(c == 'p')
+        prof_dump();
+    else if(c == 'c')
+        chan_dump();
+    else if(c == 's')
+        sched_dump();
+    else if(c == 'f')
+        filter_dump();
+    else if(c == 'u')
+        ui_printf("> serial: %u bytes dropped, %u writes waited, %d free of %u\n",
+            Serial.txDropped(), Serial.txWaits(), Serial.availableForWrite(), UI_SERIAL_TXBUF);
+    else if(c == 'r')
+    {
+        prof_reset();
+        sched_reset_stats();
+        ui_printf("> stats reset\n");
+    }
 }
 
 void ui_click(int btn, int hold)
@@ -201,34 +243,43 @@ void ui_draw_pps(int line)
     ui_line(line, "pps: %d", pps);
 }
 
+// one alert at a time, cycles every 2 sec when there are several
 void ui_draw_alert(void)
 {
-    ui_line(0, "+--------------+");
-    ui_line(1, "|  ! attack !  | ");
-    if(status.detected_deauth && status.detected_beacon && status.detected_karma)
-        ui_line(2, "|    D B K    |");
-    else if(status.detected_deauth && status.detected_beacon)
-        ui_line(2, "|deauth  beacon|");
-    else if(status.detected_deauth && status.detected_karma)
-        ui_line(2, "|deauth  fakeap|");
-    else if(status.detected_beacon && status.detected_karma)
-        ui_line(2, "|beacon  fakeap|");
-    else if(status.detected_deauth)
-        ui_line(2, "|    deauth    |");
-    else if(status.detected_beacon)
-        ui_line(2, "|    beacon    |");
-    else if(status.detected_karma)
-        ui_line(2, "|    fakeAP    |");
+    int n = detect_count();
+    int i = n ? (millis() / 2000) % n : 0;
+    detect_alert_t * a = detect_get(i);
+    char macstr[16];
+
+    if(!a)
+    {
+        ui_line(0, "! attack !");
+        ui_line(1, "");
+        ui_line(2, "");
+        ui_line(3, "");
+        return;
+    }
+
+    wifi_ap_t * ap = NULL;
+    if(a->mac[0] | a->mac[1] | a->mac[2] | a->mac[3] | a->mac[4] | a->mac[5])
+    {
+        bin_to_hex(a->mac, 6, macstr, sizeof(macstr));
+        ap = dev_ap_find(a->mac, 0);
+    }
     else
-        ui_line(3, "|      ??      |");
-    ui_line(3, "+--------------+");
+        snprintf(macstr, sizeof(macstr), "any bssid");
 
+    ui_line(0, "! %s ch %d", detect_type_str(a->type), a->channel);
+    ui_line(1, "%s", ap ? essid_str(ap->essid) : "?");
+    ui_line(2, "%s", macstr);
+    ui_line(3, "%d/%ds   %d/%d", a->peak, DETECT_WINDOW_MS / 1000, i + 1, n);
 }
 
 void ui_draw_ap(wifi_ap_t * ap)
 {
     char * enc_str[] = { "open", "wep", "wpa1", "eap1", "wpa2", "eap2" };
     char uptime[8];
+    char vendor[9];
     // char macstr[8];
 
     if(!ap)
@@ -241,12 +292,13 @@ void ui_draw_ap(wifi_ap_t * ap)
     }
 
     // bin_to_hex(ap->mac + 3, 3, macstr, sizeof(macstr));
-    fmt_uptime(millis() - ap->time_l, uptime, sizeof(uptime));
+    fmt_uptime(dev_age(ap->time_l, millis()) * 1000, uptime, sizeof(uptime));
+    vendor_name(ap->vendor - 1, vendor);
 
     ui_line(0, "#%d /%d %s %d", dev_ap_index(ap) + 1, status.aps_count, uptime, ap->rssi);
-    ui_line(1, "%s", ap->essid);
+    ui_line(1, "%s", essid_str(ap->essid));
     // ui_line(2, "%s:%s", ap->vendor, macstr);
-    ui_line(2, "%s", ap->vendor);
+    ui_line(2, "%s", vendor);
     ui_line(3, "%-2d%c %s cli %d", ap->channel, ap->ht ? 'N' : 'G', enc_str[ap->enc], ap->clients_count);
 }
 
@@ -256,6 +308,7 @@ void ui_draw_cli(wifi_client_t * cli, size_t ind)
     char macstr[16];
     char uptime[8];
     char pktc[8];
+    char vendor[9];
 
     if(!cli)
     {
@@ -268,15 +321,16 @@ void ui_draw_cli(wifi_client_t * cli, size_t ind)
 
 
     bin_to_hex(cli->mac, 6, macstr, sizeof(macstr));
-    fmt_uptime(millis() - cli->time_l, uptime, sizeof(uptime));
+    fmt_uptime(dev_age(cli->time_l, millis()) * 1000, uptime, sizeof(uptime));
+    vendor_name(cli->vendor - 1, vendor);
     fmt_num(cli->pkt_count, pktc, sizeof(pktc));
 
     if(cli->ap)
-        ui_line(0, "# %d / %d", ind + 1, cli->ap->clients_count);
+        ui_line(0, "# %d / %d", ind + 1, dev_cli_ap(cli)->clients_count);
     else
         ui_line(0, "# %d / ?", ind + 1);
     ui_line(1, "%s", macstr);
-    ui_line(2, "%s", cli->vendor);
+    ui_line(2, "%s", vendor);
     ui_line(3, "%d %sp %s", cli->rssi, pktc, uptime);
 }
 
@@ -309,9 +363,7 @@ void ui_draw(void)
         // AP view
         else if(status.ui_level == 1)
         {
-            devs_lock();
             ui_draw_ap(status.cur_ap);
-            devs_unlock();
         }
         // Actions on AP
         else if(status.ui_level == 2)
@@ -327,58 +379,23 @@ void ui_draw(void)
         // clients view
         else if(status.ui_level == 3)
         {
-            devs_lock();
             ui_draw_cli(status.cur_cli, status.ui_idx);
-            devs_unlock();
         }
         // AP rssi graph
         else if(status.ui_level == 4)
         {
-            static uint32_t last_ap_time = 0;
-
             if(!status.cur_ap)
                 ui_line(0, "  * lost AP *  ");
             else
-            {
-                int val = 100 + status.cur_ap->rssi;
-                if(last_ap_time == status.cur_ap->time_l)
-                    val = 0;
-                last_ap_time = status.cur_ap->time_l;
-
-                if(status.graph_count < 128)
-                    status.graph_data[status.graph_count++] = val;
-                else
-                {
-                    memmove(&status.graph_data[0], &status.graph_data[1], 127 * sizeof(int));
-                    status.graph_data[status.graph_count-1] = val;
-                }
-                draw_graph(status.graph_data, status.graph_count, 0, 75);
-            }
+                draw_rssi(dev_ap_rssi(status.cur_ap));
         }
         // client rssi graph
         else if(status.ui_level == 5)
         {
-            static uint32_t last_client_time = 0;
-
             if(!status.cur_cli)
                 ui_line(0, "* lost client *");
             else
-            {
-                int val = 100 + status.cur_cli->rssi;
-                if(last_client_time == status.cur_cli->time_l)
-                    val = 0;
-                last_client_time = status.cur_cli->time_l;
-
-                if(status.graph_count < 128)
-                    status.graph_data[status.graph_count++] = val;
-                else
-                {
-                    memmove(&status.graph_data[0], &status.graph_data[1], 127 * sizeof(int));
-                    status.graph_data[status.graph_count-1] = val;
-                }
-
-                draw_graph(status.graph_data, status.graph_count, 0, 75);
-            }
+                draw_rssi(dev_cli_rssi(status.cur_cli));
         }
     }
     else if(status.mode == MODE_BEACON)
@@ -425,26 +442,13 @@ void ui_draw(void)
     }
 }
 
-void draw_graph(int * vals, int count, int min, int max)
+// columns of pixels lit from lo[i] to hi[i] (excluded), 0 = bottom of the screen
+void draw_graph(const uint8_t * lo, const uint8_t * hi, int count)
 {
-    uint8_t columns[128];
-    int sch = 8 * 4;        // 4 rows of 8 pixels
-
     // max screen size
     if(count > 128)
         count = 128;
 
-    // auto scale?
-    if(!max)
-        for(size_t i=0; i<count; i++)
-            if(vals[i] > max)
-                max = (vals[i] - min);
-    if(!max)
-        return;
-
-    for(size_t i=0; i<count; i++)
-        columns[i] = sch * (vals[i] - min) / max;
-
     for(int row=0; row<4; row++)
     {
         display.setXY(row, 0);
@@ -452,9 +456,12 @@ void draw_graph(int * vals, int count, int min, int max)
         for(int i=0; i<count; i++)
         {
             uint8_t c = 0;
-            int n_pix = (int)columns[i] - (3 - row) * 8;
-            for(int j=0; j<n_pix && j<8; j++)
-                c |= 1 << (7 - j);
+            for(int j=0; j<8; j++)
+            {
+                int p = (3 - row) * 8 + j;
+                if(p >= lo[i] && p < hi[i])
+                    c |= 1 << (7 - j);
+            }
             display.SendChar(c);
         }
         for(int i=count; i<128; i++)
@@ -462,3 +469,37 @@ void draw_graph(int * vals, int count, int min, int max)
     }
 }
 
+// rssi -100 .. -25 over the 32 pixels
+static uint8_t rssi_px(int8_t rssi)
+{
+    int v = rssi ? (rssi + 100) * 32 / 75 : 0;
+    return v < 0 ? 0 : (v > 32 ? 32 : v);
+}
+
+// left half: older minutes (whiskers = min / max, bar = avg), right half: last seconds
+void draw_rssi(const rssi_hist_t * h)
+{
+    int8_t      fine[RSSI_FINE];
+    rssi_span_t coarse[RSSI_COARSE];
+    uint8_t     lo[128] = {};
+    uint8_t     hi[128] = {};
+    int         cw = 64 / RSSI_COARSE;
+    int         fw = 64 / RSSI_FINE;
+    int         x = 0;
+
+    rssi_get(h, millis(), fine, coarse);
+
+    for(int i=0; i<RSSI_COARSE; i++, x += cw)
+        for(int k=0; k<cw-1 && coarse[i].max; k++)
+        {
+            int edge = k == 0 || k == cw - 2;
+            lo[x + k] = edge ? rssi_px(coarse[i].min) : 0;
+            hi[x + k] = edge ? rssi_px(coarse[i].max) + 1 : rssi_px(coarse[i].avg);
+        }
+
+    for(int i=0; i<RSSI_FINE; i++, x += fw)
+        for(int k=0; k<fw-1 && fine[i]; k++)
+            hi[x + k] = rssi_px(fine[i]);
+
+    draw_graph(lo, hi, 128);
+}
@@ -22,6 +22,7 @@ void    ui_led(int on);
 void    ui_draw(void);
 void    ui_input(void);
 void    ui_click(int btn, int hold);
+void    ui_key(int c);
 void    ui_clear(void);
 
 void    ui_intro(void);
@@ -39,6 +40,10 @@ do                                      \
 
 #define ui_printf(x...) Serial.printf(x)
 
+// serial tx buffer: log lines queue there & the uart interrupt sends them, loop()
+// never waits on the line. when full they are dropped, except for key commands
+#define UI_SERIAL_TXBUF     1024
+
 extern OLED display;
 
 // process buttons
@@ -80,6 +85,7 @@ extern OLED display;
         last_btn_##name = 0;
 
 
-void draw_graph(int * vals, int count, int min, int max);
+void draw_graph(const uint8_t * lo, const uint8_t * hi, int count);
+void draw_rssi(const rssi_hist_t * h);
 
 #endif
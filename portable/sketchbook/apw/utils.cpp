@@ -86,13 +86,12 @@ int fmt_uptime(uint32_t now, char * buf, size_t buf_len)
 {
     uint32_t t = now / 1000;
     if(t < 60)
-        snprintf(buf, buf_len, "%ds", t);
-    else if(t < 60 * 60)
-        snprintf(buf, buf_len, "%dm%ds", t / 60, t % 60);
-    else if(t < 60 * 60 * 24)
-        snprintf(buf, buf_len, "%dh%dm", t / (60 * 60), (t % (60 * 60)) / 60);
-    else
-        snprintf(buf, buf_len, "%dd", t / (60 * 60 * 24));
+        return snprintf(buf, buf_len, "%ds", t);
+    if(t < 60 * 60)
+        return snprintf(buf, buf_len, "%dm%ds", t / 60, t % 60);
+    if(t < 60 * 60 * 24)
+        return snprintf(buf, buf_len, "%dh%dm", t / (60 * 60), (t % (60 * 60)) / 60);
+    return snprintf(buf, buf_len, "%dd", t / (60 * 60 * 24));
 }
 
 // make a random string
@@ -140,58 +139,104 @@ int clamp_modulo(int val, int max)
 #include "Arduino.h"
 #include "oui.h"
 
+#ifdef ENABLE_MAC_LIST
+
+// copy a vendor name out of the pool, with aligned 32-bit flash reads
+static void oui_vendor_name(uint16_t id, char vendor[9])
+{
+    int l = 0;
+    while(l < OUI_VENDOR_LEN && id >= pgm_read_word(&oui_group_id[l + 1]))
+        l += 1;
+
+    uint32_t off = pgm_read_dword(&oui_group_off[l]) + (id - pgm_read_word(&oui_group_id[l])) * l;
+    for(int i=0; i<l; )
+    {
+        uint32_t w = pgm_read_dword(oui_vendors + ((off + i) & ~3));
+        for(int b = (off + i) & 3; b < 4 && i < l; b++, i++)
+            vendor[i] = (char)(w >> (8 * b));
+    }
+    vendor[l] = 0;
+}
+
+// first byte of the oui for entry n
+static uint8_t oui_first_byte(int n)
+{
+    int b = 0;
+    while(b < 255 && pgm_read_word(&oui_index[b + 1]) <= n)
+        b += 1;
+    return b;
+}
+
 void rand_mac(uint8_t* mac)
 {
-    int num = random(sizeof(data_vendors) / 11 - 1);
-    uint8_t i;
+    int      n = random(OUI_COUNT);
+    uint32_t e = pgm_read_dword(&oui_entries[n]);
 
-    for(i=0; i<3; i++)
-        mac[i] = pgm_read_byte_near(data_macs + num * 5 + i);
+    mac[0] = oui_first_byte(n);
+    mac[1] = e >> 24;
+    mac[2] = e >> 16;
 
-    for(i=3; i<6; i++)
+    for(int i=3; i<6; i++)
         mac[i] = random(256);
 }
 
-int bin_search_vendor(uint8_t * search, int beg, int end)
+// returns the oui entry index for this mac, -1 if unknown
+int bin_search_vendor(uint8_t * mac)
 {
-    uint8_t cur[3];
-    int     res;
-    int     mid = (beg + end) / 2;
+    uint16_t key = (mac[1] << 8) | mac[2];
+    int      beg = pgm_read_word(&oui_index[mac[0]]);
+    int      end = pgm_read_word(&oui_index[mac[0] + 1]) - 1;
 
     while(beg <= end)
     {
-        cur[0] = pgm_read_byte_near(data_macs + mid * 5);
-        cur[1] = pgm_read_byte_near(data_macs + mid * 5 + 1);
-        cur[2] = pgm_read_byte_near(data_macs + mid * 5 + 2);
+        int      mid = (beg + end) / 2;
+        uint16_t cur = pgm_read_dword(&oui_entries[mid]) >> 16;
 
-        res = memcmp(search, cur, 3);
-
-        if (res == 0)
+        if(cur == key)
             return mid;
-        else if(res < 0)
-        {
+        else if(cur > key)
             end = mid - 1;
-            mid = (beg + end) / 2;
-        }
-        else if(res > 0)
-        {
+        else
             beg = mid + 1;
-            mid = (beg + end) / 2;
-        }
     }
     return -1;
 }
 
 int search_vendor(uint8_t * mac, char vendor[9])
 {
-    int idx = bin_search_vendor(mac, 0, sizeof(data_macs) / 5 - 1);
-    int pos = pgm_read_byte_near(data_macs + idx * 5 + 3) | pgm_read_byte_near(data_macs + idx * 5 + 4) << 8;
+    int idx = bin_search_vendor(mac);
+    if(idx < 0)
+        return -1;
 
-    if(idx >= 0)
-    {
-        for(int i=0; i<8; i++)
-            vendor[i] = (char)pgm_read_byte_near(data_vendors + pos * 8 + i);
-        return 0;
-    }
+    uint16_t id = pgm_read_dword(&oui_entries[idx]) & 0xffff;
+    oui_vendor_name(id, vendor);
+    return id;
+}
+
+void vendor_name(int id, char vendor[9])
+{
+    vendor[0] = 0;
+    if(id >= 0 && id < OUI_VENDORS)
+        oui_vendor_name(id, vendor);
+}
+
+#else
+
+void rand_mac(uint8_t* mac)
+{
+    for(int i=0; i<6; i++)
+        mac[i] = random(256);
+    mac[0] &= 0xfc;
+}
+
+int search_vendor(uint8_t * mac, char vendor[9])
+{
     return -1;
 }
+
+void vendor_name(int id, char vendor[9])
+{
+    vendor[0] = 0;
+}
+
+#endif
@@ -11,11 +11,17 @@
 #include "wifi.h"
 #include "devs.h"
 #include "utils.h"
-
-// detection settings
-#define TRESHOLD_DEAUTH     5       // per timer duration (1s)
-#define TRESHOLD_KARMA      5000    // max msecs since essid change
-#define TRESHOLD_BEACONS    5       // num fake APs removed since last time
+#include "ring.h"
+#include "sched.h"
+#include "chan.h"
+#include "report.h"
+#include "capture.h"
+#include "detect.h"
+#include "hist.h"
+#include "ie.h"
+#include "prof.h"
+#include "filter.h"
+#include "duty.h"
 
 // internals
 #define MAX_SEND_RETRIES    5       // attempts to send a frame over the air
@@ -23,7 +29,14 @@
 
 // disabled by default
 int FEATURE_BANDHOP = 0;    // hops from B, G & N bands (or stay on N band by default)
-int FEATURE_REPORT = 0;     // turns on AP + client dumping over serial port
+int FEATURE_REPORT = 0;     // turns on the binary AP + client report over serial port (see report.h)
+int FEATURE_CAPTURE = 0;    // streams raw frames over serial port from boot (see capture.h)
+int FEATURE_HISTORY = 0;    // keeps a device history on SPIFFS across reboots (see hist.h)
+int FEATURE_DUTY = 0;       // listen in bursts & deep sleep in between, battery sensors (see duty.h)
+int FEATURE_CHANPLAN = 0;   // detect mode stays on the plan channels, sweeps the others in the background (see chan.h)
+
+// periodic jobs, see sched.cpp
+static int task_cswitch = -1;
 
 
 // ========================================================================= //
@@ -37,6 +50,7 @@ void wifi_init(void)
     status.channel  = 1;
     status.phy      = PHY_MODE_11N;
     status.chanhop  = 1000;
+    status.hop_mode = FEATURE_CHANPLAN ? HOP_PLAN : HOP_ADAPTIVE;
 
     // init promisc sniffing
     wifi_set_opmode(STATION_MODE);
@@ -45,19 +59,36 @@ void wifi_init(void)
     wifi_promiscuous_enable(0);
     wifi_set_promiscuous_rx_cb(wifi_sniff);
     wifi_promiscuous_enable(1);
+    chan_init();
+    filter_init();
+    detect_init();
+    if(FEATURE_CAPTURE)
+        capture_start(NULL);
+    if(FEATURE_HISTORY && !FEATURE_DUTY)
+        hist_init();
+
+    // periodic jobs
+    if(!FEATURE_DUTY)
+        task_cswitch = sched_add("cswitch", cb_cswitch,   status.chanhop);
+    sched_add("report",  report_start, REPORT_PERIOD);
+    sched_add("rpump",   report_pump,  REPORT_PUMP_MS);
+    sched_add("capture", capture_pump, CAPTURE_PUMP_MS);
+    sched_add("beacon",  cb_beacon,    10);
+    sched_add("detect",  detect_tick,  DETECT_TICK_MS);
+    sched_add("cleanup", cb_cleanup,   1066);
+    sched_add("hist",    hist_pump,    HIST_PUMP_MS);
+    if(FEATURE_DUTY)
+        duty_init();
 
     ui_printf("> wifi init done\n");
 }
 
 void wifi_loop(void)
 {
-    uint32_t now = millis();
+    wifi_drain(RING_BATCH);
 
-    WTIMER(status.chanhop,  cb_cswitch);
-    WTIMER(5000,            cb_report);
-    WTIMER(10,              cb_beacon);
-    WTIMER(1033,            cb_detect);
-    WTIMER(1066,            cb_cleanup);
+    // the ui changes the hop interval when focusing on an AP
+    sched_set_period(task_cswitch, status.chanhop);
 }
 
 int wifi_send_pkt(uint8_t * frame, size_t len)
@@ -120,7 +151,7 @@ void wifi_switch_updown(int down)
         status.cur_ap = status.aps;
         status.channel_focus = status.cur_ap->channel;
         status.chanhop = 250;
-        ui_printf("> focusing on AP #%d (%s chan: %d)\n", status.ui_idx, status.cur_ap->essid, status.cur_ap->channel);
+        ui_printf("> focusing on AP #%d (%s chan: %d)\n", status.ui_idx, essid_str(status.cur_ap->essid), status.cur_ap->channel);
     }
     // back to status
     if(status.ui_level == 1 && next_lvl == 0)
@@ -146,7 +177,7 @@ void wifi_switch_updown(int down)
         {
             // select clients view
             case 0:
-                status.cur_cli = status.cur_ap->clients;
+                status.cur_cli = dev_ap_clients(status.cur_ap);
                 status.ui_idx = 0;
                 break;
 
@@ -173,7 +204,6 @@ void wifi_switch_updown(int down)
             // graph view
             case 3:
                 ui_clear();
-                status.graph_count = 0;
                 next_lvl = 4;
                 break;
         }
@@ -185,7 +215,6 @@ void wifi_switch_updown(int down)
     if(status.ui_level == 3 && next_lvl == 4)
     {
         ui_clear();
-        status.graph_count = 0;
         next_lvl = 5;
     }
     // client graph back to client view
@@ -209,7 +238,7 @@ void wifi_switch_leftright(int right)
         }
 
         // go to prev/next ap in circular ll
-        status.cur_ap = right ? status.cur_ap->next : status.cur_ap->prev;
+        status.cur_ap = right ? dev_ap_next(status.cur_ap) : dev_ap_prev(status.cur_ap);
         status.ui_idx = dev_ap_index(status.cur_ap);
 
         // refocus on current AP's channel
@@ -235,9 +264,9 @@ void wifi_switch_leftright(int right)
             status.ui_idx -= status.cur_ap->clients_count;
 
         ui_printf(">> ind: %d\n", status.ui_idx);
-        status.cur_cli = status.cur_ap->clients;
+        status.cur_cli = dev_ap_clients(status.cur_ap);
         for(int i=0; i<status.ui_idx && status.cur_cli; i++)
-            status.cur_cli = status.cur_cli->apnext;
+            status.cur_cli = dev_cli_apnext(status.cur_cli);
         ui_printf(">> ptr: 0x%x\n", status.cur_cli);
     }
     else
@@ -254,6 +283,7 @@ void wifi_shutdown(void)
     ui_line(1, "");
     ui_line(2, "");
     ui_line(3, "");
+    display.flush();
     delay(50);
 
     system_deep_sleep_set_option(RF_DEFAULT);
@@ -265,71 +295,10 @@ void wifi_shutdown(void)
 // timer callbacks
 // ========================================================================= //
 
-// timer to hop channels
+// timer to hop channels, chan_hop() picks the next one & how long we stay
 void cb_cswitch(void)
 {
-    // focusing on a channel? if yes & not currently on it, switch to focused chan
-    if(status.channel_focus && wifi_get_channel() != status.channel_focus)
-    {
-        // ui_printf("> chan switch %d\n", status.channel_focus);
-        wifi_set_channel(status.channel_focus);
-        return;
-    }
-
-    status.channel += 1;
-    if(status.channel > 14)
-    {
-        status.channel = 1;
-
-        if(FEATURE_BANDHOP)
-        {
-            status.phy += 1;
-            if(status.phy > PHY_MODE_11N)
-                status.phy = PHY_MODE_11B;
-            wifi_set_phy_mode((phy_mode)status.phy);
-        }
-    }
-    wifi_set_channel(status.channel);
-    // ui_printf("> chan switch %d\n", status.channel);
-}
-
-// output detected networks & clients
-void cb_report(void)
-{
-    char tmp1[20];
-    char tmp2[20];
-
-    if(!FEATURE_REPORT)
-        return;
-
-    ui_printf("> ap: %d cli: %d\n", status.aps_count, status.clients_count);
-
-    if(status.aps)
-    {
-        wifi_ap_t * ap = status.aps;
-        do
-        {
-            bin_to_hex(ap->mac, 6, tmp1, sizeof(tmp1));
-            ui_printf("AP[%s] e[%-20s] c[%2d] ch[%2d] pkts[%4d] sig[%2d]\n", tmp1, ap->essid, ap->clients_count, ap->channel, ap->beacons, ap->rssi);
-        } while(ap != status.aps);
-    }
-
-    if(status.clients)
-    {
-        wifi_client_t * cli = status.clients;
-        do
-        {
-            wifi_ap_t * ap  = cli->ap;
-
-            bin_to_hex(cli->mac, 6, tmp1, sizeof(tmp1));
-            if(ap)
-                bin_to_hex(ap->mac, 6, tmp2, sizeof(tmp2));
-            else
-                snprintf(tmp2, sizeof(tmp2), "n/a");
-
-            ui_printf("CLI[%s] assoc[%s] essid[%s] pkts[%d] rssi[%d]\n", tmp1, tmp2, ap ? ap->essid : "n/a", cli->pkt_count, cli->rssi);
-        } while(cli != status.clients);
-    }
+    sched_defer(task_cswitch, chan_hop());
 }
 
 // send a fake beacon
@@ -370,99 +339,138 @@ void cb_beacon(void)
     }
 }
 
-// detect attacks
-void cb_detect(void)
+void cb_cleanup(void)
 {
-    static uint32_t last_pkt_deauth = 0;
-    static uint32_t last_fake_aps = 0;
+    PROF_START(PROF_CLEANUP);
+    int n = devs_cleanup();
+    PROF_END(PROF_CLEANUP);
+    if(n > 0)
+        ui_printf("> cleaned up %d devs\n", n);
+}
 
-    uint32_t now = millis();
 
-    status.detected_deauth = 0;
-    status.detected_beacon = 0;
-    status.detected_karma  = 0;
+// ========================================================================= //
+// frame parsing
+// ========================================================================= //
 
-    // deauth attacks detection
-    if(status.detected_pkt_deauth - last_pkt_deauth > TRESHOLD_DEAUTH)
-    {
-        ui_printf("> deauth attack detected! %d deauth packets!\n", status.detected_pkt_deauth - last_pkt_deauth);
-        status.detected_deauth = 1;
-    }
-    last_pkt_deauth = status.detected_pkt_deauth;
+// promisc rx callback: keep a summary of the frame for the main loop
+// runs in sdk context, no parsing / allocation / logging / sending here
+// frames the prefilter drops still count as channel activity
+static inline void sniff(uint8_t * buf, uint16_t len)
+{
+    struct RxControl * hdr = (struct RxControl *)buf;
+    frame_t * frame = (frame_t*) ((uint8_t *)buf + sizeof(struct RxControl));
+    size_t frame_len = len > sizeof(struct RxControl) ? len - sizeof(struct RxControl) : 0;
 
-    // karma detection
-    if(status.aps)
+    uint8_t channel = hdr->channel ? hdr->channel : status.channel;
+
+    status.pkt_recv += 1;
+    chan_frame(channel);
+
+    // the sdk only gives us the start of the frame, past the real length the buffer
+    // holds whatever the previous frame left there
+    if(len == sizeof(struct sniffer_buf2))
     {
-        wifi_ap_t * ap = status.aps;
-        do
-        {
-            if(ap->essid_time && now - ap->essid_time < TRESHOLD_KARMA && ap->essid_count > 1)
-            {
-                status.detected_karma = 1;
-                char tmp[20];
-                bin_to_hex(ap->mac, 6, tmp, sizeof(tmp));
-                ui_printf("> karma attack detected for mac %s (%s)!\n", tmp, ap->essid);
-            }
-
-        } while(ap != status.aps);
+        struct sniffer_buf2 * sb = (struct sniffer_buf2 *)buf;
+        frame_len = sb->len < sizeof(sb->buf) ? sb->len : sizeof(sb->buf);
+        capture_frame(sb->buf, sizeof(sb->buf), sb->len, hdr->rssi, channel);
     }
-
-    // beacon spam detect
-    if(status.detected_fake_aps - last_fake_aps > TRESHOLD_BEACONS)
+    else if(len == sizeof(struct sniffer_buf))
     {
-        ui_printf("> beacon spam detected! %d fake aps removed!\n", status.detected_fake_aps - last_fake_aps);
-        status.detected_beacon = 1;
+        struct sniffer_buf * sb = (struct sniffer_buf *)buf;
+        frame_len = sb->lenseq[0].length < sizeof(sb->buf) ? sb->lenseq[0].length : sizeof(sb->buf);
+        capture_frame(sb->buf, sizeof(sb->buf), sb->lenseq[0].length, hdr->rssi, channel);
     }
-    last_fake_aps = status.detected_fake_aps;
+    else if(len > sizeof(struct RxControl))
+        capture_frame((uint8_t *)frame, frame_len, frame_len, hdr->rssi, channel);
+
+    if(len < sizeof(struct RxControl) || filter_frame(frame, frame_len) != FILTER_PASS)
+        return;
+
+    frame_sum_t * sum = ring_claim();
+    if(!sum)
+        return;
+
+    sum->rssi       = hdr->rssi;
+    sum->channel    = channel;
+    sum->len        = sizeof(frame_t);
+
+    // beacons & probe responses: keep the fixed params & first IEs, probe requests: the essid
+    if((frame->type & 0xf0) == 0x80 || (frame->type & 0xf0) == 0x50 || frame->type == 0x40)
+        sum->len = frame_len < sizeof(sum->frame) ? frame_len : sizeof(sum->frame);
+
+    memcpy(sum->frame, frame, sum->len);
+
+    ring_commit();
 }
 
-void cb_cleanup(void)
+void wifi_sniff(uint8_t * buf, uint16_t len)
 {
-    int n = devs_cleanup();
-    if(n > 0)
-        ui_printf("> cleaned up %d devs\n", n);
+    PROF_START(PROF_SNIFF);
+    sniff(buf, len);
+    PROF_END(PROF_SNIFF);
 }
 
+// handle frames queued by wifi_sniff(), at most max of them
+// returns number of frames handled
+int wifi_drain(int max)
+{
+    frame_sum_t * sum;
+    int n = 0;
 
-// ========================================================================= //
-// frame parsing
-// ========================================================================= //
+    while(n < max && (sum = ring_peek()) != NULL)
+    {
+        wifi_frame(sum);
+        ring_release();
+        n += 1;
+    }
 
-// frame parsing callback
-void wifi_sniff(uint8_t * buf, uint16_t len)
+    return n;
+}
+
+// frame processing, main loop context
+void wifi_frame(frame_sum_t * sum)
 {
-    struct RxControl * hdr = (struct RxControl *)buf;
-    frame_t * frame = (frame_t*) ((uint8_t *)buf + sizeof(struct RxControl));
-    size_t frame_len = len - sizeof(struct RxControl);
+    frame_t * frame = (frame_t *)sum->frame;
+    size_t frame_len = sum->len;
 
     char essid[33] = {};
     uint8_t chan = 0;
     uint8_t enc = 0;
     uint8_t ht = 0;
 
-    status.pkt_recv += 1;
-
-    if(len < sizeof(struct RxControl) || frame_len < sizeof(frame_t))
-        return;
-
     // try to parse beacon / probe responses
-    if(parse_beacon(frame, frame_len, essid, &chan, &enc, &ht) == 0)
+    PROF_START(PROF_BEACON);
+    int beacon = parse_beacon(frame, frame_len, essid, &chan, &enc, &ht) == 0;
+    PROF_END(PROF_BEACON);
+    if(beacon)
     {
-        devs_lock();
+        PROF_START(PROF_AP);
         wifi_ap_t * ap = dev_ap_find(frame->addr3, 1);
+        if(ap)
+            dev_ap_update(ap, sum->rssi, essid, chan ? chan : sum->channel, enc, ht);
+        PROF_END(PROF_AP);
+
+        // untracked (pool full, counted in status.aps_full, or bad mac): not churn
         if(!ap)
-        {
-            devs_unlock();
             return;
-        }
-
-        dev_ap_update(ap, hdr->rssi, essid, chan ? chan : status.channel, enc, ht);
-        devs_unlock();
+        if(ap->beacons == 1)
+            detect_ap_new(sum->channel);
     }
 
-    // deauth
+    // deauth / disassoc, addr3 is the bssid
     if(frame->type == 0xA0 || frame->type == 0xC0)
+    {
         status.detected_pkt_deauth += 1;
+        detect_deauth(frame->addr3, sum->channel);
+    }
+
+    // directed probe request, addr2 is the client
+    if(frame->type == 0x40)
+    {
+        wifi_probe(frame, frame_len, sum->rssi);
+        return;
+    }
 
     // we need mac addrs from here on
     uint8_t * cmac = NULL;
@@ -473,16 +481,14 @@ void wifi_sniff(uint8_t * buf, uint16_t len)
     // data frame
     if((frame->type & 0x0f) == 0x08)
     {
-        devs_lock();
+        PROF_START(PROF_CLI);
         wifi_client_t * cli = dev_cli_find(cmac);
         wifi_ap_t *     ap  = dev_ap_find(amac, 0);
+        if(cli)
+            dev_cli_update(cli, ap, sum->rssi);
+        PROF_END(PROF_CLI);
         if(!cli)
-        {
-            devs_unlock();
             return;
-        }
-        dev_cli_update(cli, ap, hdr->rssi);
-        devs_unlock();
     }
 
     // deauth all the things ?!
@@ -504,9 +510,8 @@ void wifi_sniff(uint8_t * buf, uint16_t len)
         if(do_deauth)
         {
             uint8_t  packet_buffer[64];
-            uint16_t seq = (((uint8_t*)frame)[23] << 8) | ((uint8_t*)frame)[22];
 
-            size_t l = craft_deauth(packet_buffer, cmac, amac, seq + 0x10);
+            size_t l = craft_deauth(packet_buffer, cmac, amac, frame->seq + 0x10);
             wifi_send_pkt(packet_buffer, l);
             status.attack_time = millis();
         }
@@ -514,6 +519,25 @@ void wifi_sniff(uint8_t * buf, uint16_t len)
 }
 
 
+// clients looking for a network by name, wildcard probes tell nothing & are skipped
+void wifi_probe(frame_t * frame, size_t frame_len, int8_t rssi)
+{
+    ie_info_t info;
+
+    if(!(ie_parse(frame->data, frame_len - sizeof(frame_t), IE_F_SSID, &info) & IE_F_SSID) || !info.ssid_len || !info.ssid[0])
+        return;
+    status.probes_seen += 1;
+
+    PROF_START(PROF_CLI);
+    wifi_client_t * cli = dev_cli_find(frame->addr2);
+    if(cli)
+    {
+        dev_cli_update(cli, NULL, rssi);
+        dev_cli_probe(cli, (const char *)info.ssid, info.ssid_len);
+    }
+    PROF_END(PROF_CLI);
+}
+
 // returns client & bss macs
 // will make sure the addresses are valid (not multicast / broadcast / ...)
 int frame_get_macs(frame_t * frame, size_t frame_len, uint8_t ** cli, uint8_t ** bss)
@@ -546,64 +570,33 @@ int frame_get_macs(frame_t * frame, size_t frame_len, uint8_t ** cli, uint8_t **
 // extract essid, chan, enctype & ht from beacon
 int parse_beacon(frame_t * frame, size_t len, char essid[33], uint8_t * channel, uint8_t * enc, uint8_t * ht)
 {
-    int ret = -1;
+    ie_info_t info;
 
-    // expect frame of type beacon
-    if((frame->type & 0xf0) != 0x80)
-        // or probe response
-        if((frame->type & 0xf0) != 0x50)
-            return -1;
-
-    // parse fixed params (wep)
-    if(*(uint16_t*)&frame->data[10] & 0x10)
-        *enc = AP_ENC_WEP;
+    // expect frame of type beacon or probe response
+    if(frame->type != 0x80 && frame->type != 0x50)
+        return -1;
 
-    // skip fixed params now
-    uint8_t * p = &frame->data[0] + 12;
+    // fixed params: timestamp, beacon interval, capabilities
+    if(len < sizeof(frame_t) + BEACON_FIXED_LEN)
+        return -1;
 
-    // parse dynamic params
-    while(p + 3 < ((uint8_t*)frame + len))
-    {
-        uint8_t t = p[0];
-        uint8_t l = p[1];
+    // valid beacon / probe resp if it has an essid element (empty when hidden)
+    if(!(ie_parse(frame->data + BEACON_FIXED_LEN, len - sizeof(frame_t) - BEACON_FIXED_LEN, IE_F_ALL, &info) & IE_F_SSID))
+        return -1;
 
-        // dont parse incomplete blocks
-        if(p + l >= ((uint8_t*)frame + len))
-            break;
+    uint8_t l = info.ssid_len > 32 ? 32 : info.ssid_len;
+    memcpy(essid, info.ssid, l);
+    essid[l] = 0;
 
-        // valid beacon / probe resp if we're here
-        ret = 0;
+    if(info.found & IE_F_DS)
+        *channel = info.channel;
+    if(info.found & IE_F_VHT)
+        *ht = AP_BAND_VHT;
+    else if(info.found & IE_F_HT)
+        *ht = AP_BAND_HT;
+    *enc = ie_enc(&info, frame->data[BEACON_CAPA] & BEACON_CAPA_PRIVACY);
 
-        // parse essid
-        if(t == 0)
-        {
-            memcpy(essid, p + 2, l > 32 ? 32 : l);
-            essid[l > 32 ? 32 : l] = 0;
-        }
-        // parse current channel
-        else if(t == 3)
-            *channel = p[2];
-        // HT capabilities
-        else if(t == 0x2d)
-            *ht = 1;
-        // VHT capa
-        else if(t == 0xbf)
-            *ht = 2;
-        // vendor specific
-        else if(t == 0xdd)
-        {
-            // wpa1
-            if(!memcmp(&p[2], "\x00\x50\xf2", 3))
-                *enc = AP_ENC_WPA1;
-        }
-        // wpa2
-        else if(t == 0x30)
-            *enc = AP_ENC_WPA2;
-
-        p += l + 2;
-    }
-
-    return ret;
+    return 0;
 }
 
 
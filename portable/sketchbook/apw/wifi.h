@@ -44,6 +44,30 @@ struct RxControl
     unsigned:12;
 };
 
+// promiscuous buffers handed to the rx callback, depending on the frame
+struct LenSeq
+{
+    uint16_t    length;             // frame length
+    uint16_t    seq;
+    uint8_t     address3[6];
+};
+
+struct sniffer_buf                  // data frames, 60 bytes
+{
+    struct RxControl rx_ctrl;
+    uint8_t     buf[36];            // first bytes of the frame
+    uint16_t    cnt;
+    struct LenSeq lenseq[1];
+};
+
+struct sniffer_buf2                 // management frames, 128 bytes
+{
+    struct RxControl rx_ctrl;
+    uint8_t     buf[112];           // first bytes of the frame
+    uint16_t    cnt;
+    uint16_t    len;                // frame length
+};
+
 typedef struct frame_t
 {
     uint8_t     type;
@@ -58,6 +82,11 @@ typedef struct frame_t
 } frame_t;
 
 
+// beacon / probe response body: timestamp (8), interval (2), capabilities (2), elements
+#define BEACON_FIXED_LEN    12
+#define BEACON_CAPA         10
+#define BEACON_CAPA_PRIVACY 0x10
+
 #define AP_ENC_OPEN         0
 #define AP_ENC_WEP          1
 #define AP_ENC_WPA1         2
@@ -71,6 +100,14 @@ typedef struct frame_t
 #define AP_BAND_HT          1
 #define AP_BAND_VHT         2
 
+// features, see wifi.cpp
+extern int FEATURE_BANDHOP;
+extern int FEATURE_REPORT;
+extern int FEATURE_CAPTURE;
+extern int FEATURE_HISTORY;
+extern int FEATURE_DUTY;
+extern int FEATURE_CHANPLAN;
+
 // main funcs
 void wifi_init(void);
 void wifi_loop(void);
@@ -81,7 +118,11 @@ int  wifi_send_pkt(uint8_t * frame, size_t len);
 void wifi_shutdown(void);
 
 // frame parsing
+struct frame_sum_t;
 void wifi_sniff(uint8_t * buf, uint16_t len);
+int  wifi_drain(int max);
+void wifi_frame(struct frame_sum_t * sum);
+void wifi_probe(frame_t * frame, size_t frame_len, int8_t rssi);
 int  parse_beacon(frame_t * frame, size_t len, char essid[33], uint8_t * channel, uint8_t * enc, uint8_t * ht);
 int  frame_get_macs(frame_t * frame, size_t frame_len, uint8_t ** cli, uint8_t ** bss);
 
@@ -92,9 +133,7 @@ uint16_t craft_data(uint8_t * buf, uint8_t * cli, uint8_t * bss, int from_ds, ui
 
 // timer callbacks
 void cb_cswitch(void);
-void cb_report(void);
 void cb_beacon(void);
-void cb_detect(void);
 void cb_cleanup(void);
 
 